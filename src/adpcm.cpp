@@ -0,0 +1,49 @@
+#include "adpcm.h"
+
+static const int8_t INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t STEP_TABLE[ADPCM_STEP_MAX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static inline int16_t decode_nibble(int& pred, int& index, uint8_t n)
+{
+    int step = STEP_TABLE[index];
+    int diff = step >> 3;
+    if (n & 4) diff += step;
+    if (n & 2) diff += step >> 1;
+    if (n & 1) diff += step >> 2;
+
+    pred += (n & 8) ? -diff : diff;
+    if (pred > 32767) pred = 32767;
+    else if (pred < -32768) pred = -32768;
+
+    index += INDEX_TABLE[n];
+    if (index < 0) index = 0;
+    else if (index > ADPCM_STEP_MAX) index = ADPCM_STEP_MAX;
+
+    return (int16_t)pred;
+}
+
+void adpcm_decode(AdpcmState* st, const uint8_t* in, size_t n, int16_t* out)
+{
+    int pred = st->predictor;
+    int index = st->step_index > ADPCM_STEP_MAX ? ADPCM_STEP_MAX : st->step_index;
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t b = in[i];
+        *out++ = decode_nibble(pred, index, b & 0x0F);
+        *out++ = decode_nibble(pred, index, b >> 4);
+    }
+
+    st->predictor = (int16_t)pred;
+    st->step_index = (uint8_t)index;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// IMA-ADPCM (4 bits per 16-bit sample) decoder for the voice prompts. Pure
+// code, shared with the host benchmark; tools/pack_voice.py is the encoder.
+//
+// A clip is one continuous mono stream: low nibble first, starting from the
+// predictor and step index stored with it. There are no per-block headers,
+// so decoding can stop and resume at any byte.
+
+#define ADPCM_STEP_MAX  88
+
+struct AdpcmState {
+    int16_t predictor;
+    uint8_t step_index;
+};
+
+// Decodes n bytes into 2 * n samples and advances the state.
+void adpcm_decode(AdpcmState* st, const uint8_t* in, size_t n, int16_t* out);
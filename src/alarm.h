@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+enum class AlarmState {
+    DISARMED,
+    EXIT_DELAY,
+    ARMED,
+    ALARM
+};
+
+enum class AlarmEventType {
+    ARM_LOCAL,
+    ARM_REMOTE,
+    DISARM_PIN_OK,
+    DISARM_OVERRIDE,
+    DISARM_REMOTE,
+    MOTION_DETECTED,
+    RESET,
+    FAULT               // a real-time task keeps missing its deadlines
+};
+
+enum class RemoteCommandType {
+    NONE,
+    ARM,
+    DISARM
+};
+
+// Where an event came from. Everything the panel generates itself is
+// LOCAL; remote commands are tagged by the producer that delivered them.
+enum class EventSource : uint8_t {
+    LOCAL,
+    MQTT,
+    LAN,
+    RF,
+    SERIAL,
+    COUNT
+};
+
+struct AlarmEvent {
+    AlarmEventType type;
+    int64_t t_us;       // esp_timer time the event was posted
+    EventSource source;
+    uint8_t ack_ref;    // 1-based command-ack slot, 0 if nobody wants an ack
+    uint32_t cmd_id;    // producer's id for a remote command (LAN seq, ...), 0 if none
+};
+
+// Queue registry name of the AlarmEvent queue alarm_task reads.
+#define EVENT_QUEUE_NAME "alarm_events"
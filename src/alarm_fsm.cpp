@@ -0,0 +1,120 @@
+#include "alarm_fsm.h"
+
+static bool is_disarm(AlarmEventType type)
+{
+    return type == AlarmEventType::DISARM_PIN_OK ||
+           type == AlarmEventType::DISARM_OVERRIDE ||
+           type == AlarmEventType::DISARM_REMOTE;
+}
+
+void alarm_fsm_init(AlarmFsm* fsm)
+{
+    fsm->state = AlarmState::DISARMED;
+    fsm->exit_deadline_ms = 0;
+    fsm->exit_seconds_remaining = 0;
+}
+
+AlarmStep alarm_fsm_on_event(AlarmFsm* fsm, AlarmEventType type, uint32_t now_ms)
+{
+    AlarmStep step = {};
+    AlarmState old = fsm->state;
+
+    // Reported, never acted on: a late sensor must not disarm the panel, and
+    // tripping the siren on scheduling trouble would be a false alarm.
+    if (type == AlarmEventType::FAULT)
+    {
+        step.note = "Real-time fault reported";
+        return step;
+    }
+
+    switch (fsm->state)
+    {
+        case AlarmState::DISARMED:
+            if (type == AlarmEventType::ARM_LOCAL ||
+                type == AlarmEventType::ARM_REMOTE)
+            {
+                fsm->state = AlarmState::EXIT_DELAY;
+                fsm->exit_deadline_ms = now_ms + EXIT_DELAY_MS;
+                fsm->exit_seconds_remaining = EXIT_DELAY_MS / 1000;
+
+                step.lcd_message = "EXIT DELAY";
+                step.note = "Exit delay started";
+            }
+            break;
+
+        case AlarmState::EXIT_DELAY:
+            if (is_disarm(type))
+            {
+                fsm->state = AlarmState::DISARMED;
+                step.lcd_message = "DISARMED";
+                step.note = "Exit delay cancelled";
+            }
+            break;
+
+        case AlarmState::ARMED:
+            if (type == AlarmEventType::MOTION_DETECTED)
+            {
+                fsm->state = AlarmState::ALARM;
+                step.lcd_message = "ALARM TRIGGERED";
+                step.note = "Motion → ALARM";
+            }
+            else if (is_disarm(type))
+            {
+                fsm->state = AlarmState::DISARMED;
+                step.lcd_message = "DISARMED";
+            }
+            break;
+
+        case AlarmState::ALARM:
+            if (is_disarm(type) || type == AlarmEventType::RESET)
+            {
+                fsm->state = AlarmState::DISARMED;
+                step.lcd_message = "DISARMED";
+            }
+            break;
+    }
+
+    step.changed = old != fsm->state;
+    return step;
+}
+
+AlarmStep alarm_fsm_tick(AlarmFsm* fsm, uint32_t now_ms)
+{
+    AlarmStep step = {};
+
+    if (fsm->state != AlarmState::EXIT_DELAY) return step;
+
+    int32_t left_ms = (int32_t)(fsm->exit_deadline_ms - now_ms);
+
+    if (left_ms <= 0)
+    {
+        fsm->state = AlarmState::ARMED;
+        fsm->exit_seconds_remaining = 0;
+        step.changed = true;
+        step.lcd_message = "ARMED";
+        step.note = "System ARMED";
+    }
+    else
+    {
+        int sec_left = left_ms / 1000;
+
+        if (sec_left != fsm->exit_seconds_remaining)
+        {
+            fsm->exit_seconds_remaining = sec_left;
+            step.countdown_changed = true;
+        }
+    }
+
+    return step;
+}
+
+const char* alarm_fsm_screen(AlarmState state)
+{
+    switch (state) {
+        case AlarmState::DISARMED:   return "DISARMED";
+        case AlarmState::EXIT_DELAY: return "EXIT DELAY";
+        case AlarmState::ARMED:      return "ARMED";
+        case AlarmState::ALARM:      return "ALARM TRIGGERED";
+    }
+    return "DISARMED";
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "alarm.h"
+
+// The alarm state machine, free of RTOS and peripheral calls so it can be
+// driven by alarm_task on the device and by host tools alike. Time is a
+// caller-supplied millisecond clock.
+
+#define EXIT_DELAY_MS 15000
+
+struct AlarmFsm {
+    AlarmState state;
+    uint32_t   exit_deadline_ms;
+    int        exit_seconds_remaining;
+};
+
+// What alarm_task has to do after a step.
+struct AlarmStep {
+    bool        changed;            // state differs from before the step
+    bool        countdown_changed;  // exit_seconds_remaining ticked down
+    const char* lcd_message;        // for lcd_show_message(), nullptr if none
+    const char* note;               // log line, nullptr if none
+};
+
+void alarm_fsm_init(AlarmFsm* fsm);
+
+AlarmStep alarm_fsm_on_event(AlarmFsm* fsm, AlarmEventType type, uint32_t now_ms);
+
+// Advances the exit delay; call at least every 100 ms while in EXIT_DELAY.
+AlarmStep alarm_fsm_tick(AlarmFsm* fsm, uint32_t now_ms);
+
+// LCD message for a state, as shown when entering it.
+const char* alarm_fsm_screen(AlarmState state);
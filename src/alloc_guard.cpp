@@ -0,0 +1,66 @@
+#include "alloc_guard.h"
+#include "task_config.h"
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+static const char* TAG = "ALLOC_GUARD";
+
+static std::atomic<bool>     s_armed{false};
+static std::atomic<uint32_t> s_count{0};
+
+void alloc_guard_arm()
+{
+    s_armed = true;
+    ESP_LOGI(TAG, "Armed (%s), free heap %u",
+             ALLOC_GUARD_TRAP ? "trap" : "count",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+}
+
+uint32_t alloc_guard_count()
+{
+    return s_count;
+}
+
+void alloc_guard_report()
+{
+    ESP_LOGI(TAG, "post-boot allocations=%lu free=%u min_free=%u",
+             (unsigned long)s_count.load(),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+}
+
+#if STATIC_ALLOC_BUILD
+
+static void* guarded_alloc(size_t size)
+{
+    if (s_armed) {
+        s_count++;
+        if (ALLOC_GUARD_TRAP) {
+            // ESP_LOG may itself allocate on some paths; stick to the ROM printf.
+            esp_rom_printf("ALLOC_GUARD: %u byte allocation after boot\n",
+                           (unsigned)size);
+            abort();
+        }
+    }
+
+    void* p = malloc(size ? size : 1);
+    if (!p) abort();
+    return p;
+}
+
+void* operator new(size_t size)                           { return guarded_alloc(size); }
+void* operator new[](size_t size)                         { return guarded_alloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept   { return guarded_alloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return guarded_alloc(size); }
+
+void operator delete(void* p) noexcept           { free(p); }
+void operator delete[](void* p) noexcept         { free(p); }
+void operator delete(void* p, size_t) noexcept   { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#endif
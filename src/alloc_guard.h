@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Post-boot allocation guard for STATIC_ALLOC_BUILD.
+//
+// Once armed (at the end of app_main), every C++ heap allocation made by the
+// firmware is counted. Build with -DALLOC_GUARD_TRAP=1 to abort on the first
+// one instead, which gives a backtrace to the offending call site.
+#ifndef ALLOC_GUARD_TRAP
+#define ALLOC_GUARD_TRAP 0
+#endif
+
+void alloc_guard_arm();
+
+uint32_t alloc_guard_count();
+
+// Logs the violation count together with current and minimum free heap.
+void alloc_guard_report();
@@ -0,0 +1,124 @@
+#include "baseline.h"
+
+#include <math.h>
+#include <string.h>
+
+static float threshold_cm(const Baseline* b)
+{
+    float t = BASELINE_K * baseline_sigma_cm(b);
+    return t > BASELINE_MIN_DELTA_CM ? t : BASELINE_MIN_DELTA_CM;
+}
+
+void baseline_init(Baseline* b)
+{
+    memset(b, 0, sizeof(*b));
+}
+
+bool baseline_ready(const Baseline* b)
+{
+    return b->n >= BASELINE_WARMUP;
+}
+
+float baseline_sigma_cm(const Baseline* b)
+{
+    float s = sqrtf(b->var_cm2);
+    return s > BASELINE_MIN_SIGMA_CM ? s : BASELINE_MIN_SIGMA_CM;
+}
+
+void baseline_learn(Baseline* b, int cm)
+{
+    if (cm <= 0) return;
+
+    float x = (float)cm;
+
+    if (b->n == 0) {
+        b->mean_cm = x;
+        b->var_cm2 = 0.0f;
+        b->n = 1;
+        return;
+    }
+
+    float diff = x - b->mean_cm;
+    if (baseline_ready(b) && fabsf(diff) > threshold_cm(b)) {
+        if (++b->rejected >= BASELINE_RELEARN) baseline_init(b);
+        return;
+    }
+    b->rejected = 0;
+
+    // Until warm-up is over, average over the samples seen so far so the
+    // first readings do not dominate.
+    float alpha = b->n < BASELINE_WARMUP && 1.0f / (b->n + 1) > BASELINE_ALPHA
+                      ? 1.0f / (b->n + 1) : BASELINE_ALPHA;
+
+    float incr = alpha * diff;
+    b->mean_cm += incr;
+    b->var_cm2 = (1.0f - alpha) * (b->var_cm2 + diff * incr);
+    if (b->n < UINT32_MAX) b->n++;
+}
+
+bool baseline_is_motion(Baseline* b, int cm)
+{
+    if (cm <= 0) return false;      // no echo says nothing either way
+
+    if (fabsf((float)cm - b->mean_cm) > threshold_cm(b)) {
+        if (b->hits < BASELINE_HITS) b->hits++;
+    } else {
+        b->hits = 0;
+    }
+    return b->hits >= BASELINE_HITS;
+}
+
+#if defined(ESP_PLATFORM)
+
+#include "nvs.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char* TAG = "BASELINE";
+
+bool baseline_load(int sensor, Baseline* b)
+{
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READONLY, &h) != ESP_OK) return false;
+
+    char key[8];
+    snprintf(key, sizeof(key), "bl%d", sensor);
+
+    Baseline stored;
+    size_t len = sizeof(stored);
+    esp_err_t err = nvs_get_blob(h, key, &stored, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK || len != sizeof(stored) || !isfinite(stored.mean_cm) ||
+        !isfinite(stored.var_cm2)) {
+        return false;
+    }
+
+    *b = stored;
+    b->hits = 0;
+    b->rejected = 0;
+    ESP_LOGI(TAG, "Sensor %d baseline %.1f cm, sigma %.1f cm (%lu samples)",
+             sensor, b->mean_cm, baseline_sigma_cm(b), (unsigned long)b->n);
+    return true;
+}
+
+void baseline_save(int sensor, const Baseline* b)
+{
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS");
+        return;
+    }
+
+    char key[8];
+    snprintf(key, sizeof(key), "bl%d", sensor);
+
+    nvs_set_blob(h, key, b, sizeof(*b));
+    nvs_commit(h);
+    nvs_close(h);
+
+    ESP_LOGI(TAG, "Sensor %d baseline saved: %.1f cm, sigma %.1f cm",
+             sensor, b->mean_cm, baseline_sigma_cm(b));
+}
+
+#endif
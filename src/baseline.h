@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Learned background distance per ultrasonic sensor, replacing the fixed
+// 100 cm motion threshold.
+//
+// While the alarm is DISARMED every valid reading updates an exponentially
+// weighted mean and variance (O(1), a few floats per sensor). Readings that
+// already look like motion are not learned, so someone walking past a
+// disarmed sensor does not drag the baseline. Once BASELINE_WARMUP samples
+// are in, a reading is motion when it differs from the mean by more than
+// BASELINE_K sigma (and at least BASELINE_MIN_DELTA_CM) for BASELINE_HITS
+// samples in a row. Before that, callers fall back to the fixed threshold.
+// If the scene changes for good (furniture moved, sensor bumped), learning
+// keeps rejecting readings; after BASELINE_RELEARN of them in a row the model
+// starts over.
+
+#define BASELINE_SENSORS        1
+#define BASELINE_ALPHA          (1.0f / 64)
+#define BASELINE_WARMUP         200        // ~30 s at the 150 ms period
+#define BASELINE_K              4.0f
+#define BASELINE_MIN_DELTA_CM   15.0f
+#define BASELINE_MIN_SIGMA_CM   2.0f
+#define BASELINE_HITS           2
+#define BASELINE_RELEARN        400        // ~60 s of rejected samples
+
+struct Baseline {
+    float    mean_cm;
+    float    var_cm2;
+    uint32_t n;
+    uint16_t rejected;
+    uint8_t  hits;
+};
+
+void baseline_init(Baseline* b);
+
+bool baseline_ready(const Baseline* b);
+
+// Only call while DISARMED.
+void baseline_learn(Baseline* b, int cm);
+
+// True when cm deviates from the baseline; needs baseline_ready().
+bool baseline_is_motion(Baseline* b, int cm);
+
+float baseline_sigma_cm(const Baseline* b);
+
+#if defined(ESP_PLATFORM)
+
+// NVS persistence under namespace "alarm", key "bl<sensor>".
+bool baseline_load(int sensor, Baseline* b);
+void baseline_save(int sensor, const Baseline* b);
+
+#endif
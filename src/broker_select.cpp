@@ -0,0 +1,138 @@
+#include "broker_select.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t smooth(uint32_t avg, uint32_t sample)
+{
+    if (sample == 0) sample = 1;            // 0 means "not measured"
+    return avg ? (avg * 3 + sample) / 4 : sample;
+}
+
+static void mark_ok(BrokerHealth& h, uint32_t now_ms)
+{
+    h.fail_run = 0;
+    if (h.ok_run < BROKER_OKS_UP) h.ok_run++;
+    if (!h.healthy && h.ok_run >= BROKER_OKS_UP) {
+        h.healthy = true;
+        h.healthy_since_ms = now_ms;
+    }
+}
+
+static void mark_failed(BrokerHealth& h)
+{
+    h.ok_run = 0;
+    if (h.fail_run < BROKER_FAILS_DOWN) h.fail_run++;
+    if (h.fail_run >= BROKER_FAILS_DOWN) h.healthy = false;
+}
+
+// a answers faster than b by more than the margin. Unmeasured never wins.
+static bool faster(const BrokerHealth& a, const BrokerHealth& b)
+{
+    return a.probe_rtt_ms && b.probe_rtt_ms &&
+           a.probe_rtt_ms + BROKER_RTT_MARGIN_MS < b.probe_rtt_ms;
+}
+
+static int preferred(const BrokerSel* s)
+{
+    int best = -1;
+    for (int i = 0; i < s->count; i++) {
+        if (!s->b[i].healthy) continue;
+        if (best < 0 || faster(s->b[i], s->b[best])) best = i;
+    }
+    return best;
+}
+
+void broker_sel_init(BrokerSel* s, uint8_t count, uint32_t now_ms)
+{
+    memset(s, 0, sizeof(*s));
+    s->count = count > BROKER_MAX ? BROKER_MAX : count;
+    s->preferred = 0;
+    s->preferred_since_ms = now_ms;
+    for (int i = 0; i < s->count; i++) {
+        s->b[i].healthy = true;
+        s->b[i].healthy_since_ms = now_ms;
+    }
+}
+
+void broker_sel_probe(BrokerSel* s, uint8_t i, bool ok, uint32_t rtt_ms, uint32_t now_ms)
+{
+    BrokerHealth& h = s->b[i];
+    h.probes++;
+    if (ok) {
+        h.probe_rtt_ms = smooth(h.probe_rtt_ms, rtt_ms);
+        mark_ok(h, now_ms);
+    } else {
+        h.probe_fails++;
+        mark_failed(h);
+    }
+}
+
+void broker_sel_connected(BrokerSel* s, uint8_t i, uint32_t connect_ms, uint32_t now_ms)
+{
+    BrokerHealth& h = s->b[i];
+    h.connects++;
+    h.connect_ms = connect_ms;
+    if (connect_ms > h.max_connect_ms) h.max_connect_ms = connect_ms;
+
+    // A broker that just accepted us is healthy, whatever the probes said.
+    h.ok_run = BROKER_OKS_UP - 1;
+    mark_ok(h, now_ms);
+}
+
+void broker_sel_failed(BrokerSel* s, uint8_t i, uint32_t now_ms)
+{
+    s->b[i].conn_fails++;
+    mark_failed(s->b[i]);
+}
+
+void broker_sel_pub_rtt(BrokerSel* s, uint8_t i, uint32_t rtt_ms)
+{
+    s->b[i].pub_rtt_ms = smooth(s->b[i].pub_rtt_ms, rtt_ms);
+}
+
+uint8_t broker_sel_choose(BrokerSel* s, uint32_t now_ms)
+{
+    int p = preferred(s);
+    if (p != s->preferred) {
+        s->preferred = (int8_t)p;
+        s->preferred_since_ms = now_ms;
+    }
+    if (p < 0 || p == s->active) return s->active;
+
+    bool move = !s->b[s->active].healthy ||
+                (now_ms - s->b[p].healthy_since_ms >= BROKER_HOLD_MS &&
+                 now_ms - s->preferred_since_ms >= BROKER_HOLD_MS);
+    if (move) {
+        s->active = (uint8_t)p;
+        s->switches++;
+    }
+    return s->active;
+}
+
+bool broker_uri_endpoint(const char* uri, char* host, size_t host_size, uint16_t* port)
+{
+    const char* p;
+    if (strncmp(uri, "mqtts://", 8) == 0) {
+        p = uri + 8;
+        *port = 8883;
+    } else if (strncmp(uri, "mqtt://", 7) == 0) {
+        p = uri + 7;
+        *port = 1883;
+    } else {
+        return false;
+    }
+
+    size_t n = strcspn(p, ":/");
+    if (n == 0 || n >= host_size) return false;
+    memcpy(host, p, n);
+    host[n] = '\0';
+
+    if (p[n] == ':') {
+        char* end;
+        long v = strtol(p + n + 1, &end, 10);
+        if (v <= 0 || v > 65535 || (*end && *end != '/')) return false;
+        *port = (uint16_t)v;
+    }
+    return true;
+}
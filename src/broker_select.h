@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Which MQTT broker to use, out of an ordered list (LAN broker first, cloud
+// after it). Pure code with a caller-supplied millisecond clock; the
+// connectivity manager feeds it probe results and connection outcomes and
+// applies the choice.
+//
+// A broker turns unhealthy after BROKER_FAILS_DOWN failed probes or
+// connection attempts in a row, and healthy again after BROKER_OKS_UP good
+// probes in a row. The preferred broker is the first healthy one in list
+// order, unless a later one answers probes faster by more than
+// BROKER_RTT_MARGIN_MS. The client leaves the active broker as soon as it
+// turns unhealthy (fail over). Any other move waits until the new broker
+// has been both healthy and the preferred one for BROKER_HOLD_MS without a
+// break: that covers fail back after an outage, and RTT ranks that flip
+// back and forth around the margin, so neither a flapping link nor noisy
+// probes bounce the connection. With no healthy broker it stays put.
+
+#define BROKER_MAX            3
+#define BROKER_FAILS_DOWN     2
+#define BROKER_OKS_UP         2
+#define BROKER_RTT_MARGIN_MS  20
+#define BROKER_HOLD_MS        60000
+#define BROKER_HOST_MAX       64
+
+struct BrokerHealth {
+    bool     healthy;
+    uint8_t  ok_run;
+    uint8_t  fail_run;
+    uint32_t healthy_since_ms;
+    uint32_t probe_rtt_ms;          // smoothed TCP connect time, 0 until measured
+    uint32_t pub_rtt_ms;            // smoothed QoS 1 publish -> PUBACK, 0 until measured
+    uint32_t connect_ms;            // last attempt -> CONNACK
+    uint32_t max_connect_ms;
+    uint32_t connects;
+    uint32_t conn_fails;            // failed attempts and dropped connections
+    uint32_t probes;
+    uint32_t probe_fails;
+};
+
+struct BrokerSel {
+    uint8_t      count;
+    uint8_t      active;
+    int8_t       preferred;         // last preferred broker seen, -1 for none
+    uint32_t     preferred_since_ms;
+    uint32_t     switches;
+    BrokerHealth b[BROKER_MAX];
+};
+
+// All brokers start healthy and unmeasured, so the first one is tried first.
+void broker_sel_init(BrokerSel* s, uint8_t count, uint32_t now_ms);
+
+void broker_sel_probe(BrokerSel* s, uint8_t i, bool ok, uint32_t rtt_ms, uint32_t now_ms);
+
+void broker_sel_connected(BrokerSel* s, uint8_t i, uint32_t connect_ms, uint32_t now_ms);
+
+// A connection attempt to i failed, or its connection dropped.
+void broker_sel_failed(BrokerSel* s, uint8_t i, uint32_t now_ms);
+
+void broker_sel_pub_rtt(BrokerSel* s, uint8_t i, uint32_t rtt_ms);
+
+// The broker the client should be on now; becomes the active one. Call it
+// after every probe round so the hold time is measured from when a broker
+// became preferred.
+uint8_t broker_sel_choose(BrokerSel* s, uint32_t now_ms);
+
+// Host and port of mqtt://host[:port][/path] (default 1883) or mqtts://...
+// (default 8883). False if the URI does not parse or the host is too long.
+bool broker_uri_endpoint(const char* uri, char* host, size_t host_size, uint16_t* port);
@@ -0,0 +1,708 @@
+#include "connectivity.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_transport_tcp.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+
+#include "mqtt_tls.h"
+#include "task_config.h"
+
+static const char* TAG = "CONN";
+
+#define WIFI_SSID "NOKIA-1580"
+#define WIFI_PASS "xxxxx"
+
+#define BACKOFF_BASE_MS   500
+#define BACKOFF_MAX_MS    60000
+#define FAST_RETRY_MS     100     // first retry after a transient drop
+#define MQTT_AFTER_IP_MS  200     // settle time between got-IP and MQTT connect
+
+#define BROKER_PROBE_MS          30000
+#define BROKER_PROBE_TIMEOUT_MS  2000
+#define PUB_RTT_STALE_MS         10000   // a PUBACK sample older than this is given up
+
+// Static addressing skips DHCP entirely, e.g.
+//   -DWIFI_STATIC_IP='"192.168.1.50"' -DWIFI_STATIC_GW='"192.168.1.1"'
+// Empty (the default) means DHCP; lwIP then asks for the last lease first
+// (CONFIG_LWIP_DHCP_RESTORE_LAST_IP) instead of a full discover.
+#ifndef WIFI_STATIC_IP
+#define WIFI_STATIC_IP      ""
+#endif
+#ifndef WIFI_STATIC_GW
+#define WIFI_STATIC_GW      ""
+#endif
+#ifndef WIFI_STATIC_NETMASK
+#define WIFI_STATIC_NETMASK "255.255.255.0"
+#endif
+#ifndef WIFI_STATIC_DNS
+#define WIFI_STATIC_DNS     WIFI_STATIC_GW
+#endif
+
+// Last AP we got an IP from. Kept in RTC memory, which survives software
+// resets and deep sleep, and mirrored to NVS for power cycles. With it the
+// station connects on one channel to one BSSID instead of scanning all 13.
+#define AP_CACHE_MAGIC    0x41504331u   // "APC1"
+#define AP_CACHE_KEY      "wifi_ap"
+
+struct ApCache {
+    uint32_t magic;
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint8_t  check;                     // xor of the bytes above
+};
+
+static RTC_NOINIT_ATTR ApCache s_rtc_ap;
+static ApCache s_ap;                    // valid if magic matches
+static bool s_fast;                     // current config targets s_ap
+static bool s_fast_pending;             // a fast attempt is in flight
+
+// Per-link retry pacing. attempt counts consecutive failures since the
+// link was last up; it picks the backoff window.
+struct Link {
+    const char*        name;
+    esp_timer_handle_t timer;
+    uint32_t           attempt;
+    int64_t            down_since_us;   // 0 while up or before the first connect
+    bool               up;
+};
+
+static Link s_wifi = { "wifi", nullptr, 0, 0, false };
+static Link s_mqtt = { "mqtt", nullptr, 0, 0, false };
+
+// s_wifi is only touched on the event loop task. s_mqtt is also updated by
+// the MQTT event handler (MQTT task) and probe_task; s_mqtt_mutex
+// serializes those updates and the schedule() that goes with them. Never
+// held across an esp_mqtt_* call: the MQTT task may be waiting for it
+// inside our event handler.
+static SemaphoreHandle_t s_mqtt_mutex = nullptr;
+#if STATIC_ALLOC_BUILD
+static StaticSemaphore_t s_mqtt_mutex_buf;
+#endif
+
+static esp_mqtt_client_handle_t s_mqtt_client = nullptr;
+static std::atomic<bool> s_mqtt_started{false};
+static std::atomic<bool> s_have_ip{false};
+
+static ConnStats s_stats;
+
+// Broker choice. s_sel is shared by the event handlers, the retry timer and
+// probe_task; s_configured is the broker the client is set up for.
+static BrokerSel s_sel;
+static portMUX_TYPE s_sel_lock = portMUX_INITIALIZER_UNLOCKED;
+static const BrokerSpec* s_brokers = nullptr;
+static esp_transport_handle_t s_transports[BROKER_MAX];
+static_assert(MQTT_TLS_MAX >= BROKER_MAX, "a TLS transport per broker");
+static esp_mqtt_client_config_t s_base_cfg;
+static uint8_t s_configured = 0xFF;
+static int64_t s_mqtt_attempt_us;
+static std::atomic<bool> s_switching{false};     // we dropped the link to move
+static TaskHandle_t s_probe_task = nullptr;
+
+static std::atomic<int> s_rtt_msg_id{0};
+static std::atomic<int64_t> s_rtt_sent_us{0};
+static int64_t s_attempt_us;            // esp_wifi_connect() of the current attempt
+static int64_t s_assoc_us;              // associated, waiting for an IP
+
+static uint8_t ap_check(const ApCache& c)
+{
+    const uint8_t* p = (const uint8_t*)&c;
+    uint8_t x = 0x5A;
+    for (size_t i = 0; i < offsetof(ApCache, check); i++) x ^= p[i];
+    return x;
+}
+
+static bool ap_valid(const ApCache& c)
+{
+    return c.magic == AP_CACHE_MAGIC && c.channel >= 1 && c.channel <= 14 &&
+           c.check == ap_check(c);
+}
+
+static void ap_load()
+{
+    if (ap_valid(s_rtc_ap)) {
+        s_ap = s_rtc_ap;
+        return;
+    }
+
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READONLY, &h) != ESP_OK) return;
+
+    ApCache stored;
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(h, AP_CACHE_KEY, &stored, &len) == ESP_OK &&
+        len == sizeof(stored) && ap_valid(stored)) {
+        s_ap = stored;
+        s_rtc_ap = stored;
+    }
+    nvs_close(h);
+}
+
+// Runs on the event loop task. NVS is only written when the AP changed.
+static void ap_store(const uint8_t bssid[6], uint8_t channel)
+{
+    if (ap_valid(s_ap) && s_ap.channel == channel && memcmp(s_ap.bssid, bssid, 6) == 0)
+        return;
+
+    s_ap.magic = AP_CACHE_MAGIC;
+    memcpy(s_ap.bssid, bssid, 6);
+    s_ap.channel = channel;
+    s_ap.check = ap_check(s_ap);
+    s_rtc_ap = s_ap;
+
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_blob(h, AP_CACHE_KEY, &s_ap, sizeof(s_ap));
+    nvs_commit(h);
+    nvs_close(h);
+
+    ESP_LOGI(TAG, "AP cached: %02x:%02x:%02x:%02x:%02x:%02x ch %u",
+             bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], channel);
+}
+
+static void ap_forget()
+{
+    s_ap.magic = 0;
+    s_rtc_ap.magic = 0;
+}
+
+// Points the station at the cached AP (fast) or back to a full scan. Only
+// called while disconnected; a config change would otherwise drop the link.
+static void apply_sta_config(bool fast)
+{
+    wifi_config_t wifi_config = {};
+    strncpy((char*)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid));
+    strncpy((char*)wifi_config.sta.password, WIFI_PASS, sizeof(wifi_config.sta.password));
+    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+
+    if (fast) {
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_ap.bssid, 6);
+        wifi_config.sta.channel = s_ap.channel;
+    } else {
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    s_fast = fast;
+}
+
+static void wifi_connect()
+{
+    // Back to the cached AP once a full scan has refreshed it.
+    if (!s_fast && ap_valid(s_ap)) apply_sta_config(true);
+
+    s_stats.wifi_attempts++;
+    if (s_fast) s_stats.wifi_fast_attempts++;
+    s_fast_pending = s_fast;
+    s_attempt_us = esp_timer_get_time();
+    s_assoc_us = 0;
+    esp_wifi_connect();
+}
+
+static void static_ip_init(esp_netif_t* sta)
+{
+    if (!WIFI_STATIC_IP[0]) return;
+
+    esp_netif_ip_info_t ip = {};
+    ip.ip.addr = esp_ip4addr_aton(WIFI_STATIC_IP);
+    ip.gw.addr = esp_ip4addr_aton(WIFI_STATIC_GW);
+    ip.netmask.addr = esp_ip4addr_aton(WIFI_STATIC_NETMASK);
+
+    esp_netif_dns_info_t dns = {};
+    dns.ip.type = IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = esp_ip4addr_aton(WIFI_STATIC_DNS);
+
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(sta));
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(sta, &ip));
+    ESP_ERROR_CHECK(esp_netif_set_dns_info(sta, ESP_NETIF_DNS_MAIN, &dns));
+    ESP_LOGI(TAG, "Static IP %s", WIFI_STATIC_IP);
+}
+
+static uint32_t backoff_ms(uint32_t attempt)
+{
+    uint32_t window = BACKOFF_BASE_MS;
+    for (uint32_t i = 0; i < attempt && window < BACKOFF_MAX_MS; i++) {
+        window *= 2;
+    }
+    if (window > BACKOFF_MAX_MS) window = BACKOFF_MAX_MS;
+
+    // Equal jitter: never retry sooner than half the window, so a fleet
+    // that lost the same AP does not come back in lock-step.
+    return window / 2 + esp_random() % (window / 2 + 1);
+}
+
+static void schedule(Link* l, uint32_t delay_ms)
+{
+    esp_timer_stop(l->timer);
+    esp_timer_start_once(l->timer, (uint64_t)delay_ms * 1000);
+    ESP_LOGI(TAG, "%s retry #%lu in %lu ms", l->name,
+             (unsigned long)l->attempt, (unsigned long)delay_ms);
+}
+
+static void mqtt_lock()
+{
+    xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+}
+
+static void mqtt_unlock()
+{
+    xSemaphoreGive(s_mqtt_mutex);
+}
+
+static void link_down(Link* l)
+{
+    if (l->up) {
+        l->down_since_us = esp_timer_get_time();
+    }
+    l->up = false;
+}
+
+static int64_t link_up(Link* l)
+{
+    int64_t took_ms = -1;
+    if (l->down_since_us != 0) {
+        took_ms = (esp_timer_get_time() - l->down_since_us) / 1000;
+    }
+    l->up = true;
+    l->attempt = 0;
+    l->down_since_us = 0;
+    esp_timer_stop(l->timer);
+    return took_ms;
+}
+
+static bool transient_reason(uint8_t reason)
+{
+    switch (reason) {
+        case WIFI_REASON_BEACON_TIMEOUT:
+        case WIFI_REASON_ASSOC_LEAVE:
+        case WIFI_REASON_AUTH_EXPIRE:
+        case WIFI_REASON_HANDSHAKE_TIMEOUT:
+        case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void wifi_retry_cb(void* arg)
+{
+    wifi_connect();
+}
+
+static uint32_t now_ms()
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static uint8_t choose_broker()
+{
+    portENTER_CRITICAL(&s_sel_lock);
+    uint8_t i = broker_sel_choose(&s_sel, now_ms());
+    portEXIT_CRITICAL(&s_sel_lock);
+    return i;
+}
+
+// Only while the client is disconnected.
+static void apply_broker(uint8_t i)
+{
+    const BrokerSpec& b = s_brokers[i];
+
+    esp_mqtt_client_config_t cfg = s_base_cfg;
+    cfg.broker.address.uri = b.uri;
+    cfg.credentials.username = b.username;
+    cfg.credentials.authentication.password = b.password;
+    cfg.network.transport = s_transports[i];
+    esp_mqtt_set_config(s_mqtt_client, &cfg);
+
+    if (s_configured != 0xFF) ESP_LOGW(TAG, "MQTT broker now %s (%s)", b.name, b.uri);
+    s_configured = i;
+}
+
+static void mqtt_retry_cb(void* arg)
+{
+    if (!s_have_ip || !s_mqtt_client) return;
+
+    uint8_t i = choose_broker();
+    if (i != s_configured) apply_broker(i);
+
+    s_mqtt_attempt_us = esp_timer_get_time();
+    s_stats.mqtt_attempts++;
+    if (!s_mqtt_started.exchange(true)) {
+        esp_mqtt_client_start(s_mqtt_client);
+    } else {
+        esp_mqtt_client_reconnect(s_mqtt_client);
+    }
+}
+
+static void wifi_event_handler(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        wifi_connect();
+    } else if (event_base == WIFI_EVENT &&
+               event_id == WIFI_EVENT_STA_CONNECTED) {
+        auto* c = (wifi_event_sta_connected_t*)event_data;
+        s_assoc_us = esp_timer_get_time();
+        s_stats.wifi_last_assoc_ms = (s_assoc_us - s_attempt_us) / 1000;
+        ap_store(c->bssid, c->channel);
+    } else if (event_base == WIFI_EVENT &&
+               event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        auto* d = (wifi_event_sta_disconnected_t*)event_data;
+        bool was_up = s_wifi.up;
+
+        s_have_ip = false;
+        link_down(&s_wifi);
+        mqtt_lock();
+        esp_timer_stop(s_mqtt.timer);
+        mqtt_unlock();
+
+        if (s_fast_pending) {
+            // The cached AP is gone or moved channel: scan everything, now.
+            s_fast_pending = false;
+            s_stats.wifi_fast_fallbacks++;
+            ESP_LOGW(TAG, "Fast connect failed (reason %d), full scan", d->reason);
+            ap_forget();
+            apply_sta_config(false);
+            schedule(&s_wifi, FAST_RETRY_MS);
+        } else if (was_up && transient_reason(d->reason)) {
+            ESP_LOGW(TAG, "WiFi dropped (reason %d), fast retry", d->reason);
+            schedule(&s_wifi, FAST_RETRY_MS);
+        } else {
+            ESP_LOGW(TAG, "WiFi disconnected (reason %d)", d->reason);
+            schedule(&s_wifi, backoff_ms(s_wifi.attempt));
+            s_wifi.attempt++;
+        }
+    } else if (event_base == IP_EVENT &&
+               event_id == IP_EVENT_STA_GOT_IP) {
+        int64_t now = esp_timer_get_time();
+        if (s_assoc_us) s_stats.wifi_last_dhcp_ms = (now - s_assoc_us) / 1000;
+        s_stats.wifi_last_fast = s_fast_pending;
+        s_fast_pending = false;
+        if (s_stats.boot_to_ip_ms < 0) s_stats.boot_to_ip_ms = now / 1000;
+
+        int64_t took = link_up(&s_wifi);
+        if (took >= 0) {
+            s_stats.wifi_reconnects++;
+            s_stats.wifi_last_reconnect_ms = took;
+            if (took > s_stats.wifi_max_reconnect_ms) s_stats.wifi_max_reconnect_ms = took;
+            ESP_LOGI(TAG, "WiFi connected + got IP (%lld ms after drop, %s)", took,
+                     s_stats.wifi_last_fast ? "fast" : "scan");
+        } else {
+            ESP_LOGI(TAG, "WiFi connected + got IP (%lld ms after boot, %s)",
+                     s_stats.boot_to_ip_ms, s_stats.wifi_last_fast ? "fast" : "scan");
+        }
+
+        s_have_ip = true;
+        if (s_probe_task) xTaskNotifyGive(s_probe_task);
+
+        // A fresh IP is the fast path for MQTT too: forget earlier failures.
+        mqtt_lock();
+        if (s_mqtt_client && !s_mqtt.up) {
+            s_mqtt.attempt = 0;
+            schedule(&s_mqtt, MQTT_AFTER_IP_MS);
+        }
+        mqtt_unlock();
+    }
+}
+
+static void mqtt_event_handler(void* handler_args, esp_event_base_t base,
+                               int32_t event_id, void* event_data)
+{
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        s_switching = false;
+        s_rtt_msg_id = 0;
+
+        portENTER_CRITICAL(&s_sel_lock);
+        broker_sel_connected(&s_sel, s_configured,
+                             (uint32_t)((esp_timer_get_time() - s_mqtt_attempt_us) / 1000),
+                             now_ms());
+        portEXIT_CRITICAL(&s_sel_lock);
+
+        mqtt_lock();
+        int64_t took = link_up(&s_mqtt);
+        mqtt_unlock();
+        if (took >= 0) {
+            s_stats.mqtt_reconnects++;
+            s_stats.mqtt_last_reconnect_ms = took;
+            if (took > s_stats.mqtt_max_reconnect_ms) s_stats.mqtt_max_reconnect_ms = took;
+        }
+        conn_log_stats();
+    } else if (event_id == MQTT_EVENT_DISCONNECTED) {
+        mqtt_lock();
+        link_down(&s_mqtt);
+
+        // probe_task dropped the link to move brokers and owns the retry.
+        // Not the broker's fault while Wi-Fi is down; the got-IP handler
+        // owns the next attempt then.
+        if (s_switching.exchange(false) || !s_have_ip) {
+            mqtt_unlock();
+            return;
+        }
+
+        portENTER_CRITICAL(&s_sel_lock);
+        broker_sel_failed(&s_sel, s_configured, now_ms());
+        portEXIT_CRITICAL(&s_sel_lock);
+
+        if (choose_broker() != s_configured) {
+            // Fail over right away; the next broker is not the one backing off.
+            s_mqtt.attempt = 0;
+            schedule(&s_mqtt, FAST_RETRY_MS);
+        } else {
+            schedule(&s_mqtt, backoff_ms(s_mqtt.attempt));
+            s_mqtt.attempt++;
+        }
+        mqtt_unlock();
+        if (s_probe_task) xTaskNotifyGive(s_probe_task);
+    } else if (event_id == MQTT_EVENT_PUBLISHED) {
+        auto* ev = (esp_mqtt_event_handle_t)event_data;
+        int id = ev->msg_id;
+        if (id != 0 && s_rtt_msg_id.compare_exchange_strong(id, 0)) {
+            uint32_t rtt = (uint32_t)((esp_timer_get_time() - s_rtt_sent_us) / 1000);
+            portENTER_CRITICAL(&s_sel_lock);
+            broker_sel_pub_rtt(&s_sel, s_configured, rtt);
+            portEXIT_CRITICAL(&s_sel_lock);
+        }
+    }
+}
+
+void conn_init()
+{
+    esp_timer_create_args_t targs = {};
+    targs.callback = wifi_retry_cb;
+    targs.name = "wifi_retry";
+    ESP_ERROR_CHECK(esp_timer_create(&targs, &s_wifi.timer));
+
+    targs.callback = mqtt_retry_cb;
+    targs.name = "mqtt_retry";
+    ESP_ERROR_CHECK(esp_timer_create(&targs, &s_mqtt.timer));
+#if STATIC_ALLOC_BUILD
+    s_mqtt_mutex = xSemaphoreCreateMutexStatic(&s_mqtt_mutex_buf);
+#else
+    s_mqtt_mutex = xSemaphoreCreateMutex();
+#endif
+
+    s_stats.boot_to_ip_ms = -1;
+    ap_load();
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_t* sta = esp_netif_create_default_wifi_sta();
+    static_ip_init(sta);
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(
+        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    apply_sta_config(ap_valid(s_ap));
+    ESP_ERROR_CHECK(esp_wifi_start());
+
+    ESP_LOGI(TAG, "WiFi STA init done (%s)",
+             s_fast ? "fast connect to cached AP" : "full scan");
+}
+
+// TCP connect time to host:port, the closest thing to a broker RTT that
+// needs no session. -1 if it did not connect within BROKER_PROBE_TIMEOUT_MS.
+static int32_t probe_connect_ms(const char* host, uint16_t port)
+{
+    char port_str[6];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    int32_t took = -1;
+    int64_t t0 = esp_timer_get_time();
+    int ret = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+
+    if (ret == 0 || errno == EINPROGRESS) {
+        fd_set wset;
+        FD_ZERO(&wset);
+        FD_SET(fd, &wset);
+        timeval tv = { BROKER_PROBE_TIMEOUT_MS / 1000, (BROKER_PROBE_TIMEOUT_MS % 1000) * 1000 };
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (ret == 0 ||
+            (select(fd + 1, nullptr, &wset, nullptr, &tv) == 1 &&
+             getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)) {
+            took = (int32_t)((esp_timer_get_time() - t0) / 1000);
+        }
+    }
+    closesocket(fd);
+    return took;
+}
+
+// Probes every broker each BROKER_PROBE_MS, or sooner after a connection
+// drop, then moves the client if the choice changed. A failed probe of the
+// broker the client is connected to does not count: the live connection
+// says more about it.
+static void probe_task(void* pv)
+{
+    s_probe_task = xTaskGetCurrentTaskHandle();
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BROKER_PROBE_MS));
+        if (!s_have_ip) continue;
+
+        for (uint8_t i = 0; i < s_sel.count; i++) {
+            char host[BROKER_HOST_MAX];
+            uint16_t port;
+            if (!broker_uri_endpoint(s_brokers[i].uri, host, sizeof(host), &port)) continue;
+
+            int32_t ms = probe_connect_ms(host, port);
+            if (ms < 0 && i == s_configured && s_mqtt.up) continue;
+
+            portENTER_CRITICAL(&s_sel_lock);
+            broker_sel_probe(&s_sel, i, ms >= 0, ms < 0 ? 0 : (uint32_t)ms, now_ms());
+            portEXIT_CRITICAL(&s_sel_lock);
+        }
+
+        uint8_t want = choose_broker();
+        if (want == s_configured) continue;
+
+        bool leaving = s_mqtt.up;
+        if (leaving) {
+            // Fail back: leave cleanly, the outbox holds what comes meanwhile.
+            // The disconnect goes out before the lock is taken; the event it
+            // raises sees s_switching and leaves the retry to us.
+            ESP_LOGI(TAG, "MQTT leaving %s for %s", s_brokers[s_configured].name,
+                     s_brokers[want].name);
+            s_switching = true;
+            esp_mqtt_client_disconnect(s_mqtt_client);
+        }
+
+        mqtt_lock();
+        if (leaving || s_mqtt.attempt > 0) {
+            // Moving, or backing off from a dead broker: try the chosen one now.
+            link_down(&s_mqtt);
+            s_mqtt.attempt = 0;
+            schedule(&s_mqtt, FAST_RETRY_MS);
+        }
+        mqtt_unlock();
+    }
+}
+
+void conn_attach_mqtt(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t& base,
+                      const BrokerSpec* brokers, uint8_t count)
+{
+    ESP_ERROR_CHECK(esp_mqtt_client_register_event(
+        client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID,
+        mqtt_event_handler, NULL));
+
+    s_mqtt_client = client;
+    s_base_cfg = base;
+    s_brokers = brokers;
+    broker_sel_init(&s_sel, count, now_ms());
+
+    // A transport per broker: TLS ones each keep their own CA and session
+    // ticket, which is only valid with the server that issued it.
+    for (uint8_t i = 0; i < s_sel.count; i++) {
+        if (strncmp(brokers[i].uri, "mqtts://", 8) == 0) {
+            s_transports[i] = mqtt_tls_transport_create(brokers[i].ca_pem);
+        } else {
+            s_transports[i] = esp_transport_tcp_init();
+        }
+        if (!s_transports[i]) ESP_LOGE(TAG, "No transport for broker %s", brokers[i].name);
+    }
+    apply_broker(0);
+
+    if (s_sel.count > 1) task_plan_create(probe_task, TASK_PROBE);
+
+    if (s_have_ip) {
+        mqtt_lock();
+        schedule(&s_mqtt, MQTT_AFTER_IP_MS);
+        mqtt_unlock();
+    }
+}
+
+bool conn_wifi_up()
+{
+    return s_have_ip;
+}
+
+bool conn_mqtt_up()
+{
+    return s_mqtt.up;
+}
+
+ConnStats conn_get_stats()
+{
+    ConnStats st = s_stats;
+    portENTER_CRITICAL(&s_sel_lock);
+    st.brokers = s_sel;
+    portEXIT_CRITICAL(&s_sel_lock);
+    st.brokers.active = s_configured;
+    return st;
+}
+
+void conn_note_publish(int msg_id)
+{
+    if (msg_id <= 0) return;
+
+    // One sample in flight; a lost PUBACK frees the slot after a while.
+    int64_t now = esp_timer_get_time();
+    int idle = 0;
+    if (!s_rtt_msg_id.compare_exchange_strong(idle, msg_id)) {
+        if (now - s_rtt_sent_us < PUB_RTT_STALE_MS * 1000LL) return;
+        s_rtt_msg_id = msg_id;
+    }
+    s_rtt_sent_us = now;
+}
+
+void conn_log_stats()
+{
+    ESP_LOGI(TAG, "wifi boot->ip=%lld ms attempts=%lu (fast %lu, fallback %lu) "
+             "reconnects=%lu last=%lld ms max=%lld ms assoc=%lld ms ip=%lld ms | "
+             "mqtt attempts=%lu reconnects=%lu last=%lld ms max=%lld ms",
+             s_stats.boot_to_ip_ms, (unsigned long)s_stats.wifi_attempts,
+             (unsigned long)s_stats.wifi_fast_attempts,
+             (unsigned long)s_stats.wifi_fast_fallbacks, (unsigned long)s_stats.wifi_reconnects,
+             s_stats.wifi_last_reconnect_ms, s_stats.wifi_max_reconnect_ms,
+             s_stats.wifi_last_assoc_ms, s_stats.wifi_last_dhcp_ms,
+             (unsigned long)s_stats.mqtt_attempts, (unsigned long)s_stats.mqtt_reconnects,
+             s_stats.mqtt_last_reconnect_ms, s_stats.mqtt_max_reconnect_ms);
+
+    ConnStats st = conn_get_stats();
+    for (uint8_t i = 0; i < st.brokers.count; i++) {
+        const BrokerHealth& h = st.brokers.b[i];
+        ESP_LOGI(TAG, "broker %s%s %s: probe rtt=%lu ms (%lu/%lu failed) puback rtt=%lu ms "
+                 "connect=%lu ms max=%lu ms connects=%lu fails=%lu",
+                 s_brokers[i].name, i == st.brokers.active ? "*" : "",
+                 h.healthy ? "healthy" : "down", (unsigned long)h.probe_rtt_ms,
+                 (unsigned long)h.probe_fails, (unsigned long)h.probes,
+                 (unsigned long)h.pub_rtt_ms, (unsigned long)h.connect_ms,
+                 (unsigned long)h.max_connect_ms, (unsigned long)h.connects,
+                 (unsigned long)h.conn_fails);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include "mqtt_client.h"
+#include "broker_select.h"
+
+// Connectivity manager: owns the Wi-Fi station and paces reconnects for
+// both Wi-Fi and MQTT with jittered exponential backoff. MQTT is only
+// (re)connected while the station holds an IP address.
+//
+// The last AP (BSSID + channel) is cached in RTC memory and NVS; boot and
+// reconnects go straight to it without a scan, falling back to a full scan
+// if that fails. WIFI_STATIC_IP (connectivity.cpp) skips DHCP.
+//
+// MQTT can fail over between up to BROKER_MAX brokers, see broker_select.h.
+// With more than one, probe_task times a TCP connect to each every
+// BROKER_PROBE_MS and the client is moved to the broker broker_sel_choose()
+// picks; what the firmware publishes meanwhile waits in its outbox. The
+// brokers are expected to bridge the alarm topics to each other, so a
+// client of either one reaches the device.
+
+struct BrokerSpec {
+    const char* name;
+    const char* uri;            // mqtt:// plain TCP, mqtts:// TLS
+    const char* ca_pem;         // mqtts://; each TLS broker gets its own transport
+    const char* username;
+    const char* password;
+};
+
+struct ConnStats {
+    int64_t  boot_to_ip_ms;            // -1 until the first IP
+    uint32_t wifi_attempts;
+    uint32_t wifi_fast_attempts;       // straight to the cached AP
+    uint32_t wifi_fast_fallbacks;      // of those, failed and went to a full scan
+    bool     wifi_last_fast;           // the current IP came from a fast connect
+    int64_t  wifi_last_assoc_ms;       // connect -> associated
+    int64_t  wifi_last_dhcp_ms;        // associated -> got IP
+    uint32_t wifi_reconnects;
+    uint32_t mqtt_attempts;
+    uint32_t mqtt_reconnects;
+    int64_t  wifi_last_reconnect_ms;   // drop -> got IP
+    int64_t  wifi_max_reconnect_ms;
+    int64_t  mqtt_last_reconnect_ms;   // drop -> MQTT connected
+    int64_t  mqtt_max_reconnect_ms;
+    BrokerSel brokers;                 // .active: the broker the client is on
+};
+
+// Brings up the Wi-Fi station (replaces the old wifi_init_sta()).
+void conn_init();
+
+// Hands over an MQTT client created from base (network.disable_auto_reconnect
+// set) and the brokers in order of preference. The broker address,
+// credentials and transport in base are replaced by the chosen broker's.
+// The client is started once IP is up and reconnected on our schedule.
+void conn_attach_mqtt(esp_mqtt_client_handle_t client, const esp_mqtt_client_config_t& base,
+                      const BrokerSpec* brokers, uint8_t count);
+
+// Call after a QoS 1 publish; samples the PUBACK round trip.
+void conn_note_publish(int msg_id);
+
+bool conn_wifi_up();
+bool conn_mqtt_up();
+
+ConnStats conn_get_stats();
+void conn_log_stats();
@@ -0,0 +1,152 @@
+#include "deadline.h"
+
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+
+#include "dlog.h"
+
+static const char* TAG = "DEADLINE";
+
+struct DeadlineRec {
+    // Written by the owning task only.
+    uint32_t      begin_us;
+    uint32_t      last_begin_us;
+    uint32_t      period_us;
+    bool          started;
+    bool          cycle_miss;
+    uint8_t       consecutive;
+    DeadlineStats st;
+
+    // Monitor only.
+    uint8_t       stall_ticks;
+    bool          reported;
+};
+
+static DeadlineRec s_rec[DEADLINE_COUNT];
+static DeadlineFaultCb s_fault_cb = nullptr;
+static esp_timer_handle_t s_monitor = nullptr;
+
+// 32-bit microsecond stamps: single-word stores the monitor can read from the
+// other core, and differences stay correct across the ~71 minute wrap.
+static inline uint32_t now_us()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+void deadline_attach(DeadlineId id)
+{
+    if (esp_task_wdt_add(NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "%s not subscribed to the task watchdog", DEADLINE_PLAN[id].name);
+    }
+}
+
+void deadline_begin(DeadlineId id)
+{
+    DeadlineRec& r = s_rec[id];
+    uint32_t t = now_us();
+
+    if (r.started) {
+        uint32_t period = t - r.last_begin_us;
+        r.period_us = period;
+        if (period > r.st.worst_period_us) r.st.worst_period_us = period;
+        if (period > DEADLINE_PLAN[id].period_ms * 1000) {
+            r.st.period_misses++;
+            r.cycle_miss = true;
+        }
+    }
+
+    r.begin_us = t;
+    r.last_begin_us = t;
+    r.started = true;
+}
+
+void deadline_latency(DeadlineId id, uint32_t latency_us)
+{
+    DeadlineRec& r = s_rec[id];
+    const DeadlineContract& c = DEADLINE_PLAN[id];
+
+    if (latency_us > r.st.worst_latency_us) r.st.worst_latency_us = latency_us;
+    if (c.max_latency_ms && latency_us > c.max_latency_ms * 1000) {
+        r.st.latency_misses++;
+        r.cycle_miss = true;
+    }
+}
+
+void deadline_end(DeadlineId id)
+{
+    DeadlineRec& r = s_rec[id];
+    uint32_t proc = now_us() - r.begin_us;
+
+    if (proc > r.st.worst_proc_us) r.st.worst_proc_us = proc;
+    if (proc > DEADLINE_PLAN[id].max_proc_ms * 1000) {
+        r.st.proc_misses++;
+        r.cycle_miss = true;
+    }
+
+    if (r.cycle_miss) {
+        if (r.consecutive < 255) r.consecutive++;
+        DLOGW(TAG, "%s missed its deadline (period %lu us, proc %lu us)",
+              DEADLINE_PLAN[id].name, (unsigned long)r.period_us, (unsigned long)proc);
+    } else {
+        r.consecutive = 0;
+    }
+    r.cycle_miss = false;
+    r.st.cycles++;
+
+    esp_task_wdt_reset();
+}
+
+DeadlineStats deadline_get_stats(DeadlineId id)
+{
+    DeadlineStats st = s_rec[id].st;
+    st.faulted = s_rec[id].reported;
+    return st;
+}
+
+static void monitor_cb(void*)
+{
+    uint32_t t = now_us();
+
+    for (int i = 0; i < DEADLINE_COUNT; i++) {
+        DeadlineRec& r = s_rec[i];
+        const DeadlineContract& c = DEADLINE_PLAN[i];
+
+        if (!r.started) continue;
+
+        if (t - r.last_begin_us > c.period_ms * 1000) {
+            if (r.stall_ticks < 255) r.stall_ticks++;
+            r.st.stalls++;
+        } else {
+            r.stall_ticks = 0;
+        }
+
+        bool sustained = r.consecutive >= DEADLINE_SUSTAINED ||
+                         r.stall_ticks >= DEADLINE_SUSTAINED;
+
+        if (sustained && !r.reported) {
+            r.reported = true;
+            r.st.faults++;
+            ESP_LOGE(TAG, "%s fault: %lu period / %lu proc / %lu latency misses, %lu stalls",
+                     c.name, (unsigned long)r.st.period_misses, (unsigned long)r.st.proc_misses,
+                     (unsigned long)r.st.latency_misses, (unsigned long)r.st.stalls);
+            if (s_fault_cb) s_fault_cb((DeadlineId)i);
+        } else if (!sustained && r.reported && r.consecutive == 0 && r.stall_ticks == 0) {
+            r.reported = false;
+            ESP_LOGI(TAG, "%s back within its deadlines", c.name);
+        }
+    }
+}
+
+void deadline_init(DeadlineFaultCb cb)
+{
+    s_fault_cb = cb;
+
+    esp_timer_create_args_t args = {};
+    args.callback = monitor_cb;
+    args.name = "deadline";
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_monitor));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_monitor, DEADLINE_CHECK_MS * 1000ULL));
+
+    ESP_LOGI(TAG, "Monitoring %d deadline contracts", DEADLINE_COUNT);
+}
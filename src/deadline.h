@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+// Deadline contracts for the real-time tasks.
+//
+// Each contract gives the longest allowed gap between two check-ins
+// (period), the longest allowed work per cycle (processing) and, for tasks
+// fed by a queue, the oldest an item may be when it is taken off (latency).
+// A task brackets every cycle with deadline_begin()/deadline_end(); both are
+// a timer read and a few stores. deadline_end() also feeds the task
+// watchdog, which every contracted task subscribes to in deadline_attach().
+//
+// A cycle that breaks any limit is a miss. DEADLINE_SUSTAINED misses in a
+// row, or a task not checking in for DEADLINE_SUSTAINED monitor periods past
+// its deadline, is a fault: the fault callback runs once, from the esp_timer
+// task, and again only after the task has had a clean cycle.
+
+#define DEADLINE_SUSTAINED  3
+#define DEADLINE_CHECK_MS   100
+
+enum DeadlineId {
+    DEADLINE_ULTRA,
+    DEADLINE_ALARM,
+    DEADLINE_COUNT
+};
+
+struct DeadlineContract {
+    const char* name;
+    uint32_t    period_ms;
+    uint32_t    max_proc_ms;
+    uint32_t    max_latency_ms;     // 0: not queue driven
+};
+
+// Indexed by DeadlineId. ultra_task takes 5 pings of up to 40 ms each plus a
+// 150 ms sleep; alarm_task wakes at least every 100 ms from its queue.
+static constexpr DeadlineContract DEADLINE_PLAN[DEADLINE_COUNT] = {
+    { "ultra_task", 500, 250, 0   },
+    { "alarm_task", 250, 100, 100 },
+};
+
+struct DeadlineStats {
+    uint32_t cycles;
+    uint32_t period_misses;
+    uint32_t proc_misses;
+    uint32_t latency_misses;
+    uint32_t stalls;                // monitor periods with no check-in past the deadline
+    uint32_t worst_period_us;
+    uint32_t worst_proc_us;
+    uint32_t worst_latency_us;
+    uint32_t faults;
+    bool     faulted;
+};
+
+typedef void (*DeadlineFaultCb)(DeadlineId id);
+
+// Starts the monitor timer. cb runs on the esp_timer task and must not block.
+void deadline_init(DeadlineFaultCb cb);
+
+// Called once by the task owning the contract, before its loop.
+void deadline_attach(DeadlineId id);
+
+void deadline_begin(DeadlineId id);
+void deadline_end(DeadlineId id);
+
+// Age of the queue item being handled in the current cycle.
+void deadline_latency(DeadlineId id, uint32_t latency_us);
+
+DeadlineStats deadline_get_stats(DeadlineId id);
@@ -0,0 +1,251 @@
+#include "dlog.h"
+
+#if DLOG_MODE != DLOG_MODE_DIRECT
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include <atomic>
+#include <stdio.h>
+
+#include "task_config.h"
+
+static const char* TAG = "DLOG";
+
+#define DLOG_RING_SLOTS  128       // power of two
+#define DLOG_DRAIN_MS    50
+#define DLOG_LINE_MAX    160
+
+// Bounded MPSC ring in the style of Vyukov's queue. For the record at
+// position pos, seq is relative to lap(pos), the position of the ring lap it
+// falls in: lap means free for that writer, lap + 1 written and waiting for
+// the reader, lap + DLOG_RING_SLOTS consumed. Everything is modulo 2^32, so
+// it survives head wrapping, and zeroed storage is a valid empty ring.
+struct DlogSlot {
+    std::atomic<uint32_t> seq;
+    uint32_t    ms;
+    const char* tag;
+    const char* fmt;
+    uint8_t     level;
+    uint8_t     nwords;
+    uint32_t    w[DLOG_MAX_WORDS];
+};
+
+static DlogSlot s_ring[DLOG_RING_SLOTS];
+static std::atomic<uint32_t> s_head{0};
+static std::atomic<uint32_t> s_dropped{0};
+static uint32_t s_tail = 0;               // dlog_task only
+
+static inline uint32_t lap(uint32_t pos)
+{
+    return pos - pos % DLOG_RING_SLOTS;
+}
+
+void dlog_commit(uint8_t level, const char* tag, const char* fmt, const DlogArgs& a)
+{
+    uint32_t pos = s_head.load(std::memory_order_relaxed);
+    DlogSlot* slot;
+
+    while (true) {
+        slot = &s_ring[pos % DLOG_RING_SLOTS];
+        uint32_t seq = slot->seq.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(seq - lap(pos));
+
+        if (diff == 0) {
+            if (s_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = s_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->ms = (uint32_t)(esp_timer_get_time() / 1000);
+    slot->tag = tag;
+    slot->fmt = fmt;
+    slot->level = level;
+    slot->nwords = a.n;
+    memcpy(slot->w, a.w, sizeof(slot->w));
+    slot->seq.store(lap(pos) + 1, std::memory_order_release);
+}
+
+static bool ring_pop(DlogSlot* out)
+{
+    DlogSlot* slot = &s_ring[s_tail % DLOG_RING_SLOTS];
+    uint32_t base = lap(s_tail);
+
+    if (slot->seq.load(std::memory_order_acquire) != base + 1) return false;
+
+    out->ms = slot->ms;
+    out->tag = slot->tag;
+    out->fmt = slot->fmt;
+    out->level = slot->level;
+    out->nwords = slot->nwords;
+    memcpy(out->w, slot->w, sizeof(out->w));
+
+    slot->seq.store(base + DLOG_RING_SLOTS, std::memory_order_release);
+    s_tail++;
+    return true;
+}
+
+#if DLOG_MODE == DLOG_MODE_TEXT
+
+// Formats one conversion at a time from the stored words. 64-bit integers
+// (ll, j) and doubles take two words; everything else one.
+static void format_record(char* out, size_t size, const DlogSlot& r)
+{
+    const char* p = r.fmt;
+    size_t n = 0;
+    int wi = 0;
+    int nwords = r.nwords < DLOG_MAX_WORDS ? r.nwords : DLOG_MAX_WORDS;
+
+    while (*p && n + 1 < size) {
+        if (*p != '%') { out[n++] = *p++; continue; }
+        if (p[1] == '%') { out[n++] = '%'; p += 2; continue; }
+
+        const char* start = p++;
+        while (*p && strchr("-+ #0123456789.", *p)) p++;
+
+        int longs = 0;
+        bool intmax = false;
+        while (*p && strchr("hlzjt", *p)) {
+            if (*p == 'l') longs++;
+            if (*p == 'j') intmax = true;
+            p++;
+        }
+        char conv = *p ? *p++ : '\0';
+
+        char spec[16];
+        size_t len = (size_t)(p - start) < sizeof(spec) - 1 ? (size_t)(p - start) : sizeof(spec) - 1;
+        memcpy(spec, start, len);
+        spec[len] = '\0';
+
+        bool fp = conv && strchr("feEgGaA", conv);
+        bool wide = fp || longs >= 2 || intmax;
+        if (wi + (wide ? 2 : 1) > nwords) {
+            n += snprintf(out + n, size - n, "<?>");
+            break;
+        }
+
+        int w;
+        if (fp) {
+            double d;
+            memcpy(&d, &r.w[wi], sizeof(d));
+            w = snprintf(out + n, size - n, spec, d);
+        } else if (wide) {
+            uint64_t v = r.w[wi] | ((uint64_t)r.w[wi + 1] << 32);
+            w = snprintf(out + n, size - n, spec, v);
+        } else if (conv == 's') {
+            w = snprintf(out + n, size - n, spec, (const char*)(uintptr_t)r.w[wi]);
+        } else if (conv == 'p') {
+            w = snprintf(out + n, size - n, spec, (void*)(uintptr_t)r.w[wi]);
+        } else {
+            w = snprintf(out + n, size - n, spec, r.w[wi]);
+        }
+        wi += wide ? 2 : 1;
+
+        if (w < 0) break;
+        n += (size_t)w;
+    }
+
+    if (n >= size) n = size - 1;
+    out[n] = '\0';
+}
+
+static void emit(const DlogSlot& r)
+{
+    static const char LEVELS[] = "?EWID";
+    char msg[DLOG_LINE_MAX];
+
+    format_record(msg, sizeof(msg), r);
+    printf("%c (%lu) %s: %s\n", LEVELS[r.level <= DLOG_DEBUG ? r.level : 0],
+           (unsigned long)r.ms, r.tag, msg);
+}
+
+#else
+
+// "DL:" ms tag fmt level nwords words..., little-endian hex.
+static void emit(const DlogSlot& r)
+{
+    uint8_t buf[14 + 4 * DLOG_MAX_WORDS];
+    uint32_t head[3] = { r.ms, (uint32_t)(uintptr_t)r.tag, (uint32_t)(uintptr_t)r.fmt };
+    int nwords = r.nwords < DLOG_MAX_WORDS ? r.nwords : DLOG_MAX_WORDS;
+
+    memcpy(buf, head, sizeof(head));
+    buf[12] = r.level;
+    buf[13] = (uint8_t)nwords;
+    memcpy(buf + 14, r.w, 4 * nwords);
+
+    char line[4 + 2 * sizeof(buf) + 1];
+    int n = snprintf(line, sizeof(line), "DL:");
+    for (int i = 0; i < 14 + 4 * nwords; i++) {
+        n += snprintf(line + n, sizeof(line) - n, "%02x", buf[i]);
+    }
+    puts(line);
+}
+
+#endif
+
+static void dlog_task(void* pv)
+{
+    uint32_t reported = 0;
+    DlogSlot rec;
+
+    while (true)
+    {
+        while (ring_pop(&rec)) emit(rec);
+
+        uint32_t dropped = s_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported) {
+            ESP_LOGW(TAG, "%lu records dropped (ring full)",
+                     (unsigned long)(dropped - reported));
+            reported = dropped;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_MS));
+    }
+}
+
+#if DLOG_BENCH
+
+static void dlog_bench()
+{
+    const int N = 32;
+
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    for (int i = 0; i < N; i++) DLOGI(TAG, "bench %d of %d", i, N);
+    uint32_t deferred = (esp_cpu_get_cycle_count() - t0) / N;
+
+    t0 = esp_cpu_get_cycle_count();
+    for (int i = 0; i < N; i++) ESP_LOGI(TAG, "bench %d of %d", i, N);
+    uint32_t direct = (esp_cpu_get_cycle_count() - t0) / N;
+
+    ESP_LOGI(TAG, "Per call: DLOGI %lu cycles (%lu ns), ESP_LOGI %lu cycles (%lu ns)",
+             (unsigned long)deferred,
+             (unsigned long)(deferred * 1000ULL / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ),
+             (unsigned long)direct,
+             (unsigned long)(direct * 1000ULL / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ));
+}
+
+#endif
+
+void dlog_init()
+{
+#if DLOG_BENCH
+    dlog_bench();
+#endif
+
+    task_plan_create(dlog_task, TASK_DLOG);
+
+    ESP_LOGI(TAG, "Deferred logging on (%s records, %d slots)",
+             DLOG_MODE == DLOG_MODE_TEXT ? "text" : "binary", DLOG_RING_SLOTS);
+}
+
+uint32_t dlog_dropped()
+{
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+#endif
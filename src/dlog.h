@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+// Deferred logging for hot paths.
+//
+// DLOGE/W/I/D(tag, fmt, ...) take the same arguments as ESP_LOGx, but only
+// store the format pointer, the tag pointer, a millisecond timestamp and the
+// raw argument words in a lock-free ring (safe from any task or ISR, on
+// either core). dlog_task drains the ring at the lowest priority on the
+// networking core, so formatting and the blocking UART write never run on
+// the caller.
+//
+// Build with -DDLOG_MODE=...
+//   DLOG_MODE_DIRECT   DLOGx is ESP_LOGx
+//   DLOG_MODE_TEXT     (default) dlog_task formats and prints "I (ms) TAG: ..."
+//   DLOG_MODE_BINARY   dlog_task prints "DL:<hex record>" lines, decoded on the
+//                      host by tools/dlog_decode.py against the firmware ELF
+//
+// Restrictions: at most DLOG_MAX_WORDS argument words (64-bit integers and
+// doubles take two), no '*' width/precision, and %s arguments must point to
+// static storage since they are read after the call returns.
+//
+// Levels are filtered at compile time. A file can override the default for
+// its own tag by defining DLOG_LOCAL_LEVEL before including this header.
+
+#define DLOG_MODE_DIRECT  0
+#define DLOG_MODE_TEXT    1
+#define DLOG_MODE_BINARY  2
+
+#ifndef DLOG_MODE
+#define DLOG_MODE DLOG_MODE_TEXT
+#endif
+
+// Build with -DDLOG_BENCH=1 to time DLOGI against ESP_LOGI at boot.
+#ifndef DLOG_BENCH
+#define DLOG_BENCH 0
+#endif
+
+#define DLOG_ERROR  1
+#define DLOG_WARN   2
+#define DLOG_INFO   3
+#define DLOG_DEBUG  4
+
+#ifndef DLOG_LOCAL_LEVEL
+#define DLOG_LOCAL_LEVEL CONFIG_LOG_DEFAULT_LEVEL
+#endif
+
+#define DLOG_MAX_WORDS 5
+
+#if DLOG_MODE == DLOG_MODE_DIRECT
+
+#define DLOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+
+static inline void dlog_init() {}
+static inline uint32_t dlog_dropped() { return 0; }
+
+#else
+
+struct DlogArgs {
+    uint32_t w[DLOG_MAX_WORDS];
+    uint8_t  n;
+};
+
+static inline void dlog_put(DlogArgs& a, uint32_t v)
+{
+    if (a.n < DLOG_MAX_WORDS) a.w[a.n] = v;
+    a.n++;
+}
+
+template <typename T>
+static inline void dlog_arg(DlogArgs& a, T v)
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        double d = v;
+        uint32_t w[2];
+        memcpy(w, &d, sizeof(w));
+        dlog_put(a, w[0]);
+        dlog_put(a, w[1]);
+    } else if constexpr (std::is_pointer_v<T>) {
+        dlog_put(a, (uint32_t)(uintptr_t)v);
+    } else if constexpr (sizeof(T) == 8) {
+        dlog_put(a, (uint32_t)(uint64_t)v);
+        dlog_put(a, (uint32_t)((uint64_t)v >> 32));
+    } else {
+        dlog_put(a, (uint32_t)v);
+    }
+}
+
+void dlog_commit(uint8_t level, const char* tag, const char* fmt, const DlogArgs& a);
+
+template <typename... Args>
+static inline void dlog_write(uint8_t level, const char* tag, const char* fmt, Args... args)
+{
+    DlogArgs a;
+    a.n = 0;
+    (dlog_arg(a, args), ...);
+    dlog_commit(level, tag, fmt, a);
+}
+
+#define DLOG_AT(lvl, tag, fmt, ...) \
+    do { if (DLOG_LOCAL_LEVEL >= (lvl)) dlog_write((lvl), tag, fmt, ##__VA_ARGS__); } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_AT(DLOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_AT(DLOG_WARN,  tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_AT(DLOG_INFO,  tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_AT(DLOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+// Starts dlog_task. Records logged before this are kept and drained then.
+void dlog_init();
+
+// Records lost because the ring was full.
+uint32_t dlog_dropped();
+
+#endif
@@ -0,0 +1,147 @@
+#include "executor.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <atomic>
+
+#include "task_config.h"
+
+static const char* TAG = "EXEC";
+
+struct ExecRec {
+    ExecFn            fn;
+    uint32_t          period_ms;
+    uint32_t          next_ms;
+    std::atomic<bool> posted;
+    ExecJobStats      st;
+};
+
+static ExecRec s_jobs[EXEC_MAX_JOBS];
+static uint8_t s_job_count = 0;
+static QueueHandle_t s_ready = nullptr;
+static ExecStats s_stats;
+
+#if STATIC_ALLOC_BUILD
+static uint8_t s_ready_storage[EXEC_READY_LEN * sizeof(ExecJob)];
+static StaticQueue_t s_ready_buf;
+#endif
+
+static inline uint32_t now_ms()
+{
+    return pdTICKS_TO_MS(xTaskGetTickCount());
+}
+
+static void run(ExecRec& r)
+{
+    int64_t t0 = esp_timer_get_time();
+    r.fn();
+    uint32_t took = (uint32_t)(esp_timer_get_time() - t0);
+
+    r.st.runs++;
+    if (took > r.st.max_us) r.st.max_us = took;
+    s_stats.runs++;
+}
+
+// Runs the periodic jobs that are due and returns how long until the next.
+static uint32_t run_due()
+{
+    uint32_t wait = EXEC_IDLE_MS;
+
+    for (uint8_t i = 0; i < s_job_count; i++) {
+        ExecRec& r = s_jobs[i];
+        if (!r.period_ms) continue;
+
+        uint32_t now = now_ms();
+        int32_t until = (int32_t)(r.next_ms - now);
+        if (until <= EXEC_SLACK_MS) {
+            if (until > 0) r.st.early_runs++;
+            uint32_t late_us = until < 0 ? (uint32_t)-until * 1000 : 0;
+            if (late_us > r.st.late_max_us) r.st.late_max_us = late_us;
+
+            run(r);
+            r.next_ms += r.period_ms;
+            if ((int32_t)(r.next_ms - now) <= 0) r.next_ms = now + r.period_ms;
+            until = (int32_t)(r.next_ms - now);
+        }
+        if ((uint32_t)until < wait) wait = until;
+    }
+    return wait;
+}
+
+static void exec_task(void* pv)
+{
+    uint32_t wait_ms = 0;
+
+    while (true)
+    {
+        // Round up: waking a tick early would only find nothing due.
+        TickType_t ticks = (wait_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+
+        ExecJob job;
+        bool got = xQueueReceive(s_ready, &job, ticks);
+        s_stats.wakeups++;
+
+        while (got) {
+            ExecRec& r = s_jobs[job];
+            r.posted = false;
+            run(r);
+            got = xQueueReceive(s_ready, &job, 0);
+        }
+
+        wait_ms = run_due();
+    }
+}
+
+ExecJob exec_add(const char* name, ExecFn fn, uint32_t period_ms)
+{
+    configASSERT(s_job_count < EXEC_MAX_JOBS);
+
+    ExecRec& r = s_jobs[s_job_count];
+    r.fn = fn;
+    r.period_ms = period_ms;
+    r.st.name = name;
+    return s_job_count++;
+}
+
+void exec_start()
+{
+#if STATIC_ALLOC_BUILD
+    s_ready = xQueueCreateStatic(EXEC_READY_LEN, sizeof(ExecJob), s_ready_storage, &s_ready_buf);
+#else
+    s_ready = xQueueCreate(EXEC_READY_LEN, sizeof(ExecJob));
+#endif
+
+    uint32_t now = now_ms();
+    for (uint8_t i = 0; i < s_job_count; i++) s_jobs[i].next_ms = now + s_jobs[i].period_ms;
+    s_stats.jobs = s_job_count;
+
+    task_plan_create(exec_task, TASK_EXEC);
+    ESP_LOGI(TAG, "%u jobs on exec_task", s_job_count);
+}
+
+void exec_post(ExecJob job)
+{
+    // Each job is on the queue at most once, so it cannot be full.
+    if (!s_ready || s_jobs[job].posted.exchange(true)) return;
+    xQueueSend(s_ready, &job, 0);
+}
+
+ExecStats exec_get_stats()
+{
+    return s_stats;
+}
+
+void exec_log_stats()
+{
+    ESP_LOGI(TAG, "%lu wakeups, %lu runs", (unsigned long)s_stats.wakeups,
+             (unsigned long)s_stats.runs);
+    for (uint8_t i = 0; i < s_job_count; i++) {
+        const ExecJobStats& st = s_jobs[i].st;
+        ESP_LOGI(TAG, "  %-10s runs %lu (early %lu), max %lu us, late max %lu us", st.name,
+                 (unsigned long)st.runs, (unsigned long)st.early_runs,
+                 (unsigned long)st.max_us, (unsigned long)st.late_max_us);
+    }
+}
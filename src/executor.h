@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cooperative executor for EXECUTOR_BUILD (see task_config.h): one task,
+// exec_task, runs the low-rate subsystems as handlers instead of giving
+// each a task and a stack of its own.
+//
+// A job runs every period_ms, when posted with exec_post(), or both.
+// exec_task sleeps on its ready queue until the earliest period is due or a
+// job is posted, then runs posted jobs in the order they were posted and
+// due periodic jobs in the order they were added. A job due within
+// EXEC_SLACK_MS runs on the current wakeup rather than waking the task
+// again (it keeps its cadence on average), so jobs with unrelated periods
+// mostly share wakeups. A periodic job that falls behind skips the periods
+// it missed instead of running back to back.
+//
+// Handlers run to completion on exec_task and must not block for long: a
+// handler waiting on a lock or the network holds up every other job. The
+// MQTT jobs do block (publishing, NVS, the history lock), so nothing with a
+// deadline belongs here; the speaker keeps its own task for that reason.
+
+#define EXEC_MAX_JOBS   8
+#define EXEC_READY_LEN  EXEC_MAX_JOBS
+#define EXEC_IDLE_MS    1000     // longest sleep with no periodic job due
+#define EXEC_SLACK_MS   10       // one tick at CONFIG_FREERTOS_HZ=100
+
+typedef void (*ExecFn)();
+
+typedef uint8_t ExecJob;
+
+struct ExecJobStats {
+    const char* name;
+    uint32_t    runs;
+    uint32_t    max_us;
+    uint32_t    late_max_us;     // periodic: how far past due a run started
+    uint32_t    early_runs;      // periodic: runs pulled ahead by the slack
+};
+
+struct ExecStats {
+    uint32_t wakeups;            // times exec_task came out of its wait
+    uint32_t runs;
+    uint8_t  jobs;
+};
+
+// Before exec_start() only, from one task. period_ms 0: runs only when posted.
+ExecJob exec_add(const char* name, ExecFn fn, uint32_t period_ms);
+
+// Creates the ready queue and exec_task.
+void exec_start();
+
+// Any task, never blocks. A job posted again before it ran runs once.
+void exec_post(ExecJob job);
+
+ExecStats exec_get_stats();
+
+// Logs runs, worst run time and lateness per job.
+void exec_log_stats();
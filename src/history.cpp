@@ -0,0 +1,166 @@
+#include "history.h"
+
+#include <string.h>
+
+#define SEC_MS  1000
+#define MIN_MS  60000
+
+static void accum_reset(HistAccum* a, uint32_t start_ms)
+{
+    a->start_ms = start_ms;
+    a->sum = 0;
+    a->min = INT16_MAX;
+    a->max = INT16_MIN;
+    a->n = 0;
+    a->miss = 0;
+}
+
+static void accum_add(HistAccum* a, int16_t cm)
+{
+    if (cm <= 0) {
+        if (a->miss < UINT16_MAX) a->miss++;
+        return;
+    }
+    if (a->n == UINT16_MAX) return;
+
+    a->sum += cm;
+    a->n++;
+    if (cm < a->min) a->min = cm;
+    if (cm > a->max) a->max = cm;
+}
+
+static HistBucket accum_close(const HistAccum* a)
+{
+    HistBucket b = {};
+    b.n = a->n;
+    b.miss = a->miss;
+    if (a->n) {
+        b.min = a->min;
+        b.max = a->max;
+        b.mean = (int16_t)(a->sum / a->n);
+    }
+    return b;
+}
+
+static void ring_push(HistRing* r, const HistBucket& b)
+{
+    r->slots[r->head] = b;
+    r->head = (r->head + 1) % r->len;
+    if (r->count < r->len) r->count++;
+}
+
+// Closes the bucket being filled once its period is over. Periods that saw
+// no sample at all become empty buckets, at most one ring's worth.
+static void roll(HistRing* r, HistAccum* a, uint32_t now_ms, uint32_t period_ms)
+{
+    uint32_t elapsed = now_ms - a->start_ms;
+    if (elapsed < period_ms) return;
+
+    ring_push(r, accum_close(a));
+
+    uint32_t periods = elapsed / period_ms;
+    HistBucket empty = {};
+    for (uint32_t i = 1; i < periods && i <= r->len; i++) ring_push(r, empty);
+
+    accum_reset(a, a->start_ms + periods * period_ms);
+}
+
+void history_init(History* h)
+{
+    memset(h, 0, sizeof(*h));
+    h->sec.slots = h->sec_slots;
+    h->sec.len = HISTORY_SEC_LEN;
+    h->min.slots = h->min_slots;
+    h->min.len = HISTORY_MIN_LEN;
+}
+
+void history_add(History* h, uint32_t now_ms, int cm)
+{
+    if (!h->started) {
+        accum_reset(&h->cur_sec, now_ms - now_ms % SEC_MS);
+        accum_reset(&h->cur_min, now_ms - now_ms % MIN_MS);
+        h->started = true;
+    }
+
+    roll(&h->sec, &h->cur_sec, now_ms, SEC_MS);
+    roll(&h->min, &h->cur_min, now_ms, MIN_MS);
+
+    int16_t v = cm > INT16_MAX ? INT16_MAX : (cm < 0 ? -1 : (int16_t)cm);
+    accum_add(&h->cur_sec, v);
+    accum_add(&h->cur_min, v);
+
+    h->raw_t[h->raw_head] = now_ms;
+    h->raw_cm[h->raw_head] = v;
+    h->raw_head = (h->raw_head + 1) % HISTORY_RAW_LEN;
+    if (h->raw_count < HISTORY_RAW_LEN) h->raw_count++;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t v)
+{
+    p = put_u16(p, v & 0xFFFF);
+    return put_u16(p, v >> 16);
+}
+
+static uint8_t* put_ring(uint8_t* p, const HistRing* r)
+{
+    uint16_t i = (r->head + r->len - r->count) % r->len;
+    for (uint16_t k = 0; k < r->count; k++, i = (i + 1) % r->len) {
+        const HistBucket& b = r->slots[i];
+        p = put_u16(p, (uint16_t)b.min);
+        p = put_u16(p, (uint16_t)b.max);
+        p = put_u16(p, (uint16_t)b.mean);
+        p = put_u16(p, b.n);
+        p = put_u16(p, b.miss);
+    }
+    return p;
+}
+
+size_t history_encode(const History* h, uint32_t now_ms, uint8_t parts,
+                      uint8_t* buf, size_t size)
+{
+    // Raw samples within the last HISTORY_RAW_MS, oldest first.
+    uint16_t raw_first = (h->raw_head + HISTORY_RAW_LEN - h->raw_count) % HISTORY_RAW_LEN;
+    uint16_t raw_n = 0;
+    if (parts & HISTORY_PART_RAW) {
+        raw_n = h->raw_count;
+        while (raw_n && now_ms - h->raw_t[raw_first] > HISTORY_RAW_MS) {
+            raw_first = (raw_first + 1) % HISTORY_RAW_LEN;
+            raw_n--;
+        }
+    }
+    uint16_t sec_n = (parts & HISTORY_PART_SEC) ? h->sec.count : 0;
+    uint16_t min_n = (parts & HISTORY_PART_MIN) ? h->min.count : 0;
+
+    size_t need = HISTORY_HEADER_BYTES + raw_n * HISTORY_RAW_BYTES +
+                  (sec_n + min_n) * HISTORY_BUCKET_BYTES;
+    if (need > size) return 0;
+
+    uint8_t* p = buf;
+    *p++ = 'H';
+    *p++ = 'H';
+    *p++ = 1;
+    *p++ = parts & HISTORY_PART_ALL;
+    p = put_u32(p, now_ms);
+    p = put_u16(p, raw_n);
+    p = put_u16(p, sec_n);
+    p = put_u16(p, min_n);
+    p = put_u32(p, h->cur_sec.start_ms);
+    p = put_u32(p, h->cur_min.start_ms);
+
+    for (uint16_t k = 0, i = raw_first; k < raw_n; k++, i = (i + 1) % HISTORY_RAW_LEN) {
+        p = put_u16(p, (uint16_t)(now_ms - h->raw_t[i]));
+        p = put_u16(p, (uint16_t)h->raw_cm[i]);
+    }
+
+    if (sec_n) p = put_ring(p, &h->sec);
+    if (min_n) p = put_ring(p, &h->min);
+
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-memory, multi-resolution history of ultrasonic readings:
+//   raw      every sample of roughly the last minute
+//   second   min/max/mean per second for HISTORY_SEC_LEN seconds
+//   minute   min/max/mean per minute for HISTORY_MIN_LEN minutes
+// history_add() is O(1) (amortised over gaps with no samples) and does no
+// allocation. Pure code; the caller owns locking and the clock.
+//
+// history_encode() produces the alarm/history blob, little-endian:
+//
+//   "HH" ver:u8 parts:u8 now_ms:u32 raw_n:u16 sec_n:u16 min_n:u16
+//   sec_end_ms:u32 min_end_ms:u32
+//   raw_n x { age_ms:u16 cm:i16 }                      oldest first
+//   sec_n x { min:i16 max:i16 mean:i16 n:u16 miss:u16 } oldest first,
+//   min_n x  (same)                                    last one ends at *_end_ms
+//
+// cm <= 0 is a miss (no echo); buckets keep misses out of min/max/mean.
+// A bucket with n == 0 and miss == 0 covers a gap in sampling.
+
+#define HISTORY_RAW_LEN   512      // > 60 s at the 150 ms sample period
+#define HISTORY_RAW_MS    60000
+#define HISTORY_SEC_LEN   300      // 5 minutes
+#define HISTORY_MIN_LEN   120      // 2 hours
+
+#define HISTORY_PART_RAW  0x01
+#define HISTORY_PART_SEC  0x02
+#define HISTORY_PART_MIN  0x04
+#define HISTORY_PART_ALL  0x07
+
+#define HISTORY_HEADER_BYTES  20
+#define HISTORY_RAW_BYTES     4
+#define HISTORY_BUCKET_BYTES  10
+#define HISTORY_BLOB_MAX  (HISTORY_HEADER_BYTES + HISTORY_RAW_LEN * HISTORY_RAW_BYTES + \
+                           (HISTORY_SEC_LEN + HISTORY_MIN_LEN) * HISTORY_BUCKET_BYTES)
+
+struct HistBucket {
+    int16_t  min;
+    int16_t  max;
+    int16_t  mean;
+    uint16_t n;
+    uint16_t miss;
+};
+
+// Bucket being filled.
+struct HistAccum {
+    uint32_t start_ms;
+    int32_t  sum;
+    int16_t  min;
+    int16_t  max;
+    uint16_t n;
+    uint16_t miss;
+};
+
+struct HistRing {
+    HistBucket* slots;
+    uint16_t    len;
+    uint16_t    head;      // next write
+    uint16_t    count;
+};
+
+struct History {
+    uint32_t   raw_t[HISTORY_RAW_LEN];
+    int16_t    raw_cm[HISTORY_RAW_LEN];
+    uint16_t   raw_head;
+    uint16_t   raw_count;
+
+    HistBucket sec_slots[HISTORY_SEC_LEN];
+    HistBucket min_slots[HISTORY_MIN_LEN];
+    HistRing   sec;
+    HistRing   min;
+
+    HistAccum  cur_sec;
+    HistAccum  cur_min;
+    bool       started;
+};
+
+void history_init(History* h);
+
+void history_add(History* h, uint32_t now_ms, int cm);
+
+// Returns the blob length, or 0 if size is too small for the parts asked.
+size_t history_encode(const History* h, uint32_t now_ms, uint8_t parts,
+                      uint8_t* buf, size_t size);
@@ -0,0 +1,274 @@
+#include "i2c_bus.h"
+
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+#include "dlog.h"
+#include "task_config.h"
+
+static const char* TAG = "I2C_BUS";
+
+#define I2C_PORT     I2C_NUM_0
+#define I2C_SDA_PIN  GPIO_NUM_21
+#define I2C_SCL_PIN  GPIO_NUM_22
+
+struct BusDevice {
+    i2c_master_dev_handle_t handle;
+    uint8_t                 prio;
+    I2cDevStats             st;
+};
+
+static i2c_master_bus_handle_t s_bus = nullptr;
+static BusDevice s_devs[I2C_BUS_MAX_DEVICES];
+static int s_dev_count = 0;
+static uint32_t s_resets = 0;
+
+static QueueHandle_t s_queues[I2C_BUS_PRIOS];
+static SemaphoreHandle_t s_pending = nullptr;      // counts queued descriptors
+
+#if STATIC_ALLOC_BUILD
+static uint8_t s_queue_storage[I2C_BUS_PRIOS][I2C_QUEUE_LEN * sizeof(I2cTxn)];
+static StaticQueue_t s_queue_bufs[I2C_BUS_PRIOS];
+static StaticSemaphore_t s_pending_buf;
+#endif
+
+static bool is_nack(esp_err_t err)
+{
+    return err == ESP_ERR_INVALID_STATE || err == ESP_ERR_INVALID_RESPONSE;
+}
+
+static esp_err_t run_once(const I2cTxn& t)
+{
+    i2c_master_dev_handle_t h = s_devs[t.dev].handle;
+
+    switch (t.op) {
+        case I2cOp::WRITE:
+            return i2c_master_transmit(h, t.tx, t.tx_len, I2C_XFER_TIMEOUT_MS);
+        case I2cOp::READ:
+            return i2c_master_receive(h, t.rx, t.rx_len, I2C_XFER_TIMEOUT_MS);
+        case I2cOp::WRITE_READ:
+            return i2c_master_transmit_receive(h, t.tx, t.tx_len, t.rx, t.rx_len,
+                                               I2C_XFER_TIMEOUT_MS);
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static void execute(const I2cTxn& t)
+{
+    I2cDevStats& st = s_devs[t.dev].st;
+    int64_t start = esp_timer_get_time();
+
+    esp_err_t err = run_once(t);
+
+    // A NACK is the device's answer; anything else may have left the bus
+    // hung, so recover it and give the transaction one more go.
+    if (err != ESP_OK && !is_nack(err)) {
+        if (err == ESP_ERR_TIMEOUT) st.timeouts++;
+        s_resets++;
+        DLOGW(TAG, "%s: bus error 0x%x, resetting bus", st.name, err);
+        i2c_master_bus_reset(s_bus);
+        err = run_once(t);
+    }
+
+    st.busy_us += (uint32_t)(esp_timer_get_time() - start);
+    st.txns++;
+    if (err == ESP_OK) {
+        st.bytes += t.tx_len + (t.op == I2cOp::WRITE ? 0 : t.rx_len);
+    } else {
+        st.errors++;
+        if (is_nack(err)) st.nacks++;
+    }
+
+    if (t.done) t.done(err, t.arg);
+}
+
+static void report(uint32_t window_ms)
+{
+    static uint32_t last_bytes[I2C_BUS_MAX_DEVICES];
+
+    for (int i = 0; i < s_dev_count; i++) {
+        const I2cDevStats& st = s_devs[i].st;
+        uint32_t rate = (uint32_t)((uint64_t)(st.bytes - last_bytes[i]) * 1000 / window_ms);
+        last_bytes[i] = st.bytes;
+
+        ESP_LOGI(TAG, "%s: %lu txns, %lu B (%lu B/s), %lu ms busy, %lu errors (%lu nack, %lu timeout)",
+                 st.name, (unsigned long)st.txns, (unsigned long)st.bytes, (unsigned long)rate,
+                 (unsigned long)(st.busy_us / 1000), (unsigned long)st.errors,
+                 (unsigned long)st.nacks, (unsigned long)st.timeouts);
+    }
+    if (s_resets) ESP_LOGW(TAG, "%lu bus resets", (unsigned long)s_resets);
+}
+
+static void i2c_task(void* pv)
+{
+    TickType_t last_report = xTaskGetTickCount();
+
+    while (true)
+    {
+        TickType_t since = xTaskGetTickCount() - last_report;
+        TickType_t period = pdMS_TO_TICKS(I2C_REPORT_MS);
+
+        if (xSemaphoreTake(s_pending, since < period ? period - since : 0))
+        {
+            I2cTxn t;
+            for (int p = 0; p < I2C_BUS_PRIOS; p++) {
+                if (xQueueReceive(s_queues[p], &t, 0)) {
+                    execute(t);
+                    break;
+                }
+            }
+        }
+
+        if (xTaskGetTickCount() - last_report >= period) {
+            report(pdTICKS_TO_MS(xTaskGetTickCount() - last_report));
+            last_report = xTaskGetTickCount();
+        }
+    }
+}
+
+void i2c_bus_init()
+{
+    if (s_bus) return;
+
+    i2c_master_bus_config_t cfg = {};
+    cfg.i2c_port = I2C_PORT;
+    cfg.sda_io_num = I2C_SDA_PIN;
+    cfg.scl_io_num = I2C_SCL_PIN;
+    cfg.clk_source = I2C_CLK_SRC_DEFAULT;
+    cfg.glitch_ignore_cnt = 7;
+    cfg.flags.enable_internal_pullup = true;
+    ESP_ERROR_CHECK(i2c_new_master_bus(&cfg, &s_bus));
+
+    for (int p = 0; p < I2C_BUS_PRIOS; p++) {
+#if STATIC_ALLOC_BUILD
+        s_queues[p] = xQueueCreateStatic(I2C_QUEUE_LEN, sizeof(I2cTxn),
+                                         s_queue_storage[p], &s_queue_bufs[p]);
+#else
+        s_queues[p] = xQueueCreate(I2C_QUEUE_LEN, sizeof(I2cTxn));
+#endif
+    }
+#if STATIC_ALLOC_BUILD
+    s_pending = xSemaphoreCreateCountingStatic(I2C_BUS_PRIOS * I2C_QUEUE_LEN, 0, &s_pending_buf);
+#else
+    s_pending = xSemaphoreCreateCounting(I2C_BUS_PRIOS * I2C_QUEUE_LEN, 0);
+#endif
+
+    task_plan_create(i2c_task, TASK_I2C);
+
+    ESP_LOGI(TAG, "I2C bus ready (SDA %d, SCL %d)", I2C_SDA_PIN, I2C_SCL_PIN);
+}
+
+I2cDevice i2c_bus_add_device(const char* name, uint8_t addr, uint32_t scl_hz, uint8_t prio)
+{
+    if (!s_bus || s_dev_count == I2C_BUS_MAX_DEVICES) return -1;
+
+    i2c_device_config_t cfg = {};
+    cfg.dev_addr_length = I2C_ADDR_BIT_LEN_7;
+    cfg.device_address = addr;
+    cfg.scl_speed_hz = scl_hz;
+
+    BusDevice& d = s_devs[s_dev_count];
+    if (i2c_master_bus_add_device(s_bus, &cfg, &d.handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add %s at 0x%02x", name, addr);
+        return -1;
+    }
+
+    d.prio = prio < I2C_BUS_PRIOS ? prio : I2C_BUS_PRIOS - 1;
+    d.st = {};
+    d.st.name = name;
+
+    ESP_LOGI(TAG, "%s at 0x%02x, %lu Hz, priority %d", name, addr, (unsigned long)scl_hz, d.prio);
+    return (I2cDevice)s_dev_count++;
+}
+
+bool i2c_bus_submit(const I2cTxn& txn)
+{
+    if (txn.dev < 0 || txn.dev >= s_dev_count) return false;
+
+    if (!xQueueSend(s_queues[s_devs[txn.dev].prio], &txn, 0)) return false;
+    xSemaphoreGive(s_pending);
+    return true;
+}
+
+struct SyncWait {
+    SemaphoreHandle_t done;
+    esp_err_t         err;
+};
+
+static void sync_done(esp_err_t err, void* arg)
+{
+    SyncWait* w = (SyncWait*)arg;
+    w->err = err;
+    xSemaphoreGive(w->done);
+}
+
+// Submits and waits, retrying while the queue is full.
+static esp_err_t submit_wait(I2cTxn& t)
+{
+    StaticSemaphore_t buf;
+    SyncWait w;
+    w.done = xSemaphoreCreateBinaryStatic(&buf);
+    w.err = ESP_OK;
+
+    t.done = sync_done;
+    t.arg = &w;
+
+    while (!i2c_bus_submit(t)) {
+        if (t.dev < 0 || t.dev >= s_dev_count) return ESP_ERR_INVALID_ARG;
+        vTaskDelay(1);
+    }
+
+    xSemaphoreTake(w.done, portMAX_DELAY);
+    return w.err;
+}
+
+esp_err_t i2c_bus_write(I2cDevice dev, const uint8_t* data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK) {
+        I2cTxn t = {};
+        t.dev = dev;
+        t.op = I2cOp::WRITE;
+        t.tx_len = len < I2C_TXN_MAX ? len : I2C_TXN_MAX;
+        memcpy(t.tx, data, t.tx_len);
+
+        err = submit_wait(t);
+        data += t.tx_len;
+        len -= t.tx_len;
+    }
+    return err;
+}
+
+esp_err_t i2c_bus_write_read(I2cDevice dev, const uint8_t* tx, size_t tx_len,
+                             uint8_t* rx, size_t rx_len)
+{
+    if (tx_len > I2C_TXN_MAX || rx_len > 255) return ESP_ERR_INVALID_SIZE;
+
+    I2cTxn t = {};
+    t.dev = dev;
+    t.op = tx_len ? I2cOp::WRITE_READ : I2cOp::READ;
+    t.tx_len = tx_len;
+    t.rx_len = rx_len;
+    t.rx = rx;
+    if (tx_len) memcpy(t.tx, tx, tx_len);
+
+    return submit_wait(t);
+}
+
+I2cDevStats i2c_bus_get_stats(I2cDevice dev)
+{
+    if (dev < 0 || dev >= s_dev_count) return {};
+    return s_devs[dev].st;
+}
+
+uint32_t i2c_bus_resets()
+{
+    return s_resets;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Owner of the I2C port. Device drivers register once and then hand
+// transaction descriptors to i2c_task, which runs them one at a time from
+// per-priority queues: the highest-priority (lowest number) pending
+// transaction always goes next, FIFO within a priority.
+//
+// i2c_bus_submit() returns at once and calls the descriptor's done callback
+// from i2c_task; i2c_bus_write()/i2c_bus_write_read() wrap it for callers
+// that want to block. A timeout or other bus error resets the bus (the
+// driver clocks SCL until a stuck slave lets go of SDA) and retries the
+// transaction once. Per-device counters are logged every I2C_REPORT_MS.
+
+#define I2C_BUS_MAX_DEVICES  4
+#define I2C_BUS_PRIOS        3          // 0 is the most urgent
+#define I2C_QUEUE_LEN        8          // per priority
+#define I2C_TXN_MAX          32         // bytes written per descriptor
+#define I2C_XFER_TIMEOUT_MS  50
+#define I2C_REPORT_MS        60000
+
+typedef int8_t I2cDevice;               // -1 if registration failed
+
+enum class I2cOp : uint8_t {
+    WRITE,
+    READ,
+    WRITE_READ,                         // write tx, repeated start, read rx
+};
+
+// Runs on i2c_task; keep it short.
+typedef void (*I2cDoneCb)(esp_err_t err, void* arg);
+
+struct I2cTxn {
+    I2cDevice dev;
+    I2cOp     op;
+    uint8_t   tx_len;
+    uint8_t   rx_len;
+    uint8_t   tx[I2C_TXN_MAX];          // copied, the caller's buffer may go away
+    uint8_t*  rx;                       // caller-owned until done runs
+    I2cDoneCb done;                     // may be nullptr
+    void*     arg;
+};
+
+struct I2cDevStats {
+    const char* name;
+    uint32_t    txns;
+    uint32_t    bytes;
+    uint32_t    errors;
+    uint32_t    nacks;
+    uint32_t    timeouts;
+    uint32_t    busy_us;                // time spent on the wire
+};
+
+void i2c_bus_init();
+
+I2cDevice i2c_bus_add_device(const char* name, uint8_t addr, uint32_t scl_hz, uint8_t prio);
+
+// False if the device's priority queue is full.
+bool i2c_bus_submit(const I2cTxn& txn);
+
+// Blocking helpers; data longer than I2C_TXN_MAX goes out as several
+// transactions.
+esp_err_t i2c_bus_write(I2cDevice dev, const uint8_t* data, size_t len);
+esp_err_t i2c_bus_write_read(I2cDevice dev, const uint8_t* tx, size_t tx_len,
+                             uint8_t* rx, size_t rx_len);
+
+I2cDevStats i2c_bus_get_stats(I2cDevice dev);
+uint32_t i2c_bus_resets();
@@ -0,0 +1,176 @@
+#include "jitter.h"
+
+#if JITTER_BENCH
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "lwip/sockets.h"
+#include <string.h>
+
+#include "task_config.h"
+
+static const char* TAG = "JITTER";
+
+#define JITTER_REPORT_MS   10000
+#define HIST_BUCKETS       24      // bucket i holds values in [2^i, 2^(i+1)) us
+
+// Synthetic load: a burst of UDP broadcasts plus SHA-256 over a TLS-record
+// sized buffer, repeated every LOAD_PERIOD_MS on the networking core.
+#define LOAD_PERIOD_MS     5
+#define LOAD_UDP_PORT      9       // discard
+#define LOAD_UDP_BURST     4
+#define LOAD_HASH_BYTES    4096
+
+struct Histogram {
+    uint32_t buckets[HIST_BUCKETS];
+    uint32_t count;
+    int64_t  min_us;
+    int64_t  max_us;
+    int64_t  sum_us;
+};
+
+// Filled on the real-time core, read and cleared by jitter_load_task on the
+// networking core; s_hist_lock keeps a report from catching one half-added.
+static Histogram s_interval;        // sample-to-sample interval
+static Histogram s_interval_delta;  // |interval[n] - interval[n-1]|
+static Histogram s_latency;         // event enqueue -> alarm_task dequeue
+static portMUX_TYPE s_hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t s_last_sample_us = 0;    // ultra_task only
+static int64_t s_last_interval_us = -1;
+
+static void hist_reset(Histogram* h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min_us = INT64_MAX;
+}
+
+static void hist_add(Histogram* h, int64_t v)
+{
+    if (v < 0) v = 0;
+
+    int b = 0;
+    while (b < HIST_BUCKETS - 1 && (v >> (b + 1)) != 0) b++;
+
+    h->buckets[b]++;
+    h->count++;
+    h->sum_us += v;
+    if (v < h->min_us) h->min_us = v;
+    if (v > h->max_us) h->max_us = v;
+}
+
+static void hist_log(const char* name, const Histogram* h)
+{
+    if (h->count == 0) {
+        ESP_LOGI(TAG, "%s: no samples", name);
+        return;
+    }
+
+    ESP_LOGI(TAG, "%s: n=%lu min=%lld mean=%lld max=%lld us",
+             name, (unsigned long)h->count, h->min_us,
+             h->sum_us / h->count, h->max_us);
+
+    char line[256];
+    int len = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        if (h->buckets[b] == 0) continue;
+        len += snprintf(line + len, sizeof(line) - len, " [%lu,%lu)=%lu",
+                        b == 0 ? 0UL : (unsigned long)(1UL << b),
+                        (unsigned long)(1UL << (b + 1)),
+                        (unsigned long)h->buckets[b]);
+        if (len >= (int)sizeof(line)) break;
+    }
+    ESP_LOGI(TAG, "%s hist(us):%s", name, line);
+}
+
+void jitter_record_sample(int64_t now_us)
+{
+    if (s_last_sample_us != 0) {
+        int64_t interval = now_us - s_last_sample_us;
+        int64_t d = interval - s_last_interval_us;
+
+        portENTER_CRITICAL(&s_hist_lock);
+        hist_add(&s_interval, interval);
+        if (s_last_interval_us >= 0) hist_add(&s_interval_delta, d < 0 ? -d : d);
+        portEXIT_CRITICAL(&s_hist_lock);
+
+        s_last_interval_us = interval;
+    }
+    s_last_sample_us = now_us;
+}
+
+void jitter_record_event_latency(int64_t latency_us)
+{
+    portENTER_CRITICAL(&s_hist_lock);
+    hist_add(&s_latency, latency_us);
+    portEXIT_CRITICAL(&s_hist_lock);
+}
+
+static void jitter_load_task(void* pv)
+{
+    static uint8_t buf[LOAD_HASH_BYTES];
+    uint8_t digest[32];
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int on = 1;
+    if (sock >= 0) {
+        setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    }
+
+    sockaddr_in dst = {};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(LOAD_UDP_PORT);
+    dst.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+    TickType_t last_report = xTaskGetTickCount();
+
+    while (true)
+    {
+        if (sock >= 0) {
+            for (int i = 0; i < LOAD_UDP_BURST; i++) {
+                sendto(sock, buf, 512, 0, (sockaddr*)&dst, sizeof(dst));
+            }
+        }
+
+        mbedtls_sha256(buf, sizeof(buf), digest, 0);
+        buf[0] = digest[0];
+
+        if (xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(JITTER_REPORT_MS)) {
+            last_report = xTaskGetTickCount();
+
+            // Take the window and start the next one in one step, log after.
+            Histogram interval, delta, latency;
+            portENTER_CRITICAL(&s_hist_lock);
+            interval = s_interval;
+            delta = s_interval_delta;
+            latency = s_latency;
+            hist_reset(&s_interval);
+            hist_reset(&s_interval_delta);
+            hist_reset(&s_latency);
+            portEXIT_CRITICAL(&s_hist_lock);
+
+            hist_log("sample interval", &interval);
+            hist_log("sample interval delta", &delta);
+            hist_log("event latency", &latency);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(LOAD_PERIOD_MS));
+    }
+}
+
+void jitter_init()
+{
+    hist_reset(&s_interval);
+    hist_reset(&s_interval_delta);
+    hist_reset(&s_latency);
+
+    task_plan_create(jitter_load_task, TASK_JITTER);
+
+    ESP_LOGI(TAG, "Jitter benchmark running (placement: %s)",
+             TASK_PLACEMENT_UNPINNED ? "unpinned" : "pinned");
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Built-in jitter benchmark for the real-time path.
+//
+// Build with -DJITTER_BENCH=1 (e.g. build_flags in platformio.ini) to start
+// a synthetic network load task on the networking core and log histograms
+// of the ultrasonic sample interval and the alarm event queue latency every
+// JITTER_REPORT_MS. With the flag off every hook compiles to nothing.
+#ifndef JITTER_BENCH
+#define JITTER_BENCH 0
+#endif
+
+#if JITTER_BENCH
+
+void jitter_init();
+
+// Called once per ultrasonic_task iteration.
+void jitter_record_sample(int64_t now_us);
+
+// Called by alarm_task for every dequeued event.
+void jitter_record_event_latency(int64_t latency_us);
+
+#else
+
+static inline void jitter_init() {}
+static inline void jitter_record_sample(int64_t) {}
+static inline void jitter_record_event_latency(int64_t) {}
+
+#endif
@@ -1,4 +1,5 @@
 #include "keypad.h"
+#include "ui_flow.h"
 
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
@@ -60,7 +61,25 @@ static void load_pin_from_nvs() {
 }
 
 bool keypad_check_pin(const char* entered) {
-    return strncmp(entered, g_pin, 4) == 0;
+    return ui_pin_equal(entered, g_pin);
+}
+
+void keypad_set_pin(const char* pin) {
+
+    strncpy(g_pin, pin, sizeof(g_pin) - 1);
+    g_pin[sizeof(g_pin) - 1] = '\0';
+
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS, PIN change not persisted");
+        return;
+    }
+
+    nvs_set_str(h, "pin", g_pin);
+    nvs_commit(h);
+    nvs_close(h);
+
+    ESP_LOGI(TAG, "PIN changed");
 }
 
 
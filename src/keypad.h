@@ -3,3 +3,4 @@
 void keypad_init();
 char keypad_get_key_nonblocking();
 bool keypad_check_pin(const char* entered);
+void keypad_set_pin(const char* pin);
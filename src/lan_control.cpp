@@ -0,0 +1,340 @@
+#include "lan_control.h"
+#include "task_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_vfs_eventfd.h"
+#include "nvs.h"
+#include "mbedtls/md.h"
+#include "lwip/sockets.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+static const char* TAG = "LAN_CTL";
+
+#define LAN_VERSION      1
+#define LAN_KEY_LEN      32
+#define LAN_TAG_LEN      16
+#define LAN_CMD_LEN      (12 + LAN_TAG_LEN)
+#define LAN_STATE_LEN    (20 + LAN_TAG_LEN)
+#define MAX_CLIENTS      4
+#define CLIENT_TTL_MS    60000
+#define SELECT_RETRY_MS  1000
+
+struct LanClient {
+    sockaddr_in addr;
+    int64_t     last_seen_us;
+    bool        used;
+};
+
+static LanClient s_clients[MAX_CLIENTS];
+static int       s_sock = -1;
+static int       s_efd  = -1;
+static uint32_t  s_nonce;
+static uint32_t  s_last_seq;
+static uint8_t   s_key[LAN_KEY_LEN];
+
+// Latest state change, written by alarm_task, pushed by the LAN task.
+struct StatePush {
+    uint8_t  state;
+    uint32_t seq;           // LAN command that caused it, 0 if none
+    uint32_t apply_us;
+};
+
+static StatePush    s_push;
+static portMUX_TYPE s_push_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t s_apply_last_us;
+static uint32_t s_apply_max_us;
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void lan_mac(const uint8_t* data, size_t len, uint8_t out[LAN_TAG_LEN])
+{
+    uint8_t full[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    s_key, sizeof(s_key), data, len, full);
+    memcpy(out, full, LAN_TAG_LEN);
+}
+
+static bool lan_mac_ok(const uint8_t* data, size_t len, const uint8_t* tag)
+{
+    uint8_t expect[LAN_TAG_LEN];
+    lan_mac(data, len, expect);
+
+    uint8_t diff = 0;
+    for (int i = 0; i < LAN_TAG_LEN; i++) diff |= expect[i] ^ tag[i];
+    return diff == 0;
+}
+
+static void client_touch(const sockaddr_in& from)
+{
+    int64_t now = esp_timer_get_time();
+    int slot = -1;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        LanClient& c = s_clients[i];
+        if (c.used && c.addr.sin_addr.s_addr == from.sin_addr.s_addr &&
+            c.addr.sin_port == from.sin_port) {
+            c.last_seen_us = now;
+            return;
+        }
+        if (!c.used || now - c.last_seen_us > (int64_t)CLIENT_TTL_MS * 1000) {
+            if (slot < 0) slot = i;
+        }
+    }
+
+    if (slot < 0) {
+        ESP_LOGW(TAG, "Client table full, ignoring subscriber");
+        return;
+    }
+
+    s_clients[slot] = { from, now, true };
+}
+
+static StatePush latest_push()
+{
+    portENTER_CRITICAL(&s_push_lock);
+    StatePush p = s_push;
+    portEXIT_CRITICAL(&s_push_lock);
+    return p;
+}
+
+static void send_state(const sockaddr_in* to, const StatePush& p)
+{
+    uint8_t pkt[LAN_STATE_LEN] = {};
+    pkt[0] = 'H';
+    pkt[1] = 'G';
+    pkt[2] = LAN_VERSION;
+    pkt[3] = LAN_OP_STATE;
+    put_u32(pkt + 4, s_nonce);
+    put_u32(pkt + 8, p.seq);
+    pkt[12] = p.state;
+    put_u32(pkt + 16, p.apply_us);
+    lan_mac(pkt, LAN_STATE_LEN - LAN_TAG_LEN, pkt + LAN_STATE_LEN - LAN_TAG_LEN);
+
+    if (to) {
+        sendto(s_sock, pkt, sizeof(pkt), 0, (const sockaddr*)to, sizeof(*to));
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        LanClient& c = s_clients[i];
+        if (!c.used) continue;
+        if (now - c.last_seen_us > (int64_t)CLIENT_TTL_MS * 1000) {
+            c.used = false;
+            continue;
+        }
+        sendto(s_sock, pkt, sizeof(pkt), 0, (const sockaddr*)&c.addr, sizeof(c.addr));
+    }
+}
+
+static void handle_packet(const uint8_t* pkt, int len, const sockaddr_in& from)
+{
+    if (len != LAN_CMD_LEN || pkt[0] != 'H' || pkt[1] != 'G' ||
+        pkt[2] != LAN_VERSION) {
+        return;
+    }
+    if (!lan_mac_ok(pkt, LAN_CMD_LEN - LAN_TAG_LEN, pkt + LAN_CMD_LEN - LAN_TAG_LEN)) {
+        ESP_LOGW(TAG, "Bad MAC from %s", inet_ntoa(from.sin_addr));
+        return;
+    }
+
+    uint8_t  op    = pkt[3];
+    uint32_t nonce = get_u32(pkt + 4);
+    uint32_t seq   = get_u32(pkt + 8);
+
+    client_touch(from);
+
+    StatePush reply = { latest_push().state, s_last_seq, 0 };
+
+    if (op == LAN_OP_SUBSCRIBE) {
+        send_state(&from, reply);
+        return;
+    }
+
+    RemoteCommandType cmd;
+    if (op == LAN_OP_ARM)         cmd = RemoteCommandType::ARM;
+    else if (op == LAN_OP_DISARM) cmd = RemoteCommandType::DISARM;
+    else return;
+
+    if (nonce != s_nonce || seq <= s_last_seq) {
+        ESP_LOGW(TAG, "Stale command (nonce %08lx seq %lu)",
+                 (unsigned long)nonce, (unsigned long)seq);
+        send_state(&from, reply);
+        return;
+    }
+
+    ESP_LOGI(TAG, "LAN: %s seq=%lu", op == LAN_OP_ARM ? "ARM" : "DISARM",
+             (unsigned long)seq);
+
+    // The seq is only used up once the command is in; one the full queue
+    // turned away can be resent as is.
+    SubmitResult r = remote_submit(cmd, EventSource::LAN, seq);
+    if (r == SubmitResult::DROPPED) {
+        ESP_LOGW(TAG, "LAN: seq=%lu dropped, event queue full", (unsigned long)seq);
+        return;
+    }
+    s_last_seq = seq;
+}
+
+static void lan_control_task(void* pv)
+{
+    uint8_t buf[64];
+
+    while (true)
+    {
+        fd_set rset;
+        FD_ZERO(&rset);
+        FD_SET(s_sock, &rset);
+        FD_SET(s_efd, &rset);
+        int maxfd = s_sock > s_efd ? s_sock : s_efd;
+
+        int ready = select(maxfd + 1, &rset, nullptr, nullptr, nullptr);
+        if (ready < 0) {
+            // A broken socket stays broken; do not spin on it.
+            ESP_LOGE(TAG, "select failed (errno %d)", errno);
+            vTaskDelay(pdMS_TO_TICKS(SELECT_RETRY_MS));
+            continue;
+        }
+        if (ready == 0) continue;
+
+        if (FD_ISSET(s_efd, &rset)) {
+            uint64_t n;
+            read(s_efd, &n, sizeof(n));
+
+            StatePush p = latest_push();
+            if (p.seq != 0) {
+                s_apply_last_us = p.apply_us;
+                if (p.apply_us > s_apply_max_us) s_apply_max_us = p.apply_us;
+                ESP_LOGI(TAG, "command %lu -> state in %lu us (max %lu)", (unsigned long)p.seq,
+                         (unsigned long)s_apply_last_us, (unsigned long)s_apply_max_us);
+            }
+            send_state(nullptr, p);
+        }
+
+        if (FD_ISSET(s_sock, &rset)) {
+            sockaddr_in from = {};
+            socklen_t from_len = sizeof(from);
+            int len = recvfrom(s_sock, buf, sizeof(buf), 0, (sockaddr*)&from, &from_len);
+            if (len > 0) handle_packet(buf, len, from);
+        }
+    }
+}
+
+static void key_to_hex(char* out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < LAN_KEY_LEN; i++) {
+        out[2 * i]     = digits[s_key[i] >> 4];
+        out[2 * i + 1] = digits[s_key[i] & 0x0f];
+    }
+    out[2 * LAN_KEY_LEN] = '\0';
+}
+
+// The key is provisioned once per device and never leaves it except for
+// the one console line on first boot. A blob of the wrong size is left
+// alone rather than replaced, so paired clients do not silently stop working.
+static bool load_key()
+{
+    nvs_handle_t h;
+    if (nvs_open("alarm", NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS");
+        return false;
+    }
+
+    size_t len = sizeof(s_key);
+    esp_err_t err = nvs_get_blob(h, "lan_key", s_key, &len);
+    if (err == ESP_OK && len == LAN_KEY_LEN) {
+        nvs_close(h);
+        return true;
+    }
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+        nvs_close(h);
+        ESP_LOGE(TAG, "Stored LAN key unreadable (%s, %u bytes)", esp_err_to_name(err),
+                 (unsigned)len);
+        return false;
+    }
+
+    esp_fill_random(s_key, sizeof(s_key));
+    err = nvs_set_blob(h, "lan_key", s_key, sizeof(s_key));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to store LAN key (%s)", esp_err_to_name(err));
+        return false;
+    }
+
+    char hex[2 * LAN_KEY_LEN + 1];
+    key_to_hex(hex);
+    ESP_LOGW(TAG, "New LAN control key, shown once: %s", hex);
+    return true;
+}
+
+void lan_control_init()
+{
+    if (!load_key()) {
+        ESP_LOGE(TAG, "No LAN control key, endpoint disabled");
+        return;
+    }
+
+    s_nonce = esp_random();
+
+    esp_vfs_eventfd_config_t efd_cfg = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_vfs_eventfd_register(&efd_cfg);
+    s_efd = eventfd(0, 0);
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s_sock < 0 || s_efd < 0) {
+        ESP_LOGE(TAG, "Socket setup failed");
+        return;
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LAN_CONTROL_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s_sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "bind(%d) failed", LAN_CONTROL_PORT);
+        return;
+    }
+
+    task_plan_create(lan_control_task, TASK_LAN);
+    ESP_LOGI(TAG, "LAN control listening on udp/%d", LAN_CONTROL_PORT);
+}
+
+void lan_control_notify_state(uint8_t state, const AlarmEvent* cause)
+{
+    StatePush p = { state, 0, 0 };
+
+    // Only the command that made this change gets the latency; a LAN
+    // command that changed nothing, or one followed by an MQTT command that
+    // did, is not charged with it.
+    if (cause && cause->source == EventSource::LAN) {
+        p.seq = cause->cmd_id;
+        p.apply_us = (uint32_t)(esp_timer_get_time() - cause->t_us);
+    }
+
+    portENTER_CRITICAL(&s_push_lock);
+    s_push = p;
+    portEXIT_CRITICAL(&s_push_lock);
+
+    if (s_efd >= 0) {
+        uint64_t one = 1;
+        write(s_efd, &one, sizeof(one));
+    }
+}
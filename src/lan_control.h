@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "alarm.h"
+#include "remote.h"
+
+// Local UDP control endpoint so arm/disarm keeps working (and stays fast)
+// without the cloud broker.
+//
+// Every datagram is 28 bytes or more, little-endian, and ends in the first
+// 16 bytes of HMAC-SHA256(key, everything before the tag). The key is 32
+// bytes per device, kept in NVS (namespace "alarm", blob "lan_key"). A
+// device without one generates it on first boot and prints it once on the
+// console; pass it to tools/lan_ctl.py with --key.
+//
+//   client -> device   "HG" ver op  nonce:u32 seq:u32                  tag[16]
+//   device -> client   "HG" ver op  nonce:u32 seq:u32 state:u8 pad[3]
+//                                   apply_us:u32                       tag[16]
+//
+// nonce is the device's boot nonce, learned from any device packet; a
+// SUBSCRIBE may send 0. Commands must carry the current nonce and a seq
+// above the last accepted one, which rules out replays. Commands go to
+// remote_submit() with EventSource::LAN and seq as their id; the seq counts
+// as accepted once the event queue took it, so after a full queue the same
+// seq can be resent.
+// Subscribers get a STATE push on every alarm state change. When a LAN
+// command caused the change, the push carries its seq and apply_us, the
+// device-side time from the command entering the event queue to the
+// change; otherwise both are 0. Replies to SUBSCRIBE and stale commands
+// carry the last accepted seq.
+
+#define LAN_CONTROL_PORT 4210
+
+enum LanOp : uint8_t {
+    LAN_OP_ARM       = 1,
+    LAN_OP_DISARM    = 2,
+    LAN_OP_SUBSCRIBE = 3,
+    LAN_OP_STATE     = 0x80,
+};
+
+// Loads or creates the device key; without one the endpoint stays closed.
+void lan_control_init();
+
+// Called from alarm_task on every state change with the event that caused
+// it, nullptr for a timed change. Never touches the network itself, the
+// LAN task does the push.
+void lan_control_notify_state(uint8_t state, const AlarmEvent* cause);
@@ -1,25 +1,30 @@
 
 #include "lcd.h"
+#include "lcd_layout.h"
 
-#include "driver/i2c.h"
+#include "i2c_bus.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 
+#include "task_config.h"
+
 static const char* TAG_LCD = "LCD_I2C";
 
 SemaphoreHandle_t lcd_mutex = nullptr;
 
+#if STATIC_ALLOC_BUILD
+static StaticSemaphore_t s_lcd_mutex_buf;
+#endif
+
 #define LCD_LOCK()   do { if (lcd_mutex) xSemaphoreTake(lcd_mutex, portMAX_DELAY); } while (0)
 #define LCD_UNLOCK() do { if (lcd_mutex) xSemaphoreGive(lcd_mutex); } while (0)
 
 
-#define I2C_PORT        I2C_NUM_0
-#define I2C_SDA_PIN     GPIO_NUM_21   
-#define I2C_SCL_PIN     GPIO_NUM_22  
 #define I2C_FREQ_HZ     100000
 #define LCD_I2C_ADDR    0x27          
+#define LCD_BUS_PRIO    1             // user-facing, but never urgent
 
 #define LCD_RS  (1 << 0)
 #define LCD_RW  (1 << 1)
@@ -31,20 +36,14 @@ SemaphoreHandle_t lcd_mutex = nullptr;
 #define LCD_D7  (1 << 7)
 
 static bool s_backlight = true;
+static I2cDevice s_dev = -1;
 
 
-static esp_err_t lcd_i2c_write_byte(uint8_t data)
-{
-    return i2c_master_write_to_device(
-        I2C_PORT,
-        LCD_I2C_ADDR,
-        &data,
-        1,
-        pdMS_TO_TICKS(50)
-    );
-}
-
-static void lcd_write_nibble(uint8_t nibble, bool rs)
+// Each nibble is two PCF8574 writes, EN high then EN low; the expander
+// latches every byte of a transfer, so a whole run of them goes out as one
+// I2C transaction. At 100 kHz a byte takes ~90 us, longer than the HD44780
+// needs between writes.
+static int lcd_put_nibble(uint8_t* buf, int n, uint8_t nibble, bool rs)
 {
     uint8_t data = 0;
 
@@ -56,26 +55,34 @@ static void lcd_write_nibble(uint8_t nibble, bool rs)
     if (nibble & 0x04) data |= LCD_D6;
     if (nibble & 0x08) data |= LCD_D7;
 
-    data |= LCD_EN;
-    lcd_i2c_write_byte(data);
-    vTaskDelay(pdMS_TO_TICKS(1));
+    buf[n++] = data | LCD_EN;
+    buf[n++] = data & ~LCD_EN;
+    return n;
+}
 
-    data &= ~LCD_EN;
-    lcd_i2c_write_byte(data);
-    vTaskDelay(pdMS_TO_TICKS(1));
+static int lcd_put_byte(uint8_t* buf, int n, uint8_t byte, bool rs)
+{
+    n = lcd_put_nibble(buf, n, (byte >> 4) & 0x0F, rs);
+    return lcd_put_nibble(buf, n, byte & 0x0F, rs);
+}
+
+static void lcd_write_nibble(uint8_t nibble, bool rs)
+{
+    uint8_t buf[2];
+    i2c_bus_write(s_dev, buf, lcd_put_nibble(buf, 0, nibble, rs));
 }
 
 
 static void lcd_send_cmd(uint8_t cmd)
 {
-    lcd_write_nibble((cmd >> 4) & 0x0F, false);
-    lcd_write_nibble(cmd & 0x0F, false);
+    uint8_t buf[4];
+    i2c_bus_write(s_dev, buf, lcd_put_byte(buf, 0, cmd, false));
 }
 
 static void lcd_send_data(uint8_t data)
 {
-    lcd_write_nibble((data >> 4) & 0x0F, true);
-    lcd_write_nibble(data & 0x0F, true);
+    uint8_t buf[4];
+    i2c_bus_write(s_dev, buf, lcd_put_byte(buf, 0, data, true));
 }
 
 
@@ -84,22 +91,22 @@ void lcd_init()
     ESP_LOGI(TAG_LCD, "Initializing I2C LCD...");
 
     if (lcd_mutex == nullptr) {
+#if STATIC_ALLOC_BUILD
+        lcd_mutex = xSemaphoreCreateMutexStatic(&s_lcd_mutex_buf);
+#else
         lcd_mutex = xSemaphoreCreateMutex();
+#endif
         if (!lcd_mutex) {
             ESP_LOGE(TAG_LCD, "Failed to create LCD mutex!");
         }
     }
 
-    i2c_config_t conf = {};
-    conf.mode = I2C_MODE_MASTER;
-    conf.sda_io_num = I2C_SDA_PIN;
-    conf.scl_io_num = I2C_SCL_PIN;
-    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-    conf.master.clk_speed = I2C_FREQ_HZ;
-
-    ESP_ERROR_CHECK(i2c_param_config(I2C_PORT, &conf));
-    ESP_ERROR_CHECK(i2c_driver_install(I2C_PORT, conf.mode, 0, 0, 0));
+    i2c_bus_init();
+    s_dev = i2c_bus_add_device("lcd", LCD_I2C_ADDR, I2C_FREQ_HZ, LCD_BUS_PRIO);
+    if (s_dev < 0) {
+        ESP_LOGE(TAG_LCD, "LCD not on the I2C bus");
+        return;
+    }
 
     vTaskDelay(pdMS_TO_TICKS(50)); 
 
@@ -148,48 +155,33 @@ void lcd_write_char(char c)
 
 void lcd_write_string(const char* str)
 {
+    uint8_t buf[I2C_TXN_MAX];
+    int n = 0;
+
     while (*str) {
-        lcd_write_char(*str++);
+        if (n + 4 > I2C_TXN_MAX) {
+            i2c_bus_write(s_dev, buf, n);
+            n = 0;
+        }
+        n = lcd_put_byte(buf, n, (uint8_t)*str++, true);
     }
+    if (n) i2c_bus_write(s_dev, buf, n);
 }
 
 void lcd_show_message(const char* msg)
 {
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout(msg, rows);
+
     LCD_LOCK();
 
     lcd_send_cmd(0x01);
     vTaskDelay(pdMS_TO_TICKS(3));
 
     lcd_set_cursor(0, 0);
-
-    int i = 0;
-    while (msg[i] != '\0' && msg[i] != '\n') {
-        lcd_write_char(msg[i]);
-        i++;
-    }
-
-    for (int col = i; col < 16; col++) {
-        lcd_write_char(' ');
-    }
-
+    lcd_write_string(rows[0]);
     lcd_set_cursor(0, 1);
-
-    if (msg[i] != '\n') {
-        lcd_write_string("                ");
-        LCD_UNLOCK();
-        return;
-    }
-
-    i++;
-    int col = 0;
-
-    while (msg[i] != '\0' && col < 16) {
-        lcd_write_char(msg[i]);
-        i++;
-        col++;
-    }
-
-    for (; col < 16; col++) lcd_write_char(' ');
+    lcd_write_string(rows[1]);
 
     LCD_UNLOCK();
 }
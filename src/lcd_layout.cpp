@@ -0,0 +1,18 @@
+#include "lcd_layout.h"
+
+static const char* fill_row(char* row, const char* src)
+{
+    int col = 0;
+    while (*src != '\0' && *src != '\n' && col < LCD_COLS) row[col++] = *src++;
+    while (col < LCD_COLS) row[col++] = ' ';
+    row[LCD_COLS] = '\0';
+
+    while (*src != '\0' && *src != '\n') src++;     // rest of an overlong line
+    return src;
+}
+
+void lcd_layout(const char* msg, char rows[LCD_ROWS][LCD_COLS + 1])
+{
+    const char* p = fill_row(rows[0], msg);
+    fill_row(rows[1], *p == '\n' ? p + 1 : p);
+}
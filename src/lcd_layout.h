@@ -0,0 +1,12 @@
+#pragma once
+
+// Text layout for the 16x2 character LCD. Pure code, so it can be run on
+// the host.
+
+#define LCD_COLS 16
+#define LCD_ROWS 2
+
+// Splits msg at the first '\n' into two rows, each truncated and padded with
+// spaces to exactly LCD_COLS characters. Without a '\n' the second row is
+// blank.
+void lcd_layout(const char* msg, char rows[LCD_ROWS][LCD_COLS + 1]);
@@ -2,35 +2,84 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include <cstring>
-#include <string>
+#include <cstdio>
+#include <atomic>
 #include "nvs_flash.h"
 
 #include "lcd.h"
 #include "ultrasonic.h"
 #include "keypad.h"
 #include "speaker.h"
+#include "voice.h"
 #include "led.h"
 #include "remote.h"
+#include "alarm.h"
+#include "telemetry.h"
+#include "alarm_fsm.h"
+#include "ui_flow.h"
+#include "history.h"
+#include "outbox.h"
+#include "baseline.h"
+#include "deadline.h"
+#include "state_snapshot.h"
+#include "task_config.h"
+#include "jitter.h"
+#include "alloc_guard.h"
+#include "mqtt_tls.h"
+#include "connectivity.h"
+#include "lan_control.h"
+#include "ota.h"
+#include "dlog.h"
+#include "executor.h"
 
-#include "esp_wifi.h"
 #include "esp_event.h"
-#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 #include "mqtt_client.h"
-#include "lwip/err.h"
-#include "lwip/sys.h"
 
 
 static const char* TAG = "ALARM_MAIN";
 
-#define WIFI_SSID "NOKIA-1580"
-#define WIFI_PASS "xxxxx"
-
-static const char* MQTT_URI = "mqtts://s66a1a0e.ala.us-east-1.emqxsl.com:8883";
-
-static const char* TOPIC_CMD       = "alarm/cmd";
-static const char* TOPIC_TELEMETRY = "alarm/telemetry";
+// Brokers, LAN first: alarm events take the local hop and keep flowing
+// while the internet is down. The connectivity manager fails over and back
+// (connectivity.h). MQTT_LAN_URI is site specific and empty by default,
+// which leaves the cloud broker alone. Two local brokers for testing:
+//   -DMQTT_LAN_URI='"mqtt://192.168.1.20:1883"'
+//   -DMQTT_CLOUD_URI='"mqtt://192.168.1.20:1884"'
+// The LAN broker has its own CA and credentials, none by default; the cloud
+// ones are never sent to it. An mqtts:// LAN broker needs MQTT_LAN_CA.
+#ifndef MQTT_LAN_URI
+#define MQTT_LAN_URI       ""
+#endif
+#ifndef MQTT_LAN_CA
+#define MQTT_LAN_CA        ""
+#endif
+#ifndef MQTT_LAN_USERNAME
+#define MQTT_LAN_USERNAME  ""
+#endif
+#ifndef MQTT_LAN_PASSWORD
+#define MQTT_LAN_PASSWORD  ""
+#endif
+#ifndef MQTT_CLOUD_URI
+#define MQTT_CLOUD_URI  "mqtts://s66a1a0e.ala.us-east-1.emqxsl.com:8883"
+#endif
+
+#define MQTT_USERNAME   "homeGuard"
+#define MQTT_PASSWORD   "gurrKash67cutwater"
+
+static BrokerSpec s_brokers[2];     // filled by mqtt_init()
+
+static const char* TOPIC_CMD         = "alarm/cmd";
+static const char* TOPIC_TELEMETRY   = "alarm/telemetry";
+static const char* TOPIC_ACK         = "alarm/ack";
+static const char* TOPIC_OTA         = "alarm/ota";
+static const char* TOPIC_OTA_STATUS  = "alarm/ota/status";
+static const char* TOPIC_HISTORY_GET = "alarm/history/get";
+static const char* TOPIC_HISTORY     = "alarm/history";
+static const char* TOPIC_DIAG        = "alarm/diag";
 
 
 static const char EMQX_CA_CERT_PEM[] = R"(-----BEGIN CERTIFICATE-----
@@ -59,36 +108,162 @@ MrY=
 static esp_mqtt_client_handle_t g_mqtt_client = nullptr;
 
 
-enum class AlarmState {
-    DISARMED,
-    EXIT_DELAY,
-    ARMED,
-    ALARM
+static AlarmFsm g_alarm = { AlarmState::DISARMED, 0, 0 };
+static QueueHandle_t g_eventQueue = nullptr;
+
+#define EVENT_QUEUE_LEN 16
+
+#if STATIC_ALLOC_BUILD
+static uint8_t s_eventQueueStorage[EVENT_QUEUE_LEN * sizeof(AlarmEvent)];
+static StaticQueue_t s_eventQueueBuf;
+#endif
+
+// g_alarm belongs to alarm_task. Every other task reads the state, the
+// exit countdown and the last distance from this snapshot, see
+// state_snapshot.h.
+static StateSnapshot s_snapshot;
+
+// alarm_task never calls into the MQTT client, whose publish can block on
+// the client lock and TLS writes while the network is slow. What it wants
+// published goes on this queue without waiting and mqtt_task publishes it.
+// If the queue was ever full, mqtt_task republishes the current state once
+// it has drained, so the last word is never a stale one. The MQTT event
+// handler and ota_task queue their messages here too: MQTT 5 properties are
+// client state set right before each publish, so every publish has to come
+// from the one publishing task (mqtt_task, exec_task in EXECUTOR_BUILD).
+enum class PubKind : uint8_t {
+    STATE,
+    ACK,
+    DIAG,
+    FLUSH,      // broker is back, send what waited in s_outbox
+    HISTORY,
+    OTA,        // s_ota_report
 };
 
-enum class AlarmEventType {
-    ARM_LOCAL,
-    ARM_REMOTE,
-    DISARM_PIN_OK,
-    DISARM_OVERRIDE,
-    DISARM_REMOTE,
-    MOTION_DETECTED,
-    RESET
+struct PubReq {
+    PubKind     kind;
+    SystemState snap;       // STATE: state and distance at the transition
+    uint8_t     ack_ref;    // ACK: 1-based s_acks slot
+    uint8_t     parts;      // HISTORY: HISTORY_PART_* mask
 };
 
-struct AlarmEvent {
-    AlarmEventType type;
+#define PUB_QUEUE_LEN   8
+#define PUB_PERIOD_MS   2000
+#define DIAG_PERIOD_MS  (5 * 60 * 1000)
+
+static QueueHandle_t g_pubQueue = nullptr;
+static std::atomic<bool> s_pub_overflow{false};
+static std::atomic<uint32_t> s_pub_dropped{0};
+
+#if STATIC_ALLOC_BUILD
+static uint8_t s_pubQueueStorage[PUB_QUEUE_LEN * sizeof(PubReq)];
+static StaticQueue_t s_pubQueueBuf;
+#endif
+
+// With CONFIG_MQTT_SKIP_PUBLISH_IF_DISCONNECTED the client refuses publishes
+// while the broker is unreachable instead of piling every QoS 1 telemetry
+// message into its heap outbox; that one now only holds messages in flight
+// and is capped at MQTT_OUTBOX_LIMIT. What we publish meanwhile waits in
+// s_outbox (fixed size, see outbox.h): periodic telemetry collapses to its
+// latest value, state changes, acks and OTA results are kept in order.
+// Diag and history are rebuilt on demand, so they are never queued.
+#define MQTT_OUTBOX_LIMIT  (8 * 1024)
+
+static Outbox s_outbox;
+
+// MQTT 5 (CONFIG_MQTT_PROTOCOL_5) carries as properties what 3.1.1 leaves
+// to the topic string or the payload:
+//   alarm/telemetry  topic alias, so after the first publish of a connection
+//                    the topic costs 2 bytes; periodic samples expire at the
+//                    broker after TELEMETRY_EXPIRY_S
+//   alarm/cmd        correlation data can replace the JSON id, a response
+//                    topic redirects the ack
+//   alarm/ack        the command's correlation data, result and state as
+//                    user properties
+//   alarm/history    content type
+//   other JSON       payload format indicator (UTF-8)
+// Build with -DMQTT_V5=0 to stay on 3.1.1, e.g. to compare wire sizes.
+#ifndef MQTT_V5
+#ifdef CONFIG_MQTT_PROTOCOL_5
+#define MQTT_V5 1
+#else
+#define MQTT_V5 0
+#endif
+#endif
+
+#define TELEMETRY_ALIAS       1
+#define TELEMETRY_EXPIRY_S    10
+#define HISTORY_CONTENT_TYPE  "application/vnd.homeguard.history"
+#define PUB_USER_PROPS        2
+
+struct PubProps {
+    uint16_t    alias;
+    uint32_t    expiry_s;          // 0: never
+    bool        utf8;
+    const char* content_type;
+    const char* corr;
+    uint16_t    corr_len;
+    const char* user[PUB_USER_PROPS][2];   // key, value
+    uint8_t     user_n;
 };
 
+// Cleared for the rest of a connection if the broker takes no aliases.
+static std::atomic<bool> s_alias_ok{ true };
 
-static AlarmState g_state = AlarmState::DISARMED;
-static QueueHandle_t g_eventQueue = nullptr;
+// Broker outages as mqtt_task sees them, with the lowest free heap sampled
+// while one was going on.
+struct OutageStats {
+    uint32_t count;
+    uint32_t last_ms;
+    uint32_t max_ms;
+    uint32_t heap_min;
+};
+
+static OutageStats s_outage = { 0, 0, 0, UINT32_MAX };
 
-static const int EXIT_DELAY_MS = 15000;
-static TickType_t g_exit_deadline = 0;
-static int g_exit_seconds_remaining = 0;
+#define SPEAKER_POLL_MS  20
+#define LED_POLL_MS      50
 
-static int g_last_distance_cm = -1;
+// Wakeups of the polling subsystems, one per loop of the speaker, LED, LCD
+// and MQTT tasks. In EXECUTOR_BUILD exec_task counts its own and only
+// speaker_task counts here.
+static std::atomic<uint32_t> s_poll_wakeups{0};
+
+#if EXECUTOR_BUILD
+static ExecJob s_mqtt_job;
+#endif
+
+// How long alarm_task takes from picking up an event (or timer tick) to
+// having applied a state change: FSM step, LCD, LAN notify, publish request.
+struct TransitionStats {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+static TransitionStats s_transition;
+static portMUX_TYPE s_transition_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Written by ultrasonic_task, encoded on request from the MQTT task.
+static History s_history;
+static uint8_t s_history_blob[HISTORY_BLOB_MAX];
+static SemaphoreHandle_t s_history_mutex = nullptr;
+
+#if STATIC_ALLOC_BUILD
+static StaticSemaphore_t s_history_mutex_buf;
+#endif
+
+// Used until the background model has warmed up.
+#define MOTION_FALLBACK_CM 100
+#define BASELINE_SAVE_MS   (10 * 60 * 1000)
+
+// Owned by ultrasonic_task. It hands a copy to mqtt_task for the NVS write
+// so the flash erase never stalls the sampling core.
+static Baseline s_baseline;
+static Baseline s_baseline_snapshot;
+static bool s_baseline_save_pending = false;
+static portMUX_TYPE s_baseline_lock = portMUX_INITIALIZER_UNLOCKED;
 
 
 void alarm_task(void* pv);
@@ -97,7 +272,6 @@ void keypad_task(void* pv);
 void speaker_task(void* pv);
 void led_task(void* pv);
 
-void remote_task(void* pv);
 void lcd_task(void* pv);
 void mqtt_task(void* pv); 
 
@@ -107,89 +281,480 @@ void led_set_armed();
 void led_set_alarm();
 void led_set_exit_delay_level(int sec_left);
 
-RemoteCommandType remote_check_command();
+static void post_event(AlarmEventType type)
+{
+    AlarmEvent ev{ type, esp_timer_get_time(), EventSource::LOCAL, 0, 0 };
+    xQueueSend(g_eventQueue, &ev, 0);
+}
+
+// Runs on alarm_task after each FSM step.
+static void snapshot_publish_alarm()
+{
+    snapshot_set_alarm(&s_snapshot, g_alarm.state, g_alarm.exit_seconds_remaining,
+                       g_alarm.exit_deadline_ms);
+}
 
-static void wifi_event_handler(void* arg, esp_event_base_t event_base,
-                               int32_t event_id, void* event_data)
+// Never blocks.
+static bool pub_queue_send(const PubReq& req)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT &&
-               event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGW(TAG, "WiFi disconnected, reconnecting...");
-        esp_wifi_connect();
-    } else if (event_base == IP_EVENT &&
-               event_id == IP_EVENT_STA_GOT_IP) {
-        ESP_LOGI(TAG, "WiFi connected + got IP");
+    if (!g_pubQueue || xQueueSend(g_pubQueue, &req, 0) != pdTRUE) return false;
+#if EXECUTOR_BUILD
+    exec_post(s_mqtt_job);
+#endif
+    return true;
+}
+
+// Commands that carry a correlation id are acknowledged on alarm/ack once
+// alarm_task has applied them. A slot has one owner at a time, handed on
+// through the queues: the MQTT event handler claims and fills it, alarm_task
+// records the outcome, the publishing task sends the ack and releases it.
+// A slot is not reused while its ack is pending.
+#define ACK_SLOTS 8
+
+static CommandAck s_acks[ACK_SLOTS];
+static std::atomic<bool> s_ack_busy[ACK_SLOTS];
+static uint8_t s_ack_next = 0;          // MQTT event handler only
+
+// Returns a 1-based slot, 0 if every ack is still pending.
+static uint8_t ack_claim()
+{
+    for (uint8_t i = 0; i < ACK_SLOTS; i++) {
+        uint8_t slot = (s_ack_next + i) % ACK_SLOTS;
+        if (!s_ack_busy[slot].exchange(true)) {
+            s_ack_next = (slot + 1) % ACK_SLOTS;
+            return slot + 1;
+        }
     }
+    return 0;
 }
 
-static void wifi_init_sta()
+static void ack_release(uint8_t ack_ref)
 {
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    if (ack_ref) s_ack_busy[ack_ref - 1].store(false, std::memory_order_release);
+}
+
+// Runs on alarm_task.
+static void publish_later(PubKind kind, uint8_t ack_ref = 0)
+{
+    PubReq req{ kind, snapshot_read(&s_snapshot), ack_ref };
+    if (!pub_queue_send(req)) {
+        s_pub_overflow = true;
+        s_pub_dropped++;
+        ack_release(ack_ref);
+    }
+}
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+static void record_transition(int64_t start_us)
+{
+    uint32_t took = (uint32_t)(esp_timer_get_time() - start_us);
+
+    portENTER_CRITICAL(&s_transition_lock);
+    s_transition.count++;
+    s_transition.last_us = took;
+    s_transition.total_us += took;
+    if (took > s_transition.max_us) s_transition.max_us = took;
+    portEXIT_CRITICAL(&s_transition_lock);
+}
 
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(
-        WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(
-        IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
+// Properties a message on topic gets whichever way it is sent; queued
+// messages are sent with these only.
+static PubProps pub_props(const char* topic, OutboxClass cls)
+{
+    PubProps p = {};
+    if (strcmp(topic, TOPIC_TELEMETRY) == 0) {
+        // The most frequent message by far: only what pays for itself.
+        p.alias = TELEMETRY_ALIAS;
+        if (cls == OutboxClass::LATEST) p.expiry_s = TELEMETRY_EXPIRY_S;
+    } else {
+        p.utf8 = true;
+    }
+    return p;
+}
 
-    wifi_config_t wifi_config = {};
-    strncpy((char*)wifi_config.sta.ssid, WIFI_SSID, sizeof(wifi_config.sta.ssid));
-    strncpy((char*)wifi_config.sta.password, WIFI_PASS, sizeof(wifi_config.sta.password));
-    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+// The one place that calls esp_mqtt_client_publish. Runs on the publishing
+// task only.
+static int mqtt_publish_now(const char* topic, const char* payload, int len, int qos,
+                            const PubProps& p)
+{
+#if MQTT_V5
+    esp_mqtt5_publish_property_config_t prop = {};
+    prop.payload_format_indicator = p.utf8;
+    prop.message_expiry_interval = p.expiry_s;
+    prop.topic_alias = s_alias_ok ? p.alias : 0;
+    prop.content_type = p.content_type;
+    prop.correlation_data = p.corr;
+    prop.correlation_data_len = p.corr_len;
+
+    if (p.user_n) {
+        esp_mqtt5_user_property_item_t items[PUB_USER_PROPS];
+        for (int i = 0; i < p.user_n; i++) items[i] = { p.user[i][0], p.user[i][1] };
+        esp_mqtt5_client_set_user_property(&prop.user_property, items, p.user_n);
+    }
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+    esp_mqtt5_client_set_publish_property(g_mqtt_client, &prop);
+    int msg_id = esp_mqtt_client_publish(g_mqtt_client, topic, payload, len, qos, 0);
+
+    // Refused while connected with an alias: the broker's Topic Alias
+    // Maximum is lower than ours. Go without aliases on this connection.
+    // -2 is the client's outbox being full, which says nothing about aliases.
+    if (msg_id == -1 && prop.topic_alias && conn_mqtt_up()) {
+        ESP_LOGW(TAG, "MQTT broker refused topic alias %u, sending full topics",
+                 prop.topic_alias);
+        s_alias_ok = false;
+        prop.topic_alias = 0;
+        esp_mqtt5_client_set_publish_property(g_mqtt_client, &prop);
+        msg_id = esp_mqtt_client_publish(g_mqtt_client, topic, payload, len, qos, 0);
+    }
 
-    ESP_LOGI(TAG, "WiFi STA init done");
+    if (prop.user_property) esp_mqtt5_client_delete_user_property(prop.user_property);
+#else
+    int msg_id = esp_mqtt_client_publish(g_mqtt_client, topic, payload, len, qos, 0);
+#endif
+    if (qos) conn_note_publish(msg_id);
+    return msg_id;
 }
 
+// Publishes right away if the broker is up and nothing is waiting ahead of
+// the message, otherwise queues it in s_outbox with pub_props() only.
+// Returns the msg_id, or -1 if it was queued or dropped.
+static int mqtt_send(const char* topic, const char* payload, OutboxClass cls,
+                     const PubProps& props)
+{
+    int len = strlen(payload);
+
+    if (s_outbox.stats.depth == 0 && conn_mqtt_up()) {
+        int msg_id = mqtt_publish_now(topic, payload, len, 1, props);
+        if (msg_id >= 0) return msg_id;
+    }
 
-static void mqtt_publish_state()
+    if (!outbox_put(&s_outbox, topic, payload, len, 1, cls))
+        DLOGW(TAG, "MQTT outbox full, dropped message for %s", topic);
+    return -1;
+}
+
+// Stops at the first publish the client refuses, the rest goes on the next
+// attempt.
+static void mqtt_flush_outbox()
 {
-    if (!g_mqtt_client) return;
+    int sent = 0;
+
+    while (conn_mqtt_up())
+    {
+        const OutboxMsg* m = outbox_peek(&s_outbox);
+        if (!m) break;
+
+        if (mqtt_publish_now(m->topic, m->payload, m->len, m->qos, pub_props(m->topic, m->cls)) < 0)
+            break;
 
-    AlarmState s = g_state;
-    const char* state_str = "DISARMED";
-    switch (s) {
-        case AlarmState::DISARMED:  state_str = "DISARMED";  break;
-        case AlarmState::EXIT_DELAY:state_str = "EXIT_DELAY";break;
-        case AlarmState::ARMED:     state_str = "ARMED";     break;
-        case AlarmState::ALARM:     state_str = "ALARM";     break;
+        outbox_sent(&s_outbox, m->seq);
+        sent++;
     }
 
+    if (sent) DLOGI(TAG, "MQTT outbox flushed %d messages", sent);
+}
+
+// cls: KEEP for a state change, LATEST for the periodic update.
+static void mqtt_publish_state(const SystemState& snap, OutboxClass cls)
+{
+    if (!g_mqtt_client) return;
+
     char payload[128];
+    telemetry_build_state(payload, sizeof(payload), snap.state, snap.distance_cm);
+
+    int msg_id = mqtt_send(TOPIC_TELEMETRY, payload, cls, pub_props(TOPIC_TELEMETRY, cls));
+
+    DLOGI(TAG, "MQTT publish telemetry msg_id=%d state=%s distance=%d",
+          msg_id, alarm_state_name(snap.state), snap.distance_cm);
+}
+
+static bool mqtt_str_eq(const char* data, int len, const char* s)
+{
+    return len == (int)strlen(s) && memcmp(data, s, len) == 0;
+}
+
+// Over MQTT 5 the ack carries the command's correlation data and its result
+// and state as user properties, and goes to the command's response topic if
+// it named one. An ack that has to wait in s_outbox is sent on alarm/ack
+// with the JSON body only.
+static void mqtt_publish_ack(CommandAck& ack)
+{
+    if (!g_mqtt_client) return;
+
+    char payload[256];
+    ack.pub_us = esp_timer_get_time();
+    telemetry_build_ack(payload, sizeof(payload), ack);
+
+    PubProps props = pub_props(TOPIC_ACK, OutboxClass::KEEP);
+    props.corr = ack.corr;
+    props.corr_len = ack.corr_len;
+    props.user[0][0] = "result";
+    props.user[0][1] = ack_result_name(ack.result);
+    props.user[1][0] = "state";
+    props.user[1][1] = alarm_state_name(ack.state);
+    props.user_n = 2;
+
+    int msg_id = -1;
+    if (ack.reply_topic[0] && conn_mqtt_up())
+        msg_id = mqtt_publish_now(ack.reply_topic, payload, strlen(payload), 1, props);
+    if (msg_id < 0)
+        msg_id = mqtt_send(TOPIC_ACK, payload, OutboxClass::KEEP, props);
+
+    DLOGI(TAG, "MQTT publish ack msg_id=%d result=%d state=%s",
+          msg_id, (int)ack.result, alarm_state_name(ack.state));
+}
+
+static bool printable(const char* s, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (s[i] < 0x20 || s[i] > 0x7e || s[i] == '"' || s[i] == '\\') return false;
+    }
+    return true;
+}
+
+// Runs in the MQTT event handler. prop is null on 3.1.1. Correlation data
+// that is printable and fits serves as the command id when the JSON has
+// none, so an MQTT 5 client can send a bare "ARM" and still get an ack.
+static void mqtt_arm_disarm_from_cmd(const char* cmd, int len,
+                                     const esp_mqtt5_event_property_t* prop)
+{
+    int64_t rx_us = esp_timer_get_time();
+
+    CommandMsg msg;
+    if (!telemetry_parse_command(cmd, len, &msg)) {
+        ESP_LOGW(TAG, "MQTT: Unknown cmd '%.*s'", len, cmd);
+        return;
+    }
+
+    int corr_len = prop && prop->correlation_data ? prop->correlation_data_len : 0;
+    if (corr_len > CMD_ID_MAX) {
+        ESP_LOGW(TAG, "MQTT: correlation data of %d bytes ignored", corr_len);
+        corr_len = 0;
+    }
+    if (msg.id[0] == '\0' && corr_len && printable(prop->correlation_data, corr_len)) {
+        memcpy(msg.id, prop->correlation_data, corr_len);
+        msg.id[corr_len] = '\0';
+    }
+
+    if (msg.id[0] == '\0') {
+        remote_submit(msg.cmd, EventSource::MQTT);
+        return;
+    }
+
+    uint8_t ref = ack_claim();
+    if (!ref) {
+        ESP_LOGW(TAG, "MQTT: %d acks pending, '%s' runs without one", ACK_SLOTS, msg.id);
+        remote_submit(msg.cmd, EventSource::MQTT, telemetry_command_key(msg));
+        return;
+    }
+
+    CommandAck& ack = s_acks[ref - 1];
+    ack = {};
+    ack.msg = msg;
+    ack.rx_us = rx_us;
+    ack.state = snapshot_read(&s_snapshot).state;
+    if (corr_len) {
+        memcpy(ack.corr, prop->correlation_data, corr_len);
+        ack.corr_len = corr_len;
+    }
+    if (prop && prop->response_topic) {
+        if (telemetry_reply_topic_ok(prop->response_topic, prop->response_topic_len)) {
+            memcpy(ack.reply_topic, prop->response_topic, prop->response_topic_len);
+            ack.reply_topic[prop->response_topic_len] = '\0';
+        } else {
+            ESP_LOGW(TAG, "MQTT: response topic '%.*s' not under %s, acking on %s",
+                     prop->response_topic_len, prop->response_topic,
+                     ACK_REPLY_PREFIX, TOPIC_ACK);
+        }
+    }
+
+    SubmitResult r = remote_submit(msg.cmd, EventSource::MQTT,
+                                   telemetry_command_key(msg), ref);
+    if (r != SubmitResult::QUEUED) {
+        ack.result = r == SubmitResult::DUPLICATE ? AckResult::DUPLICATE
+                                                  : AckResult::REJECTED;
+        PubReq req{ PubKind::ACK, {}, ref };
+        if (!pub_queue_send(req)) {
+            ESP_LOGW(TAG, "MQTT: ack for '%s' dropped", msg.id);
+            ack_release(ref);
+        }
+    }
+}
+
+static OtaReport s_ota_report;
+static portMUX_TYPE s_ota_report_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs on ota_task once an update has finished or failed.
+static void ota_report_later(const OtaReport& rep)
+{
+    portENTER_CRITICAL(&s_ota_report_lock);
+    s_ota_report = rep;
+    portEXIT_CRITICAL(&s_ota_report_lock);
+
+    PubReq req{ PubKind::OTA, {}, 0 };
+    if (!pub_queue_send(req)) ESP_LOGW(TAG, "OTA report not published, queue full");
+}
+
+static void mqtt_publish_ota()
+{
+    if (!g_mqtt_client) return;
+
+    portENTER_CRITICAL(&s_ota_report_lock);
+    OtaReport rep = s_ota_report;
+    portEXIT_CRITICAL(&s_ota_report_lock);
+
+    char payload[192];
     snprintf(payload, sizeof(payload),
-             "{\"state\":\"%s\",\"distance_cm\":%d}",
-             state_str, g_last_distance_cm);
+             "{\"ok\":%s,\"reason\":\"%s\",\"kind\":\"%s\",\"bytes\":%lu,"
+             "\"image_bytes\":%lu,\"ms\":%lu,\"max_write_us\":%lu}",
+             rep.ok ? "true" : "false", rep.reason, rep.delta ? "delta" : "full",
+             (unsigned long)rep.downloaded, (unsigned long)rep.image_len,
+             (unsigned long)rep.duration_ms, (unsigned long)rep.max_write_us);
+
+    mqtt_send(TOPIC_OTA_STATUS, payload, OutboxClass::KEEP,
+              pub_props(TOPIC_OTA_STATUS, OutboxClass::KEEP));
+}
 
-    int msg_id = esp_mqtt_client_publish(
-        g_mqtt_client, TOPIC_TELEMETRY, payload, 0, 1, 0);
+// Runs on mqtt_task after a FAULT event and every DIAG_PERIOD_MS: one entry
+// per deadline contract with its miss counters and worst-case timings, the
+// alarm_task transition time, the Wi-Fi connect times, per-broker health
+// and round trips, the outbox and the task runtime mode. Also right after an outage, once the outbox has been
+// flushed.
+static void mqtt_publish_diag()
+{
+    if (!g_mqtt_client) return;
 
-    ESP_LOGI(TAG, "MQTT publish telemetry msg_id=%d: %s", msg_id, payload);
+    static char payload[1536];      // only ever built on the one publishing task
+    int n = snprintf(payload, sizeof(payload), "{\"deadlines\":[");
+
+    for (int i = 0; i < DEADLINE_COUNT && n < (int)sizeof(payload); i++) {
+        DeadlineStats st = deadline_get_stats((DeadlineId)i);
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      "%s{\"task\":\"%s\",\"faulted\":%s,\"cycles\":%lu,"
+                      "\"period_miss\":%lu,\"proc_miss\":%lu,\"latency_miss\":%lu,"
+                      "\"stalls\":%lu,\"worst_period_us\":%lu,\"worst_proc_us\":%lu,"
+                      "\"worst_latency_us\":%lu}",
+                      i ? "," : "", DEADLINE_PLAN[i].name, st.faulted ? "true" : "false",
+                      (unsigned long)st.cycles, (unsigned long)st.period_misses,
+                      (unsigned long)st.proc_misses, (unsigned long)st.latency_misses,
+                      (unsigned long)st.stalls, (unsigned long)st.worst_period_us,
+                      (unsigned long)st.worst_proc_us, (unsigned long)st.worst_latency_us);
+    }
+    portENTER_CRITICAL(&s_transition_lock);
+    TransitionStats tr = s_transition;
+    portEXIT_CRITICAL(&s_transition_lock);
+    if (n < (int)sizeof(payload))
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      "],\"transition\":{\"count\":%lu,\"last_us\":%lu,\"max_us\":%lu,"
+                      "\"mean_us\":%lu,\"pub_dropped\":%lu}",
+                      (unsigned long)tr.count, (unsigned long)tr.last_us,
+                      (unsigned long)tr.max_us,
+                      (unsigned long)(tr.count ? tr.total_us / tr.count : 0),
+                      (unsigned long)s_pub_dropped.load());
+
+    ConnStats cs = conn_get_stats();
+    if (n < (int)sizeof(payload))
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      ",\"wifi\":{\"boot_to_ip_ms\":%lld,\"drop_to_ip_ms\":%lld,"
+                      "\"max_drop_to_ip_ms\":%lld,\"fast\":%lu,\"fallbacks\":%lu}",
+                      (long long)cs.boot_to_ip_ms, (long long)cs.wifi_last_reconnect_ms,
+                      (long long)cs.wifi_max_reconnect_ms,
+                      (unsigned long)cs.wifi_fast_attempts,
+                      (unsigned long)cs.wifi_fast_fallbacks);
+
+    for (int i = 0; i < cs.brokers.count && n < (int)sizeof(payload); i++) {
+        const BrokerHealth& h = cs.brokers.b[i];
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      "%s{\"name\":\"%s\",\"active\":%s,\"healthy\":%s,\"probe_rtt_ms\":%lu,"
+                      "\"puback_rtt_ms\":%lu,\"connect_ms\":%lu,\"max_connect_ms\":%lu,"
+                      "\"connects\":%lu,\"fails\":%lu,\"probe_fails\":%lu}",
+                      i ? "," : ",\"brokers\":[", s_brokers[i].name, i == cs.brokers.active ? "true" : "false",
+                      h.healthy ? "true" : "false", (unsigned long)h.probe_rtt_ms,
+                      (unsigned long)h.pub_rtt_ms, (unsigned long)h.connect_ms,
+                      (unsigned long)h.max_connect_ms, (unsigned long)h.connects,
+                      (unsigned long)h.conn_fails, (unsigned long)h.probe_fails);
+    }
+    if (cs.brokers.count && n < (int)sizeof(payload))
+        n += snprintf(payload + n, sizeof(payload) - n, "],\"broker_switches\":%lu",
+                      (unsigned long)cs.brokers.switches);
+
+    const OutboxStats& ob = s_outbox.stats;
+    if (n < (int)sizeof(payload))
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      ",\"outbox\":{\"depth\":%u,\"max_depth\":%u,\"max_bytes\":%lu,"
+                      "\"queued\":%lu,\"coalesced\":%lu,\"dropped\":%lu,\"sent\":%lu,"
+                      "\"outages\":%lu,\"last_outage_ms\":%lu,\"max_outage_ms\":%lu,"
+                      "\"heap_min_outage\":%lu,\"heap_min\":%lu,\"mqtt_outbox\":%d}",
+                      ob.depth, ob.max_depth, (unsigned long)ob.max_bytes,
+                      (unsigned long)ob.queued, (unsigned long)ob.coalesced,
+                      (unsigned long)ob.dropped, (unsigned long)ob.sent,
+                      (unsigned long)s_outage.count, (unsigned long)s_outage.last_ms,
+                      (unsigned long)s_outage.max_ms,
+                      (unsigned long)(s_outage.count ? s_outage.heap_min : 0),
+                      (unsigned long)esp_get_minimum_free_heap_size(),
+                      esp_mqtt_client_get_outbox_size(g_mqtt_client));
+
+#if EXECUTOR_BUILD
+    uint32_t wakeups = exec_get_stats().wakeups + s_poll_wakeups.load();
+#else
+    uint32_t wakeups = s_poll_wakeups.load();
+#endif
+    if (n < (int)sizeof(payload))
+        n += snprintf(payload + n, sizeof(payload) - n,
+                      ",\"runtime\":{\"mode\":\"%s\",\"stack_bytes\":%lu,\"poll_wakeups\":%lu,"
+                      "\"heap_free\":%lu}}",
+                      EXECUTOR_BUILD ? "executor" : "tasks",
+                      (unsigned long)task_plan_total_stack(), (unsigned long)wakeups,
+                      (unsigned long)esp_get_free_heap_size());
+
+    // snprintf returns what it would have written; never publish past the
+    // buffer. A cut-off diag is not valid JSON, so say so.
+    if (n >= (int)sizeof(payload)) {
+        ESP_LOGW(TAG, "diag truncated (%d bytes needed)", n + 1);
+        n = sizeof(payload) - 1;
+    }
+
+    int msg_id = mqtt_publish_now(TOPIC_DIAG, payload, n, 1,
+                                  pub_props(TOPIC_DIAG, OutboxClass::KEEP));
+    DLOGI(TAG, "MQTT publish diag msg_id=%d", msg_id);
 }
 
-static void mqtt_arm_disarm_from_cmd(const char* cmd, int len)
+// Runs on the esp_timer task.
+static void on_deadline_fault(DeadlineId id)
 {
-    std::string c(cmd, cmd + len);
+    post_event(AlarmEventType::FAULT);
+}
 
-    if (c == "ARM") {
-        AlarmEvent ev{ AlarmEventType::ARM_REMOTE };
-        xQueueSend(g_eventQueue, &ev, 0);
-        ESP_LOGI(TAG, "MQTT: ARM command received");
-    } else if (c == "DISARM") {
-        AlarmEvent ev{ AlarmEventType::DISARM_REMOTE };
-        xQueueSend(g_eventQueue, &ev, 0);
-        ESP_LOGI(TAG, "MQTT: DISARM command received");
-    } else {
-        ESP_LOGW(TAG, "MQTT: Unknown cmd '%s'", c.c_str());
+// alarm/history/get takes any mix of "raw", "sec" and "min" (all if empty)
+// and answers with one history blob on alarm/history, see history.h.
+// Runs in the MQTT event handler; the publishing task sends the blob.
+static void mqtt_request_history(const char* req, int len)
+{
+    uint8_t parts = 0;
+    for (int i = 0; i + 3 <= len; i++) {
+        if (memcmp(req + i, "raw", 3) == 0) parts |= HISTORY_PART_RAW;
+        if (memcmp(req + i, "sec", 3) == 0) parts |= HISTORY_PART_SEC;
+        if (memcmp(req + i, "min", 3) == 0) parts |= HISTORY_PART_MIN;
     }
+    if (!parts) parts = HISTORY_PART_ALL;
+
+    PubReq r{ PubKind::HISTORY, {}, 0, parts };
+    if (!pub_queue_send(r)) ESP_LOGW(TAG, "MQTT: history request dropped, queue full");
+}
+
+static void mqtt_publish_history(uint8_t parts)
+{
+    if (!g_mqtt_client) return;
+
+    xSemaphoreTake(s_history_mutex, portMAX_DELAY);
+    size_t n = history_encode(&s_history, (uint32_t)(esp_timer_get_time() / 1000),
+                              parts, s_history_blob, sizeof(s_history_blob));
+    xSemaphoreGive(s_history_mutex);
+
+    PubProps props = {};
+    props.content_type = HISTORY_CONTENT_TYPE;
+    int msg_id = mqtt_publish_now(TOPIC_HISTORY, (const char*)s_history_blob, n, 0, props);
+    DLOGI(TAG, "MQTT publish history msg_id=%d parts=0x%x bytes=%u",
+          msg_id, parts, (unsigned)n);
 }
 
 static void mqtt_event_handler(void* handler_args,
@@ -202,7 +767,15 @@ static void mqtt_event_handler(void* handler_args,
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            s_alias_ok = true;      // aliases are per connection
+            mqtt_tls_log_stats();
             esp_mqtt_client_subscribe(g_mqtt_client, TOPIC_CMD, 1);
+            esp_mqtt_client_subscribe(g_mqtt_client, TOPIC_OTA, 1);
+            esp_mqtt_client_subscribe(g_mqtt_client, TOPIC_HISTORY_GET, 0);
+            {
+                PubReq req{ PubKind::FLUSH, {}, 0 };
+                pub_queue_send(req);    // else the next period flushes
+            }
             break;
 
         case MQTT_EVENT_DISCONNECTED:
@@ -214,9 +787,17 @@ static void mqtt_event_handler(void* handler_args,
                      event->topic_len, event->topic,
                      event->data_len, event->data);
 
-            std::string topic(event->topic, event->topic + event->topic_len);
-            if (topic == TOPIC_CMD) {
-                mqtt_arm_disarm_from_cmd(event->data, event->data_len);
+            if (mqtt_str_eq(event->topic, event->topic_len, TOPIC_CMD)) {
+                mqtt_arm_disarm_from_cmd(event->data, event->data_len,
+                                         MQTT_V5 ? event->property : nullptr);
+            }
+            else if (mqtt_str_eq(event->topic, event->topic_len, TOPIC_HISTORY_GET)) {
+                mqtt_request_history(event->data, event->data_len);
+            }
+            else if (mqtt_str_eq(event->topic, event->topic_len, TOPIC_OTA)) {
+                if (!ota_request(event->data, event->data_len)) {
+                    ESP_LOGW(TAG, "MQTT: OTA request ignored (busy or bad URL)");
+                }
             }
             break;
         }
@@ -226,248 +807,210 @@ static void mqtt_event_handler(void* handler_args,
     }
 }
 
+// Unset credentials are left out of CONNECT rather than sent empty.
+static const char* or_null(const char* s)
+{
+    return s[0] ? s : nullptr;
+}
+
 static void mqtt_init()
 {
+    // TLS brokers run on our own esp-tls transport so the session ticket
+    // is reused across reconnects; it carries the CA chain itself.
+    uint8_t n = 0;
+    if (MQTT_LAN_URI[0] && strncmp(MQTT_LAN_URI, "mqtts://", 8) == 0 && !MQTT_LAN_CA[0]) {
+        ESP_LOGE(TAG, "LAN broker %s is TLS but MQTT_LAN_CA is not set, not using it",
+                 MQTT_LAN_URI);
+    } else if (MQTT_LAN_URI[0]) {
+        s_brokers[n++] = { "lan", MQTT_LAN_URI, MQTT_LAN_CA,
+                           or_null(MQTT_LAN_USERNAME), or_null(MQTT_LAN_PASSWORD) };
+    }
+    s_brokers[n++] = { "cloud", MQTT_CLOUD_URI, EMQX_CA_CERT_PEM, MQTT_USERNAME, MQTT_PASSWORD };
+
+    // Broker address, credentials and transport come from s_brokers once
+    // the connectivity manager has picked one.
     esp_mqtt_client_config_t mqtt_cfg = {};
-    mqtt_cfg.broker.address.uri = MQTT_URI;
-    mqtt_cfg.credentials.username = "homeGuard";
-    mqtt_cfg.credentials.authentication.password = "gurrKash67cutwater"; 
-    mqtt_cfg.broker.verification.certificate = EMQX_CA_CERT_PEM;
+    mqtt_cfg.broker.address.uri = s_brokers[0].uri;
+    // Reconnects are paced by the connectivity manager.
+    mqtt_cfg.network.disable_auto_reconnect = true;
+    mqtt_cfg.outbox.limit = MQTT_OUTBOX_LIMIT;
+#if MQTT_V5
+    mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+#endif
 
     g_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     ESP_ERROR_CHECK(esp_mqtt_client_register_event(
         g_mqtt_client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID,
         mqtt_event_handler, NULL));
-    ESP_ERROR_CHECK(esp_mqtt_client_start(g_mqtt_client));
+    conn_attach_mqtt(g_mqtt_client, mqtt_cfg, s_brokers, n);
 
-    ESP_LOGI(TAG, "MQTT client started");
+    ESP_LOGI(TAG, "MQTT client ready, waiting for IP");
 }
 
 void alarm_task(void* pv)
 {
     AlarmEvent ev;
 
+    deadline_attach(DEADLINE_ALARM);
+
     while (true)
     {
-        if (xQueueReceive(g_eventQueue, &ev, pdMS_TO_TICKS(100)))
+        bool got = xQueueReceive(g_eventQueue, &ev, pdMS_TO_TICKS(100));
+        deadline_begin(DEADLINE_ALARM);
+
+        int64_t start_us = esp_timer_get_time();
+
+        if (got)
         {
-            AlarmState old = g_state;
+            int64_t latency_us = start_us - ev.t_us;
+            jitter_record_event_latency(latency_us);
+            deadline_latency(DEADLINE_ALARM, (uint32_t)latency_us);
 
-            switch (g_state)
-            {
-                case AlarmState::DISARMED:
-                    if (ev.type == AlarmEventType::ARM_LOCAL ||
-                        ev.type == AlarmEventType::ARM_REMOTE)
-                    {
-                        g_state = AlarmState::EXIT_DELAY;
-                        TickType_t now = xTaskGetTickCount();
-
-                        g_exit_deadline = now + pdMS_TO_TICKS(EXIT_DELAY_MS);
-                        g_exit_seconds_remaining = EXIT_DELAY_MS / 1000;
-
-                        lcd_show_message("EXIT DELAY");
-                        ESP_LOGI(TAG, "Exit delay started");
-                    }
-                    break;
-
-                case AlarmState::EXIT_DELAY:
-                    if (ev.type == AlarmEventType::DISARM_PIN_OK ||
-                        ev.type == AlarmEventType::DISARM_OVERRIDE ||
-                        ev.type == AlarmEventType::DISARM_REMOTE)
-                    {
-                        g_state = AlarmState::DISARMED;
-                        lcd_show_message("DISARMED");
-                        ESP_LOGI(TAG, "Exit delay cancelled");
-                    }
-                    break;
-
-                case AlarmState::ARMED:
-                    if (ev.type == AlarmEventType::MOTION_DETECTED)
-                    {
-                        g_state = AlarmState::ALARM;
-                        lcd_show_message("ALARM TRIGGERED");
-                        ESP_LOGI(TAG, "Motion → ALARM");
-                    }
-
-                    if (ev.type == AlarmEventType::DISARM_PIN_OK ||
-                        ev.type == AlarmEventType::DISARM_OVERRIDE ||
-                        ev.type == AlarmEventType::DISARM_REMOTE)
-                    {
-                        g_state = AlarmState::DISARMED;
-                        lcd_show_message("DISARMED");
-                    }
-                    break;
-
-                case AlarmState::ALARM:
-                    if (ev.type == AlarmEventType::DISARM_PIN_OK ||
-                        ev.type == AlarmEventType::DISARM_OVERRIDE ||
-                        ev.type == AlarmEventType::DISARM_REMOTE ||
-                        ev.type == AlarmEventType::RESET)
-                    {
-                        g_state = AlarmState::DISARMED;
-                        lcd_show_message("DISARMED");
-                    }
-                    break;
-            }
+            AlarmState old = g_alarm.state;
+            uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
 
-            if (old != g_state) {
-                ESP_LOGI(TAG, "STATE CHANGE: %d -> %d",
-                         (int)old, (int)g_state);
-                mqtt_publish_state();
-            }
-        }
+            AlarmStep step = alarm_fsm_on_event(&g_alarm, ev.type, now_ms);
+            snapshot_publish_alarm();
 
-        if (g_state == AlarmState::EXIT_DELAY)
-        {
-            TickType_t now = xTaskGetTickCount();
+            if (step.lcd_message) lcd_show_message(step.lcd_message);
+            if (step.note) DLOGI(TAG, "%s", step.note);
 
-            if (now >= g_exit_deadline)
-            {
-                g_state = AlarmState::ARMED;
-                lcd_show_message("ARMED");
-                g_exit_seconds_remaining = 0;
-                ESP_LOGI(TAG, "System ARMED");
-                mqtt_publish_state();
+            if (ev.type == AlarmEventType::FAULT) publish_later(PubKind::DIAG);
+
+            if (old != g_alarm.state) {
+                DLOGI(TAG, "STATE CHANGE: %d -> %d (source %d)",
+                      (int)old, (int)g_alarm.state, (int)ev.source);
+                lan_control_notify_state((uint8_t)g_alarm.state, &ev);
+                publish_later(PubKind::STATE);
             }
-            else
-            {
-                int sec_left = (g_exit_deadline - now) / configTICK_RATE_HZ;
 
-                if (sec_left != g_exit_seconds_remaining)
-                {
-                    g_exit_seconds_remaining = sec_left;
-                    lcd_show_countdown(sec_left);
-                }
+            if (ev.ack_ref != 0)
+            {
+                CommandAck& ack = s_acks[ev.ack_ref - 1];
+                ack.apply_us = esp_timer_get_time();
+                ack.result = old != g_alarm.state ? AckResult::APPLIED : AckResult::NO_CHANGE;
+                ack.state = g_alarm.state;
+                publish_later(PubKind::ACK, ev.ack_ref);
             }
+
+            if (old != g_alarm.state) record_transition(start_us);
         }
+
+        AlarmStep step = alarm_fsm_tick(&g_alarm, pdTICKS_TO_MS(xTaskGetTickCount()));
+        if (step.changed || step.countdown_changed) snapshot_publish_alarm();
+
+        if (step.changed)
+        {
+            lcd_show_message(step.lcd_message);
+            DLOGI(TAG, "%s", step.note);
+            lan_control_notify_state((uint8_t)g_alarm.state, nullptr);
+            publish_later(PubKind::STATE);
+            record_transition(start_us);
+        }
+        else if (step.countdown_changed)
+        {
+            lcd_show_countdown(g_alarm.exit_seconds_remaining);
+        }
+
+        deadline_end(DEADLINE_ALARM);
     }
 }
 
 
 void ultrasonic_task(void* pv)
 {
+    uint32_t last_save_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool was_disarmed = true;
+
+    deadline_attach(DEADLINE_ULTRA);
+
     while (true)
     {
+        deadline_begin(DEADLINE_ULTRA);
+        jitter_record_sample(esp_timer_get_time());
+
         int dist_cm = ultrasonic_get_distance_cm();
-        g_last_distance_cm = dist_cm;  // for telemetry
+        snapshot_set_distance(&s_snapshot, dist_cm);  // for telemetry
 
-        if (dist_cm > 0 && dist_cm <= 100)
+        uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+        xSemaphoreTake(s_history_mutex, portMAX_DELAY);
+        history_add(&s_history, now_ms, dist_cm);
+        xSemaphoreGive(s_history_mutex);
+
+        bool disarmed = snapshot_read(&s_snapshot).state == AlarmState::DISARMED;
+        bool was_ready = baseline_ready(&s_baseline);
+
+        if (disarmed) baseline_learn(&s_baseline, dist_cm);
+
+        bool motion;
+        if (baseline_ready(&s_baseline)) {
+            motion = baseline_is_motion(&s_baseline, dist_cm);
+        } else {
+            motion = dist_cm > 0 && dist_cm <= MOTION_FALLBACK_CM;
+        }
+
+        if (motion)
         {
-            AlarmEvent ev{ AlarmEventType::MOTION_DETECTED };
-            xQueueSend(g_eventQueue, &ev, 0);
+            DLOGD(TAG, "Motion at %d cm (baseline %d cm)",
+                  dist_cm, (int)s_baseline.mean_cm);
+            post_event(AlarmEventType::MOTION_DETECTED);
+        }
+
+        // Persist when the model first converges, periodically while it keeps
+        // learning, and on arming so a reboot while armed has the latest one.
+        bool save = false;
+        if (baseline_ready(&s_baseline)) {
+            save = !was_ready ||
+                   (disarmed && now_ms - last_save_ms >= BASELINE_SAVE_MS) ||
+                   (was_disarmed && !disarmed);
+        }
+        if (save) {
+            portENTER_CRITICAL(&s_baseline_lock);
+            s_baseline_snapshot = s_baseline;
+            s_baseline_save_pending = true;
+            portEXIT_CRITICAL(&s_baseline_lock);
+            last_save_ms = now_ms;
         }
+        was_disarmed = disarmed;
 
+        deadline_end(DEADLINE_ULTRA);
         vTaskDelay(pdMS_TO_TICKS(150));
     }
 }
 
 void keypad_task(void* pv)
 {
-    char buffer[5] = {0};
-    int idx = 0;
-    bool entering_pin = false;
-
-    const char ARM_KEY = 'A';
+    static UiFlow ui;
+    ui_flow_init(&ui, keypad_check_pin);
 
     while (true)
     {
         char key = keypad_get_key_nonblocking();
+        uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
 
+        UiOutput out;
         if (key != 0)
         {
-            ESP_LOGI("KEYPAD", "Key: %c", key);
-
-            if (key == ARM_KEY && !entering_pin)
-            {
-                AlarmEvent ev{ AlarmEventType::ARM_LOCAL };
-                xQueueSend(g_eventQueue, &ev, 0);
-                continue;
-            }
-
-            if (!entering_pin)
-            {
-                entering_pin = true;
-                idx = 0;
-                memset(buffer, 0, sizeof(buffer));
-
-                lcd_clear();
-                lcd_show_message("ENTER PIN:");
-                lcd_set_cursor(0, 1);
-                lcd_write_string("    ");
-            }
-
-            if (key == '*')
-            {
-                idx = 0;
-                memset(buffer, 0, sizeof(buffer));
-
-                lcd_clear();
-                lcd_show_message("ENTER PIN:");
-                lcd_set_cursor(0, 1);
-                lcd_write_string("    ");
-                continue;
-            }
-
-            if (key == '#')
-            {
-                if (idx == 4)
-                {
-                    if (keypad_check_pin(buffer))
-                    {
-                        AlarmEvent ev{ AlarmEventType::DISARM_PIN_OK };
-                        xQueueSend(g_eventQueue, &ev, 0);
-
-                        lcd_clear();
-                        lcd_show_message("DISARMED");
-                    }
-                    else
-                    {
-                        lcd_clear();
-                        lcd_show_message("WRONG PIN");
-                        vTaskDelay(pdMS_TO_TICKS(1000));
-
-                        lcd_clear();
-                        lcd_show_message("ENTER PIN:");
-                        lcd_set_cursor(0, 1);
-                        lcd_write_string("    ");
-                    }
-                }
-                else
-                {
-                    lcd_clear();
-                    lcd_show_message("NEED 4 DIGITS");
-                    vTaskDelay(pdMS_TO_TICKS(700));
-
-                    lcd_clear();
-                    lcd_show_message("ENTER PIN:");
-                    lcd_set_cursor(0, 1);
-                    lcd_write_string("    ");
-                }
-
-                entering_pin = false;
-                idx = 0;
-                memset(buffer, 0, sizeof(buffer));
-                continue;
-            }
+            DLOGI("KEYPAD", "Key: %c", key);
+            out = ui_flow_on_key(&ui, key, now_ms);
+        }
+        else
+        {
+            out = ui_flow_tick(&ui, now_ms);
+        }
 
-            if (key >= '0' && key <= '9')
-            {
-                if (idx < 4)
-                {
-                    buffer[idx++] = key;
-
-                    char stars[5] = "    ";
-                    for (int i = 0; i < idx; i++)
-                        stars[i] = '*';
-
-                    lcd_clear();
-                    lcd_show_message("ENTER PIN:");
-                    lcd_set_cursor(0, 1);
-                    lcd_write_string(stars);
-                }
-            }
+        switch (out.action)
+        {
+            case UiAction::ARM:           post_event(AlarmEventType::ARM_LOCAL); break;
+            case UiAction::DISARM_PIN_OK: post_event(AlarmEventType::DISARM_PIN_OK); break;
+            case UiAction::SET_PIN:       keypad_set_pin(out.new_pin); break;
+            case UiAction::NONE:          break;
         }
 
+        if (out.redraw) lcd_show_message(out.screen);
+        else if (out.release) lcd_show_message(alarm_fsm_screen(snapshot_read(&s_snapshot).state));
+
         vTaskDelay(pdMS_TO_TICKS(30));
     }
 }
@@ -475,152 +1018,364 @@ void keypad_task(void* pv)
 
 extern void speaker_update();
 
-void speaker_task(void* pv)
+// Spoken prompts for state changes and the exit countdown; clip names as
+// packed by tools/pack_voice.py. The one ultrasonic sensor is zone 1.
+static void announce(const SystemState& snap, AlarmState prev)
 {
-    TickType_t last_beep = xTaskGetTickCount();
+    char phrase[VOICE_PHRASE_MAX];
 
-    while (true)
+    switch (snap.state)
     {
-        speaker_update();
+        case AlarmState::EXIT_DELAY:
+            snprintf(phrase, sizeof(phrase), "exit_delay %d seconds", snap.exit_seconds_remaining);
+            voice_say(phrase);
+            break;
+        case AlarmState::ARMED:
+            voice_say("armed");
+            break;
+        case AlarmState::ALARM:
+            voice_stop();
+            voice_say("alarm zone 1");
+            break;
+        case AlarmState::DISARMED:
+            voice_stop();
+            if (prev != AlarmState::DISARMED) voice_say("disarmed");
+            break;
+    }
+}
 
-        AlarmState s = g_state;
-        TickType_t now = xTaskGetTickCount();
+// Runs every SPEAKER_POLL_MS on speaker_task.
+static void speaker_poll()
+{
+    static TickType_t last_beep = 0;
+    static AlarmState prev = AlarmState::DISARMED;
+    static int prev_sec = -1;
 
-        if (s == AlarmState::ALARM)
+    speaker_update();
+
+    SystemState snap = snapshot_read(&s_snapshot);
+    AlarmState s = snap.state;
+    TickType_t now = xTaskGetTickCount();
+
+    if (s != prev)
+    {
+        announce(snap, prev);
+        prev = s;
+        prev_sec = snap.exit_seconds_remaining;
+    }
+    else if (s == AlarmState::EXIT_DELAY && snap.exit_seconds_remaining != prev_sec)
+    {
+        prev_sec = snap.exit_seconds_remaining;
+        if (prev_sec == 10 || prev_sec == 5)
         {
-            speaker_set_alarm(true);
+            char phrase[VOICE_PHRASE_MAX];
+            snprintf(phrase, sizeof(phrase), "%d seconds", prev_sec);
+            voice_say(phrase);
         }
-        else if (s == AlarmState::EXIT_DELAY)
-        {
-            speaker_set_alarm(false);
+    }
+
+    if (s == AlarmState::ALARM)
+    {
+        speaker_set_alarm(true);
+    }
+    else if (s == AlarmState::EXIT_DELAY)
+    {
+        speaker_set_alarm(false);
 
-            int sec_left = g_exit_seconds_remaining;
-            int interval = 800;
+        int sec_left = snap.exit_seconds_remaining;
+        int interval = 800;
 
-            if (sec_left <= 10 && sec_left > 5) interval = 400;
-            else if (sec_left <= 5) interval = 150;
+        if (sec_left <= 10 && sec_left > 5) interval = 400;
+        else if (sec_left <= 5) interval = 150;
 
-            if (now - last_beep >= pdMS_TO_TICKS(interval))
-            {
-                last_beep = now;
-                speaker_beep_once(80);
-            }
-        }
-        else
+        if (now - last_beep >= pdMS_TO_TICKS(interval))
         {
-            speaker_set_alarm(false);
+            last_beep = now;
+            speaker_beep_once(80);
         }
-
-        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    else
+    {
+        speaker_set_alarm(false);
     }
 }
 
-void led_task(void* pv)
+// Runs every LED_POLL_MS on led_task or exec_task.
+static void led_poll()
 {
-    AlarmState prev = AlarmState::DISARMED;
-    int prev_sec = -1;
+    static AlarmState prev = AlarmState::DISARMED;
+    static int prev_sec = -1;
 
-    while (true)
+    SystemState snap = snapshot_read(&s_snapshot);
+    AlarmState s = snap.state;
+
+    if (s != prev)
     {
-        AlarmState s = g_state;
+        prev = s;
 
-        if (s != prev)
+        switch (s)
         {
-            prev = s;
-
-            switch (s)
-            {
-                case AlarmState::DISARMED: led_set_disarmed(); break;
-                case AlarmState::ARMED:    led_set_armed();    break;
-                case AlarmState::ALARM:    led_set_alarm();    break;
-                default: break;
-            }
+            case AlarmState::DISARMED: led_set_disarmed(); break;
+            case AlarmState::ARMED:    led_set_armed();    break;
+            case AlarmState::ALARM:    led_set_alarm();    break;
+            default: break;
         }
+    }
 
-        if (s == AlarmState::EXIT_DELAY)
+    if (s == AlarmState::EXIT_DELAY)
+    {
+        if (prev_sec != snap.exit_seconds_remaining)
         {
-            if (prev_sec != g_exit_seconds_remaining)
-            {
-                prev_sec = g_exit_seconds_remaining;
-                led_set_exit_delay_level(prev_sec);
-            }
+            prev_sec = snap.exit_seconds_remaining;
+            led_set_exit_delay_level(prev_sec);
         }
+    }
+}
 
-        vTaskDelay(pdMS_TO_TICKS(50));
+static void publish_request(const PubReq& req)
+{
+    switch (req.kind)
+    {
+        case PubKind::STATE:   mqtt_publish_state(req.snap, OutboxClass::KEEP); break;
+        case PubKind::ACK:
+            mqtt_publish_ack(s_acks[req.ack_ref - 1]);
+            ack_release(req.ack_ref);
+            break;
+        case PubKind::DIAG:    mqtt_publish_diag(); break;
+        case PubKind::FLUSH:   break;
+        case PubKind::HISTORY: mqtt_publish_history(req.parts); break;
+        case PubKind::OTA:     mqtt_publish_ota(); break;
     }
 }
 
-void mqtt_task(void* pv)
+// Waiting for the first connect after boot is not an outage.
+static bool s_mqtt_was_up = false;
+static bool s_in_outage = false;
+static uint32_t s_outage_start_ms = 0;
+
+// Called every publish period and on FLUSH. Samples the heap while the
+// broker is away; once it is back, flushes the outbox and reports the
+// outage in a diag message.
+static void outage_track(uint32_t now_ms)
+{
+    if (!conn_mqtt_up()) {
+        if (!s_mqtt_was_up) return;
+        if (!s_in_outage) {
+            s_in_outage = true;
+            s_outage_start_ms = now_ms;
+            s_outage.count++;
+        }
+        uint32_t heap = esp_get_free_heap_size();
+        if (heap < s_outage.heap_min) s_outage.heap_min = heap;
+        return;
+    }
+
+    s_mqtt_was_up = true;
+    mqtt_flush_outbox();
+    if (!s_in_outage) return;
+
+    s_in_outage = false;
+    s_outage.last_ms = now_ms - s_outage_start_ms;
+    if (s_outage.last_ms > s_outage.max_ms) s_outage.max_ms = s_outage.last_ms;
+    mqtt_publish_diag();
+}
+
+static void mqtt_on_request(const PubReq& req)
+{
+    publish_request(req);
+    if (req.kind == PubKind::FLUSH)
+        outage_track(pdTICKS_TO_MS(xTaskGetTickCount()));
+    if (uxQueueMessagesWaiting(g_pubQueue) == 0 && s_pub_overflow.exchange(false))
+        mqtt_publish_state(snapshot_read(&s_snapshot), OutboxClass::KEEP);
+}
+
+// Periodic telemetry and housekeeping, every PUB_PERIOD_MS.
+static void mqtt_period()
+{
+    static int ticks = 0;
+    static uint32_t last_diag_ms = 0;
+
+    uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+    outage_track(now_ms);
+    mqtt_publish_state(snapshot_read(&s_snapshot), OutboxClass::LATEST);
+
+    if (now_ms - last_diag_ms >= DIAG_PERIOD_MS) {
+        last_diag_ms = now_ms;
+        mqtt_publish_diag();
+#if EXECUTOR_BUILD
+        exec_log_stats();
+#endif
+    }
+
+    Baseline bl;
+    bool save = false;
+    portENTER_CRITICAL(&s_baseline_lock);
+    if (s_baseline_save_pending) {
+        bl = s_baseline_snapshot;
+        s_baseline_save_pending = false;
+        save = true;
+    }
+    portEXIT_CRITICAL(&s_baseline_lock);
+    if (save) baseline_save(0, &bl);
+
+    if (STATIC_ALLOC_BUILD && ++ticks % 30 == 0) {
+        alloc_guard_report();
+    }
+}
+
+// A task of its own in both builds: on exec_task the siren and the exit
+// beeps would wait behind MQTT publishing, NVS writes and the history lock.
+void speaker_task(void* pv)
 {
     while (true)
     {
-        mqtt_publish_state();
-        vTaskDelay(pdMS_TO_TICKS(2000));  
+        speaker_poll();
+        s_poll_wakeups++;
+        vTaskDelay(pdMS_TO_TICKS(SPEAKER_POLL_MS));
     }
 }
 
-void remote_task(void* pv)
+#if EXECUTOR_BUILD
+
+// Posted by pub_queue_send().
+static void mqtt_drain()
+{
+    PubReq req;
+    while (xQueueReceive(g_pubQueue, &req, 0)) mqtt_on_request(req);
+}
+
+#else
+
+// The only publisher for alarm_task's messages, plus the periodic work.
+void mqtt_task(void* pv)
 {
+    TickType_t last = xTaskGetTickCount();
+
     while (true)
     {
-        RemoteCommandType cmd = remote_check_command();
+        TickType_t elapsed = xTaskGetTickCount() - last;
+        TickType_t period = pdMS_TO_TICKS(PUB_PERIOD_MS);
 
-        if (cmd == RemoteCommandType::ARM)
-        {
-            AlarmEvent ev{ AlarmEventType::ARM_REMOTE };
-            xQueueSend(g_eventQueue, &ev, 0);
-        }
-        else if (cmd == RemoteCommandType::DISARM)
+        PubReq req;
+        bool got = xQueueReceive(g_pubQueue, &req, elapsed < period ? period - elapsed : 0);
+        s_poll_wakeups++;
+        if (got)
         {
-            AlarmEvent ev{ AlarmEventType::DISARM_REMOTE };
-            xQueueSend(g_eventQueue, &ev, 0);
+            mqtt_on_request(req);
+            continue;
         }
-
-        vTaskDelay(pdMS_TO_TICKS(500));
+        last = xTaskGetTickCount();
+        mqtt_period();
     }
 }
 
+void led_task(void* pv)
+{
+    while (true)
+    {
+        led_poll();
+        s_poll_wakeups++;
+        vTaskDelay(pdMS_TO_TICKS(LED_POLL_MS));
+    }
+}
 
 void lcd_task(void* pv)
 {
     while (true)
     {
+        s_poll_wakeups++;
         vTaskDelay(pdMS_TO_TICKS(1000));
     }
 }
 
+#endif
+
 extern "C" void app_main(void)
 {
     ESP_ERROR_CHECK(nvs_flash_init());
 
     ESP_LOGI(TAG, "Smart Home Alarm – RTOS core starting");
 
-    wifi_init_sta(); 
-    vTaskDelay(pdMS_TO_TICKS(2000)); 
+    dlog_init();
+    snapshot_init(&s_snapshot, g_alarm.state);
+    outbox_init(&s_outbox);
 
+    conn_init();
     mqtt_init();     
 
     ultrasonic_init();
     keypad_init();
     lcd_init();
     speaker_init();
+    voice_init();
     led_init();
 
-    g_eventQueue = xQueueCreate(16, sizeof(AlarmEvent));
+#if STATIC_ALLOC_BUILD
+    g_eventQueue = xQueueCreateStatic(EVENT_QUEUE_LEN, sizeof(AlarmEvent),
+                                      s_eventQueueStorage, &s_eventQueueBuf);
+#else
+    g_eventQueue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(AlarmEvent));
+#endif
     if (!g_eventQueue)
     {
         ESP_LOGE(TAG, "Event queue creation failed");
         return;
     }
+    // For debuggers (with CONFIG_FREERTOS_QUEUE_REGISTRY_SIZE) and the
+    // simulator's event tap; a no-op otherwise.
+    vQueueAddToRegistry(g_eventQueue, EVENT_QUEUE_NAME);
+
+#if STATIC_ALLOC_BUILD
+    g_pubQueue = xQueueCreateStatic(PUB_QUEUE_LEN, sizeof(PubReq),
+                                    s_pubQueueStorage, &s_pubQueueBuf);
+#else
+    g_pubQueue = xQueueCreate(PUB_QUEUE_LEN, sizeof(PubReq));
+#endif
+    if (!g_pubQueue)
+    {
+        ESP_LOGE(TAG, "Publish queue creation failed");
+        return;
+    }
 
-    xTaskCreate(alarm_task,     "alarm_task",     4096, nullptr, 10, nullptr);
-    xTaskCreate(ultrasonic_task,"ultra_task",     2048, nullptr, 8,  nullptr);
-    xTaskCreate(keypad_task,    "keypad_task",    4096, nullptr, 7,  nullptr);
-    xTaskCreate(speaker_task,   "speaker_task",   2048, nullptr, 6,  nullptr);
-    xTaskCreate(led_task,       "led_task",       2048, nullptr, 5,  nullptr);
-    xTaskCreate(mqtt_task,      "mqtt_task",      4096, nullptr, 4,  nullptr);
-    xTaskCreate(remote_task,    "remote_task",    2048, nullptr, 3,  nullptr);
-    xTaskCreate(lcd_task,       "lcd_task",       2048, nullptr, 2,  nullptr);
+    history_init(&s_history);
+    if (!baseline_load(0, &s_baseline)) {
+        baseline_init(&s_baseline);
+        ESP_LOGI(TAG, "No stored baseline, learning while disarmed");
+    }
+#if STATIC_ALLOC_BUILD
+    s_history_mutex = xSemaphoreCreateMutexStatic(&s_history_mutex_buf);
+#else
+    s_history_mutex = xSemaphoreCreateMutex();
+#endif
+
+    deadline_init(on_deadline_fault);
+
+    task_plan_create(alarm_task,      TASK_ALARM);
+    task_plan_create(ultrasonic_task, TASK_ULTRA);
+    task_plan_create(keypad_task,     TASK_KEYPAD);
+    task_plan_create(speaker_task,    TASK_SPEAKER);
+#if EXECUTOR_BUILD
+    exec_add("led",     led_poll,     LED_POLL_MS);
+    exec_add("mqtt",    mqtt_period,  PUB_PERIOD_MS);
+    s_mqtt_job = exec_add("mqtt_queue", mqtt_drain, 0);
+    exec_start();
+#else
+    task_plan_create(led_task,        TASK_LED);
+    task_plan_create(mqtt_task,       TASK_MQTT);
+    task_plan_create(lcd_task,        TASK_LCD);
+#endif
+    ESP_LOGI(TAG, "Task stacks %lu bytes (%s)", (unsigned long)task_plan_total_stack(),
+             EXECUTOR_BUILD ? "executor" : "one task per subsystem");
+
+    remote_init(g_eventQueue);
+    lan_control_init();
+    ota_init(ota_report_later);
+
+    jitter_init();
+
+#if STATIC_ALLOC_BUILD
+    alloc_guard_arm();
+#endif
 
     ESP_LOGI(TAG, "RTOS core running.");
 }
@@ -0,0 +1,217 @@
+#include "mqtt_tls.h"
+
+#include "esp_tls.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include <string.h>
+#include <sys/select.h>
+
+static const char* TAG = "MQTT_TLS";
+
+struct TlsContext {
+    bool        used;
+    esp_tls_t*  tls;
+    const char* ca_pem;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t* session;
+#endif
+};
+
+// Transports are created and destroyed by the connectivity manager only.
+static TlsContext   s_ctx[MQTT_TLS_MAX];
+static MqttTlsStats s_stats;
+
+static TlsContext* ctx_of(esp_transport_handle_t t)
+{
+    return (TlsContext*)esp_transport_get_context_data(t);
+}
+
+static int tls_connect(esp_transport_handle_t t, const char* host, int port, int timeout_ms)
+{
+    TlsContext* c = ctx_of(t);
+
+    esp_tls_cfg_t cfg = {};
+    cfg.cacert_buf   = (const unsigned char*)c->ca_pem;
+    cfg.cacert_bytes = strlen(c->ca_pem) + 1;
+    cfg.timeout_ms   = timeout_ms;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    cfg.client_session = c->session;
+    if (c->session) s_stats.resume_offered++;
+#endif
+
+    c->tls = esp_tls_init();
+    if (!c->tls) return -1;
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_start();
+    int64_t t0 = esp_timer_get_time();
+
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, c->tls);
+
+    int64_t dt = esp_timer_get_time() - t0;
+    size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    if (ret != 1) {
+        s_stats.failures++;
+        ESP_LOGW(TAG, "Handshake with %s:%d failed after %lld ms",
+                 host, port, dt / 1000);
+        esp_tls_conn_destroy(c->tls);
+        c->tls = nullptr;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+        // A stale ticket must not poison every later attempt.
+        if (c->session) {
+            esp_tls_free_client_session(c->session);
+            c->session = nullptr;
+        }
+#endif
+        return -1;
+    }
+
+    s_stats.connects++;
+    s_stats.last_handshake_us = dt;
+    if (dt > s_stats.max_handshake_us) s_stats.max_handshake_us = dt;
+
+    s_stats.last_peak_heap = free_before > min_free ? free_before - min_free : 0;
+    if (s_stats.last_peak_heap > s_stats.max_peak_heap) {
+        s_stats.max_peak_heap = s_stats.last_peak_heap;
+    }
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (c->session) esp_tls_free_client_session(c->session);
+    c->session = esp_tls_get_client_session(c->tls);
+#endif
+
+    return 0;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    TlsContext* c = ctx_of(t);
+    if (!c->tls) return -1;
+
+    if (esp_tls_get_bytes_avail(c->tls) > 0) return 1;
+
+    int fd = -1;
+    if (esp_tls_get_conn_sockfd(c->tls, &fd) != ESP_OK || fd < 0) return -1;
+
+    fd_set rset;
+    FD_ZERO(&rset);
+    FD_SET(fd, &rset);
+    timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    return select(fd + 1, &rset, nullptr, nullptr, timeout_ms < 0 ? nullptr : &tv);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    TlsContext* c = ctx_of(t);
+    if (!c->tls) return -1;
+
+    int fd = -1;
+    if (esp_tls_get_conn_sockfd(c->tls, &fd) != ESP_OK || fd < 0) return -1;
+
+    fd_set wset;
+    FD_ZERO(&wset);
+    FD_SET(fd, &wset);
+    timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    return select(fd + 1, nullptr, &wset, nullptr, timeout_ms < 0 ? nullptr : &tv);
+}
+
+static int tls_read(esp_transport_handle_t t, char* buffer, int len, int timeout_ms)
+{
+    TlsContext* c = ctx_of(t);
+    if (!c->tls) return -1;
+
+    int poll = 1;
+    if (esp_tls_get_bytes_avail(c->tls) <= 0) {
+        poll = tls_poll_read(t, timeout_ms);
+        if (poll <= 0) return poll == 0 ? ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT : -1;
+    }
+
+    int ret = esp_tls_conn_read(c->tls, buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    return ret;
+}
+
+static int tls_write(esp_transport_handle_t t, const char* buffer, int len, int timeout_ms)
+{
+    TlsContext* c = ctx_of(t);
+    if (!c->tls) return -1;
+
+    int poll = tls_poll_write(t, timeout_ms);
+    if (poll <= 0) return poll;
+
+    return esp_tls_conn_write(c->tls, buffer, len);
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    TlsContext* c = ctx_of(t);
+    if (c->tls) {
+        esp_tls_conn_destroy(c->tls);
+        c->tls = nullptr;
+    }
+    return 0;
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_close(t);
+    TlsContext* c = ctx_of(t);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (c->session) {
+        esp_tls_free_client_session(c->session);
+        c->session = nullptr;
+    }
+#endif
+    c->used = false;
+    return 0;
+}
+
+esp_transport_handle_t mqtt_tls_transport_create(const char* ca_pem)
+{
+    TlsContext* c = nullptr;
+    for (TlsContext& slot : s_ctx) {
+        if (!slot.used) {
+            c = &slot;
+            break;
+        }
+    }
+    if (!c) {
+        ESP_LOGE(TAG, "All %d TLS transports in use", MQTT_TLS_MAX);
+        return nullptr;
+    }
+
+    esp_transport_handle_t t = esp_transport_init();
+    if (!t) return nullptr;
+
+    *c = {};
+    c->used = true;
+    c->ca_pem = ca_pem;
+
+    esp_transport_set_context_data(t, c);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close,
+                           tls_poll_read, tls_poll_write, tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+    return t;
+}
+
+MqttTlsStats mqtt_tls_get_stats()
+{
+    return s_stats;
+}
+
+void mqtt_tls_log_stats()
+{
+    ESP_LOGI(TAG, "handshake %lld ms (max %lld), peak heap %u B (max %u), "
+             "connects=%lu failures=%lu resume_offered=%lu",
+             s_stats.last_handshake_us / 1000, s_stats.max_handshake_us / 1000,
+             (unsigned)s_stats.last_peak_heap, (unsigned)s_stats.max_peak_heap,
+             (unsigned long)s_stats.connects, (unsigned long)s_stats.failures,
+             (unsigned long)s_stats.resume_offered);
+}
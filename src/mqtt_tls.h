@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_transport.h"
+
+// TLS transport for the MQTT client built directly on esp-tls, so the
+// client session ticket survives reconnects (esp-mqtt's own SSL transport
+// starts every connection with a full handshake).
+//
+// Each transport has its own context (CA chain, connection, session ticket)
+// from a static pool of MQTT_TLS_MAX, so brokers with different CAs do not
+// share a ticket. The stats below add up over all of them.
+
+#define MQTT_TLS_MAX 3          // one per mqtts:// broker (BROKER_MAX)
+
+struct MqttTlsStats {
+    uint32_t connects;
+    uint32_t failures;
+    uint32_t resume_offered;      // connects that presented a cached ticket
+    int64_t  last_handshake_us;
+    int64_t  max_handshake_us;
+    size_t   last_peak_heap;      // bytes of heap consumed during the handshake
+    size_t   max_peak_heap;
+};
+
+// nullptr once MQTT_TLS_MAX transports exist. ca_pem must outlive it.
+esp_transport_handle_t mqtt_tls_transport_create(const char* ca_pem);
+
+MqttTlsStats mqtt_tls_get_stats();
+void mqtt_tls_log_stats();
@@ -0,0 +1,339 @@
+#include "ota.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_delta_ota.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+#include <stddef.h>
+#include <string.h>
+
+#include "task_config.h"
+#include "connectivity.h"
+
+static const char* TAG = "OTA";
+
+#define OTA_CHUNK               1024
+#define OTA_SIG_MAX             72
+#define OTA_KIND_FULL           0
+#define OTA_KIND_DELTA          1
+#define OTA_VERSION             1
+
+// Give the networking core a tick between flash bursts; every write runs
+// with the flash cache off, which also stalls non-IRAM code on CORE_RT.
+#define OTA_YIELD_EVERY         (16 * 1024)
+
+#define OTA_HEALTH_CHECK_MS     15000
+#define OTA_HEALTH_DEADLINE_MS  120000
+#define OTA_REBOOT_DELAY_MS     1000
+
+struct __attribute__((packed)) OtaHeader {
+    char     magic[4];
+    uint8_t  version;
+    uint8_t  kind;
+    uint16_t reserved;
+    uint32_t payload_len;
+    uint32_t image_len;
+    uint8_t  base_sha256[32];
+    uint8_t  image_sha256[32];
+    uint16_t sig_len;                 // DER length, not signed
+    uint8_t  sig[OTA_SIG_MAX];
+};
+
+// Public half of the release signing key used by tools/make_ota.py --key.
+static const char OTA_SIGNING_PUBKEY_PEM[] = R"(-----BEGIN PUBLIC KEY-----
+MFkwEwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAEYnplkLHBgiI/CxrEtkokzfa7nJJG
+EAkR45SBHW7fqCXQVcvsR9plCkG42TM7Mgwlz5NUdnVIyQNSJ2I/rELN8w==
+-----END PUBLIC KEY-----)";
+
+static TaskHandle_t s_task = nullptr;
+static OtaReportCb s_on_report = nullptr;
+static char s_url[OTA_URL_MAX + 1];
+static volatile bool s_busy = false;
+
+static esp_timer_handle_t s_health_timer = nullptr;
+static int64_t s_health_started_us = 0;
+
+// State of the update in flight, shared with the delta callbacks.
+static const esp_partition_t* s_running = nullptr;
+static esp_ota_handle_t s_ota = 0;
+static mbedtls_sha256_context s_image_sha;
+static uint32_t s_written = 0;
+static uint32_t s_max_write_us = 0;
+
+static esp_err_t image_write(const uint8_t* buf, size_t size)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(s_ota, buf, size);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    if (dt > s_max_write_us) s_max_write_us = dt;
+
+    mbedtls_sha256_update(&s_image_sha, buf, size);
+    s_written += size;
+    return err;
+}
+
+static esp_err_t delta_write_cb(const uint8_t* buf, size_t size, void* user_data)
+{
+    return image_write(buf, size);
+}
+
+static esp_err_t delta_read_cb(uint8_t* buf, size_t size, int src_offset)
+{
+    return esp_partition_read(s_running, src_offset, buf, size);
+}
+
+static bool verify_header(const OtaHeader& h)
+{
+    uint8_t digest[32];
+    mbedtls_sha256((const uint8_t*)&h, offsetof(OtaHeader, sig_len), digest, 0);
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+
+    int ret = mbedtls_pk_parse_public_key(&pk, (const unsigned char*)OTA_SIGNING_PUBKEY_PEM,
+                                          sizeof(OTA_SIGNING_PUBKEY_PEM));
+    if (ret == 0) {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, sizeof(digest),
+                                h.sig, h.sig_len);
+    }
+    mbedtls_pk_free(&pk);
+
+    if (ret != 0) ESP_LOGE(TAG, "Signature check failed (-0x%04x)", -ret);
+    return ret == 0;
+}
+
+static int http_read_full(esp_http_client_handle_t http, uint8_t* buf, int len)
+{
+    int got = 0;
+    while (got < len) {
+        int n = esp_http_client_read(http, (char*)buf + got, len - got);
+        if (n <= 0) return got;
+        got += n;
+    }
+    return got;
+}
+
+static const char* run_update(const char* url, OtaReport* rep)
+{
+    static uint8_t chunk[OTA_CHUNK];
+    static OtaHeader hdr;
+
+    esp_http_client_config_t cfg = {};
+    cfg.url = url;
+    cfg.timeout_ms = 10000;
+    cfg.buffer_size = OTA_CHUNK;
+    if (strncmp(url, "https://", 8) == 0) cfg.crt_bundle_attach = esp_crt_bundle_attach;
+
+    esp_http_client_handle_t http = esp_http_client_init(&cfg);
+    if (!http) return "http init";
+
+    const char* reason = nullptr;
+    esp_delta_ota_handle_t delta = nullptr;
+    const esp_partition_t* target = nullptr;
+    uint32_t next_yield = OTA_YIELD_EVERY;
+
+    s_ota = 0;
+    s_written = 0;
+    s_max_write_us = 0;
+    mbedtls_sha256_init(&s_image_sha);
+
+    if (esp_http_client_open(http, 0) != ESP_OK) { reason = "http open"; goto out; }
+    esp_http_client_fetch_headers(http);
+    if (esp_http_client_get_status_code(http) != 200) { reason = "http status"; goto out; }
+
+    if (http_read_full(http, (uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+        reason = "short header";
+        goto out;
+    }
+    rep->downloaded = sizeof(hdr);
+
+    if (memcmp(hdr.magic, "HGOT", 4) != 0 || hdr.version != OTA_VERSION ||
+        hdr.kind > OTA_KIND_DELTA || hdr.sig_len > OTA_SIG_MAX) {
+        reason = "bad header";
+        goto out;
+    }
+    if (!verify_header(hdr)) { reason = "bad signature"; goto out; }
+
+    rep->delta = hdr.kind == OTA_KIND_DELTA;
+    rep->image_len = hdr.image_len;
+
+    s_running = esp_ota_get_running_partition();
+    target = esp_ota_get_next_update_partition(nullptr);
+    if (!target || hdr.image_len > target->size) { reason = "no room"; goto out; }
+
+    if (rep->delta) {
+        uint8_t base[32];
+        if (esp_partition_get_sha256(s_running, base) != ESP_OK ||
+            memcmp(base, hdr.base_sha256, sizeof(base)) != 0) {
+            reason = "base mismatch";
+            goto out;
+        }
+    }
+
+    ESP_LOGI(TAG, "%s update: %lu payload bytes -> %lu byte image in %s",
+             rep->delta ? "Delta" : "Full", (unsigned long)hdr.payload_len,
+             (unsigned long)hdr.image_len, target->label);
+
+    // Sequential writes erase sector by sector as data arrives, instead of
+    // stalling both cores for a whole-partition erase up front.
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &s_ota) != ESP_OK) {
+        reason = "ota begin";
+        goto out;
+    }
+    mbedtls_sha256_starts(&s_image_sha, 0);
+
+    if (rep->delta) {
+        esp_delta_ota_cfg_t dcfg = {};
+        dcfg.read_cb = delta_read_cb;
+        dcfg.write_cb = delta_write_cb;
+        delta = esp_delta_ota_init(&dcfg);
+        if (!delta) { reason = "delta init"; goto out; }
+    }
+
+    while (rep->downloaded - sizeof(hdr) < hdr.payload_len) {
+        uint32_t left = hdr.payload_len - (rep->downloaded - sizeof(hdr));
+        int n = esp_http_client_read(http, (char*)chunk, left < OTA_CHUNK ? left : OTA_CHUNK);
+        if (n <= 0) { reason = "short payload"; goto out; }
+        rep->downloaded += n;
+
+        esp_err_t err = delta ? esp_delta_ota_feed_patch(delta, chunk, n)
+                              : image_write(chunk, n);
+        if (err != ESP_OK) { reason = delta ? "patch" : "flash write"; goto out; }
+
+        if (rep->downloaded >= next_yield) {
+            next_yield += OTA_YIELD_EVERY;
+            vTaskDelay(1);
+        }
+    }
+
+    if (delta && esp_delta_ota_finalize(delta) != ESP_OK) { reason = "patch finalize"; goto out; }
+
+    {
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&s_image_sha, digest);
+        if (s_written != hdr.image_len || memcmp(digest, hdr.image_sha256, 32) != 0) {
+            reason = "image hash";
+            goto out;
+        }
+    }
+
+    // esp_ota_end() re-validates the image header and checksums.
+    if (esp_ota_end(s_ota) != ESP_OK) { s_ota = 0; reason = "image invalid"; goto out; }
+    s_ota = 0;
+
+    if (esp_ota_set_boot_partition(target) != ESP_OK) { reason = "set boot"; goto out; }
+
+out:
+    if (delta) esp_delta_ota_deinit(delta);
+    if (s_ota) esp_ota_abort(s_ota);
+    mbedtls_sha256_free(&s_image_sha);
+    esp_http_client_close(http);
+    esp_http_client_cleanup(http);
+
+    rep->max_write_us = s_max_write_us;
+    return reason;
+}
+
+static void ota_task(void* pv)
+{
+    s_task = xTaskGetCurrentTaskHandle();
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        OtaReport rep = {};
+        int64_t t0 = esp_timer_get_time();
+
+        ESP_LOGI(TAG, "Fetching %s", s_url);
+        const char* reason = run_update(s_url, &rep);
+
+        rep.ok = reason == nullptr;
+        rep.reason = rep.ok ? "ok" : reason;
+        rep.duration_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+
+        if (rep.ok) {
+            ESP_LOGI(TAG, "Update ok: %lu bytes transferred for a %lu byte image "
+                          "(%lu%%), %lu ms, longest flash write %lu us",
+                     (unsigned long)rep.downloaded, (unsigned long)rep.image_len,
+                     (unsigned long)(rep.image_len ? rep.downloaded * 100ULL / rep.image_len : 0),
+                     (unsigned long)rep.duration_ms, (unsigned long)rep.max_write_us);
+        } else {
+            ESP_LOGE(TAG, "Update failed: %s after %lu bytes",
+                     rep.reason, (unsigned long)rep.downloaded);
+        }
+
+        if (s_on_report) s_on_report(rep);
+
+        if (rep.ok) {
+            vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+            esp_restart();
+        }
+        s_busy = false;
+    }
+}
+
+// A freshly updated image counts as healthy once it reaches the broker; the
+// alarm tasks are already running by then. A crash before that reboots into
+// PENDING_VERIFY again and the bootloader falls back on its own.
+static void health_cb(void* arg)
+{
+    if (conn_mqtt_up()) {
+        ESP_LOGI(TAG, "New image healthy, cancelling rollback");
+        esp_ota_mark_app_valid_cancel_rollback();
+        return;
+    }
+
+    if (esp_timer_get_time() - s_health_started_us >= OTA_HEALTH_DEADLINE_MS * 1000LL) {
+        ESP_LOGE(TAG, "New image never reached MQTT, rolling back");
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+        return;
+    }
+
+    esp_timer_start_once(s_health_timer, OTA_HEALTH_CHECK_MS * 1000ULL);
+}
+
+void ota_init(OtaReportCb on_report)
+{
+    s_on_report = on_report;
+
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        ESP_LOGW(TAG, "Running %s pending verification", running->label);
+
+        esp_timer_create_args_t args = {};
+        args.callback = health_cb;
+        args.name = "ota_health";
+        esp_timer_create(&args, &s_health_timer);
+
+        s_health_started_us = esp_timer_get_time();
+        esp_timer_start_once(s_health_timer, OTA_HEALTH_CHECK_MS * 1000ULL);
+    }
+
+    task_plan_create(ota_task, TASK_OTA);
+
+    ESP_LOGI(TAG, "OTA ready, running from %s", running->label);
+}
+
+bool ota_request(const char* url, int len)
+{
+    if (!s_task || s_busy || len <= 0 || len > OTA_URL_MAX) return false;
+
+    s_busy = true;
+    memcpy(s_url, url, len);
+    s_url[len] = '\0';
+    xTaskNotifyGive(s_task);
+    return true;
+}
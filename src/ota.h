@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Signed, streaming OTA into the inactive ota_N slot (see partitions.csv).
+//
+// An update package is an OtaHeader followed by the payload, fetched over
+// HTTP(S) and written as it arrives:
+//
+//   magic "HGOT" ver:u8 kind:u8 reserved:u16 payload_len:u32 image_len:u32
+//   base_sha256[32] image_sha256[32] sig_len:u16 sig[72]
+//
+// kind FULL carries the raw app image; kind DELTA carries a detools patch
+// (heatshrink) against the running image, identified by base_sha256. The
+// signature is ECDSA P-256 over SHA-256 of everything before sig_len, so it
+// covers the hash of the image that ends up in flash. Packages are built by
+// tools/make_ota.py.
+//
+// A new image boots in PENDING_VERIFY and only stays once MQTT has come up
+// within OTA_HEALTH_DEADLINE_MS; otherwise the bootloader rolls back.
+
+#define OTA_URL_MAX 160
+
+struct OtaReport {
+    bool        ok;
+    bool        delta;
+    const char* reason;          // static string, "ok" on success
+    uint32_t    downloaded;      // package bytes received
+    uint32_t    image_len;       // size of the resulting app image
+    uint32_t    duration_ms;
+    uint32_t    max_write_us;    // longest single flash write (cache off)
+};
+
+typedef void (*OtaReportCb)(const OtaReport& report);
+
+// Confirms or rolls back a freshly updated image and starts ota_task.
+// on_report runs on ota_task when an update finishes or fails.
+void ota_init(OtaReportCb on_report);
+
+// Queues a download; false if one is already running or the URL is too long.
+bool ota_request(const char* url, int len);
@@ -0,0 +1,98 @@
+#include "outbox.h"
+
+#include <string.h>
+
+static void slot_free(Outbox* ob, OutboxMsg* m)
+{
+    ob->stats.depth--;
+    ob->stats.bytes -= m->len;
+    m->seq = 0;
+}
+
+// Oldest used slot of the class and how many the class has.
+static OutboxMsg* oldest(Outbox* ob, OutboxClass cls, int* count)
+{
+    OutboxMsg* best = nullptr;
+    *count = 0;
+    for (OutboxMsg& m : ob->slots) {
+        if (!m.seq || m.cls != cls) continue;
+        (*count)++;
+        if (!best || m.seq < best->seq) best = &m;
+    }
+    return best;
+}
+
+void outbox_init(Outbox* ob)
+{
+    memset(ob, 0, sizeof(*ob));
+    ob->next_seq = 1;
+}
+
+bool outbox_put(Outbox* ob, const char* topic, const char* payload, size_t len,
+                uint8_t qos, OutboxClass cls)
+{
+    if (len > OUTBOX_PAYLOAD_MAX) {
+        ob->stats.too_big++;
+        return false;
+    }
+
+    // Whatever LATEST value of this topic is queued is stale now.
+    for (OutboxMsg& m : ob->slots) {
+        if (m.seq && m.cls == OutboxClass::LATEST && strcmp(m.topic, topic) == 0) {
+            slot_free(ob, &m);
+            ob->stats.coalesced++;
+        }
+    }
+
+    if (cls == OutboxClass::KEEP) {
+        int keep;
+        OutboxMsg* first = oldest(ob, OutboxClass::KEEP, &keep);
+        if (keep >= OUTBOX_SLOTS - OUTBOX_LATEST_SLOTS) {
+            slot_free(ob, first);
+            ob->stats.dropped++;
+        }
+    }
+
+    OutboxMsg* slot = nullptr;
+    for (OutboxMsg& m : ob->slots) {
+        if (!m.seq) { slot = &m; break; }
+    }
+    if (!slot) {
+        ob->stats.dropped++;
+        return false;
+    }
+
+    slot->topic = topic;
+    slot->seq = ob->next_seq++;
+    slot->len = (uint16_t)len;
+    slot->qos = qos;
+    slot->cls = cls;
+    memcpy(slot->payload, payload, len);
+
+    ob->stats.queued++;
+    ob->stats.depth++;
+    ob->stats.bytes += len;
+    if (ob->stats.depth > ob->stats.max_depth) ob->stats.max_depth = ob->stats.depth;
+    if (ob->stats.bytes > ob->stats.max_bytes) ob->stats.max_bytes = ob->stats.bytes;
+    return true;
+}
+
+const OutboxMsg* outbox_peek(const Outbox* ob)
+{
+    const OutboxMsg* best = nullptr;
+    for (const OutboxMsg& m : ob->slots) {
+        if (m.seq && (!best || m.seq < best->seq)) best = &m;
+    }
+    return best;
+}
+
+void outbox_sent(Outbox* ob, uint32_t seq)
+{
+    for (OutboxMsg& m : ob->slots) {
+        if (m.seq == seq) {
+            slot_free(ob, &m);
+            ob->stats.sent++;
+            return;
+        }
+    }
+}
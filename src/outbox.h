@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Messages waiting for the broker, in fixed memory (OUTBOX_SLOTS slots of
+// OUTBOX_PAYLOAD_MAX bytes, nothing allocated). Pure code; the caller owns
+// locking and decides when to flush.
+//
+// Two classes:
+//   LATEST  only the newest value of a topic matters (periodic telemetry).
+//           A new LATEST message replaces the queued one of the same topic.
+//   KEEP    every message counts (state changes, command acks, OTA results).
+//           A KEEP message also supersedes a LATEST one queued earlier on
+//           the same topic, which it is newer than.
+// KEEP messages may fill all but OUTBOX_LATEST_SLOTS slots; past that the
+// oldest KEEP entry is evicted, so a long outage loses the oldest events
+// first and the latest values always have room. Messages leave in the
+// order they were (last) queued.
+
+#define OUTBOX_SLOTS         12
+#define OUTBOX_LATEST_SLOTS  2     // >= topics published as LATEST
+#define OUTBOX_PAYLOAD_MAX   256
+
+enum class OutboxClass : uint8_t {
+    LATEST,
+    KEEP,
+};
+
+struct OutboxMsg {
+    const char* topic;              // static storage
+    uint32_t    seq;                // 0: slot free
+    uint16_t    len;
+    uint8_t     qos;
+    OutboxClass cls;
+    char        payload[OUTBOX_PAYLOAD_MAX];
+};
+
+struct OutboxStats {
+    uint16_t depth;
+    uint16_t max_depth;
+    uint32_t bytes;                 // payload bytes queued
+    uint32_t max_bytes;
+    uint32_t queued;
+    uint32_t coalesced;             // superseded before they were sent
+    uint32_t dropped;               // evicted or refused for lack of room
+    uint32_t too_big;
+    uint32_t sent;
+};
+
+struct Outbox {
+    OutboxMsg   slots[OUTBOX_SLOTS];
+    uint32_t    next_seq;
+    OutboxStats stats;
+};
+
+void outbox_init(Outbox* ob);
+
+// False if the message was not queued (too big, or no room for a LATEST).
+bool outbox_put(Outbox* ob, const char* topic, const char* payload, size_t len,
+                uint8_t qos, OutboxClass cls);
+
+// Oldest message, or nullptr if empty.
+const OutboxMsg* outbox_peek(const Outbox* ob);
+
+// Removes the message with this seq once it has been handed to the client.
+// Does nothing if it was superseded in the meantime.
+void outbox_sent(Outbox* ob, uint32_t seq);
@@ -0,0 +1,57 @@
+#include "range_filter.h"
+
+#include <stdlib.h>
+
+void range_filter_init(RangeFilter* f)
+{
+    f->last_cm = -1;
+    f->pending_cm = -1;
+    f->pending_n = 0;
+}
+
+int range_echo_to_cm(int duration_us)
+{
+    int distance_cm = duration_us / 58;
+
+    if (distance_cm < RANGE_MIN_CM || distance_cm > RANGE_MAX_CM)
+        return -1;
+
+    return distance_cm;
+}
+
+int range_filter_apply(RangeFilter* f, const int* samples_cm, int n, int* avg_cm)
+{
+    int sample_sum = 0;
+    int valid_count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (samples_cm[i] > 0) {
+            sample_sum += samples_cm[i];
+            valid_count++;
+        }
+    }
+
+    if (valid_count == 0) {
+        *avg_cm = -1;
+        return -1;
+    }
+
+    int avg = sample_sum / valid_count;
+    *avg_cm = avg;
+
+    // Debounce: a single sudden jump is noise, a repeated one is a new level
+    if (f->last_cm != -1 && abs(avg - f->last_cm) > RANGE_DEBOUNCE_CM) {
+        if (f->pending_n && abs(avg - f->pending_cm) <= RANGE_DEBOUNCE_CM) {
+            f->pending_n++;
+        } else {
+            f->pending_cm = avg;
+            f->pending_n = 1;
+        }
+        if (f->pending_n < RANGE_CONFIRM)
+            return f->last_cm;  // keep previous stable reading
+    }
+
+    f->pending_n = 0;
+    f->last_cm = avg;
+    return avg;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// HC-SR04 echo conversion and per-reading filtering, split out of
+// ultrasonic.cpp so it has no GPIO or timer dependencies.
+
+#define RANGE_MIN_CM       2
+#define RANGE_MAX_CM       400
+#define RANGE_DEBOUNCE_CM  10      // max allowed jump between readings
+#define RANGE_CONFIRM      2       // readings a new level needs to be believed
+
+struct RangeFilter {
+    int     last_cm;               // -1 until the first accepted reading
+    int     pending_cm;            // level after a jump, waiting for confirmation
+    uint8_t pending_n;
+};
+
+void range_filter_init(RangeFilter* f);
+
+// Echo pulse width to distance, -1 outside RANGE_MIN_CM..RANGE_MAX_CM.
+int range_echo_to_cm(int duration_us);
+
+// Averages the valid (> 0) samples and holds back a jump of more than
+// RANGE_DEBOUNCE_CM from the last accepted reading, returning that one
+// instead, until RANGE_CONFIRM readings in a row agree on the new level.
+// *avg_cm gets the unfiltered average. Returns -1 (and sets *avg_cm to -1)
+// if no sample is valid.
+int range_filter_apply(RangeFilter* f, const int* samples_cm, int n, int* avg_cm);
@@ -1,30 +1,101 @@
 #include "remote.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "task_config.h"
 
 static const char* TAG = "REMOTE";
-static bool test_arm_request = false;
-static bool test_disarm_request = false;
 
-void remote_init()
+static QueueHandle_t s_queue = nullptr;
+
+// Held across check, enqueue and record, so two producers cannot both pass
+// the check with the same command. xQueueSend is called with no wait, so
+// the hold is short; a critical section would not allow the queue call.
+static SemaphoreHandle_t s_submit_mutex = nullptr;
+#if STATIC_ALLOC_BUILD
+static StaticSemaphore_t s_submit_mutex_buf;
+#endif
+
+static RemoteDedup s_dedup;
+
+static RemoteStats s_stats;
+
+static const char* source_name(EventSource src)
+{
+    switch (src) {
+        case EventSource::LOCAL:  return "local";
+        case EventSource::MQTT:   return "mqtt";
+        case EventSource::LAN:    return "lan";
+        case EventSource::RF:     return "rf";
+        case EventSource::SERIAL: return "serial";
+        default:                  return "?";
+    }
+}
+
+void remote_init(QueueHandle_t event_queue)
 {
-    ESP_LOGI(TAG, "Remote module initialized (stub)");
+    s_queue = event_queue;
+    remote_dedup_init(&s_dedup);
+    if (s_submit_mutex == nullptr) {
+#if STATIC_ALLOC_BUILD
+        s_submit_mutex = xSemaphoreCreateMutexStatic(&s_submit_mutex_buf);
+#else
+        s_submit_mutex = xSemaphoreCreateMutex();
+#endif
+    }
+    ESP_LOGI(TAG, "Remote command ingestion ready");
 }
 
-RemoteCommandType remote_check_command()
+SubmitResult remote_submit(RemoteCommandType cmd, EventSource src,
+                           uint32_t cmd_id, uint8_t ack_ref)
 {
-    if (test_arm_request)
-    {
-        test_arm_request = false;
-        ESP_LOGI(TAG, "REMOTE: ARM command received");
-        return RemoteCommandType::ARM;
+    if (!s_queue || !s_submit_mutex || cmd == RemoteCommandType::NONE) {
+        return SubmitResult::DROPPED;
+    }
+
+    const char* name = cmd == RemoteCommandType::ARM ? "ARM" : "DISARM";
+    SubmitResult result;
+
+    xSemaphoreTake(s_submit_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+
+    // Recorded only once the event is queued: a retry of a command the
+    // full queue turned away must not be dropped as its own duplicate.
+    if (remote_dedup_seen(&s_dedup, cmd, src, cmd_id, now)) {
+        s_stats.duplicates++;
+        result = SubmitResult::DUPLICATE;
+    } else {
+        AlarmEvent ev{ cmd == RemoteCommandType::ARM ? AlarmEventType::ARM_REMOTE
+                                                     : AlarmEventType::DISARM_REMOTE,
+                       now, src, ack_ref, cmd_id };
+
+        if (xQueueSend(s_queue, &ev, 0) == pdTRUE) {
+            remote_dedup_record(&s_dedup, cmd, src, cmd_id, now);
+            s_stats.accepted[(int)src]++;
+            result = SubmitResult::QUEUED;
+        } else {
+            s_stats.dropped++;
+            result = SubmitResult::DROPPED;
+        }
     }
+    xSemaphoreGive(s_submit_mutex);
 
-    if (test_disarm_request)
-    {
-        test_disarm_request = false;
-        ESP_LOGI(TAG, "REMOTE: DISARM command received");
-        return RemoteCommandType::DISARM;
+    switch (result) {
+        case SubmitResult::DUPLICATE:
+            DLOGI(TAG, "Duplicate %s from %s dropped", name, source_name(src));
+            break;
+        case SubmitResult::DROPPED:
+            DLOGW(TAG, "Event queue full, %s command lost", source_name(src));
+            break;
+        default:
+            DLOGI(TAG, "%s command from %s", name, source_name(src));
+            break;
     }
+    return result;
+}
 
-    return RemoteCommandType::NONE;
+RemoteStats remote_get_stats()
+{
+    return s_stats;
 }
@@ -1,11 +1,33 @@
 #pragma once
 
-enum class RemoteCommandType {
-    NONE,
-    ARM,
-    DISARM
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "alarm.h"
+#include "remote_dedup.h"
+
+enum class SubmitResult {
+    QUEUED,
+    DUPLICATE,
+    DROPPED        // event queue full or not initialised
+};
+
+struct RemoteStats {
+    uint32_t accepted[(int)EventSource::COUNT];
+    uint32_t duplicates;
+    uint32_t dropped;          // event queue full
 };
 
-void remote_init();
+// Command ingestion for every remote producer (MQTT, LAN, RF/IR, serial).
+// Commands go straight into the alarm event queue, tagged with their
+// source; there is no polling task in between.
+void remote_init(QueueHandle_t event_queue);
+
+// cmd_id is the producer's own identifier for the command (LAN sequence
+// number, RF rolling code, ...), 0 if it has none. Duplicates by the rules
+// in remote_dedup.h are dropped. cmd_id and ack_ref are passed through to the
+// event so alarm_task can acknowledge the command once it has been applied.
+SubmitResult remote_submit(RemoteCommandType cmd, EventSource src,
+                           uint32_t cmd_id = 0, uint8_t ack_ref = 0);
 
-RemoteCommandType remote_check_command();
\ No newline at end of file
+RemoteStats remote_get_stats();
@@ -0,0 +1,34 @@
+#include "remote_dedup.h"
+
+#include <string.h>
+
+void remote_dedup_init(RemoteDedup* d)
+{
+    memset(d, 0, sizeof(*d));
+    d->last_cmd = RemoteCommandType::NONE;
+}
+
+bool remote_dedup_seen(const RemoteDedup* d, RemoteCommandType cmd, EventSource src,
+                       uint32_t cmd_id, int64_t now_us)
+{
+    if (cmd_id != 0) {
+        for (int i = 0; i < REMOTE_ID_HISTORY; i++) {
+            if (d->ids[(int)src][i] == cmd_id) return true;
+        }
+    }
+
+    return cmd == d->last_cmd &&
+           now_us - d->last_cmd_us < (int64_t)REMOTE_DEDUP_MS * 1000;
+}
+
+void remote_dedup_record(RemoteDedup* d, RemoteCommandType cmd, EventSource src,
+                         uint32_t cmd_id, int64_t now_us)
+{
+    if (cmd_id != 0) {
+        uint8_t& next = d->next[(int)src];
+        d->ids[(int)src][next] = cmd_id;
+        next = (next + 1) % REMOTE_ID_HISTORY;
+    }
+    d->last_cmd = cmd;
+    d->last_cmd_us = now_us;
+}
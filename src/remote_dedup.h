@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "alarm.h"
+
+// The de-duplication rules behind remote_submit(), free of RTOS calls so
+// host tools can run one instance per simulated device. Time is a
+// caller-supplied microsecond clock.
+//
+// A command is a duplicate when its non-zero id matches one of the last
+// REMOTE_ID_HISTORY ids from the same source, or when the same command was
+// delivered from any source less than REMOTE_DEDUP_MS ago.
+
+#define REMOTE_DEDUP_MS   250     // same command from two paths, RF repeats
+#define REMOTE_ID_HISTORY 4       // recent cmd_ids remembered per source
+
+struct RemoteDedup {
+    uint32_t          ids[(int)EventSource::COUNT][REMOTE_ID_HISTORY];
+    uint8_t           next[(int)EventSource::COUNT];
+    RemoteCommandType last_cmd;
+    int64_t           last_cmd_us;
+};
+
+void remote_dedup_init(RemoteDedup* d);
+
+// Only checks; nothing is remembered.
+bool remote_dedup_seen(const RemoteDedup* d, RemoteCommandType cmd, EventSource src,
+                       uint32_t cmd_id, int64_t now_us);
+
+// Remembers a command once it has been delivered. A command that was
+// turned away must not be recorded, or its retry counts as a duplicate.
+void remote_dedup_record(RemoteDedup* d, RemoteCommandType cmd, EventSource src,
+                         uint32_t cmd_id, int64_t now_us);
@@ -2,6 +2,7 @@
 #include "driver/ledc.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "dlog.h"
 
 static const char* TAG = "SPEAKER";
 
@@ -68,7 +69,7 @@ void speaker_beep_once(int ms)
     ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, PWM_DUTY);
     ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
 
-    ESP_LOGI(TAG, "Beep start (%d ms)", ms);
+    DLOGI(TAG, "Beep start (%d ms)", ms);
 }
 
 void speaker_update()
@@ -82,6 +83,6 @@ void speaker_update()
         ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0);
 
         beep_end_time = 0;
-        ESP_LOGI(TAG, "Beep end");
+        DLOGI(TAG, "Beep end");
     }
 }
@@ -0,0 +1,103 @@
+#include "state_snapshot.h"
+
+#include <string.h>
+
+static void writer_lock(StateSnapshot* s)
+{
+#if defined(ESP_PLATFORM)
+    portENTER_CRITICAL(&s->writer);
+#else
+    while (s->writer.test_and_set(std::memory_order_acquire)) {}
+#endif
+}
+
+static void writer_unlock(StateSnapshot* s)
+{
+#if defined(ESP_PLATFORM)
+    portEXIT_CRITICAL(&s->writer);
+#else
+    s->writer.clear(std::memory_order_release);
+#endif
+}
+
+static void load_words(const StateSnapshot* s, SystemState* out)
+{
+    uint32_t w[SNAPSHOT_WORDS];
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) w[i] = s->words[i].load(std::memory_order_relaxed);
+    memcpy(out, w, sizeof(*out));
+}
+
+// Caller holds the writer lock, so the fields can be read without the
+// sequence check.
+static void store(StateSnapshot* s, SystemState* st)
+{
+    uint32_t seq = s->seq.load(std::memory_order_relaxed);
+    st->version = seq / 2 + 1;
+
+    uint32_t w[SNAPSHOT_WORDS] = {};
+    memcpy(w, st, sizeof(*st));
+
+    s->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < SNAPSHOT_WORDS; i++) s->words[i].store(w[i], std::memory_order_relaxed);
+    s->seq.store(seq + 2, std::memory_order_release);
+}
+
+void snapshot_init(StateSnapshot* s, AlarmState state)
+{
+    s->seq.store(0, std::memory_order_relaxed);
+#if defined(ESP_PLATFORM)
+    s->writer = portMUX_INITIALIZER_UNLOCKED;
+#else
+    s->writer.clear();
+#endif
+
+    SystemState st = {};
+    st.state = state;
+    st.distance_cm = -1;
+    store(s, &st);
+}
+
+void snapshot_set_alarm(StateSnapshot* s, AlarmState state, int exit_seconds_remaining,
+                        uint32_t exit_deadline_ms)
+{
+    writer_lock(s);
+    SystemState st;
+    load_words(s, &st);
+    st.state = state;
+    st.exit_seconds_remaining = (int16_t)exit_seconds_remaining;
+    st.exit_deadline_ms = exit_deadline_ms;
+    store(s, &st);
+    writer_unlock(s);
+}
+
+void snapshot_set_distance(StateSnapshot* s, int distance_cm)
+{
+    writer_lock(s);
+    SystemState st;
+    load_words(s, &st);
+    st.distance_cm = (int16_t)distance_cm;
+    store(s, &st);
+    writer_unlock(s);
+}
+
+SystemState snapshot_read(const StateSnapshot* s, uint32_t* retries)
+{
+    SystemState st;
+    uint32_t n = 0;
+
+    while (true) {
+        uint32_t before = s->seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            n++;
+            continue;
+        }
+        load_words(s, &st);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->seq.load(std::memory_order_relaxed) == before) break;
+        n++;
+    }
+
+    if (retries) *retries = n;
+    return st;
+}
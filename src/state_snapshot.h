@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "alarm.h"
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#endif
+
+// The alarm state other tasks look at, published as one versioned snapshot
+// so a reader never pairs a state with a distance (or countdown) from a
+// different moment.
+//
+// Seqlock: a writer makes the sequence odd, stores the fields and makes it
+// even again; a reader copies the fields and retries if the sequence was odd
+// or moved meanwhile. Readers take no lock and never block a writer. The two
+// writers (alarm_task for the FSM fields, ultrasonic_task for the distance)
+// are serialised by a critical section a few stores long, so a writer
+// preempted mid-update cannot leave the other spinning. Fields are stored
+// as relaxed atomic words, so there is no data race for the compiler to
+// exploit either.
+
+struct SystemState {
+    AlarmState state;
+    int16_t    exit_seconds_remaining;
+    int16_t    distance_cm;             // -1: no echo
+    uint32_t   exit_deadline_ms;
+    uint32_t   version;                 // bumped by every write
+};
+
+#define SNAPSHOT_WORDS ((sizeof(SystemState) + 3) / 4)
+
+struct StateSnapshot {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> words[SNAPSHOT_WORDS];
+#if defined(ESP_PLATFORM)
+    portMUX_TYPE          writer;
+#else
+    std::atomic_flag      writer;
+#endif
+};
+
+void snapshot_init(StateSnapshot* s, AlarmState state);
+
+// Writers.
+void snapshot_set_alarm(StateSnapshot* s, AlarmState state, int exit_seconds_remaining,
+                        uint32_t exit_deadline_ms);
+void snapshot_set_distance(StateSnapshot* s, int distance_cm);
+
+// Consistent copy of every field. *retries, if given, gets the number of
+// times the copy raced a writer and was redone.
+SystemState snapshot_read(const StateSnapshot* s, uint32_t* retries = nullptr);
@@ -0,0 +1,35 @@
+#include "task_config.h"
+
+BaseType_t task_plan_core(TaskId id)
+{
+    return TASK_PLACEMENT_UNPINNED ? tskNO_AFFINITY : TASK_PLAN[id].core;
+}
+
+#if STATIC_ALLOC_BUILD
+
+static StackType_t  s_stack_arena[task_plan_total_stack()];
+static StaticTask_t s_tcbs[TASK_COUNT];
+
+BaseType_t task_plan_create(TaskFunction_t fn, TaskId id)
+{
+    uint32_t offset = 0;
+    for (int i = 0; i < id; i++) offset += TASK_PLAN[i].stack_size;
+
+    const TaskSpec& t = TASK_PLAN[id];
+    TaskHandle_t h = xTaskCreateStaticPinnedToCore(
+        fn, t.name, t.stack_size, nullptr, t.priority,
+        &s_stack_arena[offset], &s_tcbs[id], task_plan_core(id));
+
+    return h ? pdPASS : pdFAIL;
+}
+
+#else
+
+BaseType_t task_plan_create(TaskFunction_t fn, TaskId id)
+{
+    const TaskSpec& t = TASK_PLAN[id];
+    return xTaskCreatePinnedToCore(fn, t.name, t.stack_size, nullptr,
+                                   t.priority, nullptr, task_plan_core(id));
+}
+
+#endif
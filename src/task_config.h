@@ -0,0 +1,108 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "jitter.h"
+
+// Core plan: Wi-Fi, LwIP, mbedTLS and the MQTT client run on PRO_CPU,
+// sensor capture, the alarm state machine and the actuators on APP_CPU.
+// The IDF side of the split lives in sdkconfig (Wi-Fi, LwIP and MQTT
+// task affinity are all pinned to core 0).
+#define CORE_NET  0
+#define CORE_RT   1
+
+// Build with -DSTATIC_ALLOC_BUILD=1 to create every task, the alarm event
+// queue and the LCD mutex from static storage sized by TASK_PLAN, and to arm
+// the post-boot allocation guard (see alloc_guard.h).
+#ifndef STATIC_ALLOC_BUILD
+#define STATIC_ALLOC_BUILD 0
+#endif
+
+// Build with -DEXECUTOR_BUILD=1 to run the polling subsystems (LEDs, MQTT
+// publishing) as handlers on one cooperative exec_task instead of a task
+// each; lcd_task, which only sleeps, is left out. Their TASK_PLAN stacks
+// shrink to 0 and exec_task gets EXEC_STACK. The sensor, keypad, alarm and
+// speaker tasks stay preemptive either way: the siren must not wait behind
+// MQTT, NVS or the history lock on exec_task. See executor.h.
+#ifndef EXECUTOR_BUILD
+#define EXECUTOR_BUILD 0
+#endif
+
+#if EXECUTOR_BUILD
+#define POLLED_STACK(bytes) 0
+#define EXEC_STACK          4096
+#else
+#define POLLED_STACK(bytes) (bytes)
+#define EXEC_STACK          0
+#endif
+
+// The jitter benchmark's load task (jitter.h) only takes stack when built in.
+#if JITTER_BENCH
+#define JITTER_STACK        4096
+#else
+#define JITTER_STACK        0
+#endif
+
+// Build with -DTASK_PLACEMENT_UNPINNED=1 to let the scheduler place every
+// task on either core again (useful for before/after jitter comparisons).
+#ifndef TASK_PLACEMENT_UNPINNED
+#define TASK_PLACEMENT_UNPINNED 0
+#endif
+
+enum TaskId {
+    TASK_ALARM,
+    TASK_ULTRA,
+    TASK_KEYPAD,
+    TASK_SPEAKER,
+    TASK_LED,
+    TASK_MQTT,
+    TASK_LCD,
+    TASK_LAN,
+    TASK_OTA,
+    TASK_DLOG,
+    TASK_I2C,
+    TASK_VOICE,
+    TASK_EXEC,
+    TASK_PROBE,
+    TASK_JITTER,
+    TASK_COUNT
+};
+
+struct TaskSpec {
+    const char* name;
+    uint32_t    stack_size;
+    UBaseType_t priority;
+    BaseType_t  core;
+};
+
+// Indexed by TaskId. Stack sizes are in bytes (ESP-IDF FreeRTOS).
+static constexpr TaskSpec TASK_PLAN[TASK_COUNT] = {
+    { "alarm_task",   4096,               10, CORE_RT  },
+    { "ultra_task",   2048,               8,  CORE_RT  },
+    { "keypad_task",  4096,               7,  CORE_RT  },
+    { "speaker_task", 2048,               6,  CORE_RT  },
+    { "led_task",     POLLED_STACK(2048), 5,  CORE_RT  },
+    { "mqtt_task",    POLLED_STACK(4096), 4,  CORE_NET },
+    { "lcd_task",     POLLED_STACK(2048), 2,  CORE_RT  },
+    { "lan_ctl_task", 3072,               6,  CORE_NET },
+    { "ota_task",     6144,               1,  CORE_NET },
+    { "dlog_task",    3072,               1,  CORE_NET },
+    { "i2c_task",     3072,               9,  CORE_RT  },
+    { "voice_task",   3072,               5,  CORE_NET },
+    { "exec_task",    EXEC_STACK,         6,  CORE_NET },
+    { "probe_task",   3072,               1,  CORE_NET },
+    { "jitter_load",  JITTER_STACK,       5,  CORE_NET },
+};
+
+static constexpr uint32_t task_plan_total_stack()
+{
+    uint32_t total = 0;
+    for (const TaskSpec& t : TASK_PLAN) total += t.stack_size;
+    return total;
+}
+
+BaseType_t task_plan_core(TaskId id);
+
+// Creates a task from its TASK_PLAN entry, from the static stack arena in
+// STATIC_ALLOC_BUILD and from the heap otherwise.
+BaseType_t task_plan_create(TaskFunction_t fn, TaskId id);
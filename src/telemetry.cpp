@@ -0,0 +1,191 @@
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const char* alarm_state_name(AlarmState s)
+{
+    switch (s) {
+        case AlarmState::DISARMED:  return "DISARMED";
+        case AlarmState::EXIT_DELAY:return "EXIT_DELAY";
+        case AlarmState::ARMED:     return "ARMED";
+        case AlarmState::ALARM:     return "ALARM";
+    }
+    return "DISARMED";
+}
+
+const char* ack_result_name(AckResult r)
+{
+    switch (r) {
+        case AckResult::APPLIED:   return "applied";
+        case AckResult::NO_CHANGE: return "no_change";
+        case AckResult::DUPLICATE: return "duplicate";
+        case AckResult::REJECTED:  return "rejected";
+    }
+    return "rejected";
+}
+
+static RemoteCommandType command_from(const char* s, int len)
+{
+    if (len == 3 && memcmp(s, "ARM", 3) == 0)    return RemoteCommandType::ARM;
+    if (len == 6 && memcmp(s, "DISARM", 6) == 0) return RemoteCommandType::DISARM;
+    return RemoteCommandType::NONE;
+}
+
+static bool json_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Finds "key": in a flat JSON object and returns a pointer to the value.
+// Only a string in key position counts (after { or , and followed by :),
+// so a string value that happens to spell the key is skipped.
+static const char* json_value(const char* data, int len, const char* key)
+{
+    size_t klen = strlen(key);
+    const char* end = data + len;
+    char prev = 0;              // last character outside strings, blanks skipped
+
+    for (const char* p = data; p < end; p++) {
+        if (json_blank(*p)) continue;
+        if (*p != '"') {
+            prev = *p;
+            continue;
+        }
+
+        const char* s = p + 1;
+        const char* q = s;
+        while (q < end && *q != '"') q += *q == '\\' ? 2 : 1;
+        if (q >= end) return nullptr;
+
+        const char* v = q + 1;
+        while (v < end && json_blank(*v)) v++;
+
+        if ((prev == '{' || prev == ',') && v < end && *v == ':' &&
+            (size_t)(q - s) == klen && memcmp(s, key, klen) == 0) {
+            for (v++; v < end && json_blank(*v); v++) {}
+            return v < end ? v : nullptr;
+        }
+        prev = '"';
+        p = q;
+    }
+    return nullptr;
+}
+
+// Copies a JSON string value (no escapes supported) into out.
+static int json_string(const char* v, const char* end, char* out, int max)
+{
+    if (!v || *v != '"') return -1;
+    v++;
+
+    int n = 0;
+    while (v < end && *v != '"') {
+        if (*v == '\\' || n == max) return -1;
+        if (out) out[n] = *v;
+        n++;
+        v++;
+    }
+    if (v == end) return -1;
+    if (out) out[n] = '\0';
+    return n;
+}
+
+// Reads a JSON integer that ends at or before end; the payload is not NUL
+// terminated. False without digits or past 18 of them.
+static bool json_int(const char* v, const char* end, int64_t* out)
+{
+    if (!v) return false;
+    bool neg = v < end && *v == '-';
+    if (neg) v++;
+
+    int64_t x = 0;
+    int digits = 0;
+    for (; v < end && *v >= '0' && *v <= '9'; v++) {
+        if (++digits > 18) return false;
+        x = x * 10 + (*v - '0');
+    }
+    if (digits == 0) return false;
+    *out = neg ? -x : x;
+    return true;
+}
+
+bool telemetry_parse_command(const char* data, int len, CommandMsg* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    while (len > 0 && json_blank(*data)) { data++; len--; }
+    while (len > 0 && json_blank(data[len - 1])) len--;
+
+    if (len == 0 || *data != '{') {
+        out->cmd = command_from(data, len);
+        return out->cmd != RemoteCommandType::NONE;
+    }
+
+    const char* end = data + len;
+
+    char cmd[8];
+    int n = json_string(json_value(data, len, "cmd"), end, cmd, sizeof(cmd) - 1);
+    if (n < 0) return false;
+    out->cmd = command_from(cmd, n);
+    if (out->cmd == RemoteCommandType::NONE) return false;
+
+    if (json_string(json_value(data, len, "id"), end, out->id, CMD_ID_MAX) < 0) {
+        out->id[0] = '\0';
+    }
+
+    out->has_ts = json_int(json_value(data, len, "ts"), end, &out->client_ts);
+
+    return true;
+}
+
+bool telemetry_reply_topic_ok(const char* topic, int len)
+{
+    const int plen = sizeof(ACK_REPLY_PREFIX) - 1;
+    if (!topic || len <= plen || len >= ACK_TOPIC_MAX) return false;
+    if (memcmp(topic, ACK_REPLY_PREFIX, plen) != 0) return false;
+
+    for (int i = plen; i < len; i++) {
+        char c = topic[i];
+        if (c < 0x20 || c > 0x7e || c == '+' || c == '#') return false;
+    }
+    return true;
+}
+
+uint32_t telemetry_command_key(const CommandMsg& msg)
+{
+    if (msg.id[0] == '\0') return 0;
+
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const char* p = msg.id; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+int telemetry_build_state(char* buf, size_t size, AlarmState s, int distance_cm)
+{
+    return snprintf(buf, size,
+                    "{\"state\":\"%s\",\"distance_cm\":%d}",
+                    alarm_state_name(s), distance_cm);
+}
+
+int telemetry_build_ack(char* buf, size_t size, const CommandAck& ack)
+{
+    int n = snprintf(buf, size, "{\"id\":\"%s\",\"cmd\":\"%s\",\"result\":\"%s\","
+                                "\"state\":\"%s\"",
+                     ack.msg.id,
+                     ack.msg.cmd == RemoteCommandType::ARM ? "ARM" : "DISARM",
+                     ack_result_name(ack.result), alarm_state_name(ack.state));
+
+    if (ack.msg.has_ts && n < (int)size) {
+        n += snprintf(buf + n, size - n, ",\"ts\":%lld", (long long)ack.msg.client_ts);
+    }
+    if (n < (int)size) {
+        n += snprintf(buf + n, size - n,
+                      ",\"rx_us\":%lld,\"apply_us\":%lld,\"pub_us\":%lld}",
+                      (long long)ack.rx_us, (long long)ack.apply_us,
+                      (long long)ack.pub_us);
+    }
+    return n;
+}
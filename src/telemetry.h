@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "alarm.h"
+
+// MQTT payload encoding and command parsing. Pure functions, no IDF
+// dependencies.
+
+#define CMD_ID_MAX     32
+#define ACK_TOPIC_MAX  64
+#define ACK_REPLY_PREFIX "alarm/ack/"   // the only response topics acked to
+
+// alarm/cmd accepts either a bare "ARM" / "DISARM" or
+//   {"cmd":"ARM","id":"<correlation id>","ts":<client timestamp>}
+// where id and ts are optional and echoed back on alarm/ack. Over MQTT 5
+// the correlation data can stand in for id, see main.cpp.
+struct CommandMsg {
+    RemoteCommandType cmd;
+    char    id[CMD_ID_MAX + 1];
+    int64_t client_ts;
+    bool    has_ts;
+};
+
+enum class AckResult : uint8_t {
+    APPLIED,      // the command changed the alarm state
+    NO_CHANGE,    // accepted, but the state machine ignored it
+    DUPLICATE,    // dropped by remote_submit() de-duplication
+    REJECTED      // malformed or queue full
+};
+
+// Device-side timestamps are esp_timer microseconds since boot.
+struct CommandAck {
+    CommandMsg msg;
+    AckResult  result;
+    AlarmState state;
+    int64_t    rx_us;
+    int64_t    apply_us;
+    int64_t    pub_us;
+
+    // MQTT 5 only: the command's correlation data, echoed on the ack, and
+    // its response topic (empty: alarm/ack), see telemetry_reply_topic_ok().
+    char       corr[CMD_ID_MAX];
+    uint8_t    corr_len;
+    char       reply_topic[ACK_TOPIC_MAX];
+};
+
+const char* alarm_state_name(AlarmState s);
+
+const char* ack_result_name(AckResult r);
+
+bool telemetry_parse_command(const char* data, int len, CommandMsg* out);
+
+// A command's MQTT 5 response topic is used only under ACK_REPLY_PREFIX, so
+// a sender cannot have the device publish on alarm/cmd, alarm/ota or another
+// device's topics. Also rejects wildcards and anything that does not fit
+// CommandAck::reply_topic.
+bool telemetry_reply_topic_ok(const char* topic, int len);
+
+// Stable non-zero id for remote_submit() de-duplication, 0 without an id.
+uint32_t telemetry_command_key(const CommandMsg& msg);
+
+int telemetry_build_state(char* buf, size_t size, AlarmState s, int distance_cm);
+int telemetry_build_ack(char* buf, size_t size, const CommandAck& ack);
@@ -0,0 +1,247 @@
+#include "ui_flow.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* const MENU_ITEMS[] = { "CHANGE PIN", "ARM", "EXIT" };
+#define MENU_COUNT (int)(sizeof(MENU_ITEMS) / sizeof(MENU_ITEMS[0]))
+
+enum MenuItem { MENU_CHANGE_PIN, MENU_ARM, MENU_EXIT };
+
+static const char* const PIN_CHANGE_PROMPTS[] = { "OLD PIN:", "NEW PIN:", "CONFIRM PIN:" };
+
+static bool expired(uint32_t now_ms, uint32_t deadline_ms)
+{
+    return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+static void clear_digits(UiFlow* ui)
+{
+    ui->len = 0;
+    memset(ui->digits, 0, sizeof(ui->digits));
+}
+
+static void to_idle(UiFlow* ui)
+{
+    ui->flow = UiFlowId::IDLE;
+    ui->step = 0;
+    clear_digits(ui);
+    memset(ui->new_pin, 0, sizeof(ui->new_pin));
+}
+
+static void flash(UiFlow* ui, const char* msg, uint32_t now_ms, uint32_t duration_ms)
+{
+    ui->flash = msg;
+    ui->flash_until_ms = now_ms + duration_ms;
+}
+
+static void render(const UiFlow* ui, UiOutput* out)
+{
+    if (ui->flash) {
+        out->redraw = true;
+        snprintf(out->screen, sizeof(out->screen), "%s", ui->flash);
+        return;
+    }
+
+    char stars[UI_PIN_LEN + 1];
+    for (int i = 0; i < UI_PIN_LEN; i++) stars[i] = i < ui->len ? '*' : ' ';
+    stars[UI_PIN_LEN] = '\0';
+
+    switch (ui->flow) {
+        case UiFlowId::IDLE:
+            out->release = true;
+            return;
+
+        case UiFlowId::PIN_ENTRY:
+            snprintf(out->screen, sizeof(out->screen), "ENTER PIN:\n%s", stars);
+            break;
+
+        case UiFlowId::PIN_CHANGE:
+            snprintf(out->screen, sizeof(out->screen), "%s\n%s",
+                     PIN_CHANGE_PROMPTS[ui->step], stars);
+            break;
+
+        case UiFlowId::MENU:
+            snprintf(out->screen, sizeof(out->screen), "MENU %d/%d\n> %s",
+                     ui->menu_item + 1, MENU_COUNT, MENU_ITEMS[ui->menu_item]);
+            break;
+    }
+    out->redraw = true;
+}
+
+// A complete PIN was submitted with '#'.
+static void pin_submitted(UiFlow* ui, uint32_t now_ms, UiOutput* out)
+{
+    if (ui->flow == UiFlowId::PIN_ENTRY) {
+        if (ui->check_pin(ui->digits)) {
+            out->action = UiAction::DISARM_PIN_OK;
+            to_idle(ui);
+            flash(ui, "PIN OK", now_ms, UI_FLASH_SHORT_MS);
+        } else {
+            clear_digits(ui);
+            flash(ui, "WRONG PIN", now_ms, UI_FLASH_MS);
+        }
+        return;
+    }
+
+    switch (ui->step) {
+        case 0:
+            if (!ui->check_pin(ui->digits)) {
+                flash(ui, "WRONG PIN", now_ms, UI_FLASH_MS);
+            } else {
+                ui->step = 1;
+            }
+            break;
+
+        case 1:
+            memcpy(ui->new_pin, ui->digits, sizeof(ui->new_pin));
+            ui->step = 2;
+            break;
+
+        case 2:
+            if (memcmp(ui->new_pin, ui->digits, UI_PIN_LEN) != 0) {
+                ui->step = 1;
+                flash(ui, "PIN MISMATCH", now_ms, UI_FLASH_MS);
+                break;
+            }
+            out->action = UiAction::SET_PIN;
+            memcpy(out->new_pin, ui->new_pin, sizeof(out->new_pin));
+            to_idle(ui);
+            flash(ui, "PIN CHANGED", now_ms, UI_FLASH_MS);
+            return;
+    }
+    clear_digits(ui);
+}
+
+static void pin_key(UiFlow* ui, char key, uint32_t now_ms, UiOutput* out)
+{
+    if (key >= '0' && key <= '9') {
+        if (ui->len < UI_PIN_LEN) ui->digits[ui->len++] = key;
+    }
+    else if (key == '*') {
+        clear_digits(ui);
+    }
+    else if (key == '#') {
+        if (ui->len < UI_PIN_LEN) {
+            clear_digits(ui);
+            flash(ui, "NEED 4 DIGITS", now_ms, UI_FLASH_SHORT_MS);
+        } else {
+            pin_submitted(ui, now_ms, out);
+        }
+    }
+}
+
+static void menu_key(UiFlow* ui, char key, UiOutput* out)
+{
+    if (key == 'B') {
+        ui->menu_item = (ui->menu_item + 1) % MENU_COUNT;
+        return;
+    }
+    if (key == '*') {
+        to_idle(ui);
+        return;
+    }
+    if (key != '#') return;
+
+    switch (ui->menu_item) {
+        case MENU_CHANGE_PIN:
+            ui->flow = UiFlowId::PIN_CHANGE;
+            ui->step = 0;
+            clear_digits(ui);
+            break;
+
+        case MENU_ARM:
+            out->action = UiAction::ARM;
+            to_idle(ui);
+            break;
+
+        case MENU_EXIT:
+            to_idle(ui);
+            break;
+    }
+}
+
+bool ui_pin_equal(const char* entered, const char* pin)
+{
+    uint8_t diff = 0;
+
+    for (int i = 0; i < UI_PIN_LEN; i++) {
+        diff |= (uint8_t)(entered[i] ^ pin[i]);
+    }
+    return diff == 0;
+}
+
+void ui_flow_init(UiFlow* ui, UiPinCheck check_pin)
+{
+    memset(ui, 0, sizeof(*ui));
+    ui->flow = UiFlowId::IDLE;
+    ui->check_pin = check_pin;
+}
+
+UiOutput ui_flow_on_key(UiFlow* ui, char key, uint32_t now_ms)
+{
+    UiOutput out = {};
+
+    // A key dismisses whatever transient message is up and is then handled
+    // normally, so nothing typed during it is lost.
+    bool dirty = ui->flash != nullptr;
+    ui->flash = nullptr;
+    ui->idle_deadline_ms = now_ms + UI_INACTIVITY_MS;
+
+    switch (ui->flow) {
+        case UiFlowId::IDLE:
+            if (key == 'A') {
+                out.action = UiAction::ARM;
+            }
+            else if (key == 'B') {
+                ui->flow = UiFlowId::MENU;
+                ui->menu_item = 0;
+                dirty = true;
+            }
+            else if ((key >= '0' && key <= '9') || key == '*' || key == '#') {
+                ui->flow = UiFlowId::PIN_ENTRY;
+                clear_digits(ui);
+                pin_key(ui, key, now_ms, &out);
+                dirty = true;
+            }
+            break;
+
+        case UiFlowId::PIN_ENTRY:
+        case UiFlowId::PIN_CHANGE:
+            if (key == 'D') to_idle(ui);
+            else pin_key(ui, key, now_ms, &out);
+            dirty = true;
+            break;
+
+        case UiFlowId::MENU:
+            if (key == 'D') to_idle(ui);
+            else menu_key(ui, key, &out);
+            dirty = true;
+            break;
+    }
+
+    if (dirty) render(ui, &out);
+    return out;
+}
+
+UiOutput ui_flow_tick(UiFlow* ui, uint32_t now_ms)
+{
+    UiOutput out = {};
+
+    if (ui->flash) {
+        if (expired(now_ms, ui->flash_until_ms)) {
+            ui->flash = nullptr;
+            ui->idle_deadline_ms = now_ms + UI_INACTIVITY_MS;
+            render(ui, &out);
+        }
+        return out;
+    }
+
+    if (ui->flow != UiFlowId::IDLE && expired(now_ms, ui->idle_deadline_ms)) {
+        to_idle(ui);
+        flash(ui, "TIMEOUT", now_ms, UI_FLASH_SHORT_MS);
+        render(ui, &out);
+    }
+
+    return out;
+}
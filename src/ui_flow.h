@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+// Keypad/LCD user interface as a timer-driven flow engine. Like alarm_fsm it
+// makes no RTOS or peripheral calls: keypad_task feeds it keys and a
+// millisecond clock and applies what comes back, so host tools can replay
+// key timings against it.
+//
+// Flows, entered from IDLE:
+//   digit / * / #   PIN_ENTRY   4 digits, # submits, * clears
+//   B               MENU        B next item, # selects
+//   A               arms directly
+// D backs out of any flow. Transient messages (WRONG PIN, ...) are timers,
+// not sleeps: a key pressed while one is showing dismisses it and is handled
+// right away. Any flow left untouched for UI_INACTIVITY_MS drops back to IDLE.
+
+#define UI_PIN_LEN         4
+#define UI_INACTIVITY_MS   10000
+#define UI_FLASH_MS        1000
+#define UI_FLASH_SHORT_MS  700
+
+enum class UiFlowId : uint8_t {
+    IDLE,
+    PIN_ENTRY,
+    PIN_CHANGE,
+    MENU,
+};
+
+enum class UiAction : uint8_t {
+    NONE,
+    ARM,
+    DISARM_PIN_OK,
+    SET_PIN,         // new_pin holds the confirmed PIN
+};
+
+typedef bool (*UiPinCheck)(const char* pin);
+
+struct UiFlow {
+    UiFlowId    flow;
+    uint8_t     step;               // PIN_CHANGE: old, new, confirm
+    uint8_t     menu_item;
+    uint8_t     len;
+    char        digits[UI_PIN_LEN + 1];
+    char        new_pin[UI_PIN_LEN + 1];
+    const char* flash;              // transient message, nullptr if none
+    uint32_t    flash_until_ms;
+    uint32_t    idle_deadline_ms;
+    UiPinCheck  check_pin;
+};
+
+// What keypad_task has to do after a step.
+struct UiOutput {
+    UiAction action;
+    char     new_pin[UI_PIN_LEN + 1];
+    bool     redraw;                // show screen with lcd_show_message()
+    bool     release;               // UI is idle, give the LCD back to the alarm
+    char     screen[34];            // "line 1\nline 2"
+};
+
+// Compares the first UI_PIN_LEN characters without an early exit on the
+// first wrong digit or a NUL, so the time taken says nothing about how many
+// matched. Both must point at buffers of at least UI_PIN_LEN characters.
+bool ui_pin_equal(const char* entered, const char* pin);
+
+void ui_flow_init(UiFlow* ui, UiPinCheck check_pin);
+
+UiOutput ui_flow_on_key(UiFlow* ui, char key, uint32_t now_ms);
+
+// Expires transient messages and the inactivity timeout; call every poll.
+UiOutput ui_flow_tick(UiFlow* ui, uint32_t now_ms);
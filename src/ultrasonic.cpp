@@ -1,7 +1,9 @@
 #include "ultrasonic.h"
+#include "range_filter.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_log.h"
+#include "dlog.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_rom_sys.h"
@@ -13,23 +15,24 @@ static const char* TAG = "ULTRA";
 
 #define US_TIMEOUT_US 30000
 #define NUM_SAMPLES   5           // number of readings to average
-#define DEBOUNCE_DIFF_CM 10       // max allowed jump between readings
 
-static int last_valid_distance = -1;
+static RangeFilter s_filter;
 
 void ultrasonic_init()
 {
     ESP_LOGI(TAG, "Initializing ultrasonic...");
 
+    range_filter_init(&s_filter);
+
     gpio_config_t trig = {
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = 1ULL << TRIG_PIN
+        .pin_bit_mask = 1ULL << TRIG_PIN,
+        .mode = GPIO_MODE_OUTPUT
     };
     gpio_config(&trig);
 
     gpio_config_t echo = {
-        .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = 1ULL << ECHO_PIN
+        .pin_bit_mask = 1ULL << ECHO_PIN,
+        .mode = GPIO_MODE_INPUT
     };
     gpio_config(&echo);
 
@@ -65,43 +68,26 @@ static int measure_distance_once()
     int64_t end = esp_timer_get_time();
     int duration_us = (int)(end - start);
 
-    int distance_cm = duration_us / 58;
-
-    if (distance_cm < 2 || distance_cm > 400)
-        return -1;
-
-    return distance_cm;
+    return range_echo_to_cm(duration_us);
 }
 
 int ultrasonic_get_distance_cm()
 {
-    int sample_sum = 0;
-    int valid_count = 0;
+    int samples[NUM_SAMPLES];
 
     for (int i = 0; i < NUM_SAMPLES; i++) {
-        int d = measure_distance_once();
-        if (d > 0) {
-            sample_sum += d;
-            valid_count++;
-        }
+        samples[i] = measure_distance_once();
         vTaskDelay(pdMS_TO_TICKS(10)); // small delay between samples
     }
 
-    if (valid_count == 0) {
-        ESP_LOGW(TAG, "No valid ultrasonic samples");
-        return -1;
-    }
-
-    int avg = sample_sum / valid_count;
+    int avg;
+    int dist = range_filter_apply(&s_filter, samples, NUM_SAMPLES, &avg);
 
-    // Debounce: ignore sudden unrealistic jumps
-    if (last_valid_distance != -1 &&
-        abs(avg - last_valid_distance) > DEBOUNCE_DIFF_CM)
-    {
-        ESP_LOGW(TAG, "Debounce triggered: old=%d new=%d", last_valid_distance, avg);
-        return last_valid_distance; // keep previous stable reading
+    if (avg < 0) {
+        DLOGW(TAG, "No valid ultrasonic samples");
+    } else if (dist != avg) {
+        DLOGW(TAG, "Debounce triggered: old=%d new=%d", dist, avg);
     }
 
-    last_valid_distance = avg;
-    return avg;
+    return dist;
 }
@@ -0,0 +1,230 @@
+#include "voice.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/i2s_std.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <atomic>
+#include <string.h>
+
+#include "adpcm.h"
+#include "dlog.h"
+#include "task_config.h"
+
+static const char* TAG = "VOICE";
+
+#define VOICE_BCLK_PIN   GPIO_NUM_19
+#define VOICE_WS_PIN     GPIO_NUM_16
+#define VOICE_DOUT_PIN   GPIO_NUM_2
+
+#define VOICE_MAGIC      "VOX1"
+#define VOICE_VERSION    1
+#define VOICE_DMA_BUFS   2           // one plays while the next is decoded
+
+struct __attribute__((packed)) VoiceHeader {
+    char     magic[4];
+    uint16_t version;
+    uint16_t count;
+    uint32_t sample_rate;
+    uint32_t reserved;
+};
+
+struct __attribute__((packed)) VoiceClip {
+    char     name[VOICE_NAME_LEN];
+    uint32_t offset;
+    uint32_t bytes;
+    uint32_t samples;
+    int16_t  predictor;
+    uint8_t  step_index;
+    uint8_t  reserved;
+};
+
+static_assert(sizeof(VoiceHeader) == 16, "voice header layout");
+static_assert(sizeof(VoiceClip) == 32, "voice clip layout");
+
+static const uint8_t* s_image = nullptr;
+static const VoiceHeader* s_header = nullptr;
+static const VoiceClip* s_clips = nullptr;
+
+static i2s_chan_handle_t s_tx = nullptr;
+static QueueHandle_t s_queue = nullptr;
+
+#if STATIC_ALLOC_BUILD
+static uint8_t s_queue_storage[VOICE_QUEUE_LEN * VOICE_PHRASE_MAX];
+static StaticQueue_t s_queue_buf;
+#endif
+static std::atomic<bool> s_stop{false};
+
+static int16_t s_pcm[VOICE_BLOCK_SAMPLES];
+static uint32_t s_max_decode_us = 0;
+
+static bool image_valid(const uint8_t* img, uint32_t size)
+{
+    auto* h = (const VoiceHeader*)img;
+    if (memcmp(h->magic, VOICE_MAGIC, 4) != 0 || h->version != VOICE_VERSION) return false;
+    if (h->sample_rate < 8000 || h->sample_rate > 48000) return false;
+    if (h->count == 0 || sizeof(VoiceHeader) + h->count * sizeof(VoiceClip) > size) return false;
+
+    auto* clips = (const VoiceClip*)(img + sizeof(VoiceHeader));
+    for (int i = 0; i < h->count; i++) {
+        const VoiceClip& c = clips[i];
+        if (c.offset > size || c.bytes > size - c.offset || c.samples > c.bytes * 2) return false;
+    }
+    return true;
+}
+
+static const VoiceClip* find_clip(const char* name)
+{
+    for (int i = 0; i < s_header->count; i++) {
+        if (strncmp(s_clips[i].name, name, VOICE_NAME_LEN) == 0) return &s_clips[i];
+    }
+    return nullptr;
+}
+
+static void write_block(const int16_t* pcm, size_t samples)
+{
+    size_t written;
+    i2s_channel_write(s_tx, pcm, samples * sizeof(int16_t), &written, portMAX_DELAY);
+}
+
+static void play_clip(const VoiceClip* c)
+{
+    AdpcmState st = { c->predictor, c->step_index };
+    const uint8_t* p = s_image + c->offset;
+    uint32_t left = c->samples;
+
+    while (left > 0 && !s_stop) {
+        uint32_t samples = left < VOICE_BLOCK_SAMPLES ? left : VOICE_BLOCK_SAMPLES;
+        uint32_t bytes = (samples + 1) / 2;
+
+        int64_t t0 = esp_timer_get_time();
+        adpcm_decode(&st, p, bytes, s_pcm);
+        uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+        if (dt > s_max_decode_us) s_max_decode_us = dt;
+
+        // Blocks until a DMA buffer is free, i.e. while the other one plays.
+        write_block(s_pcm, samples);
+        p += bytes;
+        left -= samples;
+    }
+}
+
+static void voice_task(void* pv)
+{
+    char phrase[VOICE_PHRASE_MAX];
+
+    while (true)
+    {
+        xQueueReceive(s_queue, phrase, portMAX_DELAY);
+        s_stop = false;
+
+        int64_t t0 = esp_timer_get_time();
+        i2s_channel_enable(s_tx);
+
+        char* save = nullptr;
+        for (char* name = strtok_r(phrase, " ", &save); name && !s_stop;
+             name = strtok_r(nullptr, " ", &save)) {
+            const VoiceClip* c = find_clip(name);
+            if (c) play_clip(c);
+            else ESP_LOGW(TAG, "No clip \"%s\"", name);
+        }
+
+        // Silence pushes the last samples out of the DMA ring before the
+        // channel stops; the amp then idles without DMA interrupts.
+        memset(s_pcm, 0, sizeof(s_pcm));
+        for (int i = 0; i < VOICE_DMA_BUFS; i++) write_block(s_pcm, VOICE_BLOCK_SAMPLES);
+        i2s_channel_disable(s_tx);
+
+        DLOGI(TAG, "Phrase done in %lu ms (max decode %lu us per block)",
+              (unsigned long)((esp_timer_get_time() - t0) / 1000),
+              (unsigned long)s_max_decode_us);
+    }
+}
+
+static bool i2s_init(uint32_t sample_rate)
+{
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = VOICE_DMA_BUFS;
+    chan_cfg.dma_frame_num = VOICE_BLOCK_SAMPLES;
+    chan_cfg.auto_clear = true;         // underrun plays silence, not the last buffer
+    if (i2s_new_channel(&chan_cfg, &s_tx, nullptr) != ESP_OK) return false;
+
+    i2s_std_config_t std_cfg = {};
+    std_cfg.clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate);
+    std_cfg.slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT,
+                                                           I2S_SLOT_MODE_MONO);
+    std_cfg.gpio_cfg.mclk = I2S_GPIO_UNUSED;
+    std_cfg.gpio_cfg.bclk = VOICE_BCLK_PIN;
+    std_cfg.gpio_cfg.ws = VOICE_WS_PIN;
+    std_cfg.gpio_cfg.dout = VOICE_DOUT_PIN;
+    std_cfg.gpio_cfg.din = I2S_GPIO_UNUSED;
+
+    return i2s_channel_init_std_mode(s_tx, &std_cfg) == ESP_OK;
+}
+
+void voice_init()
+{
+    const esp_partition_t* part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "voice");
+    if (!part) {
+        ESP_LOGW(TAG, "No voice partition, prompts disabled");
+        return;
+    }
+
+    const void* map = nullptr;
+    esp_partition_mmap_handle_t handle;
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map the voice partition");
+        return;
+    }
+
+    if (!image_valid((const uint8_t*)map, part->size)) {
+        ESP_LOGW(TAG, "No voice image flashed (tools/pack_voice.py), prompts disabled");
+        esp_partition_munmap(handle);
+        return;
+    }
+
+    s_image = (const uint8_t*)map;
+    s_header = (const VoiceHeader*)s_image;
+    s_clips = (const VoiceClip*)(s_image + sizeof(VoiceHeader));
+
+    if (!i2s_init(s_header->sample_rate)) {
+        ESP_LOGE(TAG, "I2S init failed, prompts disabled");
+        s_image = nullptr;
+        return;
+    }
+
+#if STATIC_ALLOC_BUILD
+    s_queue = xQueueCreateStatic(VOICE_QUEUE_LEN, VOICE_PHRASE_MAX, s_queue_storage, &s_queue_buf);
+#else
+    s_queue = xQueueCreate(VOICE_QUEUE_LEN, VOICE_PHRASE_MAX);
+#endif
+    task_plan_create(voice_task, TASK_VOICE);
+
+    ESP_LOGI(TAG, "%u clips at %lu Hz", s_header->count, (unsigned long)s_header->sample_rate);
+}
+
+bool voice_ready()
+{
+    return s_queue != nullptr;
+}
+
+bool voice_say(const char* phrase)
+{
+    if (!s_queue) return false;
+
+    char buf[VOICE_PHRASE_MAX];
+    strncpy(buf, phrase, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    return xQueueSend(s_queue, buf, 0) == pdTRUE;
+}
+
+void voice_stop()
+{
+    if (!s_queue) return;
+    xQueueReset(s_queue);
+    s_stop = true;
+}
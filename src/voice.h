@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Spoken prompts on an I2S amplifier (MAX98357A or similar).
+//
+// Clips are IMA-ADPCM streams in the "voice" flash partition, packed by
+// tools/pack_voice.py. The partition is memory-mapped, so voice_task decodes
+// VOICE_BLOCK_SAMPLES at a time straight from flash into one of two DMA
+// buffers while the other plays; the CPU cost is the decode, a few
+// microseconds per block, and the task otherwise sleeps on the I2S driver.
+//
+// Image layout, little-endian:
+//
+//   "VOX1" version:u16 count:u16 sample_rate:u32 reserved:u32
+//   count x { name:char[16] offset:u32 bytes:u32 samples:u32
+//             predictor:i16 step_index:u8 reserved:u8 }
+//   ADPCM data, offsets relative to the start of the partition
+
+#define VOICE_NAME_LEN        16
+#define VOICE_BLOCK_SAMPLES   256
+#define VOICE_QUEUE_LEN       4
+#define VOICE_PHRASE_MAX      64     // "exit_delay 10 seconds"
+
+// Maps the partition and starts voice_task. Without a valid image (nothing
+// flashed yet) prompts are silently skipped.
+void voice_init();
+
+bool voice_ready();
+
+// Queues a phrase: clip names separated by spaces, played back to back.
+// Never blocks; returns false if the queue is full or voice is not ready.
+// Unknown clip names are skipped.
+bool voice_say(const char* phrase);
+
+// Drops the phrase being played and anything queued.
+void voice_stop();
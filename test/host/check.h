@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+// Just enough of a test harness for the host tests: a failing CHECK prints
+// the expression and carries on, TEST_MAIN runs the listed cases and exits
+// 1 if any check failed. Each test file is its own CTest executable.
+
+inline int g_failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                        \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                           \
+    do {                                                                         \
+        long long a_ = (long long)(a), b_ = (long long)(b);                      \
+        if (a_ != b_) {                                                          \
+            fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n",            \
+                    __FILE__, __LINE__, #a, #b, a_, b_);                         \
+            g_failures++;                                                        \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_STR(a, b)                                                          \
+    do {                                                                         \
+        const char *a_ = (a), *b_ = (b);                                         \
+        if (strcmp(a_, b_) != 0) {                                               \
+            fprintf(stderr, "%s:%d: %s == %s failed: \"%s\" != \"%s\"\n",        \
+                    __FILE__, __LINE__, #a, #b, a_, b_);                         \
+            g_failures++;                                                        \
+        }                                                                        \
+    } while (0)
+
+typedef void (*TestFn)();
+
+struct TestCase {
+    const char* name;
+    TestFn      fn;
+};
+
+#define TEST_MAIN(...)                                                           \
+    int main()                                                                   \
+    {                                                                            \
+        static const TestCase cases[] = { __VA_ARGS__ };                         \
+        for (const TestCase& c : cases) {                                        \
+            int before = g_failures;                                             \
+            c.fn();                                                              \
+            printf("%-40s %s\n", c.name, g_failures == before ? "ok" : "FAILED"); \
+        }                                                                        \
+        return g_failures ? 1 : 0;                                               \
+    }
+
+#define CASE(fn) { #fn, fn }
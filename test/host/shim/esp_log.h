@@ -0,0 +1,12 @@
+#pragma once
+#include "sdkconfig.h"
+
+// Host tests keep quiet; the arguments are still type-checked.
+__attribute__((format(printf, 2, 3)))
+inline void host_log(const char* tag, const char* fmt, ...) {}
+
+#define ESP_LOGE(tag, fmt, ...) host_log(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) host_log(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) host_log(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) host_log(tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) host_log(tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Just enough FreeRTOS for single-threaded host tests: no scheduler, queues
+// never block, critical sections and mutexes always succeed at once.
+
+typedef int           BaseType_t;
+typedef unsigned int  UBaseType_t;
+typedef uint32_t      TickType_t;
+typedef uint8_t       StackType_t;
+
+#define pdTRUE   1
+#define pdFALSE  0
+#define pdPASS   1
+#define pdFAIL   0
+
+#define portMAX_DELAY        ((TickType_t)0xffffffffu)
+#define configTICK_RATE_HZ   CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+#define portENTER_CRITICAL(mux)       ((void)(mux))
+#define portEXIT_CRITICAL(mux)        ((void)(mux))
+
+#define tskNO_AFFINITY  ((BaseType_t)0x7FFFFFFF)
+
+typedef struct { uint8_t unused[8]; } StaticTask_t;
+typedef struct { uint8_t unused[8]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
@@ -0,0 +1,11 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size);
+// The wait is ignored: a full queue fails and an empty one returns pdFALSE.
+BaseType_t  xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t  xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+void        vQueueDelete(QueueHandle_t q);
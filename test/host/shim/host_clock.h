@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+
+// The shim's microsecond clock. It starts at 0 and only moves when a test
+// moves it; every esp_timer falling due on the way fires in order.
+void host_clock_advance(int64_t us);
@@ -0,0 +1,132 @@
+// The FreeRTOS and esp_timer shim behind test/host/shim (see FreeRTOS.h).
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "host_clock.h"
+
+#include <string.h>
+#include <deque>
+#include <vector>
+
+struct HostQueue {
+    UBaseType_t                       len;
+    UBaseType_t                       item_size;
+    std::deque<std::vector<uint8_t>>  items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    return new HostQueue{ len, item_size, {} };
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t)
+{
+    if (q->items.size() >= q->len) return pdFALSE;
+    const uint8_t* p = (const uint8_t*)item;
+    q->items.emplace_back(p, p + q->item_size);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t)
+{
+    if (q->items.empty()) return pdFALSE;
+    memcpy(item, q->items.front().data(), q->item_size);
+    q->items.pop_front();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return (UBaseType_t)q->items.size();
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    delete q;
+}
+
+// Nothing runs concurrently, so a mutex is a queue that is never full.
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xQueueCreate(0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t*)
+{
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t)
+{
+    return pdTRUE;
+}
+
+struct HostTimer {
+    esp_timer_cb_t cb;
+    void*          arg;
+    int64_t        due_us;
+    uint64_t       period_us;       // 0: one-shot
+    bool           active;
+};
+
+static int64_t s_now_us = 0;
+static std::vector<HostTimer*> s_timers;
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out)
+{
+    *out = new HostTimer{ args->callback, args->arg, 0, 0, false };
+    s_timers.push_back(*out);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    t->due_us = s_now_us + (int64_t)timeout_us;
+    t->period_us = 0;
+    t->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    t->due_us = s_now_us + (int64_t)period_us;
+    t->period_us = period_us;
+    t->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    t->active = false;
+    return ESP_OK;
+}
+
+void host_clock_advance(int64_t us)
+{
+    int64_t end = s_now_us + us;
+    for (;;) {
+        HostTimer* next = nullptr;
+        for (HostTimer* t : s_timers) {
+            if (t->active && t->due_us <= end && (!next || t->due_us < next->due_us)) next = t;
+        }
+        if (!next) break;
+
+        s_now_us = next->due_us;
+        if (next->period_us) next->due_us += (int64_t)next->period_us;
+        else next->active = false;
+        next->cb(next->arg);
+    }
+    s_now_us = end;
+}
@@ -0,0 +1,4 @@
+#pragma once
+// Host tests: the subset of the firmware's sdkconfig the sources read.
+#define CONFIG_FREERTOS_HZ        100
+#define CONFIG_LOG_DEFAULT_LEVEL  3
@@ -0,0 +1,179 @@
+// alarm_fsm: every transition of the state table and the exit-delay clock.
+
+#include "check.h"
+#include "alarm_fsm.h"
+
+#include <initializer_list>
+
+static AlarmFsm armed_fsm()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, 0);
+    alarm_fsm_tick(&f, EXIT_DELAY_MS);
+    return f;
+}
+
+static void starts_disarmed()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    CHECK(f.state == AlarmState::DISARMED);
+}
+
+static void arm_starts_exit_delay()
+{
+    for (AlarmEventType t : { AlarmEventType::ARM_LOCAL, AlarmEventType::ARM_REMOTE }) {
+        AlarmFsm f;
+        alarm_fsm_init(&f);
+        AlarmStep s = alarm_fsm_on_event(&f, t, 1000);
+        CHECK(s.changed);
+        CHECK(f.state == AlarmState::EXIT_DELAY);
+        CHECK_EQ(f.exit_deadline_ms, 1000 + EXIT_DELAY_MS);
+        CHECK_EQ(f.exit_seconds_remaining, EXIT_DELAY_MS / 1000);
+        CHECK_STR(s.lcd_message, "EXIT DELAY");
+    }
+}
+
+static void motion_while_disarmed_is_ignored()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    AlarmStep s = alarm_fsm_on_event(&f, AlarmEventType::MOTION_DETECTED, 0);
+    CHECK(!s.changed);
+    CHECK(f.state == AlarmState::DISARMED);
+}
+
+static void exit_delay_counts_down_then_arms()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, 0);
+
+    AlarmStep s = alarm_fsm_tick(&f, 0);
+    CHECK(!s.changed);
+    CHECK(!s.countdown_changed);
+
+    // Seconds shown are whole seconds left, rounded down.
+    s = alarm_fsm_tick(&f, 999);
+    CHECK(s.countdown_changed);
+    CHECK_EQ(f.exit_seconds_remaining, EXIT_DELAY_MS / 1000 - 1);
+
+    s = alarm_fsm_tick(&f, 1000);
+    CHECK(!s.countdown_changed);
+    CHECK(f.state == AlarmState::EXIT_DELAY);
+
+    s = alarm_fsm_tick(&f, EXIT_DELAY_MS - 1);
+    CHECK(f.state == AlarmState::EXIT_DELAY);
+
+    s = alarm_fsm_tick(&f, EXIT_DELAY_MS);
+    CHECK(s.changed);
+    CHECK(f.state == AlarmState::ARMED);
+    CHECK_EQ(f.exit_seconds_remaining, 0);
+    CHECK_STR(s.lcd_message, "ARMED");
+}
+
+static void exit_delay_survives_clock_wrap()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    uint32_t t0 = 0xFFFFFFFFu - 1000;
+    alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, t0);
+
+    alarm_fsm_tick(&f, t0 + 5000);
+    CHECK(f.state == AlarmState::EXIT_DELAY);
+    alarm_fsm_tick(&f, t0 + EXIT_DELAY_MS);
+    CHECK(f.state == AlarmState::ARMED);
+}
+
+static void disarm_cancels_exit_delay()
+{
+    for (AlarmEventType t : { AlarmEventType::DISARM_PIN_OK, AlarmEventType::DISARM_OVERRIDE,
+                              AlarmEventType::DISARM_REMOTE }) {
+        AlarmFsm f;
+        alarm_fsm_init(&f);
+        alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, 0);
+        AlarmStep s = alarm_fsm_on_event(&f, t, 100);
+        CHECK(s.changed);
+        CHECK(f.state == AlarmState::DISARMED);
+
+        // A late tick must not arm a cancelled exit delay.
+        alarm_fsm_tick(&f, EXIT_DELAY_MS * 2);
+        CHECK(f.state == AlarmState::DISARMED);
+    }
+}
+
+static void motion_during_exit_delay_is_ignored()
+{
+    AlarmFsm f;
+    alarm_fsm_init(&f);
+    alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, 0);
+    alarm_fsm_on_event(&f, AlarmEventType::MOTION_DETECTED, 100);
+    CHECK(f.state == AlarmState::EXIT_DELAY);
+}
+
+static void motion_while_armed_triggers()
+{
+    AlarmFsm f = armed_fsm();
+    AlarmStep s = alarm_fsm_on_event(&f, AlarmEventType::MOTION_DETECTED, EXIT_DELAY_MS + 10);
+    CHECK(s.changed);
+    CHECK(f.state == AlarmState::ALARM);
+    CHECK_STR(s.lcd_message, "ALARM TRIGGERED");
+}
+
+static void rearm_while_armed_is_no_change()
+{
+    AlarmFsm f = armed_fsm();
+    AlarmStep s = alarm_fsm_on_event(&f, AlarmEventType::ARM_REMOTE, EXIT_DELAY_MS + 10);
+    CHECK(!s.changed);
+    CHECK(f.state == AlarmState::ARMED);
+}
+
+static void alarm_clears_on_disarm_or_reset()
+{
+    for (AlarmEventType t : { AlarmEventType::DISARM_PIN_OK, AlarmEventType::DISARM_REMOTE,
+                              AlarmEventType::RESET }) {
+        AlarmFsm f = armed_fsm();
+        alarm_fsm_on_event(&f, AlarmEventType::MOTION_DETECTED, EXIT_DELAY_MS + 10);
+        AlarmStep s = alarm_fsm_on_event(&f, t, EXIT_DELAY_MS + 20);
+        CHECK(s.changed);
+        CHECK(f.state == AlarmState::DISARMED);
+    }
+
+    AlarmFsm f = armed_fsm();
+    alarm_fsm_on_event(&f, AlarmEventType::MOTION_DETECTED, EXIT_DELAY_MS + 10);
+    alarm_fsm_on_event(&f, AlarmEventType::ARM_LOCAL, EXIT_DELAY_MS + 20);
+    CHECK(f.state == AlarmState::ALARM);
+}
+
+static void fault_is_reported_not_acted_on()
+{
+    AlarmFsm f = armed_fsm();
+    AlarmStep s = alarm_fsm_on_event(&f, AlarmEventType::FAULT, EXIT_DELAY_MS + 10);
+    CHECK(!s.changed);
+    CHECK(s.note != nullptr);
+    CHECK(f.state == AlarmState::ARMED);
+}
+
+static void screens()
+{
+    CHECK_STR(alarm_fsm_screen(AlarmState::DISARMED), "DISARMED");
+    CHECK_STR(alarm_fsm_screen(AlarmState::EXIT_DELAY), "EXIT DELAY");
+    CHECK_STR(alarm_fsm_screen(AlarmState::ARMED), "ARMED");
+    CHECK_STR(alarm_fsm_screen(AlarmState::ALARM), "ALARM TRIGGERED");
+}
+
+TEST_MAIN(
+    CASE(starts_disarmed),
+    CASE(arm_starts_exit_delay),
+    CASE(motion_while_disarmed_is_ignored),
+    CASE(exit_delay_counts_down_then_arms),
+    CASE(exit_delay_survives_clock_wrap),
+    CASE(disarm_cancels_exit_delay),
+    CASE(motion_during_exit_delay_is_ignored),
+    CASE(motion_while_armed_triggers),
+    CASE(rearm_while_armed_is_no_change),
+    CASE(alarm_clears_on_disarm_or_reset),
+    CASE(fault_is_reported_not_acted_on),
+    CASE(screens),
+)
@@ -0,0 +1,140 @@
+// baseline: warm-up, the K sigma / minimum-delta threshold, the hit
+// debounce and relearning after a lasting scene change.
+
+#include "check.h"
+#include "baseline.h"
+
+#include <math.h>
+
+static Baseline learned(int a, int b, uint32_t samples = BASELINE_WARMUP)
+{
+    Baseline bl;
+    baseline_init(&bl);
+    for (uint32_t i = 0; i < samples; i++) baseline_learn(&bl, i % 2 ? b : a);
+    return bl;
+}
+
+// Two readings in a row at cm, the debounce included.
+static bool motion_at(Baseline* bl, int cm)
+{
+    baseline_is_motion(bl, cm);
+    return baseline_is_motion(bl, cm);
+}
+
+static void not_ready_until_warmup()
+{
+    Baseline bl = learned(200, 200, BASELINE_WARMUP - 1);
+    CHECK(!baseline_ready(&bl));
+    baseline_learn(&bl, 200);
+    CHECK(baseline_ready(&bl));
+    CHECK_EQ(bl.n, BASELINE_WARMUP);
+}
+
+static void warmup_starts_as_plain_average()
+{
+    // Until 1/(n+1) drops to BASELINE_ALPHA the mean is a plain average; an
+    // EWMA seeded with the first reading would still sit near 100 here.
+    Baseline bl;
+    baseline_init(&bl);
+    for (int i = 0; i < 20; i++) baseline_learn(&bl, 100);
+    for (int i = 0; i < 20; i++) baseline_learn(&bl, 200);
+    CHECK(fabsf(bl.mean_cm - 150.0f) < 0.01f);
+}
+
+static void no_echo_is_ignored()
+{
+    Baseline bl = learned(200, 200, 10);
+    baseline_learn(&bl, 0);
+    baseline_learn(&bl, -1);
+    CHECK_EQ(bl.n, 10);
+
+    bl = learned(200, 200);
+    CHECK(!motion_at(&bl, 0));
+}
+
+static void quiet_scene_uses_min_delta()
+{
+    // A steady reading has sigma at the floor, so 4 sigma is below the
+    // minimum delta and the minimum delta decides.
+    Baseline bl = learned(200, 200);
+    CHECK(baseline_sigma_cm(&bl) == BASELINE_MIN_SIGMA_CM);
+    CHECK(BASELINE_K * BASELINE_MIN_SIGMA_CM < BASELINE_MIN_DELTA_CM);
+
+    CHECK(!motion_at(&bl, 200 + (int)BASELINE_MIN_DELTA_CM - 1));
+    CHECK(!motion_at(&bl, 200 - (int)BASELINE_MIN_DELTA_CM + 1));
+    CHECK(motion_at(&bl, 200 + (int)BASELINE_MIN_DELTA_CM + 1));
+    CHECK(motion_at(&bl, 200 - (int)BASELINE_MIN_DELTA_CM - 1));
+}
+
+static void noisy_scene_uses_k_sigma()
+{
+    // 180/220 alternating: sigma about 20 cm, threshold about 80 cm.
+    Baseline bl = learned(180, 220);
+    float sigma = baseline_sigma_cm(&bl);
+    CHECK(sigma > 18.0f && sigma < 22.0f);
+
+    float t = BASELINE_K * sigma;
+    CHECK(!motion_at(&bl, (int)(bl.mean_cm + t) - 2));
+    CHECK(motion_at(&bl, (int)(bl.mean_cm + t) + 2));
+    // Well beyond the minimum delta, still within the noise.
+    CHECK(!motion_at(&bl, (int)bl.mean_cm + 50));
+}
+
+static void one_hit_is_not_motion()
+{
+    Baseline bl = learned(200, 200);
+    CHECK(!baseline_is_motion(&bl, 100));
+    CHECK(baseline_is_motion(&bl, 100));
+    CHECK(baseline_is_motion(&bl, 100));
+
+    // A reading back at the baseline starts the count over.
+    CHECK(!baseline_is_motion(&bl, 200));
+    CHECK(!baseline_is_motion(&bl, 100));
+    CHECK(baseline_is_motion(&bl, 100));
+}
+
+static void motion_is_not_learned()
+{
+    Baseline bl = learned(200, 200);
+    float mean = bl.mean_cm;
+    uint32_t n = bl.n;
+
+    for (int i = 0; i < 50; i++) baseline_learn(&bl, 80);
+    CHECK(bl.mean_cm == mean);
+    CHECK_EQ(bl.n, n);
+    CHECK_EQ(bl.rejected, 50);
+
+    // An accepted reading ends the run of rejections.
+    baseline_learn(&bl, 200);
+    CHECK_EQ(bl.rejected, 0);
+}
+
+static void lasting_change_relearns()
+{
+    Baseline bl = learned(200, 200);
+
+    for (int i = 0; i < BASELINE_RELEARN - 1; i++) baseline_learn(&bl, 120);
+    CHECK(baseline_ready(&bl));
+    CHECK(fabsf(bl.mean_cm - 200.0f) < 0.01f);
+
+    baseline_learn(&bl, 120);
+    CHECK(!baseline_ready(&bl));
+    CHECK_EQ(bl.n, 0);
+
+    for (int i = 0; i < BASELINE_WARMUP; i++) baseline_learn(&bl, 120);
+    CHECK(baseline_ready(&bl));
+    CHECK(fabsf(bl.mean_cm - 120.0f) < 0.01f);
+    CHECK(!motion_at(&bl, 120));
+    CHECK(motion_at(&bl, 200));
+}
+
+TEST_MAIN(
+    CASE(not_ready_until_warmup),
+    CASE(warmup_starts_as_plain_average),
+    CASE(no_echo_is_ignored),
+    CASE(quiet_scene_uses_min_delta),
+    CASE(noisy_scene_uses_k_sigma),
+    CASE(one_hit_is_not_motion),
+    CASE(motion_is_not_learned),
+    CASE(lasting_change_relearns)
+)
@@ -0,0 +1,157 @@
+// broker_select: fail over, fail back after the hold, and the same hold on
+// RTT-driven moves so probe noise around the margin does not bounce the
+// connection; plus broker URI parsing.
+
+#include "check.h"
+#include "broker_select.h"
+
+#include <string.h>
+
+#define ROUND_MS 30000      // BROKER_PROBE_MS in connectivity.cpp
+
+// One probe round the way probe_task runs it: every broker, then a choice.
+// rtt 0 is a failed probe.
+static uint8_t round_at(BrokerSel* s, uint32_t now_ms, uint32_t rtt0, uint32_t rtt1)
+{
+    broker_sel_probe(s, 0, rtt0 != 0, rtt0, now_ms);
+    broker_sel_probe(s, 1, rtt1 != 0, rtt1, now_ms);
+    return broker_sel_choose(s, now_ms);
+}
+
+static void starts_on_first_broker()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    CHECK_EQ(broker_sel_choose(&s, 0), 0);
+    CHECK_EQ(s.switches, 0);
+}
+
+static void fails_over_immediately()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    round_at(&s, t += ROUND_MS, 50, 80);
+
+    // One failure is not enough...
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 0, 80), 0);
+    // ...the second moves at once, with no hold.
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 0, 80), 1);
+    CHECK_EQ(s.switches, 1);
+}
+
+static void fails_back_after_hold()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    round_at(&s, t += ROUND_MS, 0, 80);
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 0, 80), 1);
+
+    // Broker 0 is healthy again after BROKER_OKS_UP rounds...
+    round_at(&s, t += ROUND_MS, 50, 80);
+    round_at(&s, t += ROUND_MS, 50, 80);
+    CHECK(s.b[0].healthy);
+    uint32_t up = t;
+
+    // ...but the client stays on 1 until it has held that for BROKER_HOLD_MS.
+    while (t + ROUND_MS - up < BROKER_HOLD_MS) CHECK_EQ(round_at(&s, t += ROUND_MS, 50, 80), 1);
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 50, 80), 0);
+    CHECK_EQ(s.switches, 2);
+}
+
+static void flapping_rtt_does_not_switch()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    for (int i = 0; i < 4; i++) round_at(&s, t += ROUND_MS, 100, 100);
+
+    // Broker 1's probes swing around broker 0's: it is preferred for a round
+    // or two at a time, never for a whole hold.
+    static const uint32_t swing[] = { 10, 10, 190, 190 };
+    int flips = 0;
+    int8_t last = s.preferred;
+    for (int i = 0; i < 40; i++) {
+        CHECK_EQ(round_at(&s, t += ROUND_MS, 100, swing[i % 4]), 0);
+        if (s.preferred != last) flips++;
+        last = s.preferred;
+    }
+    CHECK(flips >= 10);
+    CHECK_EQ(s.switches, 0);
+}
+
+static void sustained_rtt_advantage_switches()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    round_at(&s, t += ROUND_MS, 100, 100);
+
+    // Broker 1 pulls ahead by more than the margin and stays there.
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 100, 10), 0);
+    CHECK_EQ(s.preferred, 1);
+    uint32_t since = t;
+
+    while (t + ROUND_MS - since < BROKER_HOLD_MS) CHECK_EQ(round_at(&s, t += ROUND_MS, 100, 10), 0);
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 100, 10), 1);
+    CHECK_EQ(s.switches, 1);
+}
+
+static void within_margin_stays_on_first()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    for (int i = 0; i < 20; i++) CHECK_EQ(round_at(&s, t += ROUND_MS, 100, 100 - BROKER_RTT_MARGIN_MS), 0);
+    CHECK_EQ(s.preferred, 0);
+}
+
+static void no_healthy_broker_stays_put()
+{
+    BrokerSel s;
+    broker_sel_init(&s, 2, 0);
+    uint32_t t = 0;
+    round_at(&s, t += ROUND_MS, 0, 0);
+    CHECK_EQ(round_at(&s, t += ROUND_MS, 0, 0), 0);
+    CHECK_EQ(s.preferred, -1);
+    CHECK_EQ(s.switches, 0);
+}
+
+static void parses_uris()
+{
+    char host[BROKER_HOST_MAX];
+    uint16_t port = 0;
+
+    CHECK(broker_uri_endpoint("mqtt://10.0.0.2", host, sizeof(host), &port));
+    CHECK_STR(host, "10.0.0.2");
+    CHECK_EQ(port, 1883);
+
+    CHECK(broker_uri_endpoint("mqtts://broker.example.com", host, sizeof(host), &port));
+    CHECK_STR(host, "broker.example.com");
+    CHECK_EQ(port, 8883);
+
+    CHECK(broker_uri_endpoint("mqtt://lan:1884/alarm", host, sizeof(host), &port));
+    CHECK_STR(host, "lan");
+    CHECK_EQ(port, 1884);
+
+    CHECK(!broker_uri_endpoint("http://lan", host, sizeof(host), &port));
+    CHECK(!broker_uri_endpoint("mqtt://", host, sizeof(host), &port));
+    CHECK(!broker_uri_endpoint("mqtt://lan:0", host, sizeof(host), &port));
+    CHECK(!broker_uri_endpoint("mqtt://lan:70000", host, sizeof(host), &port));
+    CHECK(!broker_uri_endpoint("mqtt://lan:18x3", host, sizeof(host), &port));
+
+    char small[4];
+    CHECK(!broker_uri_endpoint("mqtt://longhost", small, sizeof(small), &port));
+}
+
+TEST_MAIN(
+    CASE(starts_on_first_broker),
+    CASE(fails_over_immediately),
+    CASE(fails_back_after_hold),
+    CASE(flapping_rtt_does_not_switch),
+    CASE(sustained_rtt_advantage_switches),
+    CASE(within_margin_stays_on_first),
+    CASE(no_healthy_broker_stays_put),
+    CASE(parses_uris)
+)
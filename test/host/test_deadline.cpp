@@ -0,0 +1,157 @@
+// deadline: misses, the DEADLINE_SUSTAINED fault hysteresis and re-arming
+// only after a clean cycle, with the monitor timer running on the shim clock.
+
+#include "check.h"
+#include "host_clock.h"
+#include "deadline.h"
+
+static int s_faults[DEADLINE_COUNT];
+
+static void on_fault(DeadlineId id)
+{
+    s_faults[id]++;
+}
+
+static void init_once()
+{
+    static bool done = false;
+    if (!done) {
+        deadline_init(on_fault);
+        done = true;
+    }
+}
+
+static void advance_ms(uint32_t ms)
+{
+    host_clock_advance((int64_t)ms * 1000);
+}
+
+// One cycle of proc_ms work, begun every period_ms.
+static void cycle(DeadlineId id, uint32_t proc_ms, uint32_t period_ms)
+{
+    deadline_begin(id);
+    advance_ms(proc_ms);
+    deadline_end(id);
+    advance_ms(period_ms - proc_ms);
+}
+
+static void clean(DeadlineId id)
+{
+    cycle(id, 10, DEADLINE_PLAN[id].period_ms / 2);
+}
+
+static void slow(DeadlineId id)
+{
+    cycle(id, DEADLINE_PLAN[id].max_proc_ms + 50, DEADLINE_PLAN[id].period_ms - 10);
+}
+
+// Starts a contract from a known state: running, no misses, not faulted.
+static void settle(DeadlineId id)
+{
+    init_once();
+    for (int i = 0; i < 3; i++) clean(id);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK(!deadline_get_stats(id).faulted);
+}
+
+static void sustained_misses_fault()
+{
+    settle(DEADLINE_ULTRA);
+    int before = s_faults[DEADLINE_ULTRA];
+
+    for (int i = 0; i < DEADLINE_SUSTAINED - 1; i++) slow(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before);
+
+    slow(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before + 1);
+    CHECK(deadline_get_stats(DEADLINE_ULTRA).faulted);
+}
+
+static void clean_cycle_breaks_the_run()
+{
+    settle(DEADLINE_ULTRA);
+    int before = s_faults[DEADLINE_ULTRA];
+
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < DEADLINE_SUSTAINED - 1; i++) slow(DEADLINE_ULTRA);
+        clean(DEADLINE_ULTRA);
+    }
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before);
+    CHECK(deadline_get_stats(DEADLINE_ULTRA).proc_misses >= 10);
+}
+
+static void fault_reported_once_until_clean()
+{
+    settle(DEADLINE_ULTRA);
+    int before = s_faults[DEADLINE_ULTRA];
+
+    for (int i = 0; i < 20; i++) slow(DEADLINE_ULTRA);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before + 1);
+
+    // One clean cycle re-arms it, the next sustained run reports again.
+    clean(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK(!deadline_get_stats(DEADLINE_ULTRA).faulted);
+
+    for (int i = 0; i < DEADLINE_SUSTAINED; i++) slow(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before + 2);
+}
+
+static void stall_faults_until_clean_cycle()
+{
+    settle(DEADLINE_ULTRA);
+    int before = s_faults[DEADLINE_ULTRA];
+    const uint32_t period = DEADLINE_PLAN[DEADLINE_ULTRA].period_ms;
+
+    // Last check-in, then nothing: the monitor counts one stall per check
+    // past the deadline, wherever its ticks fall relative to the cycle.
+    deadline_begin(DEADLINE_ULTRA);
+    deadline_end(DEADLINE_ULTRA);
+    advance_ms(period + (DEADLINE_SUSTAINED - 1) * DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before + 1);
+    CHECK(deadline_get_stats(DEADLINE_ULTRA).stalls >= DEADLINE_SUSTAINED);
+
+    // The first cycle back is a period miss, so the fault stays raised...
+    clean(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK(deadline_get_stats(DEADLINE_ULTRA).faulted);
+
+    // ...until a cycle keeps the whole contract.
+    clean(DEADLINE_ULTRA);
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK(!deadline_get_stats(DEADLINE_ULTRA).faulted);
+    CHECK_EQ(s_faults[DEADLINE_ULTRA], before + 1);
+}
+
+static void stale_queue_item_is_a_miss()
+{
+    settle(DEADLINE_ALARM);
+    int before = s_faults[DEADLINE_ALARM];
+    uint32_t stale_us = (DEADLINE_PLAN[DEADLINE_ALARM].max_latency_ms + 1) * 1000;
+
+    for (int i = 0; i < DEADLINE_SUSTAINED; i++) {
+        deadline_begin(DEADLINE_ALARM);
+        deadline_latency(DEADLINE_ALARM, stale_us);
+        advance_ms(1);
+        deadline_end(DEADLINE_ALARM);
+        advance_ms(49);
+    }
+    advance_ms(DEADLINE_CHECK_MS);
+    CHECK_EQ(s_faults[DEADLINE_ALARM], before + 1);
+    CHECK(deadline_get_stats(DEADLINE_ALARM).latency_misses >= DEADLINE_SUSTAINED);
+    CHECK_EQ(deadline_get_stats(DEADLINE_ALARM).worst_latency_us, stale_us);
+}
+
+TEST_MAIN(
+    CASE(sustained_misses_fault),
+    CASE(clean_cycle_breaks_the_run),
+    CASE(fault_reported_once_until_clean),
+    CASE(stall_faults_until_clean_cycle),
+    CASE(stale_queue_item_is_a_miss)
+)
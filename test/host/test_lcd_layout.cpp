@@ -0,0 +1,61 @@
+// lcd_layout: splitting, truncating and padding to the 16x2 display.
+
+#include "check.h"
+#include "lcd_layout.h"
+
+static void one_line_pads_both_rows()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("ARMED", rows);
+    CHECK_STR(rows[0], "ARMED           ");
+    CHECK_STR(rows[1], "                ");
+}
+
+static void newline_splits_rows()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("ENTER PIN:\n**  ", rows);
+    CHECK_STR(rows[0], "ENTER PIN:      ");
+    CHECK_STR(rows[1], "**              ");
+}
+
+static void long_lines_are_truncated()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("0123456789ABCDEFGHIJ\nabcdefghijklmnopqrst", rows);
+    CHECK_STR(rows[0], "0123456789ABCDEF");
+    CHECK_STR(rows[1], "abcdefghijklmnop");
+}
+
+static void overlong_first_line_does_not_spill()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("0123456789ABCDEFGHIJ", rows);
+    CHECK_STR(rows[0], "0123456789ABCDEF");
+    CHECK_STR(rows[1], "                ");
+}
+
+static void only_first_newline_splits()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("A\nB\nC", rows);
+    CHECK_STR(rows[0], "A               ");
+    CHECK_STR(rows[1], "B               ");
+}
+
+static void empty_message()
+{
+    char rows[LCD_ROWS][LCD_COLS + 1];
+    lcd_layout("", rows);
+    CHECK_STR(rows[0], "                ");
+    CHECK_STR(rows[1], "                ");
+}
+
+TEST_MAIN(
+    CASE(one_line_pads_both_rows),
+    CASE(newline_splits_rows),
+    CASE(long_lines_are_truncated),
+    CASE(overlong_first_line_does_not_spill),
+    CASE(only_first_newline_splits),
+    CASE(empty_message),
+)
@@ -0,0 +1,171 @@
+// outbox: send order, LATEST coalescing, KEEP superseding LATEST, KEEP
+// eviction past OUTBOX_SLOTS - OUTBOX_LATEST_SLOTS, and outbox_sent after
+// a supersede.
+
+#include "check.h"
+#include "outbox.h"
+
+#include <string.h>
+
+static const char* TELE = "alarm/telemetry";
+static const char* DIAG = "alarm/diag";
+static const char* ACK  = "alarm/ack";
+
+static bool put(Outbox* ob, const char* topic, const char* payload, OutboxClass cls)
+{
+    return outbox_put(ob, topic, payload, strlen(payload), 1, cls);
+}
+
+// Sends the oldest message; its payload, or "" if the outbox is empty.
+static const char* pop(Outbox* ob)
+{
+    static char last[OUTBOX_PAYLOAD_MAX + 1];
+    const OutboxMsg* m = outbox_peek(ob);
+    if (!m) return "";
+    memcpy(last, m->payload, m->len);
+    last[m->len] = '\0';
+    outbox_sent(ob, m->seq);
+    return last;
+}
+
+static void leaves_in_queue_order()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    CHECK(outbox_peek(&ob) == nullptr);
+
+    CHECK(put(&ob, ACK, "a", OutboxClass::KEEP));
+    CHECK(put(&ob, TELE, "b", OutboxClass::KEEP));
+    CHECK(put(&ob, DIAG, "c", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.depth, 3);
+    CHECK_EQ(ob.stats.bytes, 3);
+
+    CHECK_STR(pop(&ob), "a");
+    CHECK_STR(pop(&ob), "b");
+    CHECK_STR(pop(&ob), "c");
+    CHECK_STR(pop(&ob), "");
+    CHECK_EQ(ob.stats.sent, 3);
+    CHECK_EQ(ob.stats.depth, 0);
+    CHECK_EQ(ob.stats.bytes, 0);
+    CHECK_EQ(ob.stats.max_depth, 3);
+}
+
+static void latest_keeps_only_the_newest()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    CHECK(put(&ob, TELE, "1", OutboxClass::LATEST));
+    CHECK(put(&ob, ACK, "ack", OutboxClass::KEEP));
+    CHECK(put(&ob, TELE, "2", OutboxClass::LATEST));
+    CHECK(put(&ob, TELE, "3", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.depth, 2);
+    CHECK_EQ(ob.stats.coalesced, 2);
+
+    // The survivor goes out where it was last queued, after the ack.
+    CHECK_STR(pop(&ob), "ack");
+    CHECK_STR(pop(&ob), "3");
+}
+
+static void keep_supersedes_latest_on_its_topic()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    CHECK(put(&ob, TELE, "periodic", OutboxClass::LATEST));
+    CHECK(put(&ob, DIAG, "diag", OutboxClass::LATEST));
+    CHECK(put(&ob, TELE, "change", OutboxClass::KEEP));
+    CHECK_EQ(ob.stats.depth, 2);
+    CHECK_EQ(ob.stats.coalesced, 1);
+
+    // A LATEST after it does not touch the KEEP one.
+    CHECK(put(&ob, TELE, "periodic2", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.depth, 3);
+
+    CHECK_STR(pop(&ob), "diag");
+    CHECK_STR(pop(&ob), "change");
+    CHECK_STR(pop(&ob), "periodic2");
+}
+
+static void keep_evicts_oldest_past_its_share()
+{
+    const int keep_max = OUTBOX_SLOTS - OUTBOX_LATEST_SLOTS;
+    Outbox ob;
+    outbox_init(&ob);
+
+    char p[8];
+    for (int i = 0; i < keep_max; i++) {
+        snprintf(p, sizeof(p), "k%d", i);
+        CHECK(put(&ob, ACK, p, OutboxClass::KEEP));
+    }
+    CHECK_EQ(ob.stats.dropped, 0);
+
+    CHECK(put(&ob, ACK, "newest", OutboxClass::KEEP));
+    CHECK_EQ(ob.stats.dropped, 1);
+    CHECK_EQ(ob.stats.depth, keep_max);
+
+    // The latest values still have their slots.
+    CHECK(put(&ob, TELE, "t", OutboxClass::LATEST));
+    CHECK(put(&ob, DIAG, "d", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.depth, OUTBOX_SLOTS);
+
+    // k0 was the one evicted.
+    CHECK_STR(pop(&ob), "k1");
+}
+
+static void latest_refused_when_full()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    for (int i = 0; i < OUTBOX_SLOTS - OUTBOX_LATEST_SLOTS; i++)
+        CHECK(put(&ob, ACK, "k", OutboxClass::KEEP));
+    CHECK(put(&ob, TELE, "t", OutboxClass::LATEST));
+    CHECK(put(&ob, DIAG, "d", OutboxClass::LATEST));
+
+    // More LATEST topics than OUTBOX_LATEST_SLOTS: nothing to evict.
+    CHECK(!put(&ob, "alarm/other", "o", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.dropped, 1);
+
+    // Its own topic still coalesces into the slot it has.
+    CHECK(put(&ob, TELE, "t2", OutboxClass::LATEST));
+    CHECK_EQ(ob.stats.depth, OUTBOX_SLOTS);
+}
+
+static void sent_after_supersede_is_ignored()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    CHECK(put(&ob, TELE, "old", OutboxClass::LATEST));
+
+    // The client is handed "old"; a newer value replaces it before the
+    // flush loop reports it sent.
+    uint32_t seq = outbox_peek(&ob)->seq;
+    CHECK(put(&ob, TELE, "new", OutboxClass::LATEST));
+    outbox_sent(&ob, seq);
+
+    CHECK_EQ(ob.stats.sent, 0);
+    CHECK_EQ(ob.stats.depth, 1);
+    CHECK_STR(pop(&ob), "new");
+}
+
+static void payload_size_limit()
+{
+    Outbox ob;
+    outbox_init(&ob);
+    char big[OUTBOX_PAYLOAD_MAX + 1];
+    memset(big, 'x', sizeof(big));
+
+    CHECK(!outbox_put(&ob, ACK, big, sizeof(big), 1, OutboxClass::KEEP));
+    CHECK_EQ(ob.stats.too_big, 1);
+    CHECK(outbox_put(&ob, ACK, big, OUTBOX_PAYLOAD_MAX, 1, OutboxClass::KEEP));
+    CHECK_EQ(ob.stats.bytes, OUTBOX_PAYLOAD_MAX);
+    CHECK_EQ(ob.stats.max_bytes, OUTBOX_PAYLOAD_MAX);
+}
+
+TEST_MAIN(
+    CASE(leaves_in_queue_order),
+    CASE(latest_keeps_only_the_newest),
+    CASE(keep_supersedes_latest_on_its_topic),
+    CASE(keep_evicts_oldest_past_its_share),
+    CASE(latest_refused_when_full),
+    CASE(sent_after_supersede_is_ignored),
+    CASE(payload_size_limit)
+)
@@ -0,0 +1,105 @@
+// range_filter: echo conversion, averaging and the jump debounce.
+
+#include "check.h"
+#include "range_filter.h"
+
+static int apply1(RangeFilter* f, int cm)
+{
+    int avg;
+    return range_filter_apply(f, &cm, 1, &avg);
+}
+
+static void echo_to_cm()
+{
+    CHECK_EQ(range_echo_to_cm(58 * 100), 100);
+    CHECK_EQ(range_echo_to_cm(58 * RANGE_MIN_CM), RANGE_MIN_CM);
+    CHECK_EQ(range_echo_to_cm(58 * RANGE_MAX_CM), RANGE_MAX_CM);
+    CHECK_EQ(range_echo_to_cm(58 * RANGE_MIN_CM - 1), -1);
+    CHECK_EQ(range_echo_to_cm(58 * (RANGE_MAX_CM + 1)), -1);
+    CHECK_EQ(range_echo_to_cm(0), -1);
+}
+
+static void averages_valid_samples_only()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+
+    int samples[] = { 100, -1, 110, 0, 120 };
+    int avg;
+    CHECK_EQ(range_filter_apply(&f, samples, 5, &avg), 110);
+    CHECK_EQ(avg, 110);
+}
+
+static void no_valid_sample()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+
+    int samples[] = { -1, -1, 0 };
+    int avg = 5;
+    CHECK_EQ(range_filter_apply(&f, samples, 3, &avg), -1);
+    CHECK_EQ(avg, -1);
+}
+
+static void first_reading_is_accepted()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    CHECK_EQ(apply1(&f, 300), 300);
+}
+
+static void small_moves_pass_through()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    apply1(&f, 100);
+    CHECK_EQ(apply1(&f, 100 + RANGE_DEBOUNCE_CM), 100 + RANGE_DEBOUNCE_CM);
+    CHECK_EQ(apply1(&f, 100), 100);
+}
+
+static void single_spike_is_held_back()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    apply1(&f, 200);
+
+    int avg;
+    int spike = 40;
+    CHECK_EQ(range_filter_apply(&f, &spike, 1, &avg), 200);
+    CHECK_EQ(avg, 40);                       // unfiltered average still reported
+    CHECK_EQ(apply1(&f, 200), 200);
+    CHECK_EQ(apply1(&f, 201), 201);
+}
+
+static void repeated_jump_is_a_new_level()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    apply1(&f, 200);
+
+    CHECK_EQ(apply1(&f, 50), 200);
+    CHECK_EQ(apply1(&f, 55), 55);            // RANGE_CONFIRM readings agree
+    CHECK_EQ(apply1(&f, 55), 55);
+}
+
+static void disagreeing_jumps_restart_confirmation()
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    apply1(&f, 200);
+
+    CHECK_EQ(apply1(&f, 50), 200);
+    CHECK_EQ(apply1(&f, 120), 200);          // a different level: pending again
+    CHECK_EQ(apply1(&f, 121), 121);
+}
+
+TEST_MAIN(
+    CASE(echo_to_cm),
+    CASE(averages_valid_samples_only),
+    CASE(no_valid_sample),
+    CASE(first_reading_is_accepted),
+    CASE(small_moves_pass_through),
+    CASE(single_spike_is_held_back),
+    CASE(repeated_jump_is_a_new_level),
+    CASE(disagreeing_jumps_restart_confirmation),
+)
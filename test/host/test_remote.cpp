@@ -0,0 +1,161 @@
+// remote: command ingestion into the alarm event queue, de-duplication, and
+// ingest-to-state latency through alarm_fsm the way alarm_task applies it.
+
+#include "check.h"
+#include "host_clock.h"
+#include "remote.h"
+#include "alarm_fsm.h"
+#include "esp_timer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define QUEUE_LEN 10
+
+// Every case starts on a fresh queue, past the cross-source window of the
+// one before.
+static QueueHandle_t fresh_queue(UBaseType_t len = QUEUE_LEN)
+{
+    static QueueHandle_t q = nullptr;
+    if (q) vQueueDelete(q);
+    q = xQueueCreate(len, sizeof(AlarmEvent));
+    remote_init(q);
+    host_clock_advance(1000 * 1000);
+    return q;
+}
+
+// What alarm_task does with one event off the queue.
+static AlarmStep apply(QueueHandle_t q, AlarmFsm* fsm, AlarmEvent* ev)
+{
+    if (xQueueReceive(q, ev, 0) != pdTRUE) return AlarmStep{};
+    return alarm_fsm_on_event(fsm, ev->type, (uint32_t)(esp_timer_get_time() / 1000));
+}
+
+static void submit_reaches_state_without_polling()
+{
+    QueueHandle_t q = fresh_queue();
+    AlarmFsm fsm;
+    alarm_fsm_init(&fsm);
+
+    int64_t t0 = esp_timer_get_time();
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::MQTT) == SubmitResult::QUEUED);
+
+    // The event is in the queue the moment remote_submit returns, so the
+    // next receive applies it: nothing between producer and alarm_task.
+    AlarmEvent ev;
+    AlarmStep s = apply(q, &fsm, &ev);
+    CHECK(s.changed);
+    CHECK(fsm.state == AlarmState::EXIT_DELAY);
+    CHECK(ev.type == AlarmEventType::ARM_REMOTE);
+    CHECK_EQ(ev.t_us, t0);
+    int64_t latency_us = esp_timer_get_time() - ev.t_us;
+    CHECK_EQ(latency_us, 0);
+}
+
+static void ingest_to_state_latency()
+{
+    QueueHandle_t q = fresh_queue();
+    AlarmFsm fsm;
+    alarm_fsm_init(&fsm);
+
+    std::vector<double> us;
+    for (uint32_t i = 1; i <= 2000; i++) {
+        host_clock_advance(300 * 1000);
+        RemoteCommandType cmd = fsm.state == AlarmState::DISARMED ? RemoteCommandType::ARM
+                                                                  : RemoteCommandType::DISARM;
+        AlarmEvent ev;
+        auto t0 = std::chrono::steady_clock::now();
+        SubmitResult r = remote_submit(cmd, EventSource::LAN, i);
+        AlarmStep s = apply(q, &fsm, &ev);
+        auto t1 = std::chrono::steady_clock::now();
+
+        CHECK(r == SubmitResult::QUEUED);
+        CHECK(s.changed);
+        us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+
+    std::sort(us.begin(), us.end());
+    double p50 = us[us.size() / 2], p99 = us[us.size() * 99 / 100];
+    printf("ingest to state: p50 %.2f us, p99 %.2f us, max %.2f us\n", p50, p99, us.back());
+    // The old remote_task polled every 500 ms; anything near that is a regression.
+    CHECK(p50 < 1000.0);
+}
+
+static void event_carries_source_id_and_ack()
+{
+    QueueHandle_t q = fresh_queue();
+    CHECK(remote_submit(RemoteCommandType::DISARM, EventSource::RF, 31, 5) == SubmitResult::QUEUED);
+
+    AlarmEvent ev;
+    CHECK(xQueueReceive(q, &ev, 0) == pdTRUE);
+    CHECK(ev.type == AlarmEventType::DISARM_REMOTE);
+    CHECK(ev.source == EventSource::RF);
+    CHECK_EQ(ev.cmd_id, 31);
+    CHECK_EQ(ev.ack_ref, 5);
+}
+
+static void repeated_id_is_dropped_per_source()
+{
+    fresh_queue();
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::LAN, 77) == SubmitResult::QUEUED);
+
+    host_clock_advance(1000 * 1000);
+    CHECK(remote_submit(RemoteCommandType::DISARM, EventSource::LAN, 77) == SubmitResult::DUPLICATE);
+    // Ids are the producer's own; another source may use the same number.
+    CHECK(remote_submit(RemoteCommandType::DISARM, EventSource::RF, 77) == SubmitResult::QUEUED);
+}
+
+static void same_command_within_window_is_dropped()
+{
+    fresh_queue();
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::LAN, 1) == SubmitResult::QUEUED);
+
+    host_clock_advance(100 * 1000);
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::MQTT) == SubmitResult::DUPLICATE);
+
+    host_clock_advance(200 * 1000);
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::MQTT) == SubmitResult::QUEUED);
+}
+
+static void full_queue_does_not_poison_history()
+{
+    QueueHandle_t q = fresh_queue(1);
+    CHECK(remote_submit(RemoteCommandType::DISARM, EventSource::SERIAL) == SubmitResult::QUEUED);
+
+    host_clock_advance(1000 * 1000);
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::LAN, 900) == SubmitResult::DROPPED);
+
+    // The producer retries the command the full queue turned away: neither
+    // its id nor the cross-source window may count it as seen.
+    AlarmEvent ev;
+    CHECK(xQueueReceive(q, &ev, 0) == pdTRUE);
+    CHECK(remote_submit(RemoteCommandType::ARM, EventSource::LAN, 900) == SubmitResult::QUEUED);
+    CHECK(xQueueReceive(q, &ev, 0) == pdTRUE);
+    CHECK(ev.type == AlarmEventType::ARM_REMOTE);
+}
+
+static void stats_count_outcomes()
+{
+    RemoteStats before = remote_get_stats();
+    fresh_queue(1);
+    remote_submit(RemoteCommandType::ARM, EventSource::MQTT, 4000);
+    remote_submit(RemoteCommandType::ARM, EventSource::MQTT, 4000);
+    host_clock_advance(1000 * 1000);
+    remote_submit(RemoteCommandType::DISARM, EventSource::MQTT, 4001);
+
+    RemoteStats after = remote_get_stats();
+    CHECK_EQ(after.accepted[(int)EventSource::MQTT] - before.accepted[(int)EventSource::MQTT], 1);
+    CHECK_EQ(after.duplicates - before.duplicates, 1);
+    CHECK_EQ(after.dropped - before.dropped, 1);
+}
+
+TEST_MAIN(
+    CASE(submit_reaches_state_without_polling),
+    CASE(ingest_to_state_latency),
+    CASE(event_carries_source_id_and_ack),
+    CASE(repeated_id_is_dropped_per_source),
+    CASE(same_command_within_window_is_dropped),
+    CASE(full_queue_does_not_poison_history),
+    CASE(stats_count_outcomes)
+)
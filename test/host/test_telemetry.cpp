@@ -0,0 +1,203 @@
+// telemetry: command parsing, de-duplication keys and payload building.
+
+#include "check.h"
+#include "telemetry.h"
+
+static bool parse(const char* s, CommandMsg* m)
+{
+    return telemetry_parse_command(s, (int)strlen(s), m);
+}
+
+static void bare_commands()
+{
+    CommandMsg m;
+    CHECK(parse("ARM", &m));
+    CHECK(m.cmd == RemoteCommandType::ARM);
+    CHECK_STR(m.id, "");
+    CHECK(!m.has_ts);
+
+    CHECK(parse("  DISARM", &m));
+    CHECK(m.cmd == RemoteCommandType::DISARM);
+
+    // mosquitto_pub -l and friends send a line ending.
+    CHECK(parse("ARM\n", &m));
+    CHECK(m.cmd == RemoteCommandType::ARM);
+    CHECK(parse("\tDISARM \r\n", &m));
+    CHECK(m.cmd == RemoteCommandType::DISARM);
+
+    CHECK(!parse("ARMED", &m));
+    CHECK(!parse("arm", &m));
+    CHECK(!parse("", &m));
+}
+
+static void json_command_with_id_and_ts()
+{
+    CommandMsg m;
+    CHECK(parse("{\"cmd\":\"ARM\",\"id\":\"c-17\",\"ts\":1700000000123}", &m));
+    CHECK(m.cmd == RemoteCommandType::ARM);
+    CHECK_STR(m.id, "c-17");
+    CHECK(m.has_ts);
+    CHECK_EQ(m.client_ts, 1700000000123LL);
+}
+
+static void json_whitespace_and_order()
+{
+    CommandMsg m;
+    CHECK(parse("{ \"ts\" : -5 , \"id\" : \"x\" , \"cmd\" : \"DISARM\" }", &m));
+    CHECK(m.cmd == RemoteCommandType::DISARM);
+    CHECK_STR(m.id, "x");
+    CHECK_EQ(m.client_ts, -5);
+}
+
+static void key_text_inside_a_value_is_not_a_key()
+{
+    CommandMsg m;
+    CHECK(parse("{\"id\":\"cmd\",\"cmd\":\"ARM\"}", &m));
+    CHECK(m.cmd == RemoteCommandType::ARM);
+    CHECK_STR(m.id, "cmd");
+
+    CHECK(parse("{\"id\":\"ts\",\"cmd\":\"DISARM\"}", &m));
+    CHECK(!m.has_ts);
+
+    // "id" only appears as a value: no id.
+    CHECK(parse("{\"note\":\"id\",\"cmd\":\"ARM\"}", &m));
+    CHECK_STR(m.id, "");
+}
+
+static void json_rejects()
+{
+    CommandMsg m;
+    CHECK(!parse("{\"cmd\":\"REBOOT\"}", &m));
+    CHECK(!parse("{\"id\":\"a\"}", &m));
+    CHECK(!parse("{\"cmd\":ARM}", &m));
+    CHECK(!parse("{\"cmd\":\"ARM", &m));
+}
+
+static void ts_stops_at_payload_end()
+{
+    // The MQTT payload is not NUL terminated: digits after len are not ours.
+    const char buf[] = "{\"cmd\":\"ARM\",\"ts\":12345";
+    CommandMsg m;
+    CHECK(telemetry_parse_command(buf, (int)strlen(buf) - 3, &m));
+    CHECK(m.has_ts);
+    CHECK_EQ(m.client_ts, 12);
+
+    CHECK(parse("{\"cmd\":\"ARM\",\"ts\":-}", &m));
+    CHECK(!m.has_ts);
+    CHECK(parse("{\"cmd\":\"ARM\",\"ts\":1234567890123456789}", &m));
+    CHECK(!m.has_ts);
+}
+
+static bool reply_ok(const char* t)
+{
+    return telemetry_reply_topic_ok(t, (int)strlen(t));
+}
+
+static void reply_topic_only_under_prefix()
+{
+    CHECK(reply_ok("alarm/ack/app-7"));
+    CHECK(reply_ok("alarm/ack/phone/42"));
+
+    CHECK(!reply_ok("alarm/ack/"));
+    CHECK(!reply_ok("alarm/ack"));
+    CHECK(!reply_ok("alarm/cmd"));
+    CHECK(!reply_ok("alarm/ota"));
+    CHECK(!reply_ok("alarm/ackx/1"));
+    CHECK(!reply_ok("other-device/alarm/ack/1"));
+    CHECK(!reply_ok("alarm/ack/+"));
+    CHECK(!reply_ok("alarm/ack/#"));
+    CHECK(!telemetry_reply_topic_ok(nullptr, 0));
+
+    char lng[ACK_TOPIC_MAX + 1];
+    snprintf(lng, sizeof(lng), "%s%0*d", ACK_REPLY_PREFIX,
+             ACK_TOPIC_MAX - (int)strlen(ACK_REPLY_PREFIX), 0);
+    CHECK(!reply_ok(lng));
+    lng[ACK_TOPIC_MAX - 1] = '\0';
+    CHECK(reply_ok(lng));
+}
+
+static void overlong_id_is_dropped()
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"cmd\":\"ARM\",\"id\":\"%0*d\"}", CMD_ID_MAX + 1, 7);
+    CommandMsg m;
+    CHECK(parse(buf, &m));
+    CHECK_STR(m.id, "");
+}
+
+static void command_keys()
+{
+    CommandMsg a, b, c;
+    parse("ARM", &a);
+    parse("{\"cmd\":\"ARM\",\"id\":\"one\"}", &b);
+    parse("{\"cmd\":\"DISARM\",\"id\":\"one\"}", &c);
+
+    CHECK_EQ(telemetry_command_key(a), 0);
+    CHECK(telemetry_command_key(b) != 0);
+    CHECK_EQ(telemetry_command_key(b), telemetry_command_key(c));   // by id only
+}
+
+static void state_payload()
+{
+    char buf[64];
+    int n = telemetry_build_state(buf, sizeof(buf), AlarmState::EXIT_DELAY, 123);
+    CHECK_STR(buf, "{\"state\":\"EXIT_DELAY\",\"distance_cm\":123}");
+    CHECK_EQ(n, (int)strlen(buf));
+}
+
+static void ack_payload()
+{
+    CommandAck ack = {};
+    parse("{\"cmd\":\"DISARM\",\"id\":\"k9\",\"ts\":42}", &ack.msg);
+    ack.result = AckResult::NO_CHANGE;
+    ack.state = AlarmState::DISARMED;
+    ack.rx_us = 10;
+    ack.apply_us = 20;
+    ack.pub_us = 30;
+
+    char buf[256];
+    int n = telemetry_build_ack(buf, sizeof(buf), ack);
+    CHECK_STR(buf, "{\"id\":\"k9\",\"cmd\":\"DISARM\",\"result\":\"no_change\",\"state\":\"DISARMED\","
+                   "\"ts\":42,\"rx_us\":10,\"apply_us\":20,\"pub_us\":30}");
+    CHECK_EQ(n, (int)strlen(buf));
+}
+
+static void ack_round_trips_through_the_parser()
+{
+    // The ack echoes id and cmd in the same shape a command uses.
+    CommandAck ack = {};
+    parse("{\"cmd\":\"ARM\",\"id\":\"rt\"}", &ack.msg);
+    ack.result = AckResult::APPLIED;
+
+    char buf[256];
+    telemetry_build_ack(buf, sizeof(buf), ack);
+
+    CommandMsg back;
+    CHECK(parse(buf, &back));
+    CHECK(back.cmd == RemoteCommandType::ARM);
+    CHECK_STR(back.id, "rt");
+}
+
+static void names()
+{
+    CHECK_STR(alarm_state_name(AlarmState::ALARM), "ALARM");
+    CHECK_STR(ack_result_name(AckResult::APPLIED), "applied");
+    CHECK_STR(ack_result_name(AckResult::DUPLICATE), "duplicate");
+    CHECK_STR(ack_result_name(AckResult::REJECTED), "rejected");
+}
+
+TEST_MAIN(
+    CASE(bare_commands),
+    CASE(json_command_with_id_and_ts),
+    CASE(json_whitespace_and_order),
+    CASE(key_text_inside_a_value_is_not_a_key),
+    CASE(json_rejects),
+    CASE(ts_stops_at_payload_end),
+    CASE(reply_topic_only_under_prefix),
+    CASE(overlong_id_is_dropped),
+    CASE(command_keys),
+    CASE(state_payload),
+    CASE(ack_payload),
+    CASE(ack_round_trips_through_the_parser),
+    CASE(names),
+)
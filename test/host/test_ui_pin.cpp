@@ -0,0 +1,248 @@
+// ui_pin_equal and the keypad flows built on it: PIN entry, keys pressed
+// during a transient message, the inactivity timeout and PIN change, with
+// ui_flow_tick driven by a moving clock the way keypad_task polls it.
+
+#include "check.h"
+#include "ui_flow.h"
+
+static bool check_1231(const char* pin)
+{
+    return ui_pin_equal(pin, "1231");
+}
+
+static void equal_pins_match()
+{
+    CHECK(ui_pin_equal("1231", "1231"));
+    CHECK(ui_pin_equal("0000", "0000"));
+}
+
+static void any_wrong_digit_fails()
+{
+    CHECK(!ui_pin_equal("0231", "1231"));
+    CHECK(!ui_pin_equal("1031", "1231"));
+    CHECK(!ui_pin_equal("1201", "1231"));
+    CHECK(!ui_pin_equal("1230", "1231"));
+}
+
+static void short_entry_fails()
+{
+    char entered[UI_PIN_LEN + 1] = "12";
+    CHECK(!ui_pin_equal(entered, "1231"));
+
+    char empty[UI_PIN_LEN + 1] = "";
+    CHECK(!ui_pin_equal(empty, "1231"));
+}
+
+static void only_pin_len_digits_count()
+{
+    CHECK(ui_pin_equal("12319", "12310"));
+}
+
+static UiOutput type(UiFlow* ui, const char* keys, uint32_t* now_ms)
+{
+    UiOutput out = {};
+    for (const char* k = keys; *k; k++) {
+        *now_ms += 200;
+        out = ui_flow_on_key(ui, *k, *now_ms);
+    }
+    return out;
+}
+
+static void flow_disarms_on_right_pin()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "1231#", &now);
+    CHECK(out.action == UiAction::DISARM_PIN_OK);
+}
+
+static void flow_rejects_wrong_pin()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "1232#", &now);
+    CHECK(out.action == UiAction::NONE);
+    CHECK(ui.flash != nullptr);
+}
+
+static void star_clears_entry()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "99*1231#", &now);
+    CHECK(out.action == UiAction::DISARM_PIN_OK);
+}
+
+// keypad_task's poll: a tick every 50 ms up to until_ms; the last output
+// that asked for something.
+static UiOutput run_until(UiFlow* ui, uint32_t* now_ms, uint32_t until_ms)
+{
+    UiOutput last = {};
+    while (*now_ms < until_ms) {
+        *now_ms += 50;
+        if (*now_ms > until_ms) *now_ms = until_ms;
+        UiOutput out = ui_flow_tick(ui, *now_ms);
+        if (out.redraw || out.release) last = out;
+    }
+    return last;
+}
+
+static void key_during_wrong_pin_is_handled()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "1232#", &now);
+    CHECK_STR(out.screen, "WRONG PIN");
+
+    // Well inside UI_FLASH_MS: the key dismisses the message and counts.
+    out = type(&ui, "1", &now);
+    CHECK(ui.flash == nullptr);
+    CHECK(out.redraw);
+    CHECK_STR(out.screen, "ENTER PIN:\n*   ");
+
+    out = type(&ui, "231#", &now);
+    CHECK(out.action == UiAction::DISARM_PIN_OK);
+}
+
+static void key_during_need_digits_is_handled()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "12#", &now);
+    CHECK_STR(out.screen, "NEED 4 DIGITS");
+    CHECK(type(&ui, "1231#", &now).action == UiAction::DISARM_PIN_OK);
+}
+
+static void message_clears_on_tick()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    type(&ui, "1232#", &now);
+    uint32_t shown = now;
+
+    UiOutput out = run_until(&ui, &now, shown + UI_FLASH_MS - 1);
+    CHECK(!out.redraw);
+    CHECK(ui.flash != nullptr);
+
+    out = run_until(&ui, &now, shown + UI_FLASH_MS);
+    CHECK(out.redraw);
+    CHECK_STR(out.screen, "ENTER PIN:\n    ");
+    CHECK(ui.flow == UiFlowId::PIN_ENTRY);
+}
+
+static void idle_flow_times_out()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    type(&ui, "12", &now);
+    uint32_t last_key = now;
+
+    CHECK(!run_until(&ui, &now, last_key + UI_INACTIVITY_MS - 1).redraw);
+    CHECK(ui.flow == UiFlowId::PIN_ENTRY);
+
+    UiOutput out = run_until(&ui, &now, last_key + UI_INACTIVITY_MS);
+    CHECK(ui.flow == UiFlowId::IDLE);
+    CHECK_STR(out.screen, "TIMEOUT");
+    CHECK_EQ(ui.len, 0);
+
+    // Once TIMEOUT has been up, the LCD goes back to the alarm.
+    out = run_until(&ui, &now, now + UI_FLASH_SHORT_MS);
+    CHECK(out.release);
+}
+
+static void keys_push_the_timeout_back()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    type(&ui, "1", &now);
+    run_until(&ui, &now, now + UI_INACTIVITY_MS - 1000);
+    type(&ui, "2", &now);
+    run_until(&ui, &now, now + UI_INACTIVITY_MS - 1000);
+    CHECK(ui.flow == UiFlowId::PIN_ENTRY);
+    CHECK_EQ(ui.len, 2);
+}
+
+static void pin_change_steps()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    UiOutput out = type(&ui, "B", &now);
+    CHECK_STR(out.screen, "MENU 1/3\n> CHANGE PIN");
+    out = type(&ui, "#", &now);
+    CHECK(ui.flow == UiFlowId::PIN_CHANGE);
+    CHECK_STR(out.screen, "OLD PIN:\n    ");
+
+    // Wrong old PIN: stays on the first step.
+    out = type(&ui, "0000#", &now);
+    CHECK_STR(out.screen, "WRONG PIN");
+    CHECK_EQ(ui.step, 0);
+    run_until(&ui, &now, now + UI_FLASH_MS);
+
+    out = type(&ui, "1231#", &now);
+    CHECK_STR(out.screen, "NEW PIN:\n    ");
+    out = type(&ui, "4567#", &now);
+    CHECK_STR(out.screen, "CONFIRM PIN:\n    ");
+
+    // A confirmation that does not match goes back to the new PIN.
+    out = type(&ui, "4568#", &now);
+    CHECK_STR(out.screen, "PIN MISMATCH");
+    CHECK_EQ(ui.step, 1);
+    CHECK(out.action == UiAction::NONE);
+
+    // Typed straight over the message.
+    type(&ui, "4567#", &now);
+    out = type(&ui, "4567#", &now);
+    CHECK(out.action == UiAction::SET_PIN);
+    CHECK_STR(out.new_pin, "4567");
+    CHECK_STR(out.screen, "PIN CHANGED");
+    CHECK(ui.flow == UiFlowId::IDLE);
+}
+
+static void d_backs_out_of_pin_change()
+{
+    UiFlow ui;
+    ui_flow_init(&ui, check_1231);
+    uint32_t now = 0;
+
+    type(&ui, "B#1231#45", &now);
+    CHECK_EQ(ui.step, 1);
+    UiOutput out = type(&ui, "D", &now);
+    CHECK(ui.flow == UiFlowId::IDLE);
+    CHECK(out.release);
+    CHECK(out.action == UiAction::NONE);
+}
+
+TEST_MAIN(
+    CASE(equal_pins_match),
+    CASE(any_wrong_digit_fails),
+    CASE(short_entry_fails),
+    CASE(only_pin_len_digits_count),
+    CASE(flow_disarms_on_right_pin),
+    CASE(flow_rejects_wrong_pin),
+    CASE(star_clears_entry),
+    CASE(key_during_wrong_pin_is_handled),
+    CASE(key_during_need_digits_is_handled),
+    CASE(message_clears_on_tick),
+    CASE(idle_flow_times_out),
+    CASE(keys_push_the_timeout_back),
+    CASE(pin_change_steps),
+    CASE(d_backs_out_of_pin_change),
+)
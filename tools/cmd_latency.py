@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Command round-trip latency over MQTT using correlation ids.
+
+Fires ARM/DISARM commands at alarm/cmd with an id and client timestamp and
+waits for the matching alarm/ack. Prints per-command timings and latency
+percentiles. Needs paho-mqtt (pip install paho-mqtt).
+
+    tools/cmd_latency.py --host 192.168.1.10 --count 100
+    tools/cmd_latency.py --host broker.example --port 8883 --tls \\
+        --user homeGuard --password ... --count 20
+
+round trip   client send -> ack received (client clock)
+apply        device receive -> state machine applied (device clock)
+publish      device receive -> ack handed to the MQTT client (device clock)
+"""
+
+import argparse
+import json
+import sys
+import threading
+import time
+import uuid
+
+import paho.mqtt.client as mqtt
+
+TOPIC_CMD = "alarm/cmd"
+TOPIC_ACK = "alarm/ack"
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def summary(name, values):
+    if not values:
+        return "%-10s no samples" % name
+    return "%-10s p50=%7.1f p90=%7.1f p99=%7.1f max=%7.1f ms" % (
+        name, percentile(values, 50), percentile(values, 90),
+        percentile(values, 99), max(values))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--host", default="localhost")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--tls", action="store_true")
+    ap.add_argument("--user")
+    ap.add_argument("--password")
+    ap.add_argument("--count", type=int, default=20)
+    ap.add_argument("--interval", type=float, default=0.5,
+                    help="seconds between commands")
+    ap.add_argument("--timeout", type=float, default=5.0)
+    args = ap.parse_args()
+
+    pending = {}
+    acks = {}
+    cond = threading.Condition()
+
+    def on_message(client, userdata, msg):
+        recv = time.monotonic()
+        try:
+            ack = json.loads(msg.payload)
+        except ValueError:
+            return
+        with cond:
+            if ack.get("id") in pending:
+                acks[ack["id"]] = (recv, ack)
+                cond.notify_all()
+
+    client = mqtt.Client(client_id="cmd-latency-%s" % uuid.uuid4().hex[:8])
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    if args.tls:
+        client.tls_set()
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.subscribe(TOPIC_ACK, qos=1)
+    client.loop_start()
+    time.sleep(0.5)
+
+    rtt, apply, publish = [], [], []
+    for i in range(args.count):
+        cmd = "ARM" if i % 2 == 0 else "DISARM"
+        cid = uuid.uuid4().hex[:12]
+        payload = json.dumps({"cmd": cmd, "id": cid,
+                              "ts": int(time.time() * 1000)})
+        with cond:
+            pending[cid] = time.monotonic()
+        client.publish(TOPIC_CMD, payload, qos=1)
+
+        with cond:
+            cond.wait_for(lambda: cid in acks, timeout=args.timeout)
+            got = acks.get(cid)
+
+        if not got:
+            print("%3d %-6s %s  timeout" % (i, cmd, cid))
+        else:
+            recv, ack = got
+            r = (recv - pending[cid]) * 1000.0
+            a = (ack["apply_us"] - ack["rx_us"]) / 1000.0 if ack["apply_us"] else 0.0
+            p = (ack["pub_us"] - ack["rx_us"]) / 1000.0
+            rtt.append(r)
+            if ack["apply_us"]:
+                apply.append(a)
+            publish.append(p)
+            print("%3d %-6s %s  %-9s %-10s rtt=%7.1f apply=%6.2f publish=%6.2f ms"
+                  % (i, cmd, cid, ack["result"], ack["state"], r, a, p))
+
+        time.sleep(args.interval)
+
+    client.loop_stop()
+    print()
+    print(summary("round trip", rtt))
+    print(summary("apply", apply))
+    print(summary("publish", publish))
+    return 0 if len(rtt) == args.count else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,376 @@
+// Virtual-time soak runner: the firmware's tasks from src/main.cpp on the
+// discrete-event kernel in sim_rtos.cpp, with peripherals replaced by the
+// fakes in sim_devices.cpp and a household routine driving them.
+//
+//   des_sim [--days N] [--seed S]           generated routine
+//   des_sim --script run.txt                scripted actions (scenario.h)
+//   des_sim --days 7 --seed 3 --dump-script  print the generated script
+//   -v / -vv                                show firmware logs (W+E / all)
+//   --json                                  add a one-line JSON summary
+//
+// des_sim_exec is the same runner built with EXECUTOR_BUILD=1.
+//
+// The run is deterministic: the same seed or script gives the same trace
+// hash, so a hash change after a firmware edit means behaviour changed.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "alarm.h"
+#include "alarm_fsm.h"
+#include "deadline.h"
+#include "telemetry.h"
+
+#include "des_sim.h"
+#include "scenario.h"
+#include "sim_rtos.h"
+
+extern "C" void app_main(void);
+extern uint32_t g_log_counts[];
+
+#define DAY_US          (86400ULL * 1000000ULL)
+#define WALL_CM         250
+#define MISS_PERMILLE   20
+#define STATES          4
+
+static const char* EVENT_NAMES[] = {
+    "ARM_LOCAL", "ARM_REMOTE", "DISARM_PIN_OK", "DISARM_OVERRIDE",
+    "DISARM_REMOTE", "MOTION_DETECTED", "RESET", "FAULT",
+};
+#define EVENT_TYPES (sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]))
+
+static const char* SOURCE_NAMES[] = { "local", "mqtt", "lan", "rf", "serial" };
+
+int g_verbosity = ESP_LOG_NONE;
+
+static Scenario s_scenario;
+
+struct PubCount {
+    uint64_t n;
+    uint64_t payload;           // bytes
+    uint64_t wire;
+};
+
+static struct {
+    uint64_t events[EVENT_TYPES][(int)EventSource::COUNT];
+    uint64_t transitions[STATES][STATES];
+    uint64_t state_us[STATES];
+    int      state;
+    uint64_t state_since_us;
+    uint32_t alarm_entries;
+    std::map<std::string, PubCount> publishes;
+    std::string outbox;         // objects of the last alarm/diag
+    std::string runtime;
+    uint64_t trace;
+} s_rep = { {}, {}, {}, (int)AlarmState::DISARMED, 0, 0, {}, {}, {}, 0xcbf29ce484222325ULL };
+
+const char* sim_time_str(uint64_t t_us)
+{
+    static char buf[24];
+    uint64_t ms = t_us / 1000;
+    snprintf(buf, sizeof(buf), "%" PRIu64 "+%02u:%02u:%02u.%03u", ms / 86400000,
+             (unsigned)(ms / 3600000 % 24), (unsigned)(ms / 60000 % 60),
+             (unsigned)(ms / 1000 % 60), (unsigned)(ms % 1000));
+    return buf;
+}
+
+static void trace_add(const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < len; i++) {
+        s_rep.trace ^= p[i];
+        s_rep.trace *= 0x100000001b3ULL;
+    }
+}
+
+static void trace_event(const char* what, const char* data, size_t len)
+{
+    uint64_t now = sim_now_us();
+    trace_add(&now, sizeof(now));
+    trace_add(what, strlen(what));
+    trace_add(data, len);
+}
+
+// The flat {...} object under "key" in a diag payload, empty if none.
+static std::string diag_object(const std::string& d, const char* key)
+{
+    std::string k = std::string("\"") + key + "\":{";
+    size_t at = d.find(k);
+    if (at == std::string::npos) return "";
+    size_t end = d.find('}', at);
+    if (end == std::string::npos) return "";
+    return d.substr(at + k.size() - 1, end - at - k.size() + 2);
+}
+
+static int state_index(const char* name)
+{
+    for (int i = 0; i < STATES; i++)
+        if (strcmp(alarm_state_name((AlarmState)i), name) == 0) return i;
+    return -1;
+}
+
+void sim_on_publish(const char* topic, const char* data, int len, int wire)
+{
+    if (len == 0) len = (int)strlen(data);
+
+    PubCount& pc = s_rep.publishes[topic];
+    pc.n++;
+    pc.payload += len;
+    pc.wire += wire;
+    trace_event(topic, data, len);
+
+    if (g_verbosity >= ESP_LOG_INFO)
+        printf("%s   pub %s %.*s\n", sim_time_str(sim_now_us()), topic, len, data);
+
+    if (strcmp(topic, "alarm/diag") == 0) {
+        std::string d(data, len);
+        s_rep.outbox = diag_object(d, "outbox");
+        s_rep.runtime = diag_object(d, "runtime");
+        return;
+    }
+    if (strcmp(topic, "alarm/telemetry") != 0) return;
+
+    const char* p = strstr(data, "\"state\":\"");
+    if (!p) return;
+    p += 9;
+    const char* q = strchr(p, '"');
+    if (!q || q - p >= 16) return;
+
+    char name[16];
+    memcpy(name, p, q - p);
+    name[q - p] = '\0';
+
+    int next = state_index(name);
+    if (next < 0 || next == s_rep.state) return;
+
+    uint64_t now = sim_now_us();
+    s_rep.state_us[s_rep.state] += now - s_rep.state_since_us;
+    s_rep.transitions[s_rep.state][next]++;
+    s_rep.state = next;
+    s_rep.state_since_us = now;
+    if (next == (int)AlarmState::ALARM) s_rep.alarm_entries++;
+}
+
+void sim_on_lcd(const char* text)
+{
+    trace_event("lcd", text, strlen(text));
+}
+
+void sim_on_voice(const char* phrase)
+{
+    trace_event("voice", phrase, strlen(phrase));
+    if (g_verbosity >= ESP_LOG_INFO) printf("%s   say %s\n", sim_time_str(sim_now_us()), phrase);
+}
+
+static void on_event(QueueHandle_t, const void* item)
+{
+    AlarmEvent ev;
+    memcpy(&ev, item, sizeof(ev));
+    if ((unsigned)ev.type < EVENT_TYPES && ev.source < EventSource::COUNT)
+        s_rep.events[(int)ev.type][(int)ev.source]++;
+}
+
+// Applies the scenario at its virtual times. Runs above every firmware task
+// so an action lands exactly when scheduled.
+static void scenario_task(void*)
+{
+    for (const Action& a : s_scenario.actions) {
+        sim_sleep_until(a.t_us);
+
+        switch (a.kind) {
+            case ActKind::KEYS:
+                for (char k : a.a) g_world.keys.push_back(k);
+                break;
+            case ActKind::PRESENT:
+                g_world.present_cm = a.cm;
+                g_world.present_until_us = a.t_us + a.secs * 1000000ULL;
+                break;
+            case ActKind::MQTT:
+                sim_mqtt_inject(a.a.c_str(), a.b.c_str());
+                break;
+            case ActKind::OUTAGE:
+                sim_mqtt_outage(a.secs);
+                break;
+            case ActKind::EXPECT_ALARM:
+                break;
+        }
+    }
+    vTaskDelete(nullptr);
+}
+
+static void main_task(void*)
+{
+    app_main();
+    vTaskDelete(nullptr);
+}
+
+static void print_report(uint64_t end_us, double wall_s)
+{
+    SimKernelStats ks = sim_kernel_stats();
+
+    s_rep.state_us[s_rep.state] += end_us - s_rep.state_since_us;
+    s_rep.state_since_us = end_us;
+
+    printf("\nsimulated %.2f days in %.2f s (%.0fx), %" PRIu64 " switches, %" PRIu64
+           " timer fires, %u tasks\n",
+           end_us / (double)DAY_US, wall_s, end_us / 1e6 / (wall_s > 0 ? wall_s : 1e-9),
+           ks.switches, ks.timer_fires, ks.tasks);
+
+    printf("\ntransitions (from \\ to)\n  %-11s", "");
+    for (int j = 0; j < STATES; j++) printf(" %10s", alarm_state_name((AlarmState)j));
+    printf("\n");
+    for (int i = 0; i < STATES; i++) {
+        printf("  %-11s", alarm_state_name((AlarmState)i));
+        for (int j = 0; j < STATES; j++) printf(" %10" PRIu64, s_rep.transitions[i][j]);
+        printf("\n");
+    }
+
+    printf("\ntime in state\n");
+    for (int i = 0; i < STATES; i++)
+        printf("  %-11s %10.2f h  %5.1f%%\n", alarm_state_name((AlarmState)i),
+               s_rep.state_us[i] / 3.6e9, 100.0 * s_rep.state_us[i] / end_us);
+
+    printf("\nevents\n");
+    for (unsigned t = 0; t < EVENT_TYPES; t++) {
+        uint64_t total = 0;
+        for (int s = 0; s < (int)EventSource::COUNT; s++) total += s_rep.events[t][s];
+        if (!total) continue;
+        printf("  %-16s %8" PRIu64 "  ", EVENT_NAMES[t], total);
+        for (int s = 0; s < (int)EventSource::COUNT; s++)
+            if (s_rep.events[t][s]) printf(" %s=%" PRIu64, SOURCE_NAMES[s], s_rep.events[t][s]);
+        printf("\n");
+    }
+
+    // Wire bytes come from sim_idf.cpp's own PUBLISH size model, not from a
+    // capture against a broker.
+    printf("\npublishes (MQTT %s)          count  payload B  wire B  overhead B  (modelled)\n",
+           g_world.mqtt_v5 ? "5" : "3.1.1");
+    for (const auto& [topic, pc] : s_rep.publishes) {
+        printf("  %-18s %8" PRIu64 " %10.1f %7.1f %11.1f\n", topic.c_str(), pc.n,
+               (double)pc.payload / pc.n, (double)pc.wire / pc.n,
+               (double)(pc.wire - pc.payload) / pc.n);
+    }
+
+    printf("  broker outages %u, connects %u\n", g_world.mqtt_outages, g_world.mqtt_connects);
+    if (!s_rep.outbox.empty()) printf("  outbox %s\n", s_rep.outbox.c_str());
+    if (!s_rep.runtime.empty()) printf("  runtime %s\n", s_rep.runtime.c_str());
+
+    printf("\noutputs\n");
+    printf("  lcd messages %u, beeps %u, voice prompts %u, siren %.1f min, led changes %u, "
+           "nvs writes %u\n",
+           g_world.lcd_messages, g_world.beeps, g_world.voice_phrases, g_world.siren_us / 6e7,
+           g_world.led_changes,
+           g_world.nvs_writes);
+
+    printf("\ndeadlines\n");
+    for (int i = 0; i < DEADLINE_COUNT; i++) {
+        DeadlineStats st = deadline_get_stats((DeadlineId)i);
+        printf("  %-12s cycles %u, misses period %u proc %u latency %u, stalls %u, faults %u\n",
+               DEADLINE_PLAN[i].name, st.cycles, st.period_misses, st.proc_misses,
+               st.latency_misses, st.stalls, st.faults);
+    }
+
+    printf("\nlog lines: %u errors, %u warnings\n", g_log_counts[ESP_LOG_ERROR],
+           g_log_counts[ESP_LOG_WARN]);
+    printf("alarms: expected %u, entered %u\n", scenario_expected_alarms(s_scenario),
+           s_rep.alarm_entries);
+    printf("trace %016" PRIx64 "\n", s_rep.trace);
+}
+
+static void print_json(uint64_t end_us, double wall_s)
+{
+    SimKernelStats ks = sim_kernel_stats();
+
+    printf("{\"days\":%.3f,\"wall_s\":%.3f,\"switches\":%" PRIu64 ",\"transitions\":[",
+           end_us / (double)DAY_US, wall_s, ks.switches);
+    for (int i = 0; i < STATES; i++) {
+        printf("%s[", i ? "," : "");
+        for (int j = 0; j < STATES; j++) printf("%s%" PRIu64, j ? "," : "", s_rep.transitions[i][j]);
+        printf("]");
+    }
+    printf("],\"state_s\":[");
+    for (int i = 0; i < STATES; i++) printf("%s%.0f", i ? "," : "", s_rep.state_us[i] / 1e6);
+    printf("],\"publishes\":{");
+    bool first = true;
+    for (const auto& [topic, pc] : s_rep.publishes) {
+        printf("%s\"%s\":{\"n\":%" PRIu64 ",\"payload\":%" PRIu64 ",\"wire\":%" PRIu64 "}",
+               first ? "" : ",", topic.c_str(), pc.n, pc.payload, pc.wire);
+        first = false;
+    }
+    printf("},\"alarms_expected\":%u,\"alarms\":%u,\"siren_s\":%.0f,\"outages\":%u,"
+           "\"outbox\":%s,\"runtime\":%s,\"errors\":%u,\"warnings\":%u,\"trace\":\"%016" PRIx64 "\"}\n",
+           scenario_expected_alarms(s_scenario), s_rep.alarm_entries, g_world.siren_us / 1e6,
+           g_world.mqtt_outages, s_rep.outbox.empty() ? "null" : s_rep.outbox.c_str(),
+           s_rep.runtime.empty() ? "null" : s_rep.runtime.c_str(),
+           g_log_counts[ESP_LOG_ERROR], g_log_counts[ESP_LOG_WARN], s_rep.trace);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: des_sim [--days N] [--seed S] [--script FILE] [--dump-script]"
+                    " [-v|-vv] [--json]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    int days = 7;
+    uint64_t seed = 1;
+    const char* script = nullptr;
+    bool dump = false;
+    bool json = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (strcmp(a, "--days") == 0 && i + 1 < argc) days = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(a, "--script") == 0 && i + 1 < argc) script = argv[++i];
+        else if (strcmp(a, "--dump-script") == 0) dump = true;
+        else if (strcmp(a, "--json") == 0) json = true;
+        else if (strcmp(a, "-v") == 0) g_verbosity = ESP_LOG_WARN;
+        else if (strcmp(a, "-vv") == 0) g_verbosity = ESP_LOG_INFO;
+        else usage();
+    }
+    if (days <= 0) usage();
+
+    if (script) {
+        if (!scenario_load(script, &s_scenario)) return 2;
+    } else {
+        s_scenario = scenario_generate(seed, days);
+    }
+
+    if (dump) {
+        scenario_write(s_scenario, stdout);
+        return 0;
+    }
+
+    g_world.wall_cm = WALL_CM;
+    g_world.miss_permille = MISS_PERMILLE;
+    sim_noise_seed(seed ^ 0x5DEECE66DULL);
+    sim_set_queue_tap(EVENT_QUEUE_NAME, on_event);
+
+    xTaskCreate(main_task, "main", 4096, nullptr, 1, nullptr);
+    xTaskCreate(scenario_task, "scenario", 4096, nullptr, 24, nullptr);
+
+    uint64_t end_us = days * DAY_US;
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_run(end_us);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    print_report(end_us, wall_s);
+    if (json) print_json(end_us, wall_s);
+
+    uint32_t expected = scenario_expected_alarms(s_scenario);
+    return s_rep.alarm_entries >= expected ? 0 : 1;
+}
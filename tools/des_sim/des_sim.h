@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+
+// State shared by the peripheral fakes, the scenario driver and the report.
+
+struct SimWorld {
+    // Ultrasonic scene: the wall, and whoever is standing in the beam.
+    int      wall_cm;
+    int      present_cm;
+    uint64_t present_until_us;
+    uint32_t miss_permille;            // pings without an echo
+
+    // Keypad: keys waiting to be "pressed", one per keypad poll.
+    std::deque<char> keys;
+
+    // Outputs.
+    uint32_t lcd_messages;
+    char     lcd_text[34];
+    bool     siren;
+    uint64_t siren_since_us;
+    uint64_t siren_us;
+    uint32_t beeps;
+    uint32_t voice_phrases;
+    uint32_t led_changes;
+    uint32_t nvs_writes;
+    bool     mqtt_connected;
+    uint32_t mqtt_connects;
+    uint32_t mqtt_outages;
+    bool     mqtt_v5;                  // protocol the client was configured for
+};
+
+extern SimWorld g_world;
+extern int g_verbosity;
+
+// Deterministic noise for the fakes, seeded per run.
+void     sim_noise_seed(uint64_t seed);
+uint32_t sim_noise(uint32_t below);
+
+// Delivers an MQTT message to the firmware's event handler on the loopback
+// client's task.
+void sim_mqtt_inject(const char* topic, const char* data);
+
+// Takes the broker away for secs seconds.
+void sim_mqtt_outage(uint32_t secs);
+
+// Report hooks, implemented by des_sim.cpp.
+// wire: size of the PUBLISH packet, header and properties included.
+void sim_on_publish(const char* topic, const char* data, int len, int wire);
+void sim_on_lcd(const char* text);
+void sim_on_voice(const char* phrase);
+
+// Formats the virtual time as "d+hh:mm:ss.mmm".
+const char* sim_time_str(uint64_t t_us);
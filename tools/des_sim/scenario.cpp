@@ -0,0 +1,248 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEC_US   1000000ULL
+#define MIN_US   (60 * SEC_US)
+#define HOUR_US  (60 * MIN_US)
+#define DAY_US   (24 * HOUR_US)
+
+struct Rng {
+    uint64_t s;
+
+    uint64_t next()
+    {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [lo, hi].
+    int64_t range(int64_t lo, int64_t hi) { return lo + (int64_t)(unit() * (hi - lo + 1)); }
+
+    bool chance(double p) { return unit() < p; }
+};
+
+static void add(Scenario& sc, uint64_t t, ActKind kind, const std::string& a = "",
+                const std::string& b = "", uint32_t secs = 0, int cm = 0)
+{
+    sc.actions.push_back({ t, kind, a, b, secs, cm });
+}
+
+static void walk_bys(Scenario& sc, Rng& r, uint64_t from, uint64_t to)
+{
+    const double mean_gap_us = 12.0 * MIN_US;
+
+    uint64_t t = from + (uint64_t)(-log(1.0 - r.unit()) * mean_gap_us);
+    while (t < to) {
+        add(sc, t, ActKind::PRESENT, "", "", (uint32_t)r.range(3, 12), (int)r.range(60, 180));
+        t += (uint64_t)(-log(1.0 - r.unit()) * mean_gap_us);
+    }
+}
+
+Scenario scenario_generate(uint64_t seed, int days)
+{
+    Scenario sc;
+    Rng r{ seed };
+    int phone_id = 0;
+
+    for (int d = 0; d < days; d++) {
+        uint64_t day = d * DAY_US;
+        uint64_t wake = day + 6 * HOUR_US + 30 * MIN_US + r.range(-30, 45) * MIN_US;
+        uint64_t bed  = day + 23 * HOUR_US + r.range(-45, 45) * MIN_US;
+
+        bool away = false;
+        uint64_t leave = 0, ret = 0;
+
+        if (d % 7 < 5) {
+            away = true;
+            leave = day + 8 * HOUR_US + r.range(-20, 20) * MIN_US;
+            ret   = day + 17 * HOUR_US + 30 * MIN_US + r.range(-60, 60) * MIN_US;
+        } else if (r.chance(0.6)) {
+            away = true;
+            leave = day + 10 * HOUR_US + r.range(0, 240) * MIN_US;
+            ret   = leave + r.range(60, 300) * MIN_US;
+        }
+
+        add(sc, day + 12 * HOUR_US, ActKind::MQTT, "alarm/history/get", "min");
+
+        // Now and then the broker (or the uplink) goes away for a while.
+        if (r.chance(0.2)) {
+            add(sc, day + r.range(0, 24 * 60 - 1) * MIN_US, ActKind::OUTAGE, "", "",
+                (uint32_t)r.range(5, 180) * 60);
+        }
+
+        if (!away) {
+            walk_bys(sc, r, wake, bed);
+            continue;
+        }
+
+        walk_bys(sc, r, wake, leave - MIN_US);
+        walk_bys(sc, r, ret + MIN_US, bed);
+
+        // Leaving: arm at the panel and walk out during the exit delay, or
+        // forget and arm from the phone later.
+        uint64_t armed_at;
+        if (r.chance(0.9)) {
+            add(sc, leave, ActKind::KEYS, "A");
+            add(sc, leave + r.range(2, 6) * SEC_US, ActKind::PRESENT, "", "", (uint32_t)r.range(3, 5),
+                (int)r.range(80, 150));
+            armed_at = leave + 20 * SEC_US;
+        } else {
+            add(sc, leave, ActKind::PRESENT, "", "", 4, (int)r.range(80, 150));
+            armed_at = leave + r.range(10, 60) * MIN_US;
+            char msg[64];
+            snprintf(msg, sizeof(msg), "{\"cmd\":\"ARM\",\"id\":\"phone-%d\"}", ++phone_id);
+            add(sc, armed_at, ActKind::MQTT, "alarm/cmd", msg);
+            armed_at += 20 * SEC_US;
+        }
+
+        // The odd intrusion while nobody is home; the owner disarms from the
+        // phone after seeing the alarm.
+        if (r.chance(0.03) && ret > armed_at + 40 * MIN_US) {
+            uint64_t t = armed_at + 10 * MIN_US +
+                         (uint64_t)(r.unit() * (ret - armed_at - 30 * MIN_US));
+            add(sc, t, ActKind::PRESENT, "", "", (uint32_t)r.range(20, 60), (int)r.range(40, 200));
+            add(sc, t, ActKind::EXPECT_ALARM);
+
+            char msg[64];
+            snprintf(msg, sizeof(msg), "{\"cmd\":\"DISARM\",\"id\":\"phone-%d\"}", ++phone_id);
+            uint64_t off = t + r.range(120, 900) * SEC_US;
+            add(sc, off, ActKind::MQTT, "alarm/cmd", msg);
+            snprintf(msg, sizeof(msg), "{\"cmd\":\"ARM\",\"id\":\"phone-%d\"}", ++phone_id);
+            add(sc, off + r.range(60, 300) * SEC_US, ActKind::MQTT, "alarm/cmd", msg);
+        }
+
+        // Coming home: disarm from the phone on the way in, or walk in and
+        // sound the alarm, then enter the PIN (sometimes wrong first).
+        if (r.chance(0.75)) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "{\"cmd\":\"DISARM\",\"id\":\"phone-%d\"}", ++phone_id);
+            add(sc, ret - r.range(30, 300) * SEC_US, ActKind::MQTT, "alarm/cmd", msg);
+            add(sc, ret, ActKind::PRESENT, "", "", 5, (int)r.range(80, 150));
+        } else {
+            add(sc, ret, ActKind::PRESENT, "", "", 6, (int)r.range(80, 150));
+            add(sc, ret, ActKind::EXPECT_ALARM);
+
+            uint64_t t = ret + r.range(5, 15) * SEC_US;
+            if (r.chance(0.15)) {
+                add(sc, t, ActKind::KEYS, "0000#");
+                t += r.range(4, 10) * SEC_US;
+            }
+            add(sc, t, ActKind::KEYS, "1231#");
+        }
+    }
+
+    std::stable_sort(sc.actions.begin(), sc.actions.end(),
+                     [](const Action& x, const Action& y) { return x.t_us < y.t_us; });
+    return sc;
+}
+
+static bool parse_time(const char* s, uint64_t* out)
+{
+    unsigned d = 0, h = 0, m = 0;
+    double sec = 0;
+
+    if (sscanf(s, "%u+%u:%u:%lf", &d, &h, &m, &sec) == 4 && h < 24 && m < 60 && sec < 60) {
+        *out = d * DAY_US + h * HOUR_US + m * MIN_US + (uint64_t)llround(sec * 1e6);
+        return true;
+    }
+    char* end;
+    double v = strtod(s, &end);
+    if (*end || v < 0) return false;
+    *out = (uint64_t)llround(v * 1e6);
+    return true;
+}
+
+bool scenario_load(const char* path, Scenario* out)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char line[512];
+    int lineno = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char* hash = strchr(line, '#');
+        if (hash && (hash == line || hash[-1] == ' ' || hash[-1] == '\t')) *hash = '\0';
+
+        char when[32], kind[16];
+        int used = 0;
+        if (sscanf(line, "%31s %15s %n", when, kind, &used) < 2) continue;
+        const char* rest = line + used;
+
+        Action a = {};
+        if (!parse_time(when, &a.t_us)) {
+            ok = false;
+        } else if (strcmp(kind, "keys") == 0) {
+            char keys[64];
+            ok = sscanf(rest, "%63s", keys) == 1;
+            a.kind = ActKind::KEYS;
+            a.a = keys;
+        } else if (strcmp(kind, "present") == 0) {
+            ok = sscanf(rest, "%u %d", &a.secs, &a.cm) == 2;
+            a.kind = ActKind::PRESENT;
+        } else if (strcmp(kind, "mqtt") == 0) {
+            char topic[64];
+            int n = 0;
+            ok = sscanf(rest, "%63s %n", topic, &n) == 1;
+            a.kind = ActKind::MQTT;
+            a.a = topic;
+            a.b = rest + n;
+            while (!a.b.empty() && (a.b.back() == '\n' || a.b.back() == '\r' || a.b.back() == ' '))
+                a.b.pop_back();
+        } else if (strcmp(kind, "outage") == 0) {
+            ok = sscanf(rest, "%u", &a.secs) == 1;
+            a.kind = ActKind::OUTAGE;
+        } else if (strcmp(kind, "expect") == 0 && strncmp(rest, "alarm", 5) == 0) {
+            a.kind = ActKind::EXPECT_ALARM;
+        } else {
+            ok = false;
+        }
+
+        if (ok) out->actions.push_back(a);
+        else fprintf(stderr, "%s:%d: cannot parse: %s", path, lineno, line);
+    }
+    fclose(f);
+
+    std::stable_sort(out->actions.begin(), out->actions.end(),
+                     [](const Action& x, const Action& y) { return x.t_us < y.t_us; });
+    return ok;
+}
+
+void scenario_write(const Scenario& sc, FILE* f)
+{
+    for (const Action& a : sc.actions) {
+        uint64_t ms = a.t_us / 1000;
+        fprintf(f, "%llu+%02llu:%02llu:%02llu.%03llu ",
+                (unsigned long long)(ms / 86400000), (unsigned long long)(ms / 3600000 % 24),
+                (unsigned long long)(ms / 60000 % 60), (unsigned long long)(ms / 1000 % 60),
+                (unsigned long long)(ms % 1000));
+
+        switch (a.kind) {
+            case ActKind::KEYS:         fprintf(f, "keys %s\n", a.a.c_str()); break;
+            case ActKind::PRESENT:      fprintf(f, "present %u %d\n", a.secs, a.cm); break;
+            case ActKind::MQTT:         fprintf(f, "mqtt %s %s\n", a.a.c_str(), a.b.c_str()); break;
+            case ActKind::OUTAGE:       fprintf(f, "outage %u\n", a.secs); break;
+            case ActKind::EXPECT_ALARM: fprintf(f, "expect alarm\n"); break;
+        }
+    }
+}
+
+uint32_t scenario_expected_alarms(const Scenario& sc)
+{
+    uint32_t n = 0;
+    for (const Action& a : sc.actions) n += a.kind == ActKind::EXPECT_ALARM;
+    return n;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Scripted occupancy. A script is one action per line, in any order:
+//
+//   <day>+<hh:mm:ss[.mmm]> keys <keys>            keypad presses, one per poll
+//   <day>+<hh:mm:ss[.mmm]> present <s> <cm>       someone in the beam for s seconds
+//   <day>+<hh:mm:ss[.mmm]> mqtt <topic> <payload> message from the broker
+//   <day>+<hh:mm:ss[.mmm]> outage <s>             broker unreachable for s seconds
+//   <day>+<hh:mm:ss[.mmm]> expect alarm           the run should enter ALARM here
+//
+// '#' starts a comment. scenario_generate() writes the same actions for a
+// household routine (work days, weekends, forgotten disarms, the odd
+// intrusion, broker outages) from a seed.
+
+enum class ActKind : uint8_t {
+    KEYS,
+    PRESENT,
+    MQTT,
+    OUTAGE,
+    EXPECT_ALARM,
+};
+
+struct Action {
+    uint64_t    t_us;
+    ActKind     kind;
+    std::string a;          // keys, or topic
+    std::string b;          // payload
+    uint32_t    secs;
+    int         cm;
+};
+
+struct Scenario {
+    std::vector<Action> actions;        // sorted by time
+};
+
+Scenario scenario_generate(uint64_t seed, int days);
+
+// Returns false (and prints why) on a malformed line.
+bool scenario_load(const char* path, Scenario* out);
+
+void scenario_write(const Scenario& sc, FILE* f);
+
+uint32_t scenario_expected_alarms(const Scenario& sc);
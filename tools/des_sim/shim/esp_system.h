@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+// Heap figures for diagnostics. The simulator allocates nothing on behalf of
+// the firmware, so these are fixed.
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
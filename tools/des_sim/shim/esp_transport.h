@@ -0,0 +1,2 @@
+#pragma once
+typedef struct esp_transport_item_t* esp_transport_handle_t;
@@ -0,0 +1,133 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_transport.h"
+
+// Loopback MQTT client: publishes are recorded by des_sim, subscriptions are
+// accepted, and scripted messages arrive as MQTT_EVENT_DATA on the client's
+// own task. Publishing while disconnected fails, as with
+// CONFIG_MQTT_SKIP_PUBLISH_IF_DISCONNECTED; nothing is kept in flight.
+// Publish properties and topic aliases are honoured to the extent that
+// des_sim can count each PUBLISH packet's size on the wire.
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_PROTOCOL_UNDEFINED = 0,
+    MQTT_PROTOCOL_V_3_1,
+    MQTT_PROTOCOL_V_3_1_1,
+    MQTT_PROTOCOL_V_5,
+} esp_mqtt_protocol_ver_t;
+
+typedef struct {
+    uint8_t  payload_format_indicator;
+    char*    response_topic;
+    int      response_topic_len;
+    char*    correlation_data;
+    uint16_t correlation_data_len;
+    char*    content_type;
+    int      content_type_len;
+    int      subscribe_id;
+} esp_mqtt5_event_property_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef struct {
+    esp_mqtt_event_id_t      event_id;
+    esp_mqtt_client_handle_t client;
+    char*                    data;
+    int                      data_len;
+    int                      total_data_len;
+    int                      current_data_offset;
+    char*                    topic;
+    int                      topic_len;
+    int                      msg_id;
+    int                      session_present;
+    bool                     retain;
+    int                      qos;
+    bool                     dup;
+    esp_mqtt_protocol_ver_t  protocol_ver;
+    esp_mqtt5_event_property_t* property;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char* uri;
+            const char* hostname;
+            uint32_t    port;
+        } address;
+    } broker;
+    struct {
+        const char* username;
+        const char* client_id;
+        struct {
+            const char* password;
+        } authentication;
+    } credentials;
+    struct {
+        int  keepalive;
+        bool disable_clean_session;
+        esp_mqtt_protocol_ver_t protocol_ver;
+    } session;
+    struct {
+        esp_transport_handle_t transport;
+        bool disable_auto_reconnect;
+        int  reconnect_timeout_ms;
+        int  timeout_ms;
+    } network;
+    struct {
+        uint64_t limit;
+    } outbox;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void* arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic,
+                            const char* data, int len, int qos, int retain);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos);
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
+
+typedef struct mqtt5_user_property_list_t* mqtt5_user_property_handle_t;
+
+typedef struct {
+    const char* key;
+    const char* value;
+} esp_mqtt5_user_property_item_t;
+
+typedef struct {
+    bool        payload_format_indicator;
+    uint32_t    message_expiry_interval;
+    uint16_t    topic_alias;
+    const char* response_topic;
+    const char* correlation_data;
+    uint16_t    correlation_data_len;
+    const char* content_type;
+    mqtt5_user_property_handle_t user_property;
+} esp_mqtt5_publish_property_config_t;
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t client,
+                                                const esp_mqtt5_publish_property_config_t* property);
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t* user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num);
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property);
@@ -0,0 +1,5 @@
+#pragma once
+// Simulator build: the subset of the firmware's sdkconfig the sources read.
+#define CONFIG_FREERTOS_HZ        100
+#define CONFIG_LOG_DEFAULT_LEVEL  3
+#define CONFIG_MQTT_PROTOCOL_5    1
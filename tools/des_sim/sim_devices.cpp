@@ -0,0 +1,182 @@
+// Stand-ins for the peripheral drivers and network services, driven by the
+// scenario through g_world. Each keeps the blocking behaviour of the real
+// driver where it shapes task timing (the ultrasonic ping loop sleeps like
+// the real one does).
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "alloc_guard.h"
+#include "connectivity.h"
+#include "keypad.h"
+#include "lan_control.h"
+#include "lcd.h"
+#include "led.h"
+#include "mqtt_tls.h"
+#include "ota.h"
+#include "range_filter.h"
+#include "speaker.h"
+#include "ui_flow.h"
+#include "ultrasonic.h"
+#include "voice.h"
+
+#include "des_sim.h"
+#include "sim_rtos.h"
+
+#define NUM_SAMPLES  5
+
+SimWorld g_world;
+
+static uint64_t s_noise_state;
+
+void sim_noise_seed(uint64_t seed)
+{
+    s_noise_state = seed;
+}
+
+// splitmix64
+uint32_t sim_noise(uint32_t below)
+{
+    uint64_t z = (s_noise_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return below ? (uint32_t)(z % below) : 0;
+}
+
+// --- ultrasonic ----------------------------------------------------------
+
+static RangeFilter s_filter;
+
+void ultrasonic_init()
+{
+    range_filter_init(&s_filter);
+}
+
+static int ping_cm()
+{
+    if (sim_noise(1000) < g_world.miss_permille) return -1;
+
+    int cm = sim_now_us() < g_world.present_until_us ? g_world.present_cm : g_world.wall_cm;
+    cm += (int)sim_noise(5) - 2;
+    return cm < RANGE_MIN_CM || cm > RANGE_MAX_CM ? -1 : cm;
+}
+
+int ultrasonic_get_distance_cm()
+{
+    int samples[NUM_SAMPLES];
+
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        samples[i] = ping_cm();
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    int avg;
+    return range_filter_apply(&s_filter, samples, NUM_SAMPLES, &avg);
+}
+
+// --- keypad --------------------------------------------------------------
+
+static char s_pin[UI_PIN_LEN + 1] = "1231";
+
+void keypad_init() {}
+
+char keypad_get_key_nonblocking()
+{
+    if (g_world.keys.empty()) return 0;
+
+    char k = g_world.keys.front();
+    g_world.keys.pop_front();
+    return k;
+}
+
+bool keypad_check_pin(const char* entered)
+{
+    return ui_pin_equal(entered, s_pin);
+}
+
+void keypad_set_pin(const char* pin)
+{
+    snprintf(s_pin, sizeof(s_pin), "%s", pin);
+}
+
+// --- LCD -----------------------------------------------------------------
+
+void lcd_init() {}
+void lcd_clear() {}
+void lcd_set_cursor(int, int) {}
+void lcd_write_char(char) {}
+void lcd_write_string(const char*) {}
+
+void lcd_show_message(const char* msg)
+{
+    g_world.lcd_messages++;
+    snprintf(g_world.lcd_text, sizeof(g_world.lcd_text), "%s", msg);
+    sim_on_lcd(msg);
+}
+
+void lcd_show_countdown(int) {}
+
+// --- speaker and LEDs ----------------------------------------------------
+
+void speaker_init() {}
+void speaker_update() {}
+
+void speaker_set_alarm(bool on)
+{
+    if (on == g_world.siren) return;
+
+    g_world.siren = on;
+    if (on) g_world.siren_since_us = sim_now_us();
+    else    g_world.siren_us += sim_now_us() - g_world.siren_since_us;
+}
+
+void speaker_beep_once(int)
+{
+    g_world.beeps++;
+}
+
+void voice_init() {}
+bool voice_ready() { return true; }
+void voice_stop() {}
+
+bool voice_say(const char* phrase)
+{
+    g_world.voice_phrases++;
+    sim_on_voice(phrase);
+    return true;
+}
+
+void led_init() {}
+void led_set_disarmed()             { g_world.led_changes++; }
+void led_set_armed()                { g_world.led_changes++; }
+void led_set_alarm()                { g_world.led_changes++; }
+void led_set_exit_delay_level(int)  { g_world.led_changes++; }
+
+// --- network services ----------------------------------------------------
+
+void conn_init() {}
+void conn_attach_mqtt(esp_mqtt_client_handle_t, const esp_mqtt_client_config_t&,
+                      const BrokerSpec*, uint8_t) {}
+void conn_note_publish(int) {}
+bool conn_wifi_up()  { return true; }
+bool conn_mqtt_up()  { return g_world.mqtt_connected; }
+ConnStats conn_get_stats() { return {}; }
+void conn_log_stats() {}
+
+esp_transport_handle_t mqtt_tls_transport_create(const char*) { return nullptr; }
+MqttTlsStats mqtt_tls_get_stats() { return {}; }
+void mqtt_tls_log_stats() {}
+
+void lan_control_init() {}
+void lan_control_notify_state(uint8_t, const AlarmEvent*) {}
+
+void ota_init(OtaReportCb) {}
+bool ota_request(const char*, int) { return false; }
+
+void alloc_guard_arm() {}
+uint32_t alloc_guard_count() { return 0; }
+void alloc_guard_report() {}
@@ -0,0 +1,335 @@
+// ESP-IDF services the firmware calls directly: logging, NVS, heap figures
+// and the MQTT client.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "des_sim.h"
+#include "sim_rtos.h"
+
+#define MQTT_CONNECT_MS   4000        // Wi-Fi + TLS after boot
+#define MQTT_INBOX_LEN    16
+#define MQTT_TASK_PRIO    5           // esp-mqtt default
+#define SIM_FREE_HEAP     (160 * 1024)
+#define MQTT_ALIAS_MAX    10          // assumed broker Topic Alias Maximum, see below
+
+uint32_t g_log_counts[ESP_LOG_VERBOSE + 1];
+
+void sim_log(esp_log_level_t level, const char* tag, const char* fmt, ...)
+{
+    g_log_counts[level]++;
+    if ((int)level > g_verbosity) return;
+
+    static const char LETTERS[] = "NEWIDV";
+    printf("%s %c %s: ", sim_time_str(sim_now_us()), LETTERS[level], tag);
+
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    putchar('\n');
+}
+
+// --- NVS -----------------------------------------------------------------
+
+static std::vector<std::string> s_nvs_handles;
+static std::map<std::string, std::vector<uint8_t>> s_nvs;
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* ns, nvs_open_mode_t, nvs_handle_t* out)
+{
+    s_nvs_handles.push_back(ns);
+    *out = s_nvs_handles.size();
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t) {}
+
+esp_err_t nvs_commit(nvs_handle_t)
+{
+    return ESP_OK;
+}
+
+static std::string nvs_key(nvs_handle_t h, const char* key)
+{
+    return s_nvs_handles[h - 1] + "/" + key;
+}
+
+static esp_err_t nvs_get(nvs_handle_t h, const char* key, void* out, size_t* len)
+{
+    auto it = s_nvs.find(nvs_key(h, key));
+    if (it == s_nvs.end()) return ESP_ERR_NVS_NOT_FOUND;
+
+    if (out) {
+        if (*len < it->second.size()) return ESP_ERR_INVALID_SIZE;
+        memcpy(out, it->second.data(), it->second.size());
+    }
+    *len = it->second.size();
+    return ESP_OK;
+}
+
+static esp_err_t nvs_set(nvs_handle_t h, const char* key, const void* value, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)value;
+    s_nvs[nvs_key(h, key)].assign(p, p + len);
+    g_world.nvs_writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char* key, char* out, size_t* len)
+{
+    return nvs_get(h, key, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char* key, const char* value)
+{
+    return nvs_set(h, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char* key, void* out, size_t* len)
+{
+    return nvs_get(h, key, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char* key, const void* value, size_t len)
+{
+    return nvs_set(h, key, value, len);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char* key, uint32_t* out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get(h, key, out, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char* key, uint32_t value)
+{
+    return nvs_set(h, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char* key)
+{
+    return s_nvs.erase(nvs_key(h, key)) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+// --- MQTT loopback -------------------------------------------------------
+
+struct InboxMsg {
+    esp_mqtt_event_id_t id;
+    char                topic[64];
+    char                data[256];
+    int                 len;
+};
+
+struct mqtt5_user_property_list_t {
+    std::vector<std::pair<std::string, std::string>> items;
+};
+
+struct esp_mqtt_client {
+    esp_event_handler_t handler;
+    void*               handler_arg;
+    QueueHandle_t       inbox;
+    esp_timer_handle_t  connect_timer;
+    int                 next_msg_id;
+    esp_mqtt_protocol_ver_t protocol;
+    esp_mqtt5_publish_property_config_t pub_prop;     // as last set
+    std::map<uint16_t, std::string> aliases;          // this connection's
+};
+
+static esp_mqtt_client s_client;
+
+static void mqtt_loopback_task(void*)
+{
+    InboxMsg m;
+
+    while (true)
+    {
+        xQueueReceive(s_client.inbox, &m, portMAX_DELAY);
+
+        esp_mqtt_event_t ev = {};
+        ev.event_id = m.id;
+        ev.client = &s_client;
+        ev.topic = m.topic;
+        ev.topic_len = strlen(m.topic);
+        ev.data = m.data;
+        ev.data_len = m.len;
+        ev.total_data_len = m.len;
+        ev.protocol_ver = s_client.protocol;
+
+        esp_mqtt5_event_property_t prop = {};
+        if (s_client.protocol == MQTT_PROTOCOL_V_5) ev.property = &prop;
+
+        if (m.id == MQTT_EVENT_CONNECTED) {
+            g_world.mqtt_connected = true;
+            g_world.mqtt_connects++;
+            s_client.aliases.clear();
+        }
+        if (s_client.handler) s_client.handler(s_client.handler_arg, "MQTT_EVENTS", m.id, &ev);
+    }
+}
+
+static void connect_cb(void*)
+{
+    InboxMsg m = {};
+    m.id = MQTT_EVENT_CONNECTED;
+    xQueueSend(s_client.inbox, &m, 0);
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config)
+{
+    s_client.protocol = config->session.protocol_ver == MQTT_PROTOCOL_V_5
+                            ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1;
+    g_world.mqtt_v5 = s_client.protocol == MQTT_PROTOCOL_V_5;
+    s_client.inbox = xQueueCreate(MQTT_INBOX_LEN, sizeof(InboxMsg));
+    s_client.next_msg_id = 1;
+    xTaskCreate(mqtt_loopback_task, "mqtt_client", 6144, nullptr, MQTT_TASK_PRIO, nullptr);
+
+    esp_timer_create_args_t args = {};
+    args.callback = connect_cb;
+    args.name = "mqtt_connect";
+    esp_timer_create(&args, &s_client.connect_timer);
+    esp_timer_start_once(s_client.connect_timer, MQTT_CONNECT_MS * 1000ULL);
+
+    return &s_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t c, esp_mqtt_event_id_t,
+                                         esp_event_handler_t handler, void* arg)
+{
+    c->handler = handler;
+    c->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t)      { return ESP_OK; }
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t)       { return ESP_OK; }
+esp_err_t esp_mqtt_client_reconnect(esp_mqtt_client_handle_t)  { return ESP_OK; }
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t) { return ESP_OK; }
+
+static int varint_len(uint32_t n)
+{
+    return n < 128 ? 1 : n < 16384 ? 2 : n < 2097152 ? 3 : 4;
+}
+
+// PUBLISH properties as MQTT 5.0 section 3.3.2.3 encodes them.
+static int publish_props_len(const esp_mqtt5_publish_property_config_t& p)
+{
+    int n = 0;
+    if (p.payload_format_indicator) n += 2;
+    if (p.message_expiry_interval) n += 5;
+    if (p.topic_alias) n += 3;
+    if (p.response_topic) n += 3 + strlen(p.response_topic);
+    if (p.correlation_data) n += 3 + p.correlation_data_len;
+    if (p.content_type) n += 3 + strlen(p.content_type);
+    if (p.user_property) {
+        for (const auto& [k, v] : p.user_property->items) n += 1 + 2 + k.size() + 2 + v.size();
+    }
+    return n;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t c, const char* topic,
+                            const char* data, int len, int qos, int)
+{
+    if (!g_world.mqtt_connected) return -1;
+    if (len == 0) len = strlen(data);
+
+    // Fixed header, topic, packet id, then properties on MQTT 5. A topic
+    // alias already bound to this topic on the connection goes without it.
+    // This is a model of the encoding only: the alias limit is the assumed
+    // MQTT_ALIAS_MAX (Mosquitto's documented default), not a value a broker
+    // sent in CONNACK, and nothing here has been compared with real traffic.
+    int topic_len = strlen(topic);
+    int rest = (qos ? 2 : 0) + len;
+    if (c->protocol == MQTT_PROTOCOL_V_5) {
+        const esp_mqtt5_publish_property_config_t& p = c->pub_prop;
+        if (p.topic_alias > MQTT_ALIAS_MAX) return -1;
+        if (p.topic_alias) {
+            std::string& bound = c->aliases[p.topic_alias];
+            if (bound == topic) topic_len = 0;
+            else bound = topic;
+        }
+        int props = publish_props_len(p);
+        rest += varint_len(props) + props;
+    }
+    rest += 2 + topic_len;
+
+    sim_on_publish(topic, data, len, 1 + varint_len(rest) + rest);
+    return qos ? c->next_msg_id++ : 0;
+}
+
+esp_err_t esp_mqtt5_client_set_publish_property(esp_mqtt_client_handle_t c,
+                                                const esp_mqtt5_publish_property_config_t* property)
+{
+    c->pub_prop = *property;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt5_client_set_user_property(mqtt5_user_property_handle_t* user_property,
+                                             esp_mqtt5_user_property_item_t item[], uint8_t item_num)
+{
+    if (!*user_property) *user_property = new mqtt5_user_property_list_t;
+    for (uint8_t i = 0; i < item_num; i++) (*user_property)->items.emplace_back(item[i].key, item[i].value);
+    return ESP_OK;
+}
+
+void esp_mqtt5_client_delete_user_property(mqtt5_user_property_handle_t user_property)
+{
+    delete user_property;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t c, const char*, int)
+{
+    return c->next_msg_id++;
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t) { return 0; }
+
+// The connection drops at once; the reconnect is due secs from now, or
+// secs after the later of two overlapping outages.
+void sim_mqtt_outage(uint32_t secs)
+{
+    if (g_world.mqtt_connected) {
+        g_world.mqtt_connected = false;
+        g_world.mqtt_outages++;
+
+        InboxMsg m = {};
+        m.id = MQTT_EVENT_DISCONNECTED;
+        xQueueSend(s_client.inbox, &m, 0);
+    }
+    esp_timer_stop(s_client.connect_timer);
+    esp_timer_start_once(s_client.connect_timer, secs * 1000000ULL);
+}
+
+uint32_t esp_get_free_heap_size(void)         { return SIM_FREE_HEAP; }
+uint32_t esp_get_minimum_free_heap_size(void) { return SIM_FREE_HEAP; }
+
+void sim_mqtt_inject(const char* topic, const char* data)
+{
+    InboxMsg m = {};
+    m.id = MQTT_EVENT_DATA;
+    snprintf(m.topic, sizeof(m.topic), "%s", topic);
+    m.len = snprintf(m.data, sizeof(m.data), "%s", data);
+    if (m.len >= (int)sizeof(m.data)) m.len = sizeof(m.data) - 1;
+
+    if (!g_world.mqtt_connected || !xQueueSend(s_client.inbox, &m, 0)) {
+        sim_log(ESP_LOG_WARN, "SIM", "MQTT message on %s lost (not connected or inbox full)", topic);
+    }
+}
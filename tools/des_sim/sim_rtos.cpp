@@ -0,0 +1,560 @@
+#include "sim_rtos.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <vector>
+
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+#define SIM_STACK_BYTES  (256 * 1024)
+#define NEVER            UINT64_MAX
+
+// Context switching. swapcontext() makes a sigprocmask system call on every
+// switch, which was most of the run time; on x86-64 Linux only the
+// callee-saved registers are swapped. Other hosts fall back to ucontext.
+#if defined(__x86_64__) && defined(__linux__)
+
+#define SIM_FAST_SWITCH 1
+
+struct Fiber {
+    void* sp;
+};
+
+extern "C" void sim_fiber_switch(void** save_sp, void* load_sp);
+
+asm(R"(
+    .text
+    .globl sim_fiber_switch
+    .type sim_fiber_switch, @function
+sim_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size sim_fiber_switch, .-sim_fiber_switch
+)");
+
+static void fiber_init(Fiber* f, void* stack, size_t size, void (*entry)())
+{
+    // Six zeroed registers, then entry as the return address; entry starts
+    // with the stack misaligned by 8, as after a call.
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+    void** sp = (void**)(top - 8 * sizeof(void*));
+    memset(sp, 0, 8 * sizeof(void*));
+    sp[6] = (void*)entry;
+    f->sp = sp;
+}
+
+static void fiber_switch(Fiber* from, Fiber* to)
+{
+    sim_fiber_switch(&from->sp, to->sp);
+}
+
+#else
+
+struct Fiber {
+    ucontext_t ctx;
+};
+
+static void fiber_init(Fiber* f, void* stack, size_t size, void (*entry)())
+{
+    getcontext(&f->ctx);
+    f->ctx.uc_stack.ss_sp = stack;
+    f->ctx.uc_stack.ss_size = size;
+    f->ctx.uc_link = nullptr;
+    makecontext(&f->ctx, entry, 0);
+}
+
+static void fiber_switch(Fiber* from, Fiber* to)
+{
+    swapcontext(&from->ctx, &to->ctx);
+}
+
+#endif
+
+struct WaitList {
+    std::vector<SimTask*> tasks;        // in arrival order
+};
+
+enum class TaskState : uint8_t { READY, RUNNING, BLOCKED, DEAD };
+
+struct SimTask {
+    Fiber          ctx;
+    char           name[16];
+    UBaseType_t    prio;
+    TaskFunction_t fn;
+    void*          arg;
+    TaskState      state;
+    uint64_t       ready_seq;
+    uint64_t       wake_us;
+    WaitList*      waiting_on;
+    bool           timed_out;
+    void*          stack;
+};
+
+struct SimQueue {
+    size_t               item_size;
+    uint32_t             len;
+    uint32_t             count;
+    uint32_t             head;
+    std::vector<uint8_t> buf;
+    WaitList             rx_wait;
+    WaitList             tx_wait;
+};
+
+struct SimTimer {
+    esp_timer_cb_t cb;
+    void*          arg;
+    uint64_t       period_us;
+    uint64_t       next_us;
+    bool           active;
+};
+
+static std::vector<SimTask*>  s_tasks;
+static std::vector<SimTimer*> s_timers;
+static SimTask*   s_current = nullptr;
+static Fiber      s_sched_ctx;
+static uint64_t   s_now_us = 0;
+static uint64_t   s_seq = 0;
+static SimKernelStats s_stats;
+
+static const char*   s_tap_name = nullptr;
+static QueueHandle_t s_tap_queue = nullptr;
+static SimQueueTap   s_tap = nullptr;
+
+// --- scheduling core -----------------------------------------------------
+
+static void make_ready(SimTask* t)
+{
+    if (t->waiting_on) {
+        auto& v = t->waiting_on->tasks;
+        for (size_t i = 0; i < v.size(); i++) {
+            if (v[i] == t) { v.erase(v.begin() + i); break; }
+        }
+        t->waiting_on = nullptr;
+    }
+    t->state = TaskState::READY;
+    t->ready_seq = ++s_seq;
+    t->wake_us = NEVER;
+}
+
+static void to_scheduler()
+{
+    fiber_switch(&s_current->ctx, &s_sched_ctx);
+}
+
+static void yield_current()
+{
+    s_current->state = TaskState::READY;
+    s_current->ready_seq = ++s_seq;
+    to_scheduler();
+}
+
+static void preempt_if(const SimTask* woken)
+{
+    if (s_current && woken->prio > s_current->prio) yield_current();
+}
+
+// Returns false on timeout.
+static bool block_until(uint64_t wake_us, WaitList* wl)
+{
+    if (!s_current) sim_fatal("blocking call outside a task (esp_timer callback?)");
+
+    SimTask* t = s_current;
+    t->state = TaskState::BLOCKED;
+    t->wake_us = wake_us;
+    t->timed_out = false;
+    t->waiting_on = wl;
+    if (wl) wl->tasks.push_back(t);
+
+    to_scheduler();
+    return !t->timed_out;
+}
+
+static uint64_t deadline_for(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return NEVER;
+    return (s_now_us / SIM_TICK_US + ticks) * SIM_TICK_US;
+}
+
+static void wake_one(WaitList& wl)
+{
+    if (wl.tasks.empty()) return;
+
+    SimTask* best = wl.tasks[0];
+    for (SimTask* t : wl.tasks) if (t->prio > best->prio) best = t;
+
+    make_ready(best);
+    preempt_if(best);
+}
+
+static void task_entry()
+{
+    SimTask* t = s_current;
+    t->fn(t->arg);
+    t->state = TaskState::DEAD;         // returning from a task is fatal on the device
+    to_scheduler();
+}
+
+static void fire_timers()
+{
+    while (true) {
+        SimTimer* due = nullptr;
+        for (SimTimer* tm : s_timers) {
+            if (tm->active && tm->next_us <= s_now_us && (!due || tm->next_us < due->next_us))
+                due = tm;
+        }
+        if (!due) return;
+
+        if (due->period_us) due->next_us += due->period_us;
+        else due->active = false;
+
+        s_stats.timer_fires++;
+        due->cb(due->arg);
+    }
+}
+
+void sim_run(uint64_t end_us)
+{
+    while (true) {
+        SimTask* best = nullptr;
+        for (SimTask* t : s_tasks) {
+            if (t->state != TaskState::READY) continue;
+            if (!best || t->prio > best->prio ||
+                (t->prio == best->prio && t->ready_seq < best->ready_seq))
+                best = t;
+        }
+
+        if (best) {
+            s_current = best;
+            best->state = TaskState::RUNNING;
+            s_stats.switches++;
+            fiber_switch(&s_sched_ctx, &best->ctx);
+            s_current = nullptr;
+            continue;
+        }
+
+        uint64_t next = NEVER;
+        for (SimTask* t : s_tasks)
+            if (t->state == TaskState::BLOCKED && t->wake_us < next) next = t->wake_us;
+        for (SimTimer* tm : s_timers)
+            if (tm->active && tm->next_us < next) next = tm->next_us;
+
+        if (next > end_us) {
+            s_now_us = end_us;
+            return;
+        }
+
+        s_now_us = next;
+        fire_timers();
+
+        for (SimTask* t : s_tasks) {
+            if (t->state == TaskState::BLOCKED && t->wake_us <= s_now_us) {
+                t->timed_out = true;
+                make_ready(t);
+            }
+        }
+    }
+}
+
+uint64_t sim_now_us()
+{
+    return s_now_us;
+}
+
+void sim_sleep_until(uint64_t t_us)
+{
+    if (t_us > s_now_us) block_until(t_us, nullptr);
+}
+
+void sim_set_queue_tap(const char* name, SimQueueTap tap)
+{
+    s_tap_name = name;
+    s_tap = tap;
+}
+
+SimKernelStats sim_kernel_stats()
+{
+    SimKernelStats st = s_stats;
+    st.tasks = s_tasks.size();
+    return st;
+}
+
+// --- tasks ---------------------------------------------------------------
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack,
+                       void* arg, UBaseType_t prio, TaskHandle_t* out)
+{
+    SimTask* t = new SimTask();
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->prio = prio;
+    t->fn = fn;
+    t->arg = arg;
+    t->stack = malloc(SIM_STACK_BYTES);
+
+    fiber_init(&t->ctx, t->stack, SIM_STACK_BYTES, task_entry);
+
+    s_tasks.push_back(t);
+    make_ready(t);
+    if (out) *out = t;
+
+    preempt_if(t);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                   void* arg, UBaseType_t prio, TaskHandle_t* out,
+                                   BaseType_t)
+{
+    return xTaskCreate(fn, name, stack, arg, prio, out);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name,
+                                           uint32_t stack, void* arg, UBaseType_t prio,
+                                           StackType_t*, StaticTask_t*, BaseType_t)
+{
+    TaskHandle_t h = nullptr;
+    xTaskCreate(fn, name, stack, arg, prio, &h);
+    return h;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) yield_current();
+    else block_until(deadline_for(ticks), nullptr);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    SimTask* t = task ? task : s_current;
+    if (t->waiting_on) make_ready(t);
+    t->state = TaskState::DEAD;
+    if (t == s_current) to_scheduler();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(s_now_us / SIM_TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+    SimTask* t = task ? task : s_current;
+    return t ? t->name : "esp_timer";
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t)
+{
+    return SIM_STACK_BYTES;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+// --- queues and semaphores -----------------------------------------------
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    SimQueue* q = new SimQueue();
+    q->item_size = item_size;
+    q->len = len;
+    q->buf.resize((size_t)len * item_size);
+    return q;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t len, UBaseType_t item_size,
+                                 uint8_t*, StaticQueue_t*)
+{
+    return xQueueCreate(len, item_size);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks)
+{
+    uint64_t wake = deadline_for(ticks);
+
+    while (q->count == q->len) {
+        if (ticks == 0 || !block_until(wake, &q->tx_wait)) return pdFALSE;
+    }
+
+    if (q->item_size) {
+        uint32_t tail = (q->head + q->count) % q->len;
+        memcpy(&q->buf[(size_t)tail * q->item_size], item, q->item_size);
+        if (s_tap && q == s_tap_queue) s_tap(q, item);
+    }
+    q->count++;
+
+    wake_one(q->rx_wait);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken)
+{
+    if (woken) *woken = pdFALSE;
+    return xQueueSend(q, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks)
+{
+    uint64_t wake = deadline_for(ticks);
+
+    while (q->count == 0) {
+        if (ticks == 0 || !block_until(wake, &q->rx_wait)) return pdFALSE;
+    }
+
+    if (q->item_size) {
+        memcpy(item, &q->buf[(size_t)q->head * q->item_size], q->item_size);
+        q->head = (q->head + 1) % q->len;
+    }
+    q->count--;
+
+    wake_one(q->tx_wait);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q->count;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (q == s_tap_queue) s_tap_queue = nullptr;
+    delete q;
+}
+
+void vQueueAddToRegistry(QueueHandle_t q, const char* name)
+{
+    if (s_tap_name && strcmp(name, s_tap_name) == 0) s_tap_queue = q;
+}
+
+// A semaphore is a queue of zero-size items; a mutex starts out given. No
+// priority inheritance: tasks never hold a mutex across a blocking call in
+// this firmware, so zero-time execution cannot invert priorities.
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SimQueue* q = (SimQueue*)xQueueCreate(max, 0);
+    q->count = initial;
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max, UBaseType_t initial,
+                                                 StaticSemaphore_t*)
+{
+    return xSemaphoreCreateCounting(max, initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)         { return xSemaphoreCreateCounting(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t*) { return xSemaphoreCreateMutex(); }
+SemaphoreHandle_t xSemaphoreCreateBinary(void)        { return xSemaphoreCreateCounting(1, 0); }
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t*) { return xSemaphoreCreateBinary(); }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, nullptr, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, nullptr, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* woken)
+{
+    if (woken) *woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+// --- esp_timer -----------------------------------------------------------
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out)
+{
+    SimTimer* tm = new SimTimer();
+    tm->cb = args->callback;
+    tm->arg = args->arg;
+    s_timers.push_back(tm);
+    *out = tm;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t tm, uint64_t timeout_us)
+{
+    if (tm->active) return ESP_ERR_INVALID_STATE;
+    tm->period_us = 0;
+    tm->next_us = s_now_us + timeout_us;
+    tm->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t tm, uint64_t period_us)
+{
+    if (tm->active) return ESP_ERR_INVALID_STATE;
+    tm->period_us = period_us;
+    tm->next_us = s_now_us + period_us;
+    tm->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t tm)
+{
+    if (!tm->active) return ESP_ERR_INVALID_STATE;
+    tm->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t tm)
+{
+    tm->active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t tm)
+{
+    return tm->active;
+}
+
+// --- task watchdog -------------------------------------------------------
+
+esp_err_t esp_task_wdt_add(TaskHandle_t)    { return ESP_OK; }
+esp_err_t esp_task_wdt_delete(TaskHandle_t) { return ESP_OK; }
+esp_err_t esp_task_wdt_reset(void)          { return ESP_OK; }
+
+// --- errors --------------------------------------------------------------
+
+void sim_fatal(const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "des_sim: fatal at %.3f s: ", s_now_us / 1e6);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    exit(2);
+}
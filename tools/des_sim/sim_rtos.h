@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// Discrete-event kernel behind the FreeRTOS and esp_timer shims.
+//
+// Every task is a fiber with its own stack. The scheduler always resumes the
+// highest-priority ready task (FIFO within a priority) and lets it run until
+// it blocks; running code takes no virtual time. When nothing is ready the
+// clock jumps straight to the next timeout or esp_timer expiry. A task that
+// readies a higher-priority one is preempted on the spot, as on one core.
+// Nothing depends on the host clock or thread timing, so a run is a pure
+// function of its inputs.
+
+#define SIM_TICK_US  (1000000 / configTICK_RATE_HZ)
+
+struct SimKernelStats {
+    uint64_t switches;          // task resumptions
+    uint64_t timer_fires;       // esp_timer callbacks
+    uint32_t tasks;
+};
+
+uint64_t sim_now_us();
+
+// Blocks the calling task until the virtual clock reaches t_us (not tick
+// aligned, for the scenario driver).
+void sim_sleep_until(uint64_t t_us);
+
+// Runs tasks and timers until the virtual clock reaches end_us.
+void sim_run(uint64_t end_us);
+
+// Called with every item sent on the queue the firmware registers under
+// name with vQueueAddToRegistry(). Set it before the queue is created.
+typedef void (*SimQueueTap)(QueueHandle_t q, const void* item);
+void sim_set_queue_tap(const char* name, SimQueueTap tap);
+
+SimKernelStats sim_kernel_stats();
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Decode DLOG_MODE_BINARY records from a serial capture (see src/dlog.h).
+
+    pio device monitor | tools/dlog_decode.py .pio/build/nodemcu-32s/firmware.elf
+    tools/dlog_decode.py firmware.elf capture.log
+
+Lines of the form "DL:<hex>" are replaced with "I (ms) TAG: message", format
+and tag strings being looked up by address in the ELF the device runs;
+every other line passes through untouched. The ELF must match the flashed
+image exactly, otherwise the addresses point at the wrong strings.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LEVELS = "?EWID"
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsfeEgGp%])")
+
+
+class Elf32:
+    """Just enough ELF32 to read bytes at a virtual address."""
+
+    def __init__(self, path):
+        self.data = open(path, "rb").read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            sys.exit(f"{path}: not an ELF32 file")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            (_, sh_type, _, addr, offset, size) = struct.unpack_from(
+                "<IIIIII", self.data, shoff + i * shentsize)
+            if sh_type != 8 and addr and size:      # skip SHT_NOBITS
+                self.sections.append((addr, offset, size))
+
+    def string(self, addr):
+        for base, offset, size in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.index(b"\0", start, offset + size)
+                return self.data[start:end].decode("utf-8", "replace")
+        return None
+
+
+def format_record(elf, fmt, words):
+    out = []
+    pos = 0
+    wi = 0
+
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, length, conv = m.groups()
+
+        if conv == "%":
+            out.append("%")
+            continue
+
+        wide = conv in "feEgG" or length in ("ll", "j")
+        need = 2 if wide else 1
+        if wi + need > len(words):
+            out.append("<?>")
+            break
+        raw = words[wi] | (words[wi + 1] << 32 if wide else 0)
+        wi += need
+
+        spec = "%" + flags + width + ("." + prec if prec is not None else "")
+        if conv in "di":
+            bits = 64 if wide else 32
+            val = raw - (1 << bits) if raw >> (bits - 1) else raw
+            out.append((spec + "d") % val)
+        elif conv in "uoxX":
+            out.append((spec + ("d" if conv == "u" else conv)) % raw)
+        elif conv == "c":
+            out.append((spec + "c") % chr(raw & 0xFF))
+        elif conv == "s":
+            s = elf.string(raw)
+            out.append((spec + "s") % (s if s is not None else f"<0x{raw:08x}>"))
+        elif conv == "p":
+            out.append(f"0x{raw:x}")
+        else:
+            out.append((spec + conv) % struct.unpack("<d", struct.pack("<Q", raw))[0])
+
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(elf, hexstr):
+    rec = bytes.fromhex(hexstr)
+    ms, tag, fmt, level, nwords = struct.unpack_from("<IIIBB", rec)
+    words = list(struct.unpack_from(f"<{nwords}I", rec, 14))
+
+    tag_s = elf.string(tag) or f"<0x{tag:08x}>"
+    fmt_s = elf.string(fmt)
+    msg = format_record(elf, fmt_s, words) if fmt_s is not None else f"<fmt 0x{fmt:08x}> {words}"
+    return f"{LEVELS[level] if level < len(LEVELS) else '?'} ({ms}) {tag_s}: {msg}"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf")
+    ap.add_argument("log", nargs="?", help="capture file (default: stdin)")
+    args = ap.parse_args()
+
+    elf = Elf32(args.elf)
+    src = open(args.log, errors="replace") if args.log else sys.stdin
+
+    for line in src:
+        i = line.find("DL:")
+        if i < 0:
+            sys.stdout.write(line)
+            continue
+        try:
+            print(line[:i] + decode(elf, line[i + 3:].strip()))
+        except (ValueError, struct.error):
+            sys.stdout.write(line)
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
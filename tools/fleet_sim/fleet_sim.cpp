@@ -0,0 +1,505 @@
+// Fleet simulator: thousands of virtual HomeGuard devices against one broker.
+//
+// Every device runs the firmware's own alarm state machine (src/alarm_fsm.cpp),
+// motion baseline (src/baseline.cpp), command de-duplication
+// (src/remote_dedup.cpp) and payload codecs (src/telemetry.cpp) behind its
+// own MQTT connection, publishes telemetry like mqtt_task does (periodic
+// and state changes alike on alarm/telemetry at QoS 1), and answers commands
+// with acks.
+// Keypad and sensor activity is scripted from a per-device PRNG so a run is
+// reproducible for a given --seed. A controller connection fires correlated
+// commands at random devices and measures the round trip.
+//
+//   cmake -S tools/fleet_sim -B build/fleet_sim && cmake --build build/fleet_sim
+//   build/fleet_sim/fleet_sim --host 127.0.0.1 --devices 2000 --duration 120
+//
+// Raise the fd limit (ulimit -n) above --devices first.
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "alarm_fsm.h"
+#include "baseline.h"
+#include "remote_dedup.h"
+#include "telemetry.h"
+#include "mqtt_lite.h"
+
+#define TELEMETRY_PERIOD_MS   2000     // mqtt_task period
+#define KEEPALIVE_S           60
+#define REPORT_PERIOD_MS      5000
+#define SENSOR_IDLE_CM        250
+#define SENSOR_INTRUDER_CM    40
+#define SENSOR_NOISE_CM       40       // idle readings spread below SENSOR_IDLE_CM
+
+struct Options {
+    const char* host = "127.0.0.1";
+    int port = 1883;
+    const char* user = nullptr;
+    const char* pass = nullptr;
+    int devices = 1000;
+    int ramp_per_s = 500;
+    int duration_s = 60;
+    double cmd_rate = 20.0;            // controller commands per second
+    uint32_t seed = 1;
+};
+
+static uint64_t now_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t xorshift(uint32_t* s)
+{
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static uint32_t rand_between(uint32_t* s, uint32_t lo, uint32_t hi)
+{
+    return lo + xorshift(s) % (hi - lo + 1);
+}
+
+struct Counters {
+    uint64_t published = 0;
+    uint64_t bytes = 0;
+    uint64_t commands = 0;
+    uint64_t acks = 0;
+    uint64_t transitions = 0;
+    uint64_t disconnects = 0;
+};
+
+static Counters g_count;
+static uint64_t g_start_us;
+
+struct VirtualDevice : MqttHandler {
+    int       id;
+    MqttLite  mqtt;
+    AlarmFsm  fsm;
+    uint32_t  rng;
+    int       distance_cm;
+    Baseline  baseline;
+    uint32_t  next_telemetry_ms;
+    uint32_t  next_activity_ms;
+    RemoteDedup dedup;
+    bool      epollout;             // EPOLLOUT currently registered
+
+    uint32_t clock_ms() const { return (uint32_t)((now_us() - g_start_us) / 1000); }
+
+    void topic(char* buf, size_t size, const char* leaf) const
+    {
+        snprintf(buf, size, "fleet/%d/alarm/%s", id, leaf);
+    }
+
+    void publish(const char* leaf, const char* payload, int len, int qos)
+    {
+        char t[48];
+        topic(t, sizeof(t), leaf);
+        mqtt.publish(t, payload, len, qos);
+        g_count.published++;
+        g_count.bytes += len;
+    }
+
+    void publish_state()
+    {
+        char payload[96];
+        int len = telemetry_build_state(payload, sizeof(payload), fsm.state, distance_cm);
+        publish("telemetry", payload, len, 1);
+    }
+
+    void apply(const AlarmStep& step)
+    {
+        if (!step.changed) return;
+        g_count.transitions++;
+        publish_state();
+    }
+
+    void on_connected() override
+    {
+        char t[48];
+        topic(t, sizeof(t), "cmd");
+        mqtt.subscribe(t, 1);
+        publish_state();
+    }
+
+    void on_message(const char*, size_t, const char* payload, size_t len) override
+    {
+        int64_t rx = (int64_t)(now_us() - g_start_us);
+
+        CommandAck ack = {};
+        if (!telemetry_parse_command(payload, (int)len, &ack.msg)) return;
+        ack.rx_us = rx;
+
+        // mqtt_arm_disarm_from_cmd() -> remote_submit() -> alarm_task, with
+        // the event queue taken out: it never fills here.
+        uint32_t key = telemetry_command_key(ack.msg);
+        if (remote_dedup_seen(&dedup, ack.msg.cmd, EventSource::MQTT, key, rx)) {
+            ack.result = AckResult::DUPLICATE;
+        } else {
+            remote_dedup_record(&dedup, ack.msg.cmd, EventSource::MQTT, key, rx);
+            AlarmEventType type = ack.msg.cmd == RemoteCommandType::ARM
+                                      ? AlarmEventType::ARM_REMOTE
+                                      : AlarmEventType::DISARM_REMOTE;
+            AlarmStep step = alarm_fsm_on_event(&fsm, type, clock_ms());
+            ack.result = step.changed ? AckResult::APPLIED : AckResult::NO_CHANGE;
+            apply(step);
+        }
+        // Like the firmware, only commands with an id get an ack.
+        if (ack.msg.id[0] == '\0') return;
+        ack.state = fsm.state;
+        ack.apply_us = (int64_t)(now_us() - g_start_us);
+        ack.pub_us = ack.apply_us;
+
+        char out[256];
+        int n = telemetry_build_ack(out, sizeof(out), ack);
+        publish("ack", out, n, 1);
+    }
+
+    int idle_reading()
+    {
+        return SENSOR_IDLE_CM - (int)rand_between(&rng, 0, SENSOR_NOISE_CM);
+    }
+
+    // One ultrasonic_task sample: learned while disarmed, else checked
+    // against the baseline.
+    bool sample(int cm)
+    {
+        distance_cm = cm;
+        if (fsm.state == AlarmState::DISARMED) {
+            baseline_learn(&baseline, cm);
+            return false;
+        }
+        return baseline_is_motion(&baseline, cm);
+    }
+
+    // Scripted keypad and sensor activity.
+    void activity(uint32_t now)
+    {
+        sample(idle_reading());
+
+        switch (fsm.state) {
+            case AlarmState::DISARMED:
+                apply(alarm_fsm_on_event(&fsm, AlarmEventType::ARM_LOCAL, now));
+                next_activity_ms = now + rand_between(&rng, 20000, 120000);
+                break;
+
+            case AlarmState::EXIT_DELAY:
+                next_activity_ms = now + 1000;
+                break;
+
+            case AlarmState::ARMED:
+                if (rand_between(&rng, 0, 99) < 20) {
+                    // Someone in view for a few sensor periods.
+                    bool motion = false;
+                    for (int k = 0; k < BASELINE_HITS && !motion; k++)
+                        motion = sample(SENSOR_INTRUDER_CM);
+                    if (motion)
+                        apply(alarm_fsm_on_event(&fsm, AlarmEventType::MOTION_DETECTED, now));
+                }
+                next_activity_ms = now + rand_between(&rng, 5000, 30000);
+                break;
+
+            case AlarmState::ALARM:
+                apply(alarm_fsm_on_event(&fsm, AlarmEventType::DISARM_PIN_OK, now));
+                next_activity_ms = now + rand_between(&rng, 10000, 60000);
+                break;
+        }
+    }
+
+    void tick(uint32_t now)
+    {
+        if (!mqtt.connected()) return;
+
+        apply(alarm_fsm_tick(&fsm, now));
+
+        if ((int32_t)(now - next_activity_ms) >= 0) activity(now);
+
+        if ((int32_t)(now - next_telemetry_ms) >= 0) {
+            next_telemetry_ms += TELEMETRY_PERIOD_MS;
+            char payload[96];
+            int len = telemetry_build_state(payload, sizeof(payload), fsm.state, distance_cm);
+            publish("telemetry", payload, len, 1);
+        }
+    }
+};
+
+struct PendingCmd {
+    int      device;
+    uint32_t seq;
+    uint64_t sent_us;
+};
+
+struct Controller : MqttHandler {
+    MqttLite mqtt;
+    uint32_t seq = 0;
+    std::vector<PendingCmd> pending;
+    std::vector<uint32_t> latencies_us;
+
+    void on_connected() override
+    {
+        mqtt.subscribe("fleet/+/alarm/ack", 1);
+    }
+
+    void on_message(const char*, size_t, const char* payload, size_t len) override
+    {
+        uint64_t t = now_us();
+
+        // Correlation ids are "c<seq>".
+        const char* p = (const char*)memmem(payload, len, "\"id\":\"c", 7);
+        if (!p) return;
+        uint32_t s = (uint32_t)strtoul(p + 7, nullptr, 10);
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (pending[i].seq != s) continue;
+            latencies_us.push_back((uint32_t)(t - pending[i].sent_us));
+            pending[i] = pending.back();
+            pending.pop_back();
+            g_count.acks++;
+            return;
+        }
+    }
+
+    void send(int device, bool arm)
+    {
+        char topic[48], payload[96];
+        snprintf(topic, sizeof(topic), "fleet/%d/alarm/cmd", device);
+        uint64_t t = now_us();
+        int len = snprintf(payload, sizeof(payload),
+                           "{\"cmd\":\"%s\",\"id\":\"c%u\",\"ts\":%llu}",
+                           arm ? "ARM" : "DISARM", ++seq, (unsigned long long)t);
+        mqtt.publish(topic, payload, len, 1);
+        pending.push_back({ device, seq, t });
+        g_count.commands++;
+    }
+};
+
+static uint32_t percentile(std::vector<uint32_t>& v, int p)
+{
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, v.size() * p / 100);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static long rss_kb()
+{
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    long pages = 0, resident = 0;
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--host H] [--port P] [--user U --password P]\n"
+            "          [--devices N] [--ramp N/s] [--duration S]\n"
+            "          [--cmd-rate N/s] [--seed N]\n", argv0);
+    exit(2);
+}
+
+static Options parse_args(int argc, char** argv)
+{
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char* v = argv[++i];
+
+        if      (!strcmp(a, "--host"))     o.host = v;
+        else if (!strcmp(a, "--port"))     o.port = atoi(v);
+        else if (!strcmp(a, "--user"))     o.user = v;
+        else if (!strcmp(a, "--password")) o.pass = v;
+        else if (!strcmp(a, "--devices"))  o.devices = atoi(v);
+        else if (!strcmp(a, "--ramp"))     o.ramp_per_s = atoi(v);
+        else if (!strcmp(a, "--duration")) o.duration_s = atoi(v);
+        else if (!strcmp(a, "--cmd-rate")) o.cmd_rate = atof(v);
+        else if (!strcmp(a, "--seed"))     o.seed = (uint32_t)strtoul(v, nullptr, 10);
+        else usage(argv[0]);
+    }
+    if (o.devices <= 0 || o.ramp_per_s <= 0) usage(argv[0]);
+    return o;
+}
+
+// epoll user data: device index, or -1 for the controller.
+static void watch(int ep, int fd, int tag, bool want_write, bool add)
+{
+    epoll_event ev = {};
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u64 = (uint64_t)(int64_t)tag;
+    epoll_ctl(ep, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void report(const char* label, uint64_t elapsed_us, int connected,
+                   std::vector<uint32_t>& lat, size_t device_bytes)
+{
+    double s = elapsed_us / 1e6;
+    printf("%s t=%.0fs connected=%d pub=%llu (%.0f msg/s, %.0f B/msg avg) "
+           "transitions=%llu cmds=%llu acks=%llu drops=%llu\n",
+           label, s, connected,
+           (unsigned long long)g_count.published, g_count.published / s,
+           g_count.published ? (double)g_count.bytes / g_count.published : 0.0,
+           (unsigned long long)g_count.transitions,
+           (unsigned long long)g_count.commands, (unsigned long long)g_count.acks,
+           (unsigned long long)g_count.disconnects);
+    printf("%s cmd latency us: n=%zu p50=%u p90=%u p99=%u max=%u\n", label,
+           lat.size(), percentile(lat, 50), percentile(lat, 90), percentile(lat, 99),
+           lat.empty() ? 0 : *std::max_element(lat.begin(), lat.end()));
+    printf("%s memory: %zu B/device struct", label, sizeof(VirtualDevice));
+    if (device_bytes) printf(", %zu B/device incl. buffers", device_bytes);
+    printf(", RSS %ld kB (%.1f kB/device)\n", rss_kb(),
+           connected ? (double)rss_kb() / connected : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    Options opt = parse_args(argc, argv);
+
+    sockaddr_in broker = {};
+    broker.sin_family = AF_INET;
+    broker.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.host, &broker.sin_addr) != 1) {
+        fprintf(stderr, "bad --host %s (IPv4 address expected)\n", opt.host);
+        return 2;
+    }
+
+    g_start_us = now_us();
+    int ep = epoll_create1(0);
+
+    std::vector<VirtualDevice> devices(opt.devices);
+    for (int i = 0; i < opt.devices; i++) {
+        VirtualDevice& d = devices[i];
+        d.id = i;
+        d.rng = opt.seed * 2654435761u + i + 1;
+        alarm_fsm_init(&d.fsm);
+        d.distance_cm = SENSOR_IDLE_CM;
+        remote_dedup_init(&d.dedup);
+        // As if booted with a learned baseline in NVS.
+        baseline_init(&d.baseline);
+        for (int k = 0; k < BASELINE_WARMUP; k++) baseline_learn(&d.baseline, d.idle_reading());
+    }
+
+    Controller ctl;
+    ctl.mqtt.begin(broker, "fleet-controller", opt.user, opt.pass, KEEPALIVE_S);
+    watch(ep, ctl.mqtt.fd(), -1, true, true);
+
+    uint32_t ctl_rng = opt.seed ^ 0x9E3779B9u;
+    int started = 0;
+    uint64_t next_report = REPORT_PERIOD_MS;
+    uint64_t next_ping = KEEPALIVE_S * 1000 / 2;
+    double cmd_budget = 0;
+    uint64_t last_loop_ms = 0;
+    std::vector<epoll_event> events(1024);
+
+    while (true) {
+        uint64_t elapsed = now_us() - g_start_us;
+        uint32_t now = (uint32_t)(elapsed / 1000);
+        if (elapsed >= (uint64_t)opt.duration_s * 1000000) break;
+
+        // Connection ramp.
+        int target = std::min<int>(opt.devices, (int)((uint64_t)now * opt.ramp_per_s / 1000) + 1);
+        for (; started < target; started++) {
+            VirtualDevice& d = devices[started];
+            char client_id[24];
+            snprintf(client_id, sizeof(client_id), "fleet-%d", d.id);
+            if (!d.mqtt.begin(broker, client_id, opt.user, opt.pass, KEEPALIVE_S)) {
+                g_count.disconnects++;
+                continue;
+            }
+            d.next_telemetry_ms = now + rand_between(&d.rng, 0, TELEMETRY_PERIOD_MS);
+            d.next_activity_ms = now + rand_between(&d.rng, 5000, 60000);
+            watch(ep, d.mqtt.fd(), started, true, true);
+            d.epollout = true;
+        }
+
+        int n = epoll_wait(ep, events.data(), (int)events.size(), 10);
+        for (int i = 0; i < n; i++) {
+            int tag = (int)(int64_t)events[i].data.u64;
+            MqttLite& m = tag < 0 ? ctl.mqtt : devices[tag].mqtt;
+            MqttHandler& h = tag < 0 ? (MqttHandler&)ctl : (MqttHandler&)devices[tag];
+
+            bool ok = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) ok = false;
+            if (ok && (events[i].events & EPOLLOUT)) ok = m.on_writable();
+            if (ok && (events[i].events & EPOLLIN))  ok = m.on_readable(h);
+
+            if (!ok) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, m.fd(), nullptr);
+                m.close();
+                g_count.disconnects++;
+            }
+        }
+
+        now = (uint32_t)((now_us() - g_start_us) / 1000);
+
+        for (int i = 0; i < started; i++) devices[i].tick(now);
+
+        if (ctl.mqtt.connected() && started > 0) {
+            cmd_budget += (now - last_loop_ms) * opt.cmd_rate / 1000.0;
+            while (cmd_budget >= 1.0) {
+                int target_dev = (int)rand_between(&ctl_rng, 0, started - 1);
+                ctl.send(target_dev, devices[target_dev].fsm.state == AlarmState::DISARMED);
+                cmd_budget -= 1.0;
+            }
+        }
+        last_loop_ms = now;
+
+        if (now >= next_ping) {
+            next_ping += KEEPALIVE_S * 1000 / 2;
+            ctl.mqtt.ping();
+            for (int i = 0; i < started; i++) {
+                if (devices[i].mqtt.connected()) devices[i].mqtt.ping();
+            }
+        }
+
+        // EPOLLOUT only for connections with unsent bytes (or a connect in
+        // flight); a drained socket left on EPOLLOUT turns epoll_wait into a
+        // busy loop. Devices are only re-registered when that changes.
+        if (ctl.mqtt.fd() >= 0) watch(ep, ctl.mqtt.fd(), -1, ctl.mqtt.want_write(), false);
+        for (int i = 0; i < started; i++) {
+            VirtualDevice& d = devices[i];
+            bool want = d.mqtt.want_write() || !d.mqtt.connected();
+            if (d.mqtt.fd() >= 0 && want != d.epollout) {
+                watch(ep, d.mqtt.fd(), i, want, false);
+                d.epollout = want;
+            }
+        }
+
+        if (now >= next_report) {
+            next_report += REPORT_PERIOD_MS;
+            int connected = 0;
+            for (int i = 0; i < started; i++) connected += devices[i].mqtt.connected();
+            report("[fleet]", now_us() - g_start_us, connected, ctl.latencies_us, 0);
+        }
+    }
+
+    int connected = 0;
+    size_t buffers = 0;
+    for (VirtualDevice& d : devices) {
+        connected += d.mqtt.connected();
+        buffers += d.mqtt.buffered_bytes();
+    }
+    report("[final]", now_us() - g_start_us, connected, ctl.latencies_us,
+           sizeof(VirtualDevice) + buffers / devices.size());
+    printf("[final] unanswered commands: %zu\n", ctl.pending.size());
+
+    for (VirtualDevice& d : devices) d.mqtt.close();
+    ctl.mqtt.close();
+    close(ep);
+    return 0;
+}
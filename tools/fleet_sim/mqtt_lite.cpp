@@ -0,0 +1,187 @@
+#include "mqtt_lite.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/tcp.h>
+
+bool MqttLite::begin(const sockaddr_in& broker, const char* client_id,
+                     const char* user, const char* pass, uint16_t keepalive_s)
+{
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) return false;
+
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd_, (const sockaddr*)&broker, sizeof(broker)) < 0 &&
+        errno != EINPROGRESS) {
+        close();
+        return false;
+    }
+
+    size_t id_len = strlen(client_id);
+    size_t rem = 10 + 2 + id_len;
+    uint8_t flags = 0x02;  // clean session
+    if (user) { rem += 2 + strlen(user); flags |= 0x80; }
+    if (pass) { rem += 2 + strlen(pass); flags |= 0x40; }
+
+    put_header(0x10, rem);
+    put_str("MQTT", 4);
+    out_.push_back(4);        // protocol level 3.1.1
+    out_.push_back(flags);
+    put_u16(keepalive_s);
+    put_str(client_id, id_len);
+    if (user) put_str(user, strlen(user));
+    if (pass) put_str(pass, strlen(pass));
+    return true;
+}
+
+void MqttLite::close()
+{
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    connected_ = false;
+    out_.clear();
+    out_off_ = 0;
+    in_.clear();
+}
+
+void MqttLite::put_u16(uint16_t v)
+{
+    out_.push_back(v >> 8);
+    out_.push_back(v & 0xFF);
+}
+
+void MqttLite::put_str(const char* s, size_t len)
+{
+    put_u16((uint16_t)len);
+    out_.insert(out_.end(), s, s + len);
+}
+
+void MqttLite::put_header(uint8_t type, size_t remaining)
+{
+    out_.push_back(type);
+    do {
+        uint8_t b = remaining % 128;
+        remaining /= 128;
+        if (remaining) b |= 0x80;
+        out_.push_back(b);
+    } while (remaining);
+}
+
+bool MqttLite::flush()
+{
+    while (out_off_ < out_.size()) {
+        ssize_t n = send(fd_, out_.data() + out_off_, out_.size() - out_off_, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN;
+        out_off_ += n;
+    }
+    out_.clear();
+    out_off_ = 0;
+    return true;
+}
+
+bool MqttLite::on_writable()
+{
+    return flush();
+}
+
+bool MqttLite::publish(const char* topic, const char* payload, size_t len, int qos)
+{
+    size_t tlen = strlen(topic);
+    put_header(0x30 | (qos << 1), 2 + tlen + (qos ? 2 : 0) + len);
+    put_str(topic, tlen);
+    if (qos) {
+        put_u16(next_id_++);
+        if (next_id_ == 0) next_id_ = 1;
+    }
+    out_.insert(out_.end(), payload, payload + len);
+    return flush();
+}
+
+bool MqttLite::subscribe(const char* topic, int qos)
+{
+    size_t tlen = strlen(topic);
+    put_header(0x82, 2 + 2 + tlen + 1);
+    put_u16(next_id_++);
+    put_str(topic, tlen);
+    out_.push_back((uint8_t)qos);
+    return flush();
+}
+
+bool MqttLite::ping()
+{
+    put_header(0xC0, 0);
+    return flush();
+}
+
+bool MqttLite::handle_packet(uint8_t type, const uint8_t* body, size_t len, MqttHandler& h)
+{
+    switch (type >> 4) {
+        case 2:   // CONNACK
+            if (len < 2 || body[1] != 0) return false;
+            connected_ = true;
+            h.on_connected();
+            return true;
+
+        case 3: { // PUBLISH
+            if (len < 2) return false;
+            size_t tlen = (body[0] << 8) | body[1];
+            int qos = (type >> 1) & 3;
+            size_t off = 2 + tlen + (qos ? 2 : 0);
+            if (off > len) return false;
+
+            if (qos == 1) {
+                put_header(0x40, 2);
+                out_.push_back(body[2 + tlen]);
+                out_.push_back(body[3 + tlen]);
+            }
+            h.on_message((const char*)body + 2, tlen,
+                         (const char*)body + off, len - off);
+            return flush();
+        }
+
+        case 4:   // PUBACK
+            pubacks_++;
+            return true;
+
+        default:  // SUBACK, PINGRESP, ...
+            return true;
+    }
+}
+
+bool MqttLite::on_readable(MqttHandler& h)
+{
+    uint8_t buf[2048];
+
+    while (true) {
+        ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        in_.insert(in_.end(), buf, buf + n);
+    }
+
+    size_t pos = 0;
+    while (in_.size() - pos >= 2) {
+        size_t rem = 0, mult = 1, i = pos + 1;
+        bool complete = false;
+        for (; i < in_.size() && i < pos + 5; i++) {
+            rem += (in_[i] & 0x7F) * mult;
+            mult *= 128;
+            if (!(in_[i] & 0x80)) { complete = true; i++; break; }
+        }
+        if (!complete || in_.size() - i < rem) break;
+
+        if (!handle_packet(in_[pos], in_.data() + i, rem, h)) return false;
+        pos = i + rem;
+    }
+    in_.erase(in_.begin(), in_.begin() + pos);
+    return true;
+}
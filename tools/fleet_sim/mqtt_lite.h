@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <netinet/in.h>
+
+// Minimal non-blocking MQTT 3.1.1 client for the fleet simulator: one
+// socket, CONNECT/PUBLISH/SUBSCRIBE/PING, QoS 0 and 1. No TLS, no retries;
+// the event loop owns readiness and timing.
+
+struct MqttHandler {
+    virtual void on_connected() = 0;
+    virtual void on_message(const char* topic, size_t topic_len,
+                            const char* payload, size_t len) = 0;
+    virtual ~MqttHandler() = default;
+};
+
+class MqttLite {
+public:
+    bool begin(const sockaddr_in& broker, const char* client_id,
+               const char* user, const char* pass, uint16_t keepalive_s);
+    void close();
+
+    int  fd() const { return fd_; }
+    bool connected() const { return connected_; }
+    bool want_write() const { return out_.size() > out_off_; }
+
+    // Return false once the connection is unusable.
+    bool on_readable(MqttHandler& h);
+    bool on_writable();
+
+    bool publish(const char* topic, const char* payload, size_t len, int qos);
+    bool subscribe(const char* topic, int qos);
+    bool ping();
+
+    uint32_t pubacks() const { return pubacks_; }
+    size_t   buffered_bytes() const { return out_.capacity() + in_.capacity(); }
+
+private:
+    void put_u16(uint16_t v);
+    void put_str(const char* s, size_t len);
+    void put_header(uint8_t type, size_t remaining);
+    bool flush();
+    bool handle_packet(uint8_t type, const uint8_t* body, size_t len, MqttHandler& h);
+
+    int fd_ = -1;
+    bool connected_ = false;
+    uint16_t next_id_ = 1;
+    uint32_t pubacks_ = 0;
+    std::vector<uint8_t> out_;
+    size_t out_off_ = 0;
+    std::vector<uint8_t> in_;
+};
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Fetch and print the on-device sensor history (see src/history.h).
+
+    tools/history_dump.py --host 192.168.1.10               # everything
+    tools/history_dump.py --host broker.example --port 8883 --tls \\
+        --user homeGuard --password ... --parts min
+    tools/history_dump.py --file blob.bin                     # saved blob
+
+Publishes the request on alarm/history/get, waits for the blob on
+alarm/history and prints raw samples and second/minute buckets with their
+time relative to the request. --save keeps the blob for later. Fetching
+needs paho-mqtt (pip install paho-mqtt); --file does not.
+"""
+
+import argparse
+import struct
+import sys
+import threading
+import uuid
+
+TOPIC_GET = "alarm/history/get"
+TOPIC_BLOB = "alarm/history"
+
+HEADER = struct.Struct("<2sBBIHHHII")
+RAW = struct.Struct("<Hh")
+BUCKET = struct.Struct("<hhhHH")
+
+
+def decode(blob):
+    magic, ver, parts, now_ms, raw_n, sec_n, min_n, sec_end, min_end = \
+        HEADER.unpack_from(blob)
+    if magic != b"HH" or ver != 1:
+        sys.exit("not a history blob (magic %r, version %d)" % (magic, ver))
+
+    off = HEADER.size
+    raw = [RAW.unpack_from(blob, off + i * RAW.size) for i in range(raw_n)]
+    off += raw_n * RAW.size
+    sec = [BUCKET.unpack_from(blob, off + i * BUCKET.size) for i in range(sec_n)]
+    off += sec_n * BUCKET.size
+    mins = [BUCKET.unpack_from(blob, off + i * BUCKET.size) for i in range(min_n)]
+
+    return now_ms, raw, (sec, sec_end, 1.0), (mins, min_end, 60.0)
+
+
+def print_buckets(name, buckets, end_ms, now_ms, period_s):
+    if not buckets:
+        return
+    print("\n%s buckets (%d)" % (name, len(buckets)))
+    print("  %9s %6s %6s %6s %5s %5s" % ("start", "min", "max", "mean", "n", "miss"))
+    for i, (lo, hi, mean, n, miss) in enumerate(buckets):
+        start = (end_ms - now_ms) / 1000.0 - (len(buckets) - i) * period_s
+        if n == 0 and miss == 0:
+            print("  %+8.0fs   (no samples)" % start)
+        elif n == 0:
+            print("  %+8.0fs %6s %6s %6s %5d %5d" % (start, "-", "-", "-", n, miss))
+        else:
+            print("  %+8.0fs %6d %6d %6d %5d %5d" % (start, lo, hi, mean, n, miss))
+
+
+def show(blob):
+    now_ms, raw, sec, mins = decode(blob)
+
+    print("device time %.1f s, %d bytes" % (now_ms / 1000.0, len(blob)))
+    if raw:
+        print("\nraw samples (%d)" % len(raw))
+        for age, cm in raw:
+            print("  %+8.2fs %6s" % (-age / 1000.0, cm if cm > 0 else "miss"))
+
+    print_buckets("per-second", sec[0], sec[1], now_ms, sec[2])
+    print_buckets("per-minute", mins[0], mins[1], now_ms, mins[2])
+
+
+def fetch(args):
+    import paho.mqtt.client as mqtt
+
+    got = threading.Event()
+    blob = []
+
+    def on_message(client, userdata, msg):
+        blob.append(msg.payload)
+        got.set()
+
+    client = mqtt.Client(client_id="history-%s" % uuid.uuid4().hex[:8])
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    if args.tls:
+        client.tls_set()
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.subscribe(TOPIC_BLOB, qos=0)
+    client.loop_start()
+
+    client.publish(TOPIC_GET, args.parts, qos=0)
+    if not got.wait(args.timeout):
+        sys.exit("no history blob within %.1f s" % args.timeout)
+
+    client.loop_stop()
+    client.disconnect()
+    return blob[0]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--file", help="decode a saved blob instead of fetching")
+    ap.add_argument("--host", default="localhost")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--tls", action="store_true")
+    ap.add_argument("--user")
+    ap.add_argument("--password")
+    ap.add_argument("--parts", default="",
+                    help='any of "raw sec min" (default: all)')
+    ap.add_argument("--save", help="write the fetched blob here")
+    ap.add_argument("--timeout", type=float, default=5.0)
+    args = ap.parse_args()
+
+    if args.file:
+        blob = open(args.file, "rb").read()
+    else:
+        blob = fetch(args)
+        if args.save:
+            open(args.save, "wb").write(blob)
+
+    show(blob)
+
+
+if __name__ == "__main__":
+    main()
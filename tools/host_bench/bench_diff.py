@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""Compare two host_bench runs (see host_bench.cpp).
+
+    tools/host_bench/bench_diff.py old.jsonl new.jsonl [--threshold 10]
+
+Prints every benchmark's ns/op in both runs and the change, and exits 1 if
+any benchmark got slower by more than --threshold percent, so it can gate a
+commit. Benchmarks present in only one run are listed but never fail.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    runs = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("{"):
+                rec = json.loads(line)
+                runs[rec["bench"]] = rec
+    return runs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("old")
+    ap.add_argument("new")
+    ap.add_argument("--threshold", type=float, default=10.0,
+                    help="percent slowdown that counts as a regression")
+    args = ap.parse_args()
+
+    old, new = load(args.old), load(args.new)
+    regressed = []
+
+    print("%-26s %10s %10s %8s" % ("bench", "old ns", "new ns", "change"))
+    for name in sorted(set(old) | set(new)):
+        if name not in old or name not in new:
+            ns = (old.get(name) or new[name])["ns_per_op"]
+            print("%-26s %10s %10s %8s" % (name, "%.2f" % ns if name in old else "-",
+                                           "%.2f" % ns if name in new else "-", "n/a"))
+            continue
+
+        a, b = old[name]["ns_per_op"], new[name]["ns_per_op"]
+        pct = (b - a) / a * 100.0 if a > 0 else 0.0
+        mark = " !" if pct > args.threshold else ""
+        print("%-26s %10.2f %10.2f %+7.1f%%%s" % (name, a, b, pct, mark))
+        if pct > args.threshold:
+            regressed.append(name)
+
+    if regressed:
+        print("\nslower by more than %.0f%%: %s" % (args.threshold, ", ".join(regressed)))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,333 @@
+// Microbenchmarks for the firmware's pure hot-path functions, built and run
+// on the host:
+//
+//   cmake -S tools/host_bench -B build/host_bench && cmake --build build/host_bench
+//   build/host_bench/host_bench --label "$(git rev-parse --short HEAD)" > bench.jsonl
+//   tools/host_bench/bench_diff.py old.jsonl bench.jsonl
+//
+// Each benchmark prints one JSON line:
+//   {"label":"...","bench":"<name>","ns_per_op":<best>,"median_ns":<median>,"iters":<n>}
+// ns_per_op is the best of BENCH_REPEATS runs of iters calls each, with iters
+// sized so one run takes about BENCH_RUN_MS. Host numbers only track relative
+// changes between commits; they are not device timings.
+//
+// A name (or prefix) as argument runs just the matching benchmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adpcm.h"
+#include "alarm_fsm.h"
+#include "baseline.h"
+#include "history.h"
+#include "lcd_layout.h"
+#include "range_filter.h"
+#include "state_snapshot.h"
+#include "telemetry.h"
+#include "ui_flow.h"
+
+#define BENCH_REPEATS  7
+#define BENCH_RUN_MS   50
+
+typedef void (*BenchFn)(uint32_t iters);
+
+struct Bench {
+    const char* name;
+    BenchFn     fn;
+};
+
+static const char* g_label = "";
+
+// Results go here so the compiler cannot drop the calls being measured.
+static volatile uint32_t g_sink;
+
+static double run_ns(BenchFn fn, uint32_t iters)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn(iters);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+static void run(const Bench& b)
+{
+    // Grow iters until one run is long enough to time reliably.
+    uint32_t iters = 1;
+    double ns = run_ns(b.fn, iters);
+    while (ns < BENCH_RUN_MS * 1e6 && iters < (1u << 30)) {
+        iters = ns > 0 && ns * 10 < BENCH_RUN_MS * 1e6
+                    ? iters * 10 : (uint32_t)(iters * (BENCH_RUN_MS * 1e6 / ns)) + 1;
+        ns = run_ns(b.fn, iters);
+    }
+
+    double per_op[BENCH_REPEATS];
+    for (int i = 0; i < BENCH_REPEATS; i++) per_op[i] = run_ns(b.fn, iters) / iters;
+    std::sort(per_op, per_op + BENCH_REPEATS);
+
+    printf("{\"label\":\"%s\",\"bench\":\"%s\",\"ns_per_op\":%.2f,\"median_ns\":%.2f,\"iters\":%u}\n",
+           g_label, b.name, per_op[0], per_op[BENCH_REPEATS / 2], iters);
+    fflush(stdout);
+}
+
+// --- alarm state machine -------------------------------------------------
+
+static void bench_fsm_event(uint32_t iters)
+{
+    static const AlarmEventType SEQ[] = {
+        AlarmEventType::ARM_LOCAL, AlarmEventType::MOTION_DETECTED,
+        AlarmEventType::DISARM_PIN_OK, AlarmEventType::MOTION_DETECTED,
+    };
+
+    AlarmFsm fsm;
+    alarm_fsm_init(&fsm);
+    uint32_t now = 0;
+
+    for (uint32_t i = 0; i < iters; i++) {
+        // Jump past the exit delay every few events so ARMED and ALARM are hit.
+        now += (i & 7) == 1 ? EXIT_DELAY_MS : 100;
+        AlarmStep s = alarm_fsm_on_event(&fsm, SEQ[i & 3], now);
+        if ((i & 7) == 1) s = alarm_fsm_tick(&fsm, now);
+        g_sink = g_sink + s.changed;
+    }
+}
+
+static void bench_fsm_tick(uint32_t iters)
+{
+    AlarmFsm fsm;
+    alarm_fsm_init(&fsm);
+    uint32_t now = 0;
+    alarm_fsm_on_event(&fsm, AlarmEventType::ARM_LOCAL, now);
+
+    for (uint32_t i = 0; i < iters; i++) {
+        now += 100;
+        if (fsm.state != AlarmState::EXIT_DELAY) {
+            alarm_fsm_on_event(&fsm, AlarmEventType::DISARM_REMOTE, now);
+            alarm_fsm_on_event(&fsm, AlarmEventType::ARM_LOCAL, now);
+        }
+        AlarmStep s = alarm_fsm_tick(&fsm, now);
+        g_sink = g_sink + s.countdown_changed;
+    }
+}
+
+// --- PIN check and UI ----------------------------------------------------
+
+static void bench_pin_equal(uint32_t iters)
+{
+    static const char* const TRIES[] = { "1231", "1234", "9231", "123" };
+
+    for (uint32_t i = 0; i < iters; i++)
+        g_sink = g_sink + ui_pin_equal(TRIES[i & 3], "1231");
+}
+
+static bool check_pin(const char* pin)
+{
+    return ui_pin_equal(pin, "1231");
+}
+
+static void bench_ui_key(uint32_t iters)
+{
+    static const char KEYS[] = "1231#B#D";
+
+    UiFlow ui;
+    ui_flow_init(&ui, check_pin);
+    uint32_t now = 0;
+
+    for (uint32_t i = 0; i < iters; i++) {
+        now += 150;
+        UiOutput out = ui_flow_on_key(&ui, KEYS[i & 7], now);
+        g_sink = g_sink + out.redraw;
+    }
+}
+
+// --- ultrasonic ----------------------------------------------------------
+
+static void bench_echo_to_cm(uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++)
+        g_sink = g_sink + range_echo_to_cm((int)(i & 0x7FFF));
+}
+
+static void bench_range_filter(uint32_t iters)
+{
+    RangeFilter f;
+    range_filter_init(&f);
+    int samples[5];
+
+    for (uint32_t i = 0; i < iters; i++) {
+        for (int k = 0; k < 5; k++) samples[k] = ((i + k) % 11 == 0) ? -1 : 120 + (int)((i * 7 + k) % 9);
+        int avg;
+        g_sink = g_sink + range_filter_apply(&f, samples, 5, &avg);
+    }
+}
+
+static void bench_baseline(uint32_t iters)
+{
+    Baseline b;
+    baseline_init(&b);
+
+    for (uint32_t i = 0; i < iters; i++) {
+        int cm = 240 + (int)(i % 7);
+        if ((i & 1) == 0) baseline_learn(&b, cm);
+        if (baseline_ready(&b)) g_sink = g_sink + baseline_is_motion(&b, cm);
+    }
+}
+
+static History g_history;
+
+static void bench_history_add(uint32_t iters)
+{
+    history_init(&g_history);
+    uint32_t now = 0;
+
+    for (uint32_t i = 0; i < iters; i++) {
+        now += 150;
+        history_add(&g_history, now, (i % 13 == 0) ? -1 : 100 + (int)(i % 50));
+    }
+    g_sink = g_sink + g_history.raw_count;
+}
+
+// --- LCD -----------------------------------------------------------------
+
+static void bench_lcd_layout(uint32_t iters)
+{
+    static const char* const MSGS[] = {
+        "DISARMED", "PIN:\n****", "ALARM TRIGGERED\nENTER PIN", "A LINE LONGER THAN SIXTEEN\nX",
+    };
+    char rows[LCD_ROWS][LCD_COLS + 1];
+
+    for (uint32_t i = 0; i < iters; i++) {
+        lcd_layout(MSGS[i & 3], rows);
+        g_sink = g_sink + (uint8_t)rows[1][0];
+    }
+}
+
+// --- MQTT payloads -------------------------------------------------------
+
+static void bench_build_state(uint32_t iters)
+{
+    char buf[128];
+
+    for (uint32_t i = 0; i < iters; i++)
+        g_sink = g_sink + telemetry_build_state(buf, sizeof(buf), (AlarmState)(i & 3), (int)(i % 400));
+}
+
+static void bench_parse_command(uint32_t iters)
+{
+    static const char* const CMDS[] = {
+        "ARM",
+        "{\"cmd\":\"DISARM\",\"id\":\"a1b2c3d4\",\"ts\":1700000000123}",
+        "{\"cmd\":\"ARM\",\"id\":\"phone-7\"}",
+        "{\"cmd\":\"REBOOT\"}",
+    };
+    static int lens[4];
+    if (!lens[0]) for (int k = 0; k < 4; k++) lens[k] = (int)strlen(CMDS[k]);
+
+    CommandMsg msg;
+    for (uint32_t i = 0; i < iters; i++)
+        g_sink = g_sink + telemetry_parse_command(CMDS[i & 3], lens[i & 3], &msg);
+}
+
+static void bench_build_ack(uint32_t iters)
+{
+    CommandAck ack;
+    memset(&ack, 0, sizeof(ack));
+    telemetry_parse_command("{\"cmd\":\"ARM\",\"id\":\"a1b2c3d4\",\"ts\":1700000000123}", 51, &ack.msg);
+    ack.result = AckResult::APPLIED;
+    ack.state = AlarmState::EXIT_DELAY;
+    char buf[256];
+
+    for (uint32_t i = 0; i < iters; i++) {
+        ack.rx_us = i;
+        ack.apply_us = i + 180;
+        ack.pub_us = i + 950;
+        g_sink = g_sink + telemetry_build_ack(buf, sizeof(buf), ack);
+    }
+}
+
+// --- voice prompt decoder ------------------------------------------------
+
+// One voice_task block: 128 ADPCM bytes -> 256 samples. At 16 kHz a block
+// lasts 16 ms, so ns_per_op / 16e6 is the share of a core playback costs.
+static void bench_adpcm_block(uint32_t iters)
+{
+    static uint8_t in[128];
+    static int16_t out[256];
+    uint32_t x = 12345;
+    for (uint8_t& b : in) {
+        x = x * 1103515245 + 12345;
+        b = (uint8_t)(x >> 16);
+    }
+
+    AdpcmState st = { 0, 0 };
+    for (uint32_t i = 0; i < iters; i++) {
+        adpcm_decode(&st, in, sizeof(in), out);
+        g_sink = g_sink + out[i & 255];
+    }
+}
+
+// --- state snapshot (uncontended; see snapshot_stress for contention) ----
+
+static StateSnapshot g_snapshot;
+
+static void bench_snapshot_read(uint32_t iters)
+{
+    snapshot_init(&g_snapshot, AlarmState::ARMED);
+    for (uint32_t i = 0; i < iters; i++) g_sink = g_sink + snapshot_read(&g_snapshot).version;
+}
+
+static void bench_snapshot_write(uint32_t iters)
+{
+    snapshot_init(&g_snapshot, AlarmState::ARMED);
+    for (uint32_t i = 0; i < iters; i++) snapshot_set_distance(&g_snapshot, (int)(i & 0xff));
+    g_sink = g_sink + snapshot_read(&g_snapshot).version;
+}
+
+static const Bench BENCHES[] = {
+    { "alarm_fsm_on_event",        bench_fsm_event },
+    { "alarm_fsm_tick",            bench_fsm_tick },
+    { "ui_pin_equal",              bench_pin_equal },
+    { "ui_flow_on_key",            bench_ui_key },
+    { "range_echo_to_cm",          bench_echo_to_cm },
+    { "range_filter_apply",        bench_range_filter },
+    { "baseline_learn_detect",     bench_baseline },
+    { "history_add",               bench_history_add },
+    { "lcd_layout",                bench_lcd_layout },
+    { "telemetry_build_state",     bench_build_state },
+    { "telemetry_parse_command",   bench_parse_command },
+    { "telemetry_build_ack",       bench_build_ack },
+    { "adpcm_decode_block",        bench_adpcm_block },
+    { "snapshot_read",             bench_snapshot_read },
+    { "snapshot_set_distance",     bench_snapshot_write },
+};
+
+int main(int argc, char** argv)
+{
+    const char* only = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            g_label = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [--label LABEL] [NAME_PREFIX]\n", argv[0]);
+            return 2;
+        } else {
+            only = argv[i];
+        }
+    }
+
+    int ran = 0;
+    for (const Bench& b : BENCHES) {
+        if (only && strncmp(b.name, only, strlen(only)) != 0) continue;
+        run(b);
+        ran++;
+    }
+
+    if (ran == 0) {
+        fprintf(stderr, "no benchmark matches \"%s\"\n", only);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Concurrent readers and writers on the state snapshot (src/state_snapshot.h),
+// checking that every read is a consistent one:
+//
+//   build/host_bench/snapshot_stress [--seconds S] [--readers N]
+//
+// Two writer threads play alarm_task and ultrasonic_task. The alarm writer
+// derives all three of its fields from one counter, so a read that mixes
+// fields from two writes shows up as a mismatch. Readers also check that
+// versions never go backwards. Prints one JSON line and exits 1 on any
+// inconsistency.
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "state_snapshot.h"
+
+static StateSnapshot g_snap;
+static std::atomic<bool> g_stop{false};
+
+struct ReaderResult {
+    uint64_t reads;
+    uint64_t retries;
+    uint64_t torn;
+    uint64_t backwards;
+};
+
+static void alarm_writer(uint64_t* writes)
+{
+    uint32_t i = 0;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        i++;
+        snapshot_set_alarm(&g_snap, (AlarmState)(i % 4), (int)(i % 30000), i);
+    }
+    *writes = i;
+}
+
+static void distance_writer(uint64_t* writes)
+{
+    uint32_t i = 0;
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        i++;
+        snapshot_set_distance(&g_snap, (int)(i % 400));
+    }
+    *writes = i;
+}
+
+static void reader(ReaderResult* r)
+{
+    uint32_t last_version = 0;
+
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        uint32_t retries;
+        SystemState st = snapshot_read(&g_snap, &retries);
+        r->reads++;
+        r->retries += retries;
+
+        uint32_t d = st.exit_deadline_ms;
+        if (d != 0 && ((int)st.state != (int)(d % 4) || st.exit_seconds_remaining != (int)(d % 30000)))
+            r->torn++;
+        if (st.distance_cm < -1 || st.distance_cm >= 400) r->torn++;
+        if (st.version < last_version) r->backwards++;
+        last_version = st.version;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 2.0;
+    int readers = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--seconds S] [--readers N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    snapshot_init(&g_snap, AlarmState::DISARMED);
+
+    uint64_t alarm_writes = 0, distance_writes = 0;
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+
+    threads.emplace_back(alarm_writer, &alarm_writes);
+    threads.emplace_back(distance_writer, &distance_writes);
+    for (int i = 0; i < readers; i++) threads.emplace_back(reader, &results[i]);
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    g_stop = true;
+    for (std::thread& t : threads) t.join();
+
+    ReaderResult total = {};
+    for (const ReaderResult& r : results) {
+        total.reads += r.reads;
+        total.retries += r.retries;
+        total.torn += r.torn;
+        total.backwards += r.backwards;
+    }
+
+    printf("{\"seconds\":%.1f,\"readers\":%d,\"writes\":%llu,\"reads\":%llu,"
+           "\"retries_per_read\":%.4f,\"torn\":%llu,\"backwards\":%llu}\n",
+           seconds, readers, (unsigned long long)(alarm_writes + distance_writes),
+           (unsigned long long)total.reads,
+           total.reads ? (double)total.retries / total.reads : 0.0,
+           (unsigned long long)total.torn, (unsigned long long)total.backwards);
+
+    return total.torn || total.backwards ? 1 : 0;
+}
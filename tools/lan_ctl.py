@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""LAN control client for EspHomeGuard (see src/lan_control.h).
+
+    tools/lan_ctl.py 192.168.1.50 status
+    tools/lan_ctl.py 192.168.1.50 arm
+    tools/lan_ctl.py 192.168.1.50 disarm --repeat 50   # latency percentiles
+
+The device key is the 64 hex digits the device prints once on its first
+boot ("New LAN control key"); pass it with --key or in LAN_CTL_KEY.
+
+For arm/disarm the round trip is measured from sending the command to
+receiving the STATE push it caused; the device-side queue -> state
+change time carried in the push is printed next to it.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+
+PORT = 4210
+KEY_LEN = 32
+VERSION = 1
+OP_ARM, OP_DISARM, OP_SUBSCRIBE, OP_STATE = 1, 2, 3, 0x80
+STATES = ["DISARMED", "EXIT_DELAY", "ARMED", "ALARM"]
+
+
+def tag(key, data):
+    return hmac.new(key, data, hashlib.sha256).digest()[:16]
+
+
+def command(key, op, nonce, seq):
+    body = b"HG" + struct.pack("<BBII", VERSION, op, nonce, seq)
+    return body + tag(key, body)
+
+
+def parse_state(key, pkt):
+    if len(pkt) != 36 or pkt[:2] != b"HG" or pkt[3] != OP_STATE:
+        return None
+    if not hmac.compare_digest(tag(key, pkt[:20]), pkt[20:]):
+        return None
+    _, _, nonce, seq, state, apply_us = struct.unpack("<BBIIB3xI", pkt[2:20])
+    return nonce, seq, state, apply_us
+
+
+def recv_state(sock, key, timeout):
+    deadline = time.monotonic() + timeout
+    while True:
+        left = deadline - time.monotonic()
+        if left <= 0:
+            return None
+        sock.settimeout(left)
+        try:
+            pkt, _ = sock.recvfrom(64)
+        except socket.timeout:
+            return None
+        st = parse_state(key, pkt)
+        if st:
+            return st
+
+
+def percentile(values, p):
+    values = sorted(values)
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("host")
+    ap.add_argument("action", choices=["status", "arm", "disarm"])
+    ap.add_argument("--repeat", type=int, default=1)
+    ap.add_argument("--timeout", type=float, default=2.0)
+    ap.add_argument("--key", default=os.environ.get("LAN_CTL_KEY"),
+                    help="device key, 64 hex digits (default: $LAN_CTL_KEY)")
+    args = ap.parse_args()
+
+    try:
+        key = bytes.fromhex(args.key or "")
+    except ValueError:
+        key = b""
+    if len(key) != KEY_LEN:
+        print("need the device key: --key <64 hex digits> or LAN_CTL_KEY")
+        return 2
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    dev = (args.host, PORT)
+
+    sock.sendto(command(key, OP_SUBSCRIBE, 0, 0), dev)
+    st = recv_state(sock, key, args.timeout)
+    if not st:
+        print("no answer from %s:%d" % dev)
+        return 1
+    nonce, seq, state, _ = st
+    print("state %s (nonce %08x)" % (STATES[state], nonce))
+    if args.action == "status":
+        return 0
+
+    # The device only needs seq to grow; wall-clock milliseconds do that
+    # across invocations without keeping client state.
+    seq = max(seq, int(time.time() * 1000) & 0xFFFFFFFF)
+    ops = [OP_ARM, OP_DISARM] if args.repeat > 1 else \
+          [OP_ARM if args.action == "arm" else OP_DISARM]
+
+    rtts = []
+    for i in range(args.repeat):
+        op = ops[i % len(ops)]
+        seq += 1
+        t0 = time.monotonic()
+        sock.sendto(command(key, op, nonce, seq), dev)
+        st = recv_state(sock, key, args.timeout)
+        if not st or st[1] != seq:
+            print("#%d: no state change (already %s?)" % (i, STATES[state]))
+            continue
+        rtt_ms = (time.monotonic() - t0) * 1000.0
+        _, _, state, apply_us = st
+        rtts.append(rtt_ms)
+        print("#%d: %s in %.1f ms (device %.1f ms)"
+              % (i, STATES[state], rtt_ms, apply_us / 1000.0))
+
+    if len(rtts) > 1:
+        print("p50=%.1f p90=%.1f p99=%.1f max=%.1f ms (n=%d)" % (
+            percentile(rtts, 50), percentile(rtts, 90),
+            percentile(rtts, 99), max(rtts), len(rtts)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
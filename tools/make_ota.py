@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Build a signed OTA package for EspHomeGuard (see src/ota.h).
+
+    tools/make_ota.py --image new.bin --key ota_signing_key.pem -o full.hgota
+    tools/make_ota.py --base old.bin --image new.bin --key ota_signing_key.pem \\
+        -o delta.hgota
+
+With --base the payload is a detools patch (heatshrink, as esp_delta_ota
+expects) against the image the device is running now; without it the raw
+image is shipped. Both sizes are printed so the saving is visible. Delta
+packages need detools (pip install detools); signing shells out to openssl.
+
+Serve the package from any HTTP server and point the device at it:
+
+    python3 -m http.server 8000
+    mosquitto_pub -t alarm/ota -m http://192.168.1.10:8000/delta.hgota
+
+The device reports the outcome on alarm/ota/status. A new signing key is
+made with
+
+    openssl ecparam -name prime256v1 -genkey -noout -out ota_signing_key.pem
+    openssl ec -in ota_signing_key.pem -pubout
+
+and the public half goes into OTA_SIGNING_PUBKEY_PEM in src/ota.cpp.
+"""
+
+import argparse
+import hashlib
+import io
+import struct
+import subprocess
+import sys
+
+MAGIC = b"HGOT"
+VERSION = 1
+KIND_FULL, KIND_DELTA = 0, 1
+SIG_MAX = 72
+
+
+def app_digest(image):
+    """What esp_partition_get_sha256() returns for an app partition: the
+    SHA-256 appended by esptool, or the hash of the whole image."""
+    if len(image) > 32 and hashlib.sha256(image[:-32]).digest() == image[-32:]:
+        return image[-32:]
+    return hashlib.sha256(image).digest()
+
+
+def make_patch(base, image):
+    import detools
+
+    out = io.BytesIO()
+    detools.create_patch(io.BytesIO(base), io.BytesIO(image), out,
+                         compression="heatshrink")
+    return out.getvalue()
+
+
+def sign(key, data):
+    sig = subprocess.run(["openssl", "dgst", "-sha256", "-sign", key],
+                         input=data, capture_output=True, check=True).stdout
+    if len(sig) > SIG_MAX:
+        sys.exit("signature too long; expected an ECDSA P-256 key")
+    return sig
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--image", required=True, help="new app .bin")
+    ap.add_argument("--base", help="app .bin the device runs now (delta)")
+    ap.add_argument("--key", required=True, help="ECDSA P-256 private key (PEM)")
+    ap.add_argument("-o", "--output", required=True)
+    args = ap.parse_args()
+
+    image = open(args.image, "rb").read()
+
+    if args.base:
+        base = open(args.base, "rb").read()
+        kind, payload, base_digest = KIND_DELTA, make_patch(base, image), app_digest(base)
+    else:
+        kind, payload, base_digest = KIND_FULL, image, bytes(32)
+
+    signed = (MAGIC + struct.pack("<BBHII", VERSION, kind, 0, len(payload), len(image))
+              + base_digest + hashlib.sha256(image).digest())
+    sig = sign(args.key, signed)
+    header = signed + struct.pack("<H", len(sig)) + sig.ljust(SIG_MAX, b"\0")
+
+    with open(args.output, "wb") as f:
+        f.write(header)
+        f.write(payload)
+
+    total = len(header) + len(payload)
+    print(f"image    {len(image):>9} bytes")
+    print(f"package  {total:>9} bytes ({'delta' if kind == KIND_DELTA else 'full'}, "
+          f"{100.0 * total / len(image):.1f}% of a full image)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""Pack WAV clips into the voice partition image (see src/voice.h).
+
+    tools/pack_voice.py -o voice.bin clips/*.wav
+    tools/pack_voice.py -o voice.bin alarm=take3.wav zone=zone.wav ...
+    tools/pack_voice.py --list voice.bin
+    tools/pack_voice.py --extract alarm out.wav voice.bin
+
+A clip is named after its file (without .wav) unless given as name=path.
+WAVs may be 8 or 16 bit, mono or stereo, any rate: they are mixed down to
+mono, resampled to --rate and IMA-ADPCM encoded at 4 bits per sample.
+The firmware asks for these clips:
+
+    exit_delay seconds armed disarmed alarm zone 1 5 10 15
+
+Flash the image into the partition with
+
+    parttool.py write_partition --partition-name voice --input voice.bin
+"""
+
+import argparse
+import os
+import struct
+import sys
+import wave
+
+MAGIC = b"VOX1"
+VERSION = 1
+HEADER = struct.Struct("<4sHHII")
+CLIP = struct.Struct("<16sIIIhBB")
+PARTITION_SIZE = 0xF0000        # partitions.csv
+
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+
+
+def clamp(v, lo, hi):
+    return lo if v < lo else hi if v > hi else v
+
+
+def adpcm_encode(samples):
+    """Returns (data, predictor, step_index); low nibble first."""
+    pred0 = samples[0] if samples else 0
+    pred, index = pred0, 0
+    nibbles = []
+
+    for s in samples:
+        step = STEP_TABLE[index]
+        diff = s - pred
+        n = 0
+        if diff < 0:
+            n = 8
+            diff = -diff
+
+        vpdiff = step >> 3
+        if diff >= step:
+            n |= 4
+            diff -= step
+            vpdiff += step
+        step >>= 1
+        if diff >= step:
+            n |= 2
+            diff -= step
+            vpdiff += step
+        step >>= 1
+        if diff >= step:
+            n |= 1
+            vpdiff += step
+
+        pred = clamp(pred - vpdiff if n & 8 else pred + vpdiff, -32768, 32767)
+        index = clamp(index + INDEX_TABLE[n], 0, len(STEP_TABLE) - 1)
+        nibbles.append(n)
+
+    if len(nibbles) % 2:
+        nibbles.append(0)
+    data = bytes(nibbles[i] | (nibbles[i + 1] << 4) for i in range(0, len(nibbles), 2))
+    return data, pred0, 0
+
+
+def adpcm_decode(data, samples, pred, index):
+    out = []
+    for b in data:
+        for n in (b & 0x0F, b >> 4):
+            step = STEP_TABLE[index]
+            diff = step >> 3
+            if n & 4:
+                diff += step
+            if n & 2:
+                diff += step >> 1
+            if n & 1:
+                diff += step >> 2
+            pred = clamp(pred - diff if n & 8 else pred + diff, -32768, 32767)
+            index = clamp(index + INDEX_TABLE[n], 0, len(STEP_TABLE) - 1)
+            out.append(pred)
+    return out[:samples]
+
+
+def read_wav(path, rate):
+    with wave.open(path, "rb") as w:
+        channels, width, src_rate = w.getnchannels(), w.getsampwidth(), w.getframerate()
+        raw = w.readframes(w.getnframes())
+
+    if width == 2:
+        vals = struct.unpack("<%dh" % (len(raw) // 2), raw)
+    elif width == 1:
+        vals = [(b - 128) << 8 for b in raw]
+    else:
+        sys.exit("%s: %d-bit samples not supported" % (path, width * 8))
+
+    mono = [sum(vals[i:i + channels]) // channels for i in range(0, len(vals), channels)]
+    if src_rate == rate or not mono:
+        return mono
+
+    # Linear interpolation is plenty for speech going to a small speaker.
+    n = int(len(mono) * rate / src_rate)
+    out = []
+    for i in range(n):
+        x = i * src_rate / rate
+        j = int(x)
+        f = x - j
+        b = mono[j + 1] if j + 1 < len(mono) else mono[j]
+        out.append(int(round(mono[j] * (1 - f) + b * f)))
+    return out
+
+
+def pack(args):
+    clips = []
+    for spec in args.clips:
+        name, sep, path = spec.partition("=")
+        if not sep:
+            path = spec
+            name = os.path.splitext(os.path.basename(spec))[0]
+        if len(name.encode()) > 15 or " " in name:
+            sys.exit("clip name %r: at most 15 bytes, no spaces" % name)
+        clips.append((name, read_wav(path, args.rate)))
+
+    offset = HEADER.size + CLIP.size * len(clips)
+    table = []
+    blobs = []
+    for name, samples in clips:
+        data, pred, index = adpcm_encode(samples)
+        table.append(CLIP.pack(name.encode(), offset, len(data), len(samples), pred, index, 0))
+        blobs.append(data)
+        offset += len(data)
+        print("%-16s %6.2f s %7d bytes" % (name, len(samples) / args.rate, len(data)))
+
+    image = HEADER.pack(MAGIC, VERSION, len(clips), args.rate, 0) + b"".join(table) + b"".join(blobs)
+    if len(image) > args.size:
+        sys.exit("image is %d bytes, partition holds %d" % (len(image), args.size))
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("%d clips, %d bytes (%.0f%% of the partition)" %
+          (len(clips), len(image), 100.0 * len(image) / args.size))
+
+
+def load(path):
+    image = open(path, "rb").read()
+    magic, version, count, rate, _ = HEADER.unpack_from(image)
+    if magic != MAGIC or version != VERSION:
+        sys.exit("%s: not a voice image" % path)
+
+    clips = {}
+    for i in range(count):
+        name, off, size, samples, pred, index, _ = CLIP.unpack_from(image, HEADER.size + i * CLIP.size)
+        clips[name.rstrip(b"\0").decode()] = (image[off:off + size], samples, pred, index)
+    return rate, clips
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("clips", nargs="*", help="name=file.wav or file.wav")
+    ap.add_argument("-o", "--output", help="image to write")
+    ap.add_argument("--rate", type=int, default=16000)
+    ap.add_argument("--size", type=lambda s: int(s, 0), default=PARTITION_SIZE)
+    ap.add_argument("--list", metavar="IMAGE", help="print the clips in an image")
+    ap.add_argument("--extract", nargs=2, metavar=("NAME", "OUT_WAV"),
+                    help="decode one clip of the image given as the last argument")
+    args = ap.parse_args()
+
+    if args.list:
+        rate, clips = load(args.list)
+        print("%d Hz" % rate)
+        for name, (data, samples, _, _) in clips.items():
+            print("%-16s %6.2f s %7d bytes" % (name, samples / rate, len(data)))
+    elif args.extract:
+        if len(args.clips) != 1:
+            sys.exit("--extract needs the image as the last argument")
+        rate, clips = load(args.clips[0])
+        name, out = args.extract
+        if name not in clips:
+            sys.exit("no clip %r" % name)
+        pcm = adpcm_decode(*clips[name])
+        with wave.open(out, "wb") as w:
+            w.setnchannels(1)
+            w.setsampwidth(2)
+            w.setframerate(rate)
+            w.writeframes(struct.pack("<%dh" % len(pcm), *pcm))
+    elif args.clips and args.output:
+        pack(args)
+    else:
+        ap.error("give clips and -o, --list or --extract")
+
+
+if __name__ == "__main__":
+    main()
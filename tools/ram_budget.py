@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Per-subsystem RAM budget from a GNU ld map file.
+
+Usage:
+    tools/ram_budget.py .pio/build/nodemcu-32s/firmware.map
+    tools/ram_budget.py build/EspHomeGuard.map --budget 120000
+
+Every input section placed in an internal-RAM output section (DRAM data/bss,
+IRAM, RTC) is attributed to a subsystem: one per source file under src/
+(main, lcd, keypad, ...) and one per ESP-IDF archive (idf:lwip, idf:mbedtls,
+...). In STATIC_ALLOC_BUILD the task stacks show up as task_config bss.
+"""
+
+import argparse
+import collections
+import re
+import sys
+
+RAM_SECTIONS = {
+    ".dram0.data": "data",
+    ".dram0.bss": "bss",
+    ".noinit": "bss",
+    ".iram0.text": "iram",
+    ".iram0.data": "iram",
+    ".iram0.bss": "iram",
+    ".rtc.data": "rtc",
+    ".rtc.bss": "rtc",
+    ".rtc_noinit": "rtc",
+}
+
+OUTPUT_RE = re.compile(r"^(\.\S+)\s*(0x[0-9a-fA-F]+)?")
+INPUT_RE = re.compile(r"^ (\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+CONT_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+OBJ_RE = re.compile(r"(?:lib([^/\\(]+)\.a)?\(?([^/\\()]+?)\.(?:c|cpp|S)\.o(?:bj)?\)?$")
+
+
+def subsystem(obj_path):
+    m = OBJ_RE.search(obj_path.strip())
+    if not m:
+        return "other"
+    archive, stem = m.groups()
+    if archive in (None, "src", "__idf_src", "main", "__idf_main"):
+        return stem
+    return "idf:" + archive.replace("__idf_", "")
+
+
+def parse(path):
+    usage = collections.defaultdict(lambda: collections.Counter())
+    out_kind = None
+    pending = None
+
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+
+            if line.startswith("."):
+                name = OUTPUT_RE.match(line).group(1)
+                out_kind = RAM_SECTIONS.get(name)
+                pending = None
+                continue
+            if out_kind is None or line.startswith("*"):
+                continue
+
+            m = INPUT_RE.match(line)
+            if m:
+                _, _, size, obj = m.groups()
+                usage[subsystem(obj)][out_kind] += int(size, 16)
+                pending = None
+                continue
+
+            # Long input section names are wrapped onto a second line.
+            if re.match(r"^ \S+$", line):
+                pending = line
+                continue
+            m = CONT_RE.match(line)
+            if m and pending is not None:
+                _, size, obj = m.groups()
+                usage[subsystem(obj)][out_kind] += int(size, 16)
+                pending = None
+
+    return usage
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("map")
+    ap.add_argument("--budget", type=int, default=0,
+                    help="fail if our own subsystems exceed this many DRAM bytes")
+    ap.add_argument("--all", action="store_true",
+                    help="list every ESP-IDF archive instead of folding them")
+    args = ap.parse_args()
+
+    usage = parse(args.map)
+    kinds = ("data", "bss", "iram", "rtc")
+
+    rows = []
+    idf = collections.Counter()
+    for name, c in usage.items():
+        if name.startswith("idf:") and not args.all:
+            idf.update(c)
+        else:
+            rows.append((name, c))
+    rows.sort(key=lambda r: -(r[1]["data"] + r[1]["bss"]))
+    if idf:
+        rows.append(("idf (all)", idf))
+
+    print("%-22s %8s %8s %8s %8s %9s" % (("subsystem",) + kinds + ("dram",)))
+    own_dram = 0
+    for name, c in rows:
+        dram = c["data"] + c["bss"]
+        if not name.startswith("idf"):
+            own_dram += dram
+        print("%-22s %8d %8d %8d %8d %9d" %
+              ((name,) + tuple(c[k] for k in kinds) + (dram,)))
+
+    print("\nfirmware subsystems: %d bytes DRAM" % own_dram)
+    if args.budget and own_dram > args.budget:
+        print("over budget by %d bytes" % (own_dram - args.budget))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,73 @@
+// Replays timed key presses against the firmware's keypad UI flow
+// (src/ui_flow.cpp) and prints every screen and action with its timestamp.
+//
+//   cmake -S tools/ui_replay -B build/ui_replay && cmake --build build/ui_replay
+//   printf '0 1\n150 2\n300 3\n450 9\n600 #\n900 1\n' | build/ui_replay/ui_replay
+//
+// Input is one "<ms> <key>" pair per line, in time order; lines starting
+// with '#' are comments. The flow is ticked every
+// KEYPAD_POLL_MS like keypad_task does, until RUN_OUT_MS after the last key.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ui_flow.h"
+
+#define KEYPAD_POLL_MS  30
+#define RUN_OUT_MS      (UI_INACTIVITY_MS + 2000)
+
+static const char* g_pin = "1231";
+
+static bool check_pin(const char* pin)
+{
+    return ui_pin_equal(pin, g_pin);
+}
+
+static void print(uint32_t t, const UiOutput& out)
+{
+    static const char* const ACTIONS[] = { "NONE", "ARM", "DISARM_PIN_OK", "SET_PIN" };
+
+    if (out.action != UiAction::NONE) {
+        printf("%7u ms  action %s%s%s\n", t, ACTIONS[(int)out.action],
+               out.action == UiAction::SET_PIN ? " " : "",
+               out.action == UiAction::SET_PIN ? out.new_pin : "");
+    }
+    if (out.redraw) {
+        const char* nl = strchr(out.screen, '\n');
+        if (nl) printf("%7u ms  [%-16.*s|%-16s]\n", t, (int)(nl - out.screen), out.screen, nl + 1);
+        else    printf("%7u ms  [%-16s|%-16s]\n", t, out.screen, "");
+    }
+    if (out.release) printf("%7u ms  (alarm screen)\n", t);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1) g_pin = argv[1];
+
+    UiFlow ui;
+    ui_flow_init(&ui, check_pin);
+
+    uint32_t now = 0;
+    char line[64];
+
+    auto run_until = [&](uint32_t t) {
+        for (; now + KEYPAD_POLL_MS <= t; now += KEYPAD_POLL_MS) {
+            print(now, ui_flow_tick(&ui, now));
+        }
+    };
+
+    while (fgets(line, sizeof(line), stdin)) {
+        unsigned t;
+        char key;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%u %c", &t, &key) != 2) continue;
+
+        run_until(t);
+        now = t;
+        printf("%7u ms  key %c\n", t, key);
+        print(t, ui_flow_on_key(&ui, key, t));
+    }
+
+    run_until(now + RUN_OUT_MS);
+    return 0;
+}